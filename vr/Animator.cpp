@@ -0,0 +1,397 @@
+/** @file Animator.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Fixed timestep animation of the parts in the VR scene.
+  */
+
+#include "Animator.h"
+
+#include <vtkMapper.h>
+
+#include <cmath>
+
+namespace {
+
+constexpr double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.;
+
+/**
+ * @brief This function sets a 4x4 matrix to the identity.
+ * @param m is the matrix, row major.
+ */
+void identity(double m[16]) {
+    for (int i = 0; i < 16; i++)
+        m[i] = (i % 5 == 0) ? 1. : 0.;
+}
+
+/**
+ * @brief This function builds a rotation about x, then y, then z.
+ * @param angle is the rotation about each axis in degrees.
+ * @param m receives the 3x3 matrix, row major.
+ */
+void rotation3(const double angle[3], double m[9]) {
+    double cx = std::cos(angle[0] * DEGREES_TO_RADIANS), sx = std::sin(angle[0] * DEGREES_TO_RADIANS);
+    double cy = std::cos(angle[1] * DEGREES_TO_RADIANS), sy = std::sin(angle[1] * DEGREES_TO_RADIANS);
+    double cz = std::cos(angle[2] * DEGREES_TO_RADIANS), sz = std::sin(angle[2] * DEGREES_TO_RADIANS);
+
+    /* Rz * Ry * Rx */
+    m[0] = cz * cy;     m[1] = cz * sy * sx - sz * cx;  m[2] = cz * sy * cx + sz * sx;
+    m[3] = sz * cy;     m[4] = sz * sy * sx + cz * cx;  m[5] = sz * sy * cx - cz * sx;
+    m[6] = -sy;         m[7] = cy * sx;                 m[8] = cy * cx;
+}
+
+/**
+ * @brief This function multiplies a 4x4 matrix by an affine one (bottom row 0 0 0 1).
+ * @param a is the left matrix, row major.
+ * @param b is the right matrix, row major, its bottom row is not read.
+ * @param c receives a * b, it must not be a or b.
+ */
+void multiplyAffine(const double a[16], const double b[16], double c[16]) {
+    for (int i = 0; i < 4; i++) {
+        const double* row = a + 4 * i;
+        for (int j = 0; j < 3; j++)
+            c[4 * i + j] = row[0] * b[j] + row[1] * b[4 + j] + row[2] * b[8 + j];
+        c[4 * i + 3] = row[0] * b[3] + row[1] * b[7] + row[2] * b[11] + row[3];
+    }
+}
+
+/**
+ * @brief This function moves a value towards a target by at most a given amount.
+ * @param value is the value.
+ * @param target is the target.
+ * @param amount is the largest change allowed.
+ * @return the new value.
+ */
+double approach(double value, double target, double amount) {
+    if (value < target)
+        return value + amount < target ? value + amount : target;
+    return value - amount > target ? value - amount : target;
+}
+
+}
+
+/**
+ * @brief Constructor for the Animator class.
+ * @param step is the simulation step length in seconds.
+ */
+Animator::Animator(double step)
+    : stepSize(step), steps(0), explode(0.), previousExplode(0.), explodeTarget(0.), explodeRate(1.),
+      composeAll(false) {
+    for (int i = 0; i < 3; i++) {
+        rotation[i] = 0.;
+        centreSum[i] = 0.;
+    }
+}
+
+/**
+ * @brief This function starts animating an actor, its current position becomes the rest pose.
+ * @param actor is the actor, it must already be placed.
+ */
+void Animator::addPart(vtkActor* actor) {
+    if (actor == nullptr || hasPart(actor))
+        return;
+
+    Frame frame;
+    vtkMatrix4x4* user = actor->GetUserMatrix();
+    if (user != nullptr)
+        vtkMatrix4x4::DeepCopy(frame.transform, user);
+    else
+        identity(frame.transform);
+
+    /* The placement is the actor's own position and orientation, without any user matrix */
+    actor->SetUserMatrix(nullptr);
+    actor->GetMatrix(frame.placement);
+    vtkMatrix4x4::Invert(frame.placement, frame.inversePlacement);
+    vtkMatrix4x4::Multiply4x4(frame.transform, frame.placement, frame.outer);
+    for (int i = 0; i < 16; i++)
+        frame.pose[i] = frame.transform[i];
+
+    Track track = {};
+    double bounds[6] = { 0., 0., 0., 0., 0., 0. };
+    if (actor->GetMapper() != nullptr)
+        actor->GetMapper()->GetBounds(bounds);
+    for (int i = 0; i < 3; i++) {
+        track.centre[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+        centreSum[i] += track.centre[i];
+    }
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    matrix->DeepCopy(frame.pose);
+    actor->SetUserMatrix(matrix);
+
+    index[actor] = actors.size();
+    actors.push_back(actor);
+    matrices.push_back(matrix);
+    tracks.push_back(track);
+    states.push_back(State());
+    frames.push_back(frame);
+
+    /* The assembly centre moved, so every exploded offset changes */
+    composeAll = true;
+}
+
+/**
+ * @brief This function stops animating an actor and leaves it at its current pose.
+ * @param actor is the actor.
+ */
+void Animator::removePart(vtkActor* actor) {
+    auto it = index.find(actor);
+    if (it == index.end())
+        return;
+
+    size_t i = it->second;
+    size_t last = actors.size() - 1;
+    for (int k = 0; k < 3; k++)
+        centreSum[k] -= tracks[i].centre[k];
+
+    /* Keep the arrays contiguous by moving the last part into the gap */
+    if (i != last) {
+        actors[i] = actors[last];
+        matrices[i] = matrices[last];
+        tracks[i] = tracks[last];
+        states[i] = states[last];
+        frames[i] = frames[last];
+        index[actors[i]] = i;
+    }
+
+    actors.pop_back();
+    matrices.pop_back();
+    tracks.pop_back();
+    states.pop_back();
+    frames.pop_back();
+    index.erase(it);
+    composeAll = true;
+}
+
+/**
+ * @brief This function checks if an actor is animated.
+ * @param actor is the actor.
+ * @return true if addPart() has been called for it.
+ */
+bool Animator::hasPart(vtkActor* actor) const {
+    return index.find(actor) != index.end();
+}
+
+/**
+ * @brief This function sets the transform applied on top of an actor's animation.
+ * @param actor is the actor.
+ * @param matrix is the 4x4 matrix, row major.
+ */
+void Animator::setTransform(vtkActor* actor, const double matrix[16]) {
+    auto it = index.find(actor);
+    if (it == index.end())
+        return;
+
+    Frame& frame = frames[it->second];
+    for (int i = 0; i < 16; i++)
+        frame.transform[i] = matrix[i];
+    vtkMatrix4x4::Multiply4x4(frame.transform, frame.placement, frame.outer);
+    states[it->second].moving = true;
+}
+
+/**
+ * @brief This function sets how one part moves on its own.
+ * @param actor is the actor.
+ * @param rotate is the rotation rate around the model axes, in degrees per second.
+ * @param translate is the translation rate along the model axes, in model units per second.
+ */
+void Animator::setPartMotion(vtkActor* actor, const double rotate[3], const double translate[3]) {
+    auto it = index.find(actor);
+    if (it == index.end())
+        return;
+
+    for (int i = 0; i < 3; i++) {
+        tracks[it->second].rotate[i] = rotate[i];
+        tracks[it->second].translate[i] = translate[i];
+    }
+}
+
+/**
+ * @brief This function sets the rotation rate applied to every part around one model axis.
+ * @param axis is 0, 1 or 2 for x, y or z.
+ * @param degreesPerSecond is the rotation rate.
+ */
+void Animator::setRotation(int axis, double degreesPerSecond) {
+    if (axis >= 0 && axis < 3)
+        rotation[axis] = degreesPerSecond;
+}
+
+/**
+ * @brief This function sets the exploded view amount the parts move towards.
+ * @param amount is the target amount, 0 for the assembled view.
+ * @param perSecond is how fast the amount changes.
+ */
+void Animator::setExplode(double amount, double perSecond) {
+    explodeTarget = amount;
+    explodeRate = perSecond > 0. ? perSecond : 1.;
+}
+
+/**
+ * @brief This function advances the simulation to a time and updates the actor matrices.
+ * @param seconds is the time since the animation started.
+ * @return the number of simulation steps taken.
+ */
+int Animator::update(double seconds) {
+    /* The step count is derived from the absolute time, not accumulated frame by frame, so
+     * rounding does not depend on the frame rate */
+    uint64_t target = seconds > 0. ? uint64_t(seconds / stepSize) : 0;
+    uint64_t count = target > steps ? target - steps : 0;
+
+    /* After a long stall the lost time is skipped rather than simulated, so catching up can
+     * never take longer than the stall did */
+    if (count > MAX_CATCH_UP) {
+        steps += count - MAX_CATCH_UP;
+        count = MAX_CATCH_UP;
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+        step();
+
+    double alpha = (seconds - double(steps) * stepSize) / stepSize;
+    compose(alpha < 0. ? 0. : (alpha > 1. ? 1. : alpha));
+    return int(count);
+}
+
+/**
+ * @brief This function returns the simulation step length.
+ * @return the step length in seconds.
+ */
+double Animator::stepLength() const {
+    return stepSize;
+}
+
+/**
+ * @brief This function returns the number of simulation steps taken since the animation started.
+ * @return the number of steps.
+ */
+uint64_t Animator::stepCount() const {
+    return steps;
+}
+
+/**
+ * @brief This function returns the number of animated parts.
+ * @return the number of parts.
+ */
+int Animator::partCount() const {
+    return int(actors.size());
+}
+
+/**
+ * @brief This function returns the pose shown for a part after the last update().
+ * @param actor is the actor.
+ * @param matrix receives the 4x4 user matrix, row major.
+ * @return false if the actor is not animated.
+ */
+bool Animator::getPose(vtkActor* actor, double matrix[16]) const {
+    auto it = index.find(actor);
+    if (it == index.end())
+        return false;
+
+    for (int i = 0; i < 16; i++)
+        matrix[i] = frames[it->second].pose[i];
+    return true;
+}
+
+/**
+ * @brief This function returns the actors whose user matrix was changed by the last update().
+ * @return the moved actors.
+ */
+const std::vector<vtkActor*>& Animator::movedParts() const {
+    return moved;
+}
+
+/**
+ * @brief This function advances every part by one simulation step.
+ */
+void Animator::step() {
+    previousExplode = explode;
+    explode = approach(explode, explodeTarget, explodeRate * stepSize);
+
+    const size_t n = states.size();
+    for (size_t i = 0; i < n; i++) {
+        const Track& track = tracks[i];
+        State& state = states[i];
+
+        for (int k = 0; k < 3; k++) {
+            /* Keep angles small so precision does not drop over a long session */
+            double angle = state.angle[k];
+            if (angle >= 360. || angle <= -360.)
+                angle = std::fmod(angle, 360.);
+
+            state.previousAngle[k] = angle;
+            state.angle[k] = angle + (rotation[k] + track.rotate[k]) * stepSize;
+
+            state.previousOffset[k] = state.offset[k];
+            state.offset[k] += track.translate[k] * stepSize;
+        }
+    }
+
+    steps++;
+}
+
+/**
+ * @brief This function composes the interpolated pose of every part into its actor's user matrix.
+ * Parts that have not moved since they were last composed are skipped.
+ * @param alpha is how far the current time is between the previous and current step, 0-1.
+ */
+void Animator::compose(double alpha) {
+    moved.clear();
+    const size_t n = states.size();
+    if (n == 0)
+        return;
+
+    double centre[3];
+    for (int k = 0; k < 3; k++)
+        centre[k] = centreSum[k] / double(n);
+
+    double amount = previousExplode + (explode - previousExplode) * alpha;
+    bool exploding = explode != previousExplode;
+
+    /* Most parts share the global rotation, so the last rotation built is reused when the angles match */
+    double lastAngle[3] = { NAN, NAN, NAN };
+    double motion[16] = { 1., 0., 0., 0., 0., 1., 0., 0., 0., 0., 1., 0., 0., 0., 0., 1. };
+    double rotation[9];
+
+    for (size_t i = 0; i < n; i++) {
+        const Track& track = tracks[i];
+        State& state = states[i];
+        Frame& frame = frames[i];
+
+        bool changed = exploding;
+        for (int k = 0; k < 3; k++) {
+            if (state.angle[k] != state.previousAngle[k] || state.offset[k] != state.previousOffset[k])
+                changed = true;
+        }
+
+        /* A part that has just stopped is composed once more to show its final pose */
+        bool needed = changed || state.moving || composeAll;
+        state.moving = changed;
+        if (!needed)
+            continue;
+
+        double angle[3];
+        for (int k = 0; k < 3; k++) {
+            angle[k] = state.previousAngle[k] + (state.angle[k] - state.previousAngle[k]) * alpha;
+            motion[4 * k + 3] = state.previousOffset[k] + (state.offset[k] - state.previousOffset[k]) * alpha
+                                + amount * (track.centre[k] - centre[k]);
+        }
+
+        if (angle[0] != lastAngle[0] || angle[1] != lastAngle[1] || angle[2] != lastAngle[2]) {
+            rotation3(angle, rotation);
+            for (int k = 0; k < 3; k++) {
+                lastAngle[k] = angle[k];
+                motion[4 * k] = rotation[3 * k];
+                motion[4 * k + 1] = rotation[3 * k + 1];
+                motion[4 * k + 2] = rotation[3 * k + 2];
+            }
+        }
+
+        /* pose = transform * placement * motion * placement^-1, so the motion happens in model coordinates */
+        double a[16];
+        multiplyAffine(motion, frame.inversePlacement, a);
+        multiplyAffine(frame.outer, a, frame.pose);
+
+        matrices[i]->DeepCopy(frame.pose);
+        moved.push_back(actors[i]);
+    }
+
+    composeAll = false;
+}
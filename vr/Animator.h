@@ -0,0 +1,197 @@
+/** @file Animator.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Fixed timestep animation of the parts in the VR scene.
+  */
+
+#ifndef VIEWER_ANIMATOR_H
+#define VIEWER_ANIMATOR_H
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkMatrix4x4.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class Animator
+ * @brief The Animator class moves parts by simulation time rather than by frames, so animations run at the same speed whatever the frame rate.
+ *
+ * The simulation advances in fixed steps (20 ms by default) and each frame shows the pose
+ * interpolated between the last two steps, so the pose at a given time does not depend on how
+ * that time was split into frames (after a stall of more than 50 steps the lost time is skipped).
+ * Each part has a track (rotation and translation rates, its exploded view direction) and a
+ * state (angles and offset); both are kept in contiguous arrays that are updated in one pass
+ * per step. Once per frame the interpolated pose is composed into
+ * each actor's user matrix, together with the transform last set with setTransform().
+ *
+ * Rotations and translations are applied in the part's model coordinates about the model origin,
+ * so parts of one assembly move together. It is not thread safe, the VR thread owns it.
+ */
+class Animator {
+public:
+    /**
+     * @brief Constructor for the Animator class.
+     * @param step is the simulation step length in seconds.
+     */
+    explicit Animator(double step = 0.02);
+
+    /**
+     * @brief This function starts animating an actor, its current position becomes the rest pose.
+     * A user matrix already set on the actor is kept as its transform (see setTransform).
+     * @param actor is the actor, it must already be placed.
+     */
+    void addPart(vtkActor* actor);
+
+    /**
+     * @brief This function stops animating an actor and leaves it at its current pose.
+     * @param actor is the actor.
+     */
+    void removePart(vtkActor* actor);
+
+    /**
+     * @brief This function checks if an actor is animated.
+     * @param actor is the actor.
+     * @return true if addPart() has been called for it.
+     */
+    bool hasPart(vtkActor* actor) const;
+
+    /**
+     * @brief This function sets the transform applied on top of an actor's animation (in world coordinates).
+     * @param actor is the actor.
+     * @param matrix is the 4x4 matrix, row major.
+     */
+    void setTransform(vtkActor* actor, const double matrix[16]);
+
+    /**
+     * @brief This function sets how one part moves on its own, in addition to the global rotation.
+     * @param actor is the actor.
+     * @param rotate is the rotation rate around the model x, y and z axes, in degrees per second.
+     * @param translate is the translation rate along the model axes, in model units per second.
+     */
+    void setPartMotion(vtkActor* actor, const double rotate[3], const double translate[3]);
+
+    /**
+     * @brief This function sets the rotation rate applied to every part around one model axis.
+     * @param axis is 0, 1 or 2 for x, y or z.
+     * @param degreesPerSecond is the rotation rate.
+     */
+    void setRotation(int axis, double degreesPerSecond);
+
+    /**
+     * @brief This function sets the exploded view amount the parts move towards.
+     * At 1 each part is moved away from the centre of all parts by its own distance from that centre.
+     * @param amount is the target amount, 0 for the assembled view.
+     * @param perSecond is how fast the amount changes.
+     */
+    void setExplode(double amount, double perSecond = 1.);
+
+    /**
+     * @brief This function advances the simulation to a time and updates the actor matrices, it is called once per frame.
+     * @param seconds is the time since the animation started.
+     * @return the number of simulation steps taken.
+     */
+    int update(double seconds);
+
+    /**
+     * @brief This function returns the simulation step length.
+     * @return the step length in seconds.
+     */
+    double stepLength() const;
+
+    /**
+     * @brief This function returns the number of simulation steps taken since the animation started.
+     * @return the number of steps.
+     */
+    uint64_t stepCount() const;
+
+    /**
+     * @brief This function returns the number of animated parts.
+     * @return the number of parts.
+     */
+    int partCount() const;
+
+    /**
+     * @brief This function returns the pose shown for a part after the last update().
+     * @param actor is the actor.
+     * @param matrix receives the 4x4 user matrix, row major.
+     * @return false if the actor is not animated.
+     */
+    bool getPose(vtkActor* actor, double matrix[16]) const;
+
+    /**
+     * @brief This function returns the actors whose user matrix was changed by the last update(), so their bounds can be refitted.
+     * @return the moved actors.
+     */
+    const std::vector<vtkActor*>& movedParts() const;
+
+private:
+    /**
+     * @struct Track
+     * @brief The Track structure holds how a part moves, it only changes when a command changes it.
+     */
+    struct Track {
+        double      rotate[3];          /**< Own rotation rate, degrees per second */
+        double      translate[3];       /**< Own translation rate, model units per second */
+        double      centre[3];          /**< Centre of the part's bounds in model coordinates */
+    };
+
+    /**
+     * @struct State
+     * @brief The State structure holds the simulated pose of a part at the last two steps.
+     */
+    struct State {
+        double      angle[3];           /**< Rotation at the current step, degrees */
+        double      offset[3];          /**< Translation at the current step */
+        double      previousAngle[3];   /**< Rotation at the previous step */
+        double      previousOffset[3];  /**< Translation at the previous step */
+        bool        moving;             /**< True if the part moved when it was last composed */
+    };
+
+    /**
+     * @struct Frame
+     * @brief The Frame structure holds the fixed matrices a part's pose is composed with.
+     */
+    struct Frame {
+        double      placement[16];      /**< Actor matrix without the user matrix */
+        double      inversePlacement[16]; /**< Inverse of placement */
+        double      transform[16];      /**< Transform set with setTransform() */
+        double      outer[16];          /**< transform * placement */
+        double      pose[16];           /**< User matrix shown after the last update() */
+    };
+
+    /**
+     * @brief This function advances every part by one simulation step.
+     */
+    void step();
+
+    /**
+     * @brief This function composes the interpolated pose of every part into its actor's user matrix.
+     * @param alpha is how far the current time is between the previous and current step, 0-1.
+     */
+    void compose(double alpha);
+
+    static constexpr uint64_t                   MAX_CATCH_UP = 50; /**< Most steps simulated in one update */
+
+    double                                      stepSize;       /**< Simulation step length in seconds */
+    uint64_t                                    steps;          /**< Steps taken since the animation started */
+    double                                      rotation[3];    /**< Global rotation rates, degrees per second */
+    double                                      explode;        /**< Exploded view amount at the current step */
+    double                                      previousExplode; /**< Exploded view amount at the previous step */
+    double                                      explodeTarget;  /**< Exploded view amount being moved towards */
+    double                                      explodeRate;    /**< Change of the exploded view amount per second */
+    double                                      centreSum[3];   /**< Sum of the part centres, for the assembly centre */
+    bool                                        composeAll;     /**< True if every part must be composed at the next update */
+
+    /* One entry per part, at the same index in each array */
+    std::vector<vtkSmartPointer<vtkActor>>      actors;         /**< Animated actors */
+    std::vector<vtkSmartPointer<vtkMatrix4x4>>  matrices;       /**< User matrix of each actor */
+    std::vector<Track>                          tracks;         /**< Motion of each part */
+    std::vector<State>                          states;         /**< Simulated pose of each part */
+    std::vector<Frame>                          frames;         /**< Fixed matrices of each part */
+    std::unordered_map<vtkActor*, size_t>       index;          /**< Position of each actor in the arrays */
+    std::vector<vtkActor*>                      moved;          /**< Actors composed at the last update */
+};
+
+#endif
@@ -0,0 +1,69 @@
+/** @file BVHCuller.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Frustum culler that uses a view's PartBVH.
+  */
+
+#include "BVHCuller.h"
+
+#include <vtkCamera.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderer.h>
+
+vtkStandardNewMacro(BVHCuller);
+
+/**
+ * @brief Constructor for the BVHCuller class.
+ */
+BVHCuller::BVHCuller()
+    : Index(nullptr), VisibleParts(0) {
+}
+
+/**
+ * @brief This function prints the culler settings, used by VTK for debugging.
+ * @param os is the stream to print to.
+ * @param indent is the indentation to use.
+ */
+void BVHCuller::PrintSelf(ostream& os, vtkIndent indent) {
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Indexed parts: " << (this->Index ? this->Index->size() : 0) << "\n";
+    os << indent << "VisibleParts: " << this->VisibleParts << "\n";
+}
+
+/**
+ * @brief This function sets the index the frustum is tested against.
+ * @param index is the view's index, or nullptr to keep every prop.
+ */
+void BVHCuller::SetIndex(PartBVH* index) {
+    this->Index = index;
+}
+
+/**
+ * @brief This function removes the props outside the renderer's camera frustum from the list.
+ * @param renderer is the renderer.
+ * @param propList is the list of props to draw.
+ * @param listLength is the length of the list.
+ * @param initialized is left unchanged.
+ * @return 0.
+ */
+double BVHCuller::Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int& initialized) {
+    vtkCamera* camera = renderer->GetActiveCamera();
+    if (this->Index == nullptr || camera == nullptr)
+        return 0.;
+
+    /* The same planes vtkFrustumCoverageCuller uses, so in VR each eye is culled with its own frustum */
+    double aspect[2];
+    renderer->GetAspect(aspect);
+    double planes[24];
+    camera->GetFrustumPlanes(aspect[0] / aspect[1], planes);
+    this->VisibleParts = this->Index->cull(planes);
+
+    /* Keep the order of the props that remain, the renderer draws them in list order */
+    int kept = 0;
+    for (int i = 0; i < listLength; i++) {
+        if (this->Index->inFrustum(propList[i]))
+            propList[kept++] = propList[i];
+    }
+    listLength = kept;
+
+    return 0.;
+}
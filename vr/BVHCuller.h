@@ -0,0 +1,79 @@
+/** @file BVHCuller.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Frustum culler that uses a view's PartBVH.
+  */
+
+#ifndef VIEWER_BVHCULLER_H
+#define VIEWER_BVHCULLER_H
+
+#include "PartBVH.h"
+
+#include <vtkCuller.h>
+
+/**
+ * @class BVHCuller
+ * @brief The BVHCuller class removes the part actors outside the camera's view from a renderer's prop list before they are drawn.
+ *
+ * It replaces vtkFrustumCoverageCuller, which tests the bounds of every prop one by one each
+ * render. The frustum is tested against the boxes of a PartBVH instead, so whole branches of
+ * parts out of view are dropped with one test. Props the index does not hold (background
+ * geometry, VR controller models) are always kept. The index is owned by the view, which keeps it
+ * up to date as actors are added, removed and moved.
+ */
+class BVHCuller : public vtkCuller {
+public:
+    /**
+     * @brief This function creates a new culler (VTK objects are created through New()).
+     * @return a pointer to the new culler.
+     */
+    static BVHCuller* New();
+    vtkTypeMacro(BVHCuller, vtkCuller);
+
+    /**
+     * @brief This function prints the culler settings, used by VTK for debugging.
+     * @param os is the stream to print to.
+     * @param indent is the indentation to use.
+     */
+    void PrintSelf(ostream& os, vtkIndent indent) override;
+
+    /**
+     * @brief This function sets the index the frustum is tested against.
+     * @param index is the view's index, or nullptr to keep every prop.
+     */
+    void SetIndex(PartBVH* index);
+
+    /**
+     * @brief This function removes the props outside the renderer's camera frustum from the list, it is called by the renderer.
+     * @param renderer is the renderer.
+     * @param propList is the list of props to draw, culled props are removed from it.
+     * @param listLength is the length of the list, updated to the number of props kept.
+     * @param initialized is left unchanged, the culler does not allocate render times.
+     * @return 0, no render time is allocated.
+     */
+    double Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int& initialized) override;
+
+    /**
+     * @brief Number of indexed part actors found inside the frustum at the last render.
+     */
+    vtkGetMacro(VisibleParts, int);
+
+protected:
+    /**
+     * @brief Constructor for the BVHCuller class.
+     */
+    BVHCuller();
+
+    /**
+     * @brief Destructor for the BVHCuller class.
+     */
+    ~BVHCuller() override = default;
+
+private:
+    BVHCuller(const BVHCuller&) = delete;
+    void operator=(const BVHCuller&) = delete;
+
+    PartBVH*                                    Index;              /**< Index of the view's part actors */
+    int                                         VisibleParts;       /**< Part actors in the frustum at the last render */
+};
+
+#endif
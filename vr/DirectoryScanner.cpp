@@ -0,0 +1,318 @@
+/** @file DirectoryScanner.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Background scanner that mirrors a folder tree of STL files in the part tree.
+  */
+
+#include "DirectoryScanner.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "STLLoader.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+
+/* Entries a worker finds before it hands them to the GUI thread */
+const int BATCH_SIZE = 256;
+
+/* Names are sorted the way a file manager sorts them, case aside */
+bool byName(const QString& a, const QString& b) {
+    return a.compare(b, Qt::CaseInsensitive) < 0;
+}
+
+}
+
+/**
+ * @class ScanTask
+ * @brief The ScanTask class is the unit of work run by the pool, it lists one folder.
+ */
+class ScanTask : public QRunnable {
+public:
+    ScanTask(DirectoryScanner* scanner, int generation, int folder, const QString& path)
+        : scanner(scanner), generation(generation), folder(folder), path(path) {
+    }
+
+    void run() override {
+        /* Subfolders are only listed once the batch naming them has been handed over, so
+         * their entries always reach the GUI thread after the folder they are in */
+        QList<QPair<int, QString>> subfolders;
+        DirectoryScanner::Batch batch = { generation, folder, {}, {}, false };
+
+        QDirIterator entries(path, { "*.stl" }, QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable);
+        while (entries.hasNext() && scanner->generation.load() == generation) {
+            entries.next();
+            QFileInfo info = entries.fileInfo();
+            if (info.isDir()) {
+                if (info.isSymLink())
+                    continue;
+                int number = scanner->nextFolder++;
+                batch.folders.append({ number, info.fileName() });
+                subfolders.append({ number, info.filePath() });
+            }
+            else {
+                batch.files.append(info.filePath());
+            }
+
+            if (batch.folders.size() + batch.files.size() >= BATCH_SIZE)
+                hand(batch, subfolders);
+        }
+
+        batch.complete = true;
+        hand(batch, subfolders);
+
+        /* The tasks of the subfolders were counted before this one ends, so the count only reaches
+         * zero when the whole tree has been listed, and that is the last thing handed over */
+        if (--scanner->running == 0) {
+            DirectoryScanner* target = scanner;
+            QMetaObject::invokeMethod(scanner, [target]() {
+                target->deliverDone();
+            }, Qt::QueuedConnection);
+        }
+    }
+
+private:
+    /* Hands the entries found so far to the GUI thread and starts listing the subfolders among them */
+    void hand(DirectoryScanner::Batch& batch, QList<QPair<int, QString>>& subfolders) {
+        std::sort(batch.folders.begin(), batch.folders.end(), [](const QPair<int, QString>& a, const QPair<int, QString>& b) {
+            return byName(a.second, b.second);
+        });
+        std::sort(batch.files.begin(), batch.files.end(), byName);
+
+        DirectoryScanner* target = scanner;
+        DirectoryScanner::Batch entries = batch;
+        QMetaObject::invokeMethod(scanner, [target, entries]() {
+            target->deliver(entries);
+        }, Qt::QueuedConnection);
+
+        for (const QPair<int, QString>& subfolder : subfolders)
+            scanner->start(generation, subfolder.first, subfolder.second);
+
+        batch.folders.clear();
+        batch.files.clear();
+        subfolders.clear();
+    }
+
+    DirectoryScanner*   scanner;        /**< Scanner that owns the task */
+    int                 generation;     /**< Scan the task belongs to */
+    int                 folder;         /**< Number of the folder listed */
+    QString             path;           /**< Path of the folder listed */
+};
+
+/**
+ * @brief Constructor for the DirectoryScanner class.
+ * @param model is the tree the rows are added to.
+ * @param loader is the loader the files found are queued on, or nullptr to only build the rows.
+ * @param parent is a pointer to the parent QObject.
+ */
+DirectoryScanner::DirectoryScanner(ModelPartList* model, STLLoader* loader, QObject* parent)
+    : QObject(parent), model(model), loader(loader), generation(0), nextFolder(0), running(0),
+      flushPending(false), scanning(false), lazyThreshold(0), foldersListed(0), filesFound(0) {
+    /* Listing a folder mostly waits for the disk, so one task per core keeps several requests in flight */
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &DirectoryScanner::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &DirectoryScanner::handleRowsAboutToBeRemoved);
+}
+
+/**
+ * @brief Destructor for the DirectoryScanner class, cancels the scan and waits for the workers.
+ */
+DirectoryScanner::~DirectoryScanner() {
+    generation++;
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function starts scanning a directory, it may be called while other scans run.
+ * @param directory is the directory, it becomes a folder row under the parent.
+ * @param parent is the item the directory's row is added under, invalid for the root.
+ */
+void DirectoryScanner::scan(const QString& directory, const QModelIndex& parent) {
+    QFileInfo info(directory);
+    if (!info.isDir())
+        return;
+
+    if (!scanning) {
+        foldersListed = 0;
+        filesFound = 0;
+    }
+    scanning = true;
+
+    int folder = nextFolder++;
+    QString name = info.fileName().isEmpty() ? QDir::toNativeSeparators(info.absoluteFilePath()) : info.fileName();
+    folders.insert(folder, { -1, name, nullptr, 0 });
+    roots.insert(folder, QPersistentModelIndex(parent));
+    start(generation.load(), folder, info.absoluteFilePath());
+}
+
+/**
+ * @brief This function stops every scan. Rows already added are kept.
+ */
+void DirectoryScanner::cancel() {
+    /* Tasks already queued see the new generation and end straight away, so the running count
+     * still reaches zero; clearing the pool would leave it stuck */
+    generation++;
+    delivered.clear();
+    folders.clear();
+    roots.clear();
+
+    if (scanning) {
+        scanning = false;
+        emit finished();
+    }
+}
+
+/**
+ * @brief This function sets how many files of one folder become parts straight away, the rest are added lazily.
+ * @param files is the number of files, 0 to add every file straight away.
+ */
+void DirectoryScanner::setLazyThreshold(int files) {
+    lazyThreshold = std::max(files, 0);
+}
+
+/**
+ * @brief This function returns true while a scan has not finished.
+ * @return true if the scanner is busy.
+ */
+bool DirectoryScanner::isBusy() const {
+    return scanning;
+}
+
+/**
+ * @brief This function blocks until the workers are idle. The last entries are added by the event loop afterwards.
+ */
+void DirectoryScanner::waitForDone() {
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function stops the scans when rows are removed, folders found later could belong to them.
+ */
+void DirectoryScanner::handleRowsAboutToBeRemoved() {
+    cancel();
+}
+
+/**
+ * @brief This function starts the task that lists a folder, it is safe to call from any thread.
+ * @param generation is the scan the folder belongs to.
+ * @param folder is the number of the folder.
+ * @param path is the path of the folder.
+ */
+void DirectoryScanner::start(int generation, int folder, const QString& path) {
+    running++;
+    pool.start(new ScanTask(this, generation, folder, path));
+}
+
+/**
+ * @brief This function runs on the GUI thread when a worker has found entries, they are added with the next batches.
+ * @param batch are the entries.
+ */
+void DirectoryScanner::deliver(const Batch& batch) {
+    if (batch.generation != generation.load())
+        return;
+
+    delivered.append(batch);
+
+    /* Entries from every worker that arrive in this event loop iteration are added together */
+    if (!flushPending) {
+        flushPending = true;
+        QTimer::singleShot(0, this, &DirectoryScanner::flushDelivered);
+    }
+}
+
+/**
+ * @brief This function runs on the GUI thread when the last task has finished.
+ */
+void DirectoryScanner::deliverDone() {
+    /* Every scan was cancelled, or a scan started meanwhile has tasks of its own */
+    if (!scanning || running.load() != 0)
+        return;
+
+    flushDelivered();
+    scanning = false;
+    folders.clear();
+    roots.clear();
+    emit finished();
+}
+
+/**
+ * @brief This function adds the entries delivered since it last ran to the tree.
+ * Folders are registered in the order they were found, then the files of each folder are added
+ * in one insertion. A folder's row is made when its first file is added.
+ */
+void DirectoryScanner::flushDelivered() {
+    flushPending = false;
+    if (delivered.isEmpty())
+        return;
+
+    QList<int> order;
+    QHash<int, QStringList> files;
+    for (const Batch& batch : delivered) {
+        for (const QPair<int, QString>& subfolder : batch.folders)
+            folders.insert(subfolder.first, { batch.folder, subfolder.second, nullptr, 0 });
+        if (!batch.files.isEmpty()) {
+            if (!files.contains(batch.folder))
+                order.append(batch.folder);
+            files[batch.folder].append(batch.files);
+        }
+        if (batch.complete)
+            foldersListed++;
+    }
+    delivered.clear();
+
+    for (int folder : order) {
+        const QStringList& paths = files[folder];
+        ModelPart* part = folderPart(folder);
+        QModelIndex index = model->indexOf(part);
+        filesFound += paths.size();
+
+        /* The first files of a folder become parts and are read now, the rest when a view shows them */
+        Folder& entry = folders[folder];
+        int now = lazyThreshold > 0 ? std::max(0, std::min(int(paths.size()), lazyThreshold - entry.files)) : int(paths.size());
+        entry.files += paths.size();
+
+        QList<QList<QVariant>> rows;
+        rows.reserve(paths.size());
+        for (const QString& path : paths)
+            rows.append({ QFileInfo(path).fileName(), QString("true") });
+
+        QList<ModelPart*> parts = model->appendChildren(index, rows.mid(0, now));
+        for (int i = 0; i < parts.size(); i++) {
+            parts[i]->setFileName(paths[i]);
+            if (loader != nullptr)
+                loader->load(parts[i], paths[i]);
+        }
+        if (now < paths.size())
+            model->appendLater(index, rows.mid(now), paths.mid(now));
+    }
+
+    emit progressChanged(foldersListed, filesFound);
+}
+
+/**
+ * @brief This function returns the row of a folder, making it and the rows of the folders it is in when needed.
+ * @param folder is the number of the folder.
+ * @return the row.
+ */
+ModelPart* DirectoryScanner::folderPart(int folder) {
+    const Folder& entry = folders[folder];
+    if (entry.part != nullptr)
+        return entry.part;
+
+    /* The hash may grow while the folders above are made, so nothing is kept from the entry across the call */
+    int above = entry.parent;
+    QString name = entry.name;
+    QModelIndex parent = above < 0 ? QModelIndex(roots.value(folder)) : model->indexOf(folderPart(above));
+    QList<ModelPart*> rows = model->appendChildren(parent, { { name, QString("true") } });
+
+    folders[folder].part = rows.first();
+    return rows.first();
+}
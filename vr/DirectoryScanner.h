@@ -0,0 +1,179 @@
+/** @file DirectoryScanner.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Background scanner that mirrors a folder tree of STL files in the part tree.
+  */
+
+#ifndef VIEWER_DIRECTORYSCANNER_H
+#define VIEWER_DIRECTORYSCANNER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QModelIndex>
+#include <QPair>
+#include <QPersistentModelIndex>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+
+class ModelPart;
+class ModelPartList;
+class STLLoader;
+
+/**
+ * @class DirectoryScanner
+ * @brief The DirectoryScanner class walks a directory and its subfolders on worker threads and
+ * builds the matching folder rows and part rows in the tree as it goes.
+ *
+ * Every folder is listed by its own task, so the subfolders of a folder are listed in parallel
+ * while the rest of it is still being read. Entries are handed to the GUI thread in batches and
+ * the batches that arrive in the same event loop iteration are inserted together, one insertion
+ * per folder, so the first rows appear as soon as the first folder is listed rather than when the
+ * whole tree has been walked. A folder row is only made once an STL file is found in it or below
+ * it, so folders without parts never appear. Each file found is queued on the STLLoader, which
+ * reads the files in parallel while the scan goes on. Folders with many files only make the first
+ * rows into parts straight away, the rest are added lazily (see ModelPartList::appendLater()).
+ *
+ * Symbolic links to folders are not followed, so a link back up the tree cannot make the scan loop.
+ */
+class DirectoryScanner : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor for the DirectoryScanner class.
+     * @param model is the tree the rows are added to.
+     * @param loader is the loader the files found are queued on, or nullptr to only build the rows.
+     * @param parent is a pointer to the parent QObject.
+     */
+    DirectoryScanner(ModelPartList* model, STLLoader* loader, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor for the DirectoryScanner class, cancels the scan and waits for the workers.
+     */
+    ~DirectoryScanner();
+
+    /**
+     * @brief This function starts scanning a directory, it may be called while other scans run.
+     * @param directory is the directory, it becomes a folder row under the parent.
+     * @param parent is the item the directory's row is added under, invalid for the root.
+     */
+    void scan(const QString& directory, const QModelIndex& parent);
+
+    /**
+     * @brief This function stops every scan. Rows already added are kept.
+     */
+    void cancel();
+
+    /**
+     * @brief This function sets how many files of one folder become parts straight away, the rest are added lazily.
+     * @param files is the number of files, 0 to add every file straight away.
+     */
+    void setLazyThreshold(int files);
+
+    /**
+     * @brief This function returns true while a scan has not finished.
+     * @return true if the scanner is busy.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief This function blocks until the workers are idle. The last entries are added by the event loop afterwards.
+     */
+    void waitForDone();
+
+signals:
+    /**
+     * @brief This signal is emitted on the GUI thread whenever entries have been added to the tree.
+     * @param folders is the number of folders listed so far.
+     * @param files is the number of STL files found so far.
+     */
+    void progressChanged(int folders, int files);
+
+    /**
+     * @brief This signal is emitted when every scan has finished or been cancelled.
+     */
+    void finished();
+
+private slots:
+    /**
+     * @brief This function stops the scans when rows are removed, folders found later could belong to them.
+     */
+    void handleRowsAboutToBeRemoved();
+
+private:
+    friend class ScanTask;
+
+    /**
+     * @struct Folder
+     * @brief The Folder structure holds a folder found by a worker and its row, once it has one.
+     */
+    struct Folder {
+        int             parent;         /**< Folder the folder is in, -1 for a scanned directory */
+        QString         name;           /**< Name shown in the tree */
+        ModelPart*      part;           /**< Row of the folder, nullptr until a file is found in or below it */
+        int             files;          /**< Files added to the folder so far */
+    };
+
+    /**
+     * @struct Batch
+     * @brief The Batch structure holds entries of one folder found by a worker, it is handed to the GUI thread.
+     */
+    struct Batch {
+        int                             generation;     /**< Scan the entries belong to */
+        int                             folder;         /**< Folder the entries are in */
+        QList<QPair<int, QString>>      folders;        /**< Subfolders found, with the number given to each */
+        QStringList                     files;          /**< STL files found, full paths */
+        bool                            complete;       /**< True for the last entries of the folder */
+    };
+
+    /**
+     * @brief This function starts the task that lists a folder, it is safe to call from any thread.
+     * @param generation is the scan the folder belongs to.
+     * @param folder is the number of the folder.
+     * @param path is the path of the folder.
+     */
+    void start(int generation, int folder, const QString& path);
+
+    /**
+     * @brief This function runs on the GUI thread when a worker has found entries, they are added with the next batches.
+     * @param batch are the entries.
+     */
+    void deliver(const Batch& batch);
+
+    /**
+     * @brief This function runs on the GUI thread when the last task has finished.
+     */
+    void deliverDone();
+
+    /**
+     * @brief This function adds the entries delivered since it last ran to the tree.
+     */
+    void flushDelivered();
+
+    /**
+     * @brief This function returns the row of a folder, making it and the rows of the folders it is in when needed.
+     * @param folder is the number of the folder.
+     * @return the row.
+     */
+    ModelPart* folderPart(int folder);
+
+    ModelPartList*                  model;          /**< Tree the rows are added to */
+    STLLoader*                      loader;         /**< Loader the files are queued on */
+    QThreadPool                     pool;           /**< Worker threads, one per core */
+    std::atomic<int>                generation;     /**< Incremented on cancel so stale entries are dropped */
+    std::atomic<int>                nextFolder;     /**< Number given to the next folder found */
+    std::atomic<int>                running;        /**< Tasks started and not finished, over all scans */
+    QHash<int, Folder>              folders;        /**< Folders of the current scans, by number */
+    QHash<int, QPersistentModelIndex> roots;        /**< Item each scanned directory is added under */
+    QList<Batch>                    delivered;      /**< Entries not yet added */
+    bool                            flushPending;   /**< True if flushDelivered() is queued */
+    bool                            scanning;       /**< True while a scan has not finished */
+    int                             lazyThreshold;  /**< Files of a folder made into parts straight away */
+    int                             foldersListed;  /**< Folders listed in the current scans */
+    int                             filesFound;     /**< STL files found in the current scans */
+};
+
+#endif
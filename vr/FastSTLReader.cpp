@@ -0,0 +1,293 @@
+/** @file FastSTLReader.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Memory-mapped STL reader used in place of vtkSTLReader.
+  */
+
+#include "FastSTLReader.h"
+#include "MeshPreparation.h"
+
+#include <QFile>
+#include <QString>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+#include <vtkCellArray.h>
+#include <vtkErrorCode.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+vtkStandardNewMacro(FastSTLReader);
+
+namespace {
+
+const qint64 headerSize = 80;           /**< Size of the binary STL header */
+const qint64 recordSize = 50;           /**< Normal, three vertices and attribute count */
+
+/**
+ * @brief This function decides if a mapped file holds a binary STL.
+ * Some binary exporters start the header with "solid", so the file size is checked first.
+ */
+bool isBinarySTL(const uchar* data, qint64 size) {
+    if (size >= headerSize + 4) {
+        quint32 triangles;
+        std::memcpy(&triangles, data + headerSize, 4);
+        if (headerSize + 4 + recordSize * qint64(triangles) == size)
+            return true;
+    }
+
+    qint64 i = 0;
+    while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n'))
+        i++;
+    return !(size - i >= 5 && std::memcmp(data + i, "solid", 5) == 0);
+}
+
+/**
+ * @brief This function returns the number of triangles of a mapped binary STL.
+ * The file size is trusted over the header if they disagree (truncated files).
+ */
+vtkIdType binaryTriangleCount(const uchar* data, qint64 size) {
+    quint32 declared = 0;
+    if (size >= headerSize + 4)
+        std::memcpy(&declared, data + headerSize, 4);
+
+    vtkIdType triangles = std::min<vtkIdType>(declared, (size - headerSize - 4) / recordSize);
+    return std::max<vtkIdType>(triangles, 0);
+}
+
+/**
+ * @brief This function copies the vertices of each 50-byte binary record into a flat xyz array.
+ */
+void readBinaryTriangles(const uchar* data, vtkIdType triangles, float* points) {
+    const uchar* record = data + headerSize + 4;
+    for (vtkIdType i = 0; i < triangles; i++) {
+        /* Skip the 12 byte facet normal, the attribute count after the vertices is ignored */
+        std::memcpy(points + 9 * i, record + 12, 36);
+        record += recordSize;
+    }
+}
+
+/**
+ * @brief This function collects the vertices of an ASCII STL ("vertex x y z" lines).
+ * @return false if a vertex line could not be parsed.
+ */
+bool readAsciiVertices(const char* p, const char* end, std::vector<float>& points) {
+    /* A facet takes roughly 250 bytes of text, reserve to avoid most regrowth */
+    points.reserve(size_t(end - p) / 250 * 9);
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+        const char* token = p;
+        while (p < end && !(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+
+        if (p - token != 6 || std::memcmp(token, "vertex", 6) != 0)
+            continue;
+
+        for (int c = 0; c < 3; c++) {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            if (p < end && *p == '+')
+                p++;
+            float value;
+            std::from_chars_result result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+                return false;
+            points.push_back(value);
+            p = result.ptr;
+        }
+    }
+
+    /* Drop any incomplete trailing facet */
+    points.resize(points.size() - points.size() % 9);
+    return true;
+}
+
+/**
+ * @brief This function makes triangles of a flat array of vertices, three per triangle, welding identical vertices if asked.
+ */
+void setTriangles(vtkPolyData* output, vtkFloatArray* raw, bool merge) {
+    vtkIdType vertexCount = raw->GetNumberOfTuples();
+    vtkIdType triangleCount = vertexCount / 3;
+
+    vtkNew<vtkIdTypeArray> offsets;
+    offsets->SetNumberOfTuples(triangleCount + 1);
+    vtkIdType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangleCount; i++)
+        offset[i] = 3 * i;
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfTuples(vertexCount);
+    vtkIdType* ids = connectivity->GetPointer(0);
+
+    vtkNew<vtkPoints> points;
+    if (merge) {
+        std::vector<vtkIdType> unique;
+        MeshPreparation::weldVertices(raw->GetPointer(0), vertexCount, ids, unique);
+
+        vtkNew<vtkFloatArray> welded;
+        welded->SetNumberOfComponents(3);
+        welded->SetNumberOfTuples(vtkIdType(unique.size()));
+        const float* in = raw->GetPointer(0);
+        float* out = welded->GetPointer(0);
+        for (size_t i = 0; i < unique.size(); i++)
+            std::memcpy(out + 3 * i, in + 3 * unique[i], 3 * sizeof(float));
+        points->SetData(welded);
+    }
+    else {
+        for (vtkIdType i = 0; i < vertexCount; i++)
+            ids[i] = i;
+        points->SetData(raw);
+    }
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(offsets, connectivity);
+
+    output->SetPoints(points);
+    output->SetPolys(polys);
+}
+
+}
+
+
+/**
+ * @brief Constructor for the FastSTLReader class.
+ */
+FastSTLReader::FastSTLReader() : MergePoints(true) {
+    this->SetNumberOfInputPorts(0);
+}
+
+/**
+ * @brief This function prints the reader settings, used by VTK for debugging.
+ * @param os is the stream to print to.
+ * @param indent is the indentation to use.
+ */
+void FastSTLReader::PrintSelf(ostream& os, vtkIndent indent) {
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "FileName: " << this->FileName << "\n";
+    os << indent << "MergePoints: " << (this->MergePoints ? "On" : "Off") << "\n";
+}
+
+/**
+ * @brief This function sets the name of the STL file to read.
+ * @param fileName is the name of the STL file (UTF-8).
+ */
+void FastSTLReader::SetFileName(const std::string& fileName) {
+    if (this->FileName == fileName)
+        return;
+    this->FileName = fileName;
+    this->Modified();
+}
+
+/**
+ * @brief This function returns the name of the STL file to read.
+ * @return the name of the STL file.
+ */
+const std::string& FastSTLReader::GetFileName() const {
+    return this->FileName;
+}
+
+/**
+ * @brief This function reads an evenly spaced sample of the triangles of a binary STL, without touching the rest of the file. It is safe to call from any thread.
+ * Only the pages holding the records sampled are read from disk, so a small sample of a large file
+ * costs a few milliseconds. ASCII files have no fixed record size and are not sampled.
+ * @param fileName is the name of the STL file (UTF-8).
+ * @param triangles is the number of triangles wanted, every triangle is read if the file has fewer.
+ * @param total if not null, receives the number of triangles in the file.
+ * @return the triangles as unshared vertices, or nullptr if the file is not a binary STL or could not be read.
+ */
+vtkSmartPointer<vtkPolyData> FastSTLReader::ReadSample(const std::string& fileName, vtkIdType triangles, vtkIdType* total) {
+    QFile file(QString::fromStdString(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    qint64 size = file.size();
+    const uchar* data = size > 0 ? file.map(0, size) : nullptr;
+    if (data == nullptr)
+        return nullptr;
+
+    if (!isBinarySTL(data, size)) {
+        file.unmap(const_cast<uchar*>(data));
+        return nullptr;
+    }
+
+    vtkIdType count = binaryTriangleCount(data, size);
+    vtkIdType sampled = std::min(std::max<vtkIdType>(triangles, 0), count);
+    if (total != nullptr)
+        *total = count;
+
+    vtkNew<vtkFloatArray> raw;
+    raw->SetNumberOfComponents(3);
+    raw->SetNumberOfTuples(3 * sampled);
+    float* points = raw->GetPointer(0);
+    const uchar* records = data + headerSize + 4;
+    for (vtkIdType i = 0; i < sampled; i++) {
+        vtkIdType record = i * count / sampled;
+        std::memcpy(points + 9 * i, records + record * recordSize + 12, 36);
+    }
+    file.unmap(const_cast<uchar*>(data));
+
+    vtkSmartPointer<vtkPolyData> sample = vtkSmartPointer<vtkPolyData>::New();
+    setTriangles(sample, raw, false);
+    return sample;
+}
+
+/**
+ * @brief This function is called by the VTK pipeline to read the file.
+ * @return 1 on success, 0 on failure.
+ */
+int FastSTLReader::RequestData(vtkInformation* vtkNotUsed(request), vtkInformationVector** vtkNotUsed(inputVector),
+                               vtkInformationVector* outputVector) {
+    vtkPolyData* output = vtkPolyData::GetData(outputVector, 0);
+
+    QFile file(QString::fromStdString(this->FileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        vtkErrorMacro(<< "Cannot open " << this->FileName);
+        this->SetErrorCode(vtkErrorCode::CannotOpenFileError);
+        return 0;
+    }
+
+    qint64 size = file.size();
+    const uchar* data = size > 0 ? file.map(0, size) : nullptr;
+    if (data == nullptr) {
+        vtkErrorMacro(<< "Cannot map " << this->FileName);
+        this->SetErrorCode(vtkErrorCode::FileFormatError);
+        return 0;
+    }
+
+    /* 1. Read every triangle as three unshared vertices */
+    vtkNew<vtkFloatArray> raw;
+    raw->SetNumberOfComponents(3);
+
+    if (isBinarySTL(data, size)) {
+        vtkIdType triangles = binaryTriangleCount(data, size);
+        raw->SetNumberOfTuples(3 * triangles);
+        readBinaryTriangles(data, triangles, raw->GetPointer(0));
+    }
+    else {
+        std::vector<float> vertices;
+        if (!readAsciiVertices(reinterpret_cast<const char*>(data), reinterpret_cast<const char*>(data) + size, vertices)) {
+            vtkErrorMacro(<< "Bad vertex in " << this->FileName);
+            this->SetErrorCode(vtkErrorCode::FileFormatError);
+            file.unmap(const_cast<uchar*>(data));
+            return 0;
+        }
+        raw->SetNumberOfTuples(vtkIdType(vertices.size() / 3));
+        std::memcpy(raw->GetPointer(0), vertices.data(), vertices.size() * sizeof(float));
+    }
+
+    file.unmap(const_cast<uchar*>(data));
+
+    /* 2. Build the triangle cells, either directly or through the weld pass */
+    setTriangles(output, raw, this->MergePoints);
+    return 1;
+}
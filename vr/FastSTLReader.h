@@ -0,0 +1,93 @@
+/** @file FastSTLReader.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Memory-mapped STL reader used in place of vtkSTLReader.
+  */
+
+#ifndef VIEWER_FASTSTLREADER_H
+#define VIEWER_FASTSTLREADER_H
+
+#include <string>
+
+#include <vtkPolyData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+/**
+ * @class FastSTLReader
+ * @brief The FastSTLReader class reads binary and ASCII STL files by mapping them into memory.
+ *
+ * Binary files are walked record by record (50 bytes per triangle) straight into preallocated
+ * vtkFloatArray / vtkCellArray buffers, so there is no stream buffering and no point locator.
+ * Vertex welding is optional and runs as a separate hash pass once all triangles are read.
+ * Being a vtkPolyDataAlgorithm it can be wired to a mapper exactly like vtkSTLReader.
+ */
+class FastSTLReader : public vtkPolyDataAlgorithm {
+public:
+    /**
+     * @brief This function creates a new reader (VTK objects are created through New()).
+     * @return a pointer to the new reader.
+     */
+    static FastSTLReader* New();
+    vtkTypeMacro(FastSTLReader, vtkPolyDataAlgorithm);
+
+    /**
+     * @brief This function prints the reader settings, used by VTK for debugging.
+     * @param os is the stream to print to.
+     * @param indent is the indentation to use.
+     */
+    void PrintSelf(ostream& os, vtkIndent indent) override;
+
+    /**
+     * @brief This function sets the name of the STL file to read.
+     * @param fileName is the name of the STL file (UTF-8).
+     */
+    void SetFileName(const std::string& fileName);
+
+    /**
+     * @brief This function returns the name of the STL file to read.
+     * @return the name of the STL file.
+     */
+    const std::string& GetFileName() const;
+
+    /**
+     * @brief This function reads an evenly spaced sample of the triangles of a binary STL, without touching the rest of the file. It is safe to call from any thread.
+     * @param fileName is the name of the STL file (UTF-8).
+     * @param triangles is the number of triangles wanted, every triangle is read if the file has fewer.
+     * @param total if not null, receives the number of triangles in the file.
+     * @return the triangles as unshared vertices, or nullptr if the file is not a binary STL or could not be read.
+     */
+    static vtkSmartPointer<vtkPolyData> ReadSample(const std::string& fileName, vtkIdType triangles, vtkIdType* total = nullptr);
+
+    /**
+     * @brief Turn vertex welding on or off. When on (the default, matching vtkSTLReader) identical vertices are shared between triangles.
+     */
+    vtkSetMacro(MergePoints, bool);
+    vtkGetMacro(MergePoints, bool);
+    vtkBooleanMacro(MergePoints, bool);
+
+protected:
+    /**
+     * @brief Constructor for the FastSTLReader class.
+     */
+    FastSTLReader();
+
+    /**
+     * @brief Destructor for the FastSTLReader class.
+     */
+    ~FastSTLReader() override = default;
+
+    /**
+     * @brief This function is called by the VTK pipeline to read the file.
+     * @return 1 on success, 0 on failure.
+     */
+    int RequestData(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector) override;
+
+private:
+    FastSTLReader(const FastSTLReader&) = delete;
+    void operator=(const FastSTLReader&) = delete;
+
+    std::string                                 FileName;           /**< File to read */
+    bool                                        MergePoints;        /**< True to weld identical vertices */
+};
+
+#endif
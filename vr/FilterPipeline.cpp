@@ -0,0 +1,679 @@
+/** @file FilterPipeline.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Clip and shrink filters applied to parts on a pool of worker threads.
+  */
+
+#include "FilterPipeline.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+#include <QRunnable>
+#include <QMetaObject>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+/**
+ * @class FilterTask
+ * @brief The FilterTask class is the unit of work run by the pool, it computes the uncached stages of one part.
+ */
+class FilterTask : public QRunnable {
+public:
+    FilterTask(FilterPipeline* pipeline, const FilterPipeline::Job& job, std::shared_ptr<std::atomic<int>> current)
+        : pipeline(pipeline), job(job), current(current) {
+    }
+
+    void run() override {
+        /* The settings may have changed again while this task was waiting in the queue */
+        if (current->load() != job.request)
+            return;
+
+        const FilterPipeline::Settings& settings = job.settings;
+        if (settings.clip && job.clipped == nullptr)
+            job.clipped = FilterPipeline::clip(job.source, settings.origin, settings.normal);
+
+        if (current->load() != job.request)
+            return;
+
+        if (settings.shrink && job.shrunk == nullptr)
+            job.shrunk = FilterPipeline::shrink(settings.clip ? job.clipped.Get() : job.source.Get(), settings.factor);
+
+        /* The result builds its triangle index here, off the GUI thread, so picks hit the filtered triangles */
+        job.geometry = std::make_shared<const PartGeometry>(settings.shrink ? job.shrunk : job.clipped);
+
+        FilterPipeline* target = pipeline;
+        FilterPipeline::Job result = job;
+        QMetaObject::invokeMethod(pipeline, [target, result]() {
+            target->deliver(result);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    FilterPipeline*                     pipeline;       /**< Pipeline that owns the task */
+    FilterPipeline::Job                 job;            /**< Work to do, and its result */
+    std::shared_ptr<std::atomic<int>>   current;        /**< Part's latest request */
+};
+
+namespace {
+
+/* Outputs kept per stage and part, enough to turn one filter off and on again without recomputing */
+const size_t CACHE_DEPTH = 2;
+
+/* Filtering jobs split their work across the cores themselves, a second worker only lets a new
+ * job start while a stale one finishes */
+const int WORKERS = 2;
+
+bool operator==(const FilterPipeline::Settings& a, const FilterPipeline::Settings& b) {
+    for (int k = 0; k < 3; k++) {
+        if (a.origin[k] != b.origin[k] || a.normal[k] != b.normal[k])
+            return false;
+    }
+    return a.clip == b.clip && a.shrink == b.shrink && a.factor == b.factor;
+}
+
+/* Cache key of the clip stage */
+void clipParameters(const FilterPipeline::Settings& settings, double parameters[6]) {
+    for (int k = 0; k < 3; k++) {
+        parameters[k] = settings.origin[k];
+        parameters[k + 3] = settings.normal[k];
+    }
+}
+
+/* Cache key of the shrink stage */
+void shrinkParameters(const FilterPipeline::Settings& settings, double parameters[6]) {
+    parameters[0] = settings.factor;
+    for (int k = 1; k < 6; k++)
+        parameters[k] = 0.;
+}
+
+/* Flat xyz floats of a point or normal array, copied only if it is not already stored as floats */
+const float* floats(vtkDataArray* array, std::vector<float>& copy) {
+    vtkFloatArray* values = vtkFloatArray::FastDownCast(array);
+    if (values != nullptr && values->GetNumberOfComponents() == 3)
+        return values->GetPointer(0);
+
+    copy.resize(size_t(array->GetNumberOfTuples()) * 3);
+    for (vtkIdType i = 0; i < array->GetNumberOfTuples(); i++) {
+        double tuple[3];
+        array->GetTuple(i, tuple);
+        for (int k = 0; k < 3; k++)
+            copy[size_t(i) * 3 + k] = float(tuple[k]);
+    }
+    return copy.data();
+}
+
+/* New xyz float array, with the name given to normals by MeshPreparation if it holds normals */
+vtkSmartPointer<vtkFloatArray> newFloats(vtkIdType count, const char* name = nullptr) {
+    vtkSmartPointer<vtkFloatArray> array = vtkSmartPointer<vtkFloatArray>::New();
+    if (name != nullptr)
+        array->SetName(name);
+    array->SetNumberOfComponents(3);
+    array->SetNumberOfTuples(count);
+    return array;
+}
+
+/* Indexed triangle geometry in the layout MeshPreparation produces */
+vtkSmartPointer<vtkPolyData> assemble(vtkFloatArray* points, vtkFloatArray* normals, vtkIdTypeArray* connectivity) {
+    vtkIdType triangleCount = connectivity->GetNumberOfTuples() / 3;
+    vtkNew<vtkIdTypeArray> offsets;
+    offsets->SetNumberOfTuples(triangleCount + 1);
+    vtkIdType* offset = offsets->GetPointer(0);
+    vtkSMPTools::For(0, triangleCount + 1, [offset](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; i++)
+            offset[i] = 3 * i;
+    });
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(offsets, connectivity);
+
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(points);
+
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    output->SetPoints(outputPoints);
+    output->SetPolys(polys);
+    if (normals != nullptr)
+        output->GetPointData()->SetNormals(normals);
+    return output;
+}
+
+}
+
+/**
+ * @brief This function returns the settings of a part that has not been filtered.
+ * @return the settings.
+ */
+FilterPipeline::Settings FilterPipeline::defaults() {
+    Settings settings;
+    settings.clip = false;
+    settings.origin[0] = settings.origin[1] = settings.origin[2] = 0.;
+    settings.normal[0] = -1.;
+    settings.normal[1] = settings.normal[2] = 0.;
+    settings.shrink = false;
+    settings.factor = 0.8;
+    return settings;
+}
+
+/**
+ * @brief Constructor for the FilterPipeline class.
+ * @param model is the part tree, parts are filtered again when their geometry changes.
+ * @param parent is a pointer to the parent QObject.
+ */
+FilterPipeline::FilterPipeline(ModelPartList* model, QObject* parent)
+    : QObject(parent), model(model), requests(0) {
+    pool.setMaxThreadCount(WORKERS);
+    connect(model, &QAbstractItemModel::dataChanged, this, &FilterPipeline::handleDataChanged);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &FilterPipeline::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelReset, this, &FilterPipeline::handleModelReset);
+}
+
+/**
+ * @brief Destructor for the FilterPipeline class, cancels outstanding work and waits for the workers.
+ */
+FilterPipeline::~FilterPipeline() {
+    for (PartState& state : states)
+        state.current->store(0);
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function changes the filters of a part.
+ * @param part is the part.
+ * @param settings are the filters.
+ */
+void FilterPipeline::setFilters(ModelPart* part, const Settings& settings) {
+    auto it = states.find(part);
+    if (it == states.end()) {
+        /* A part that has never been filtered has nothing to undo */
+        if (!settings.clip && !settings.shrink)
+            return;
+
+        PartState state;
+        state.settings = defaults();
+        state.current = std::make_shared<std::atomic<int>>(0);
+        state.pending = false;
+        it = states.insert(part, state);
+    }
+
+    /* The part already shows these settings, is being filtered with them or waits for its geometry */
+    if (it->settings == settings)
+        return;
+
+    it->settings = settings;
+    apply(part);
+}
+
+/**
+ * @brief This function returns the filters of a part.
+ * @param part is the part.
+ * @return the settings, defaults() if the part has never been filtered.
+ */
+FilterPipeline::Settings FilterPipeline::filters(ModelPart* part) const {
+    auto it = states.find(part);
+    return it != states.end() ? it->settings : defaults();
+}
+
+/**
+ * @brief This function returns true while parts are being filtered.
+ * @return true if the pipeline is busy.
+ */
+bool FilterPipeline::isBusy() const {
+    for (const PartState& state : states) {
+        if (state.pending)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief This function blocks until all workers are idle.
+ */
+void FilterPipeline::waitForDone() {
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function removes the geometry on the far side of a plane, splitting the triangles it crosses.
+ * Points are classified once, then the triangles are counted and written in two parallel passes with a
+ * prefix sum in between, so every triangle knows where its output goes. A triangle crossing the plane
+ * keeps one or two triangles and adds two points on the crossed edges; the edge points are interpolated
+ * from the lower point index, so the two triangles sharing an edge add exactly the same point.
+ * @param input is the prepared (indexed triangle) geometry, it is only read.
+ * @param origin is a point on the plane.
+ * @param normal is the normal of the plane, the side it points to is kept.
+ * @return the clipped geometry, with point normals.
+ */
+vtkSmartPointer<vtkPolyData> FilterPipeline::clip(vtkPolyData* input, const double origin[3], const double normal[3]) {
+    vtkNew<vtkIdTypeArray> emptyConnectivity;
+    if (input == nullptr || input->GetPoints() == nullptr || input->GetPolys() == nullptr)
+        return assemble(newFloats(0), newFloats(0, "Normals"), emptyConnectivity);
+
+    vtkIdType pointCount = input->GetNumberOfPoints();
+    std::vector<float> pointCopy, normalCopy;
+    const float* points = floats(input->GetPoints()->GetData(), pointCopy);
+    vtkDataArray* inputNormals = input->GetPointData()->GetNormals();
+    const float* normals = inputNormals != nullptr ? floats(inputNormals, normalCopy) : nullptr;
+
+    /* 1. Signed distance of every point from the plane */
+    std::vector<double> distance(pointCount);
+    vtkSMPTools::For(0, pointCount, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; i++) {
+            const float* p = points + 3 * i;
+            distance[size_t(i)] = (p[0] - origin[0]) * normal[0] + (p[1] - origin[1]) * normal[1] + (p[2] - origin[2]) * normal[2];
+        }
+    });
+
+    /* 2. Index of each kept point in the output, -1 for the points cut away */
+    std::vector<vtkIdType> kept(pointCount);
+    vtkIdType keptCount = 0;
+    for (vtkIdType i = 0; i < pointCount; i++)
+        kept[size_t(i)] = distance[size_t(i)] >= 0. ? keptCount++ : -1;
+
+    vtkCellArray* polys = input->GetPolys();
+    vtkIdType cellCount = polys->GetNumberOfCells();
+    std::vector<uint8_t> inside(cellCount);
+    std::vector<vtkIdType> firstTriangle(size_t(cellCount) + 1);
+    std::vector<vtkIdType> firstPoint(size_t(cellCount) + 1);
+
+    vtkSmartPointer<vtkFloatArray> outputPoints;
+    vtkSmartPointer<vtkFloatArray> outputNormals;
+    vtkNew<vtkIdTypeArray> connectivity;
+
+    auto run = [&](const auto* offsets, const auto* ids) {
+        /* 3. Which corners of each triangle are kept, and so how many triangles and points it adds */
+        vtkSMPTools::For(0, cellCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; c++) {
+                uint8_t mask = 0;
+                if (offsets[c + 1] - offsets[c] == 3) {
+                    for (int v = 0; v < 3; v++) {
+                        if (kept[size_t(ids[offsets[c] + v])] >= 0)
+                            mask |= uint8_t(1 << v);
+                    }
+                }
+                inside[size_t(c)] = mask;
+            }
+        });
+
+        for (vtkIdType c = 0; c < cellCount; c++) {
+            int corners = (inside[size_t(c)] & 1) + ((inside[size_t(c)] >> 1) & 1) + ((inside[size_t(c)] >> 2) & 1);
+            firstTriangle[size_t(c) + 1] = firstTriangle[size_t(c)] + (corners == 2 ? 2 : corners > 0 ? 1 : 0);
+            firstPoint[size_t(c) + 1] = firstPoint[size_t(c)] + (corners == 1 || corners == 2 ? 2 : 0);
+        }
+
+        vtkIdType newPoints = firstPoint[size_t(cellCount)];
+        outputPoints = newFloats(keptCount + newPoints);
+        outputNormals = normals != nullptr ? newFloats(keptCount + newPoints, "Normals") : nullptr;
+        connectivity->SetNumberOfTuples(3 * firstTriangle[size_t(cellCount)]);
+        float* outPoints = outputPoints->GetPointer(0);
+        float* outNormals = outputNormals != nullptr ? outputNormals->GetPointer(0) : nullptr;
+        vtkIdType* triangles = connectivity->GetPointer(0);
+
+        /* 4. Kept points keep their coordinates and normals */
+        vtkSMPTools::For(0, pointCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType i = begin; i < end; i++) {
+                vtkIdType j = kept[size_t(i)];
+                if (j < 0)
+                    continue;
+                std::memcpy(outPoints + 3 * j, points + 3 * i, 3 * sizeof(float));
+                if (outNormals != nullptr)
+                    std::memcpy(outNormals + 3 * j, normals + 3 * i, 3 * sizeof(float));
+            }
+        });
+
+        /* Writes the point where the plane crosses the edge from a kept point to a cut point */
+        auto crossing = [&](vtkIdType a, vtkIdType b, vtkIdType target) {
+            vtkIdType from = std::min(a, b), to = std::max(a, b);
+            double t = distance[size_t(from)] / (distance[size_t(from)] - distance[size_t(to)]);
+            for (int k = 0; k < 3; k++)
+                outPoints[3 * target + k] = float(points[3 * from + k] + t * (points[3 * to + k] - points[3 * from + k]));
+            if (outNormals == nullptr)
+                return;
+
+            double n[3], length = 0.;
+            for (int k = 0; k < 3; k++) {
+                n[k] = normals[3 * from + k] + t * (normals[3 * to + k] - normals[3 * from + k]);
+                length += n[k] * n[k];
+            }
+            length = length > 0. ? 1. / std::sqrt(length) : 0.;
+            for (int k = 0; k < 3; k++)
+                outNormals[3 * target + k] = float(n[k] * length);
+        };
+
+        /* 5. Triangles, the corners are rotated so the one on its own side of the plane comes first */
+        vtkSMPTools::For(0, cellCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; c++) {
+                uint8_t mask = inside[size_t(c)];
+                if (mask == 0)
+                    continue;
+
+                vtkIdType* out = triangles + 3 * firstTriangle[size_t(c)];
+                vtkIdType corner[3] = { vtkIdType(ids[offsets[c]]), vtkIdType(ids[offsets[c] + 1]), vtkIdType(ids[offsets[c] + 2]) };
+                if (mask == 7) {
+                    for (int v = 0; v < 3; v++)
+                        out[v] = kept[size_t(corner[v])];
+                    continue;
+                }
+
+                bool single = mask == 1 || mask == 2 || mask == 4;
+                int first = 0;
+                while (((mask >> first) & 1) != (single ? 1 : 0))
+                    first++;
+                vtkIdType a = corner[first], b = corner[(first + 1) % 3], d = corner[(first + 2) % 3];
+                vtkIdType p = keptCount + firstPoint[size_t(c)], q = p + 1;
+
+                if (single) {
+                    /* a is kept: one triangle towards the crossings of ab and ad */
+                    crossing(a, b, p);
+                    crossing(a, d, q);
+                    out[0] = kept[size_t(a)]; out[1] = p; out[2] = q;
+                } else {
+                    /* a is cut: the quad b, d, crossing of da, crossing of ab becomes two triangles */
+                    crossing(a, b, p);
+                    crossing(a, d, q);
+                    out[0] = kept[size_t(b)]; out[1] = kept[size_t(d)]; out[2] = q;
+                    out[3] = kept[size_t(b)]; out[4] = q; out[5] = p;
+                }
+            }
+        });
+    };
+
+    if (polys->IsStorage64Bit())
+        run(polys->GetOffsetsArray64()->GetPointer(0), polys->GetConnectivityArray64()->GetPointer(0));
+    else
+        run(polys->GetOffsetsArray32()->GetPointer(0), polys->GetConnectivityArray32()->GetPointer(0));
+
+    return assemble(outputPoints, outputNormals, connectivity);
+}
+
+/**
+ * @brief This function shrinks every triangle towards its centre, so the triangles no longer share corners.
+ * Each triangle gets three points of its own, with the normals of the corners they came from.
+ * @param input is the prepared (indexed triangle) geometry, it is only read.
+ * @param factor is the size of the shrunk triangles relative to the originals.
+ * @return the shrunk geometry, with point normals.
+ */
+vtkSmartPointer<vtkPolyData> FilterPipeline::shrink(vtkPolyData* input, double factor) {
+    vtkNew<vtkIdTypeArray> connectivity;
+    if (input == nullptr || input->GetPoints() == nullptr || input->GetPolys() == nullptr)
+        return assemble(newFloats(0), newFloats(0, "Normals"), connectivity);
+
+    std::vector<float> pointCopy, normalCopy;
+    const float* points = floats(input->GetPoints()->GetData(), pointCopy);
+    vtkDataArray* inputNormals = input->GetPointData()->GetNormals();
+    const float* normals = inputNormals != nullptr ? floats(inputNormals, normalCopy) : nullptr;
+
+    vtkCellArray* polys = input->GetPolys();
+    vtkIdType cellCount = polys->GetNumberOfCells();
+    vtkSmartPointer<vtkFloatArray> outputPoints = newFloats(3 * cellCount);
+    vtkSmartPointer<vtkFloatArray> outputNormals = normals != nullptr ? newFloats(3 * cellCount, "Normals") : nullptr;
+    connectivity->SetNumberOfTuples(3 * cellCount);
+    float* outPoints = outputPoints->GetPointer(0);
+    float* outNormals = outputNormals != nullptr ? outputNormals->GetPointer(0) : nullptr;
+    vtkIdType* triangles = connectivity->GetPointer(0);
+
+    auto run = [&](const auto* offsets, const auto* ids) {
+        vtkSMPTools::For(0, cellCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; c++) {
+                const float* corner[3];
+                for (int v = 0; v < 3; v++)
+                    corner[v] = points + 3 * vtkIdType(ids[offsets[c] + v]);
+
+                for (int k = 0; k < 3; k++) {
+                    double centre = (double(corner[0][k]) + corner[1][k] + corner[2][k]) / 3.;
+                    for (int v = 0; v < 3; v++)
+                        outPoints[9 * c + 3 * v + k] = float(centre + factor * (corner[v][k] - centre));
+                }
+                for (int v = 0; v < 3; v++) {
+                    triangles[3 * c + v] = 3 * c + v;
+                    if (outNormals != nullptr)
+                        std::memcpy(outNormals + 9 * c + 3 * v, normals + 3 * vtkIdType(ids[offsets[c] + v]), 3 * sizeof(float));
+                }
+            }
+        });
+    };
+
+    if (polys->IsStorage64Bit())
+        run(polys->GetOffsetsArray64()->GetPointer(0), polys->GetConnectivityArray64()->GetPointer(0));
+    else
+        run(polys->GetOffsetsArray32()->GetPointer(0), polys->GetConnectivityArray32()->GetPointer(0));
+
+    return assemble(outputPoints, outputNormals, connectivity);
+}
+
+/**
+ * @brief This function filters again the changed parts whose geometry has been replaced.
+ * A new geometry comes with a new actor that draws it unfiltered (see ModelPart::setGeometry).
+ * @param topLeft is the first changed index.
+ * @param bottomRight is the last changed index.
+ */
+void FilterPipeline::handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        ModelPart* part = index.isValid() ? static_cast<ModelPart*>(index.internalPointer()) : nullptr;
+        auto it = states.find(part);
+        if (it == states.end() || part->getGeometry() == nullptr)
+            continue;
+
+        /* Cached stages of the old geometry would only hold on to it */
+        prune(*it, part->getGeometry()->polyData());
+
+        bool active = it->settings.clip || it->settings.shrink;
+        if (active && !it->pending && part->getFiltered() == nullptr)
+            apply(part);
+    }
+}
+
+/**
+ * @brief This function forgets the parts of rows that are about to be removed.
+ * @param parent is the parent of the rows.
+ * @param first is the first row to be removed.
+ * @param last is the last row to be removed.
+ */
+void FilterPipeline::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    for (int row = first; row <= last; row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (index.isValid())
+            forgetSubtree(static_cast<ModelPart*>(index.internalPointer()));
+    }
+}
+
+/**
+ * @brief This function forgets every part when the model is reset.
+ */
+void FilterPipeline::handleModelReset() {
+    for (PartState& state : states)
+        state.current->store(0);
+    states.clear();
+}
+
+/**
+ * @brief This function shows the result of a part's settings, from the cache or by starting a job.
+ * @param part is the part, it must have a state.
+ */
+void FilterPipeline::apply(ModelPart* part) {
+    PartState& state = states[part];
+    state.current->store(++requests);
+    state.pending = false;
+
+    /* Parts still loading are filtered when their geometry arrives, see handleDataChanged() */
+    std::shared_ptr<const PartGeometry> base = part->getGeometry();
+    if (base == nullptr)
+        return;
+
+    vtkPolyData* source = base->polyData();
+    prune(state, source);
+
+    const Settings& settings = state.settings;
+    if (!settings.clip && !settings.shrink) {
+        if (part->getFiltered() != nullptr)
+            show(part, nullptr);
+        return;
+    }
+
+    /* Reuse the cached stages from the start of the pipeline, the first miss and everything after it is computed */
+    double parameters[6];
+    Stage* clipped = nullptr;
+    Stage* shrunk = nullptr;
+    vtkPolyData* input = source;
+    if (settings.clip) {
+        clipParameters(settings, parameters);
+        clipped = find(state.clips, input, parameters);
+        input = clipped != nullptr ? clipped->output.Get() : nullptr;
+    }
+    if (settings.shrink && input != nullptr) {
+        shrinkParameters(settings, parameters);
+        shrunk = find(state.shrinks, input, parameters);
+    }
+
+    Stage* last = settings.shrink ? shrunk : clipped;
+    if (last != nullptr && last->geometry != nullptr) {
+        show(part, last->geometry);
+        return;
+    }
+
+    Job job;
+    job.part = part;
+    job.request = state.current->load();
+    job.settings = settings;
+    job.source = source;
+    job.clipped = clipped != nullptr ? clipped->output : nullptr;
+    job.shrunk = shrunk != nullptr ? shrunk->output : nullptr;
+    state.pending = true;
+    pool.start(new FilterTask(this, job, state.current));
+}
+
+/**
+ * @brief This function runs on the GUI thread when a worker has filtered a part.
+ * The stages the worker computed are added to the cache before the result is shown.
+ * @param job is the finished job.
+ */
+void FilterPipeline::deliver(const Job& job) {
+    auto it = states.find(job.part);
+    if (it == states.end() || it->current->load() != job.request)
+        return;
+
+    it->pending = false;
+
+    /* The geometry was replaced while the job ran, filter the new one instead */
+    std::shared_ptr<const PartGeometry> base = job.part->getGeometry();
+    if (base == nullptr || base->polyData() != job.source) {
+        apply(job.part);
+        return;
+    }
+
+    double parameters[6];
+    const Settings& settings = job.settings;
+    if (settings.clip) {
+        clipParameters(settings, parameters);
+        remember(it->clips, job.source, parameters, job.clipped, settings.shrink ? nullptr : job.geometry);
+    }
+    if (settings.shrink) {
+        shrinkParameters(settings, parameters);
+        remember(it->shrinks, settings.clip ? job.clipped : job.source, parameters, job.shrunk, job.geometry);
+    }
+
+    show(job.part, job.geometry);
+}
+
+/**
+ * @brief This function gives a part its filtered geometry and tells the tree it changed.
+ * @param part is the part.
+ * @param geometry is the filtered geometry, or nullptr to show the part's own geometry.
+ */
+void FilterPipeline::show(ModelPart* part, std::shared_ptr<const PartGeometry> geometry) {
+    part->setFiltered(geometry);
+    model->updatePart(part);
+    emit filtered(part);
+}
+
+/**
+ * @brief This function finds the cached output of a stage and makes it the most recently used.
+ * @param stages are the cached outputs of the stage, most recent first.
+ * @param input is the geometry the stage is applied to.
+ * @param parameters are the parameters of the stage.
+ * @return the cached output, or nullptr if it is not cached.
+ */
+FilterPipeline::Stage* FilterPipeline::find(std::vector<Stage>& stages, vtkPolyData* input, const double parameters[6]) {
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (stages[i].input != input || std::memcmp(stages[i].parameters, parameters, sizeof(stages[i].parameters)) != 0)
+            continue;
+
+        std::rotate(stages.begin(), stages.begin() + i, stages.begin() + i + 1);
+        return &stages.front();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief This function adds the output of a stage to the cache, dropping the least recently used output if the cache is full.
+ * @param stages are the cached outputs of the stage, most recent first.
+ * @param input is the geometry the stage was applied to.
+ * @param parameters are the parameters of the stage.
+ * @param output is the output of the stage.
+ * @param geometry is the output with its pick index if it was the final result, or nullptr.
+ */
+void FilterPipeline::remember(std::vector<Stage>& stages, vtkPolyData* input, const double parameters[6],
+                              vtkPolyData* output, std::shared_ptr<const PartGeometry> geometry) {
+    Stage* stage = find(stages, input, parameters);
+    if (stage == nullptr) {
+        Stage added;
+        added.input = input;
+        std::memcpy(added.parameters, parameters, sizeof(added.parameters));
+        added.output = output;
+        stages.insert(stages.begin(), added);
+        if (stages.size() > CACHE_DEPTH)
+            stages.resize(CACHE_DEPTH);
+        stage = &stages.front();
+    }
+    if (geometry != nullptr)
+        stage->geometry = geometry;
+}
+
+/**
+ * @brief This function drops the cached stages that were not computed from a part's current geometry.
+ * @param state is the part's state.
+ * @param source is the part's current geometry.
+ */
+void FilterPipeline::prune(PartState& state, vtkPolyData* source) {
+    state.clips.erase(std::remove_if(state.clips.begin(), state.clips.end(), [source](const Stage& stage) {
+        return stage.input != source;
+    }), state.clips.end());
+
+    /* Shrink stages hang off the part's geometry or off one of the clip outputs left */
+    state.shrinks.erase(std::remove_if(state.shrinks.begin(), state.shrinks.end(), [&state, source](const Stage& stage) {
+        if (stage.input == source)
+            return false;
+        for (const Stage& clipped : state.clips) {
+            if (clipped.output == stage.input)
+                return false;
+        }
+        return true;
+    }), state.shrinks.end());
+}
+
+/**
+ * @brief This function forgets a part and all of its children, their running jobs are dropped when they finish.
+ * @param part is the top of the subtree.
+ */
+void FilterPipeline::forgetSubtree(ModelPart* part) {
+    auto it = states.find(part);
+    if (it != states.end()) {
+        it->current->store(0);
+        states.erase(it);
+    }
+
+    for (int i = 0; i < part->childCount(); i++)
+        forgetSubtree(part->child(i));
+}
@@ -0,0 +1,250 @@
+/** @file FilterPipeline.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Clip and shrink filters applied to parts on a pool of worker threads.
+  */
+
+#ifndef VIEWER_FILTERPIPELINE_H
+#define VIEWER_FILTERPIPELINE_H
+
+#include "PartGeometry.h"
+
+#include <QObject>
+#include <QHash>
+#include <QModelIndex>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+class ModelPart;
+class ModelPartList;
+
+/**
+ * @class FilterPipeline
+ * @brief The FilterPipeline class clips parts by a plane and shrinks their triangles, without blocking the GUI.
+ *
+ * Each part has its own settings. The stages run in a fixed order (clip, then shrink) on a worker
+ * pool, each split across the cores with vtkSMPTools, and the result is handed back to the GUI
+ * thread where it replaces what the part's mapper draws in one step (see ModelPart::setFiltered).
+ * The part's own geometry is never modified, so turning the filters off is immediate.
+ *
+ * The output of every stage is cached against its input and parameters, so changing one filter
+ * only recomputes the stages after it: turning the shrink filter on or off reuses the clipped
+ * geometry, and going back to settings used a moment ago needs no work at all. When the part's
+ * geometry is replaced (a proxy swapped in by the ResidencyManager, or the file read again) the
+ * cache is dropped and the filters are applied to the new geometry.
+ *
+ * The filters work on the prepared geometry (indexed triangles with point normals, see
+ * MeshPreparation) and produce the same kind of geometry, so the result is drawn by the part's
+ * usual vtkPolyDataMapper and picked against its own triangle index.
+ */
+class FilterPipeline : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @struct Settings
+     * @brief The Settings structure holds the filters applied to one part.
+     */
+    struct Settings {
+        bool        clip;           /**< True to remove the part of the geometry in front of the plane */
+        double      origin[3];      /**< A point on the clipping plane */
+        double      normal[3];      /**< Normal of the clipping plane, the side it points to is kept */
+        bool        shrink;         /**< True to shrink every triangle towards its centre */
+        double      factor;         /**< Size of the shrunk triangles relative to the originals */
+    };
+
+    /**
+     * @brief This function returns the settings of a part that has not been filtered: both filters off,
+     * the plane through the origin keeping x < 0 and triangles shrunk to 80%.
+     * @return the settings.
+     */
+    static Settings defaults();
+
+    /**
+     * @brief Constructor for the FilterPipeline class.
+     * @param model is the part tree, parts are filtered again when their geometry changes.
+     * @param parent is a pointer to the parent QObject.
+     */
+    FilterPipeline(ModelPartList* model, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor for the FilterPipeline class, cancels outstanding work and waits for the workers.
+     */
+    ~FilterPipeline();
+
+    /**
+     * @brief This function changes the filters of a part. The result is shown once the workers have
+     * computed it, straight away if it is cached. Parts that have no geometry yet are filtered when it arrives.
+     * @param part is the part.
+     * @param settings are the filters.
+     */
+    void setFilters(ModelPart* part, const Settings& settings);
+
+    /**
+     * @brief This function returns the filters of a part.
+     * @param part is the part.
+     * @return the settings, defaults() if the part has never been filtered.
+     */
+    Settings filters(ModelPart* part) const;
+
+    /**
+     * @brief This function returns true while parts are being filtered.
+     * @return true if the pipeline is busy.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief This function blocks until all workers are idle (used on shutdown and by headless tools).
+     * The results are delivered by the event loop afterwards.
+     */
+    void waitForDone();
+
+    /**
+     * @brief This function removes the geometry on the far side of a plane, splitting the triangles it crosses. It is safe to call from any thread.
+     * @param input is the prepared (indexed triangle) geometry, it is only read.
+     * @param origin is a point on the plane.
+     * @param normal is the normal of the plane, the side it points to is kept.
+     * @return the clipped geometry, with point normals.
+     */
+    static vtkSmartPointer<vtkPolyData> clip(vtkPolyData* input, const double origin[3], const double normal[3]);
+
+    /**
+     * @brief This function shrinks every triangle towards its centre, so the triangles no longer share corners. It is safe to call from any thread.
+     * @param input is the prepared (indexed triangle) geometry, it is only read.
+     * @param factor is the size of the shrunk triangles relative to the originals.
+     * @return the shrunk geometry, with point normals.
+     */
+    static vtkSmartPointer<vtkPolyData> shrink(vtkPolyData* input, double factor);
+
+signals:
+    /**
+     * @brief This signal is emitted on the GUI thread once a part shows the result of new settings.
+     * @param part is the part.
+     */
+    void filtered(ModelPart* part);
+
+private slots:
+    /**
+     * @brief This function filters again the changed parts whose geometry has been replaced.
+     * @param topLeft is the first changed index.
+     * @param bottomRight is the last changed index.
+     */
+    void handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+    /**
+     * @brief This function forgets the parts of rows that are about to be removed.
+     * @param parent is the parent of the rows.
+     * @param first is the first row to be removed.
+     * @param last is the last row to be removed.
+     */
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief This function forgets every part when the model is reset.
+     */
+    void handleModelReset();
+
+private:
+    friend class FilterTask;
+
+    /**
+     * @struct Stage
+     * @brief The Stage structure holds one cached output of a filter.
+     */
+    struct Stage {
+        vtkSmartPointer<vtkPolyData>            input;          /**< Geometry the filter was applied to */
+        double                                  parameters[6];  /**< Plane origin and normal, or the shrink factor */
+        vtkSmartPointer<vtkPolyData>            output;         /**< Result of the filter */
+        std::shared_ptr<const PartGeometry>     geometry;       /**< Result with its pick index, once it has been shown */
+    };
+
+    /**
+     * @struct Job
+     * @brief The Job structure holds the work sent to a worker for one part, and what it sends back.
+     */
+    struct Job {
+        ModelPart*                              part;           /**< Part being filtered */
+        int                                     request;        /**< Request the job belongs to */
+        Settings                                settings;       /**< Filters to apply */
+        vtkSmartPointer<vtkPolyData>            source;         /**< Part's own geometry */
+        vtkSmartPointer<vtkPolyData>            clipped;        /**< Clipped geometry, cached or computed by the worker */
+        vtkSmartPointer<vtkPolyData>            shrunk;         /**< Shrunk geometry, cached or computed by the worker */
+        std::shared_ptr<const PartGeometry>     geometry;       /**< Final result, computed by the worker */
+    };
+
+    /**
+     * @struct PartState
+     * @brief The PartState structure holds the settings, cache and latest request of one part.
+     */
+    struct PartState {
+        Settings                                settings;       /**< Filters of the part */
+        std::shared_ptr<std::atomic<int>>       current;        /**< Latest request, read by the workers to drop stale jobs */
+        bool                                    pending;        /**< True while a worker computes the latest request */
+        std::vector<Stage>                      clips;          /**< Cached clip outputs, most recent first */
+        std::vector<Stage>                      shrinks;        /**< Cached shrink outputs, most recent first */
+    };
+
+    /**
+     * @brief This function shows the result of a part's settings, from the cache or by starting a job.
+     * @param part is the part, it must have a state.
+     */
+    void apply(ModelPart* part);
+
+    /**
+     * @brief This function runs on the GUI thread when a worker has filtered a part.
+     * @param job is the finished job.
+     */
+    void deliver(const Job& job);
+
+    /**
+     * @brief This function gives a part its filtered geometry and tells the tree it changed.
+     * @param part is the part.
+     * @param geometry is the filtered geometry, or nullptr to show the part's own geometry.
+     */
+    void show(ModelPart* part, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function finds the cached output of a stage and makes it the most recently used.
+     * @param stages are the cached outputs of the stage, most recent first.
+     * @param input is the geometry the stage is applied to.
+     * @param parameters are the parameters of the stage.
+     * @return the cached output, or nullptr if it is not cached.
+     */
+    static Stage* find(std::vector<Stage>& stages, vtkPolyData* input, const double parameters[6]);
+
+    /**
+     * @brief This function adds the output of a stage to the cache, dropping the least recently used output if the cache is full.
+     * @param stages are the cached outputs of the stage, most recent first.
+     * @param input is the geometry the stage was applied to.
+     * @param parameters are the parameters of the stage.
+     * @param output is the output of the stage.
+     * @param geometry is the output with its pick index if it was the final result, or nullptr.
+     */
+    static void remember(std::vector<Stage>& stages, vtkPolyData* input, const double parameters[6],
+                         vtkPolyData* output, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function drops the cached stages that were not computed from a part's current geometry.
+     * @param state is the part's state.
+     * @param source is the part's current geometry.
+     */
+    static void prune(PartState& state, vtkPolyData* source);
+
+    /**
+     * @brief This function forgets a part and all of its children, their running jobs are dropped when they finish.
+     * @param part is the top of the subtree.
+     */
+    void forgetSubtree(ModelPart* part);
+
+    ModelPartList*                              model;          /**< Part tree */
+    QThreadPool                                 pool;           /**< Workers that run the filters */
+    QHash<ModelPart*, PartState>                states;         /**< Settings and cache of each filtered part */
+    int                                         requests;       /**< Requests made so far */
+};
+
+#endif
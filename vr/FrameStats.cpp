@@ -0,0 +1,261 @@
+/** @file FrameStats.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Per-frame timing collected by the VR thread.
+  */
+
+#include "FrameStats.h"
+
+#include <QFile>
+#include <QTextStream>
+
+#include <cmath>
+
+namespace {
+
+/* Bucket i holds durations from MIN_MS * RATIO^i up to MIN_MS * RATIO^(i+1) */
+constexpr double MIN_MS = 0.01;
+constexpr double RATIO = 1.05;
+
+/**
+ * @brief This function adds to an atomic that only the calling thread writes, without a locked read-modify-write.
+ * @param value is the atomic to add to.
+ * @param amount is the amount to add.
+ */
+template <typename T, typename U>
+inline void addRelaxed(std::atomic<T>& value, U amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+}
+
+/**
+ * @brief Constructor for the FrameStats class.
+ */
+FrameStats::FrameStats()
+    : frames(0), dropped(0), dropThreshold(float(1.5 * 1000. / 90.)), resetRequested(false) {
+    clear();
+}
+
+/**
+ * @brief This function sets the frame time the display expects.
+ * @param ms is the target frame time in milliseconds.
+ */
+void FrameStats::setTargetFrameTime(double ms) {
+    dropThreshold = float(1.5 * ms);
+}
+
+/**
+ * @brief This function records one frame, it must only be called from the recording thread.
+ * @param time is the time the frame started, in seconds since recording started.
+ * @param ms is the duration of each phase in milliseconds.
+ */
+void FrameStats::addFrame(double time, const float ms[PHASE_COUNT]) {
+    if (resetRequested.exchange(false, std::memory_order_acquire))
+        clear();
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        addRelaxed(total[phase], double(ms[phase]));
+        addRelaxed(histogram[phase][bucket(ms[phase])], 1u);
+    }
+    if (ms[FRAME] > dropThreshold.load(std::memory_order_relaxed))
+        addRelaxed(dropped, 1u);
+
+    Sample sample;
+    sample.frame = frames.load(std::memory_order_relaxed);
+    sample.time = time;
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+        sample.ms[phase] = ms[phase];
+
+    /* Published last, so a reader that sees the count also sees the histogram it covers */
+    frames.store(sample.frame + 1, std::memory_order_release);
+
+    /* If the reader has stopped collecting the sample is lost, the totals are still right */
+    samples.push(sample);
+}
+
+/**
+ * @brief This function asks the recording thread to clear the totals and histograms before its next frame.
+ */
+void FrameStats::reset() {
+    resetRequested.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief This function returns the number of frames recorded.
+ * @return the number of frames.
+ */
+quint64 FrameStats::frameCount() const {
+    return frames.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief This function returns the number of frames that took longer than 1.5 times the target frame time.
+ * @return the number of dropped frames.
+ */
+quint64 FrameStats::droppedFrames() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief This function returns the mean duration of a phase.
+ * @param phase is the phase.
+ * @return the mean in milliseconds, 0 if no frames have been recorded.
+ */
+double FrameStats::mean(Phase phase) const {
+    quint64 n = frameCount();
+    return n > 0 ? total[phase].load(std::memory_order_relaxed) / double(n) : 0.;
+}
+
+/**
+ * @brief This function returns a percentile of a phase's duration, to within one histogram bucket.
+ * @param phase is the phase.
+ * @param p is the percentile, 0-100.
+ * @return the upper edge of the bucket the percentile falls in, in milliseconds.
+ */
+double FrameStats::percentile(Phase phase, double p) const {
+    /* The recording thread may add frames while the buckets are read, so count them as read */
+    quint32 counts[BUCKETS];
+    quint64 n = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = histogram[phase][i].load(std::memory_order_relaxed);
+        n += counts[i];
+    }
+    if (n == 0)
+        return 0.;
+
+    quint64 target = quint64(std::ceil(p / 100. * double(n)));
+    if (target < 1)
+        target = 1;
+
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= target)
+            return MIN_MS * std::pow(RATIO, i + 1);
+    }
+    return MIN_MS * std::pow(RATIO, BUCKETS);
+}
+
+/**
+ * @brief This function moves the samples recorded since the last call into the trace, it must only be called from the reading thread.
+ * @return the number of samples moved.
+ */
+int FrameStats::collect() {
+    int count = 0;
+    Sample sample;
+    while (samples.pop(sample)) {
+        samplesTrace.append(sample);
+        count++;
+    }
+
+    /* Drop the oldest quarter at a time rather than one sample per frame */
+    if (samplesTrace.size() > maxTraceLength())
+        samplesTrace.remove(0, samplesTrace.size() - maxTraceLength() * 3 / 4);
+
+    return count;
+}
+
+/**
+ * @brief This function returns the collected trace.
+ * @return the frame samples, oldest first.
+ */
+const QVector<FrameStats::Sample>& FrameStats::trace() const {
+    return samplesTrace;
+}
+
+/**
+ * @brief This function writes the collected trace to a file, as JSON if the name ends in .json and as CSV otherwise.
+ * @param fileName is the file to write.
+ * @return true if the file was written.
+ */
+bool FrameStats::saveTrace(const QString& fileName) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+    bool json = fileName.endsWith(".json", Qt::CaseInsensitive);
+
+    if (json) {
+        out << "{\n  \"frames\": " << frameCount() << ",\n  \"dropped\": " << droppedFrames() << ",\n  \"summary\": {\n";
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            Phase p = Phase(phase);
+            out << "    \"" << phaseName(p) << "\": { \"mean\": " << mean(p) << ", \"p50\": " << percentile(p, 50.)
+                << ", \"p95\": " << percentile(p, 95.) << ", \"p99\": " << percentile(p, 99.) << " }"
+                << (phase + 1 < PHASE_COUNT ? ",\n" : "\n");
+        }
+        out << "  },\n  \"trace\": [\n";
+    }
+    else {
+        out << "frame,time";
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+            out << "," << phaseName(Phase(phase)) << "_ms";
+        out << "\n";
+    }
+
+    for (int i = 0; i < samplesTrace.size(); i++) {
+        const Sample& s = samplesTrace[i];
+        if (json) {
+            out << "    { \"frame\": " << s.frame << ", \"time\": " << s.time;
+            for (int phase = 0; phase < PHASE_COUNT; phase++)
+                out << ", \"" << phaseName(Phase(phase)) << "_ms\": " << s.ms[phase];
+            out << (i + 1 < samplesTrace.size() ? " },\n" : " }\n");
+        }
+        else {
+            out << s.frame << "," << s.time;
+            for (int phase = 0; phase < PHASE_COUNT; phase++)
+                out << "," << s.ms[phase];
+            out << "\n";
+        }
+    }
+
+    if (json)
+        out << "  ]\n}\n";
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+/**
+ * @brief This function returns the name of a phase.
+ * @param phase is the phase.
+ * @return the name, as used in the saved trace.
+ */
+const char* FrameStats::phaseName(Phase phase) {
+    switch (phase) {
+        case COMMANDS:  return "commands";
+        case SCENE:     return "scene";
+        case EVENTS:    return "events";
+        case RENDER:    return "render";
+        case ANIMATION: return "animation";
+        case BOUNDS:    return "bounds";
+        case FRAME:     return "frame";
+        default:        return "unknown";
+    }
+}
+
+/**
+ * @brief This function returns the histogram bucket a duration falls in.
+ * @param ms is the duration in milliseconds.
+ * @return the bucket index.
+ */
+int FrameStats::bucket(float ms) {
+    if (!(ms > MIN_MS))
+        return 0;
+
+    int i = int(std::log(ms / MIN_MS) / std::log(RATIO));
+    return i < BUCKETS ? i : BUCKETS - 1;
+}
+
+/**
+ * @brief This function clears the totals and histograms, it is called by the recording thread.
+ */
+void FrameStats::clear() {
+    frames.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        total[phase].store(0., std::memory_order_relaxed);
+        for (int i = 0; i < BUCKETS; i++)
+            histogram[phase][i].store(0, std::memory_order_relaxed);
+    }
+}
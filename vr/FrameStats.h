@@ -0,0 +1,165 @@
+/** @file FrameStats.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Per-frame timing collected by the VR thread.
+  */
+
+#ifndef VIEWER_FRAMESTATS_H
+#define VIEWER_FRAMESTATS_H
+
+#include "SPSCQueue.h"
+
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @class FrameStats
+ * @brief The FrameStats class records how long each part of a VR frame takes, for the GUI to display and save.
+ *
+ * One thread (the VR thread) records frames with addFrame() and one other thread (the GUI thread)
+ * reads them. Nothing is locked: totals and histogram buckets are atomics that only the recording
+ * thread writes, and the individual frame samples are passed to the reader through an SPSCQueue.
+ * Percentiles come from log spaced histogram buckets (5% wide) so recording costs the same no
+ * matter how many frames have been seen.
+ */
+class FrameStats {
+public:
+    /**
+     * @enum Phase
+     * @brief The parts of a frame that are timed, in the order the VR loop runs them.
+     */
+    enum Phase {
+        COMMANDS,       /**< Commands from the GUI thread and actors staged for the scene */
+        SCENE,          /**< Level of detail selection, instanced mapper and section plane updates */
+        EVENTS,         /**< Interactor event processing, the part of the backend's frame that is not rendering */
+        RENDER,         /**< Render window render (includes the compositor wait) */
+        ANIMATION,      /**< Animation update, up to writing the moving actors' matrices */
+        BOUNDS,         /**< Moving the moved parts' boxes in the part BVH and refitting it */
+        FRAME,          /**< The whole loop iteration, the sum of the other phases */
+        PHASE_COUNT
+    };
+
+    /**
+     * @struct Sample
+     * @brief The Sample structure holds the timings of one frame.
+     */
+    struct Sample {
+        quint64     frame = 0;              /**< Frame number, starting at 0 */
+        double      time = 0.;              /**< Seconds since recording started */
+        float       ms[PHASE_COUNT] = {};   /**< Duration of each phase in milliseconds */
+    };
+
+    /**
+     * @brief Constructor for the FrameStats class.
+     */
+    FrameStats();
+
+    /**
+     * @brief This function sets the frame time the display expects, frames that take more than 1.5 times longer are counted as dropped.
+     * @param ms is the target frame time in milliseconds (11.1 for a 90 Hz headset).
+     */
+    void setTargetFrameTime(double ms);
+
+    /**
+     * @brief This function records one frame, it must only be called from the recording thread.
+     * @param time is the time the frame started, in seconds since recording started.
+     * @param ms is the duration of each phase in milliseconds.
+     */
+    void addFrame(double time, const float ms[PHASE_COUNT]);
+
+    /**
+     * @brief This function asks the recording thread to clear the totals and histograms before its next frame.
+     */
+    void reset();
+
+    /**
+     * @brief This function returns the number of frames recorded.
+     * @return the number of frames.
+     */
+    quint64 frameCount() const;
+
+    /**
+     * @brief This function returns the number of frames that took longer than 1.5 times the target frame time.
+     * @return the number of dropped frames.
+     */
+    quint64 droppedFrames() const;
+
+    /**
+     * @brief This function returns the mean duration of a phase.
+     * @param phase is the phase.
+     * @return the mean in milliseconds, 0 if no frames have been recorded.
+     */
+    double mean(Phase phase) const;
+
+    /**
+     * @brief This function returns a percentile of a phase's duration, to within one histogram bucket (5%).
+     * @param phase is the phase.
+     * @param p is the percentile, 0-100.
+     * @return the duration in milliseconds, 0 if no frames have been recorded.
+     */
+    double percentile(Phase phase, double p) const;
+
+    /**
+     * @brief This function moves the samples recorded since the last call into the trace, it must only be called from the reading thread.
+     * The trace keeps roughly the most recent maxTraceLength() frames, the oldest are dropped in blocks.
+     * @return the number of samples moved.
+     */
+    int collect();
+
+    /**
+     * @brief This function returns the collected trace.
+     * @return the frame samples, oldest first.
+     */
+    const QVector<Sample>& trace() const;
+
+    /**
+     * @brief This function writes the collected trace to a file, as JSON if the name ends in .json and as CSV otherwise.
+     * @param fileName is the file to write.
+     * @return true if the file was written.
+     */
+    bool saveTrace(const QString& fileName) const;
+
+    /**
+     * @brief This function returns the name of a phase.
+     * @param phase is the phase.
+     * @return the name, as used in the saved trace.
+     */
+    static const char* phaseName(Phase phase);
+
+    /**
+     * @brief This function returns the number of samples the trace keeps.
+     * @return the number of samples.
+     */
+    static constexpr int maxTraceLength() {
+        return 1 << 17;
+    }
+
+private:
+    /**
+     * @brief This function returns the histogram bucket a duration falls in.
+     * @param ms is the duration in milliseconds.
+     * @return the bucket index.
+     */
+    static int bucket(float ms);
+
+    /**
+     * @brief This function clears the totals and histograms, it is called by the recording thread.
+     */
+    void clear();
+
+    static constexpr int                BUCKETS = 256;  /**< Buckets per histogram, 0.01 ms to about 2.5 s */
+
+    std::atomic<quint64>                frames;         /**< Frames recorded */
+    std::atomic<quint64>                dropped;        /**< Frames over the dropped threshold */
+    std::atomic<double>                 total[PHASE_COUNT]; /**< Sum of each phase's durations in milliseconds */
+    std::atomic<quint32>                histogram[PHASE_COUNT][BUCKETS]; /**< Frame count per duration bucket */
+    std::atomic<float>                  dropThreshold;  /**< Frame time above which a frame counts as dropped */
+    std::atomic<bool>                   resetRequested; /**< Set by reset(), cleared by the recording thread */
+
+    SPSCQueue<Sample, 4096>             samples;        /**< Samples on their way to the reading thread */
+    QVector<Sample>                     samplesTrace;   /**< Samples collected by the reading thread */
+};
+
+#endif
@@ -0,0 +1,535 @@
+/** @file GeometryCache.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * On-disk cache of prepared part geometry so STL files are only parsed once.
+  */
+
+#include "GeometryCache.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+namespace {
+
+/**
+ * @struct CacheHeader
+ * @brief The CacheHeader structure is at the start of every entry, the sections follow at the recorded offsets.
+ */
+struct CacheHeader {
+    char        magic[8];           /**< "VRGEOM" */
+    quint32     version;            /**< Format version, entries of other versions are discarded */
+    quint32     headerSize;         /**< Bytes before the first section */
+    quint64     pathHash;           /**< Hash of the absolute source path, guards against name collisions */
+    qint64      sourceSize;         /**< Size of the source file */
+    qint64      sourceModified;     /**< Modification time of the source file (ms since epoch) */
+    quint64     contentHash;        /**< Hash of the source file contents */
+    quint64     pointCount;         /**< Number of welded vertices */
+    quint64     triangleCount;      /**< Number of triangles */
+    double      bounds[6];          /**< xmin, xmax, ymin, ymax, zmin, zmax */
+    quint64     pointsOffset;       /**< float xyz per vertex */
+    quint64     normalsOffset;      /**< float xyz per vertex */
+    quint64     indicesOffset;      /**< quint32 x3 per triangle */
+    quint64     fileSize;           /**< Size of the whole entry */
+    quint64     payloadHash;        /**< Hash of everything after the header */
+};
+
+const char      cacheMagic[8] = { 'V', 'R', 'G', 'E', 'O', 'M', 0, 0 };
+const quint32   cacheVersion = 1;
+const quint64   sectionAlignment = 64;
+
+std::atomic<bool>   cacheEnabled(true);                     /**< Cache on/off */
+std::atomic<qint64> cacheMaximumSize(qint64(1) << 30);      /**< Size limit, 1 GiB by default */
+QMutex              cacheMutex;                             /**< Guards the directory setting, the size and eviction */
+QString             cacheDirectory;                         /**< Empty until set or first used */
+qint64              cacheSize = -1;                         /**< Total size of the entries, -1 until the directory is listed */
+
+inline quint64 rotateLeft(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief This function hashes a block of memory, four independent lanes keep it close to memory speed.
+ */
+quint64 hashBytes(const uchar* data, qint64 size, quint64 seed = 0) {
+    const quint64 k1 = 0x9E3779B97F4A7C15ull;
+    const quint64 k2 = 0xC2B2AE3D27D4EB4Full;
+    quint64 lanes[4] = { seed ^ k1, seed ^ k2, seed + k1, seed - k2 };
+
+    qint64 i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            quint64 word;
+            std::memcpy(&word, data + i + 8 * l, 8);
+            lanes[l] = rotateLeft(lanes[l] ^ (word * k2), 31) * k1;
+        }
+    }
+
+    quint64 h = (quint64(size) * k1) ^ rotateLeft(lanes[0], 1) ^ rotateLeft(lanes[1], 7)
+              ^ rotateLeft(lanes[2], 12) ^ rotateLeft(lanes[3], 18);
+    for (; i < size; i++)
+        h = (h ^ data[i]) * 0x100000001B3ull;
+
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 29;
+    return h;
+}
+
+quint64 hashString(const QString& text) {
+    QByteArray utf8 = text.toUtf8();
+    return hashBytes(reinterpret_cast<const uchar*>(utf8.constData()), utf8.size());
+}
+
+quint64 alignUp(quint64 offset) {
+    return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+}
+
+/**
+ * @brief This function checks that the header describes an entry that fits in the mapped file.
+ */
+bool headerIsValid(const CacheHeader& header, qint64 size) {
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion)
+        return false;
+    if (header.fileSize != quint64(size) || header.headerSize < sizeof(CacheHeader) || header.headerSize > quint64(size))
+        return false;
+    if (header.pointCount > quint64(std::numeric_limits<quint32>::max()))
+        return false;
+
+    quint64 pointBytes = header.pointCount * 3 * sizeof(float);
+    quint64 indexBytes = header.triangleCount * 3 * sizeof(quint32);
+    if (header.triangleCount > quint64(size) / (3 * sizeof(quint32)))
+        return false;
+
+    /* Each offset is bounded by the file before a length is added to it, so a damaged offset cannot wrap around */
+    quint64 end = quint64(size);
+    if (header.indicesOffset > end || header.normalsOffset > header.indicesOffset || header.pointsOffset > header.normalsOffset)
+        return false;
+
+    return header.pointsOffset % sectionAlignment == 0 && header.normalsOffset % sectionAlignment == 0
+        && header.indicesOffset % sectionAlignment == 0
+        && header.pointsOffset >= header.headerSize
+        && pointBytes <= header.normalsOffset - header.pointsOffset
+        && pointBytes <= header.indicesOffset - header.normalsOffset
+        && indexBytes <= end - header.indicesOffset;
+}
+
+/**
+ * @brief This function checks that the source file has not changed since the entry was stored.
+ */
+bool sourceMatches(const CacheHeader& header, const QFileInfo& source) {
+    return header.pathHash == hashString(source.absoluteFilePath())
+        && header.sourceSize == source.size()
+        && header.sourceModified == source.lastModified().toMSecsSinceEpoch();
+}
+
+/**
+ * @brief This function deletes a damaged entry and takes it off the size of the cache.
+ */
+void removeEntry(const QString& path, qint64 size) {
+    QMutexLocker lock(&cacheMutex);
+    if (QFile::remove(path) && cacheSize >= 0)
+        cacheSize -= size;
+}
+
+}
+
+
+/**
+ * @brief This function looks a file up in the cache.
+ * @param fileName is the name of the STL file.
+ * @param contentHash if not null, receives the hash of the file contents (needed by store()).
+ * @return the cached geometry, or nullptr on a miss.
+ */
+vtkSmartPointer<vtkPolyData> GeometryCache::load(const QString& fileName, quint64* contentHash) {
+    if (!isEnabled())
+        return nullptr;
+
+    /* The source is only hashed when it has no entry, for store() */
+    quint64 hash = 0;
+    vtkSmartPointer<vtkPolyData> cached;
+    if (storedHash(fileName, hash))
+        cached = load(fileName, hash);
+    else if (contentHash != nullptr)
+        hash = GeometryCache::contentHash(fileName);
+
+    if (contentHash != nullptr)
+        *contentHash = hash;
+    return cached;
+}
+
+/**
+ * @brief This function looks a file up in the cache when the hash of its contents is known already, so the file is not read again.
+ * @param fileName is the name of the STL file.
+ * @param contentHash is the hash of the file contents (see contentHash()).
+ * @return the cached geometry, or nullptr on a miss.
+ */
+vtkSmartPointer<vtkPolyData> GeometryCache::load(const QString& fileName, quint64 contentHash) {
+    if (!isEnabled())
+        return nullptr;
+
+    QString path = entryPath(fileName);
+    QFile entry(path);
+    if (!entry.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    qint64 size = entry.size();
+    const uchar* data = size >= qint64(sizeof(CacheHeader)) ? entry.map(0, size) : nullptr;
+    if (data == nullptr) {
+        entry.close();
+        removeEntry(path, size);
+        return nullptr;
+    }
+
+    /* Validate before trusting any offset, then check the payload has not been damaged */
+    CacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    bool valid = headerIsValid(header, size)
+        && sourceMatches(header, QFileInfo(fileName))
+        && header.contentHash == contentHash
+        && header.payloadHash == hashBytes(data + header.headerSize, size - header.headerSize);
+
+    if (!valid) {
+        entry.unmap(const_cast<uchar*>(data));
+        entry.close();
+        removeEntry(path, size);
+        return nullptr;
+    }
+
+    vtkIdType pointCount = vtkIdType(header.pointCount);
+    vtkIdType triangleCount = vtkIdType(header.triangleCount);
+
+    vtkNew<vtkFloatArray> points;
+    points->SetNumberOfComponents(3);
+    points->SetNumberOfTuples(pointCount);
+    std::memcpy(points->GetPointer(0), data + header.pointsOffset, size_t(pointCount) * 3 * sizeof(float));
+
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(pointCount);
+    std::memcpy(normals->GetPointer(0), data + header.normalsOffset, size_t(pointCount) * 3 * sizeof(float));
+
+    vtkNew<vtkIdTypeArray> offsets;
+    offsets->SetNumberOfTuples(triangleCount + 1);
+    vtkIdType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangleCount; i++)
+        offset[i] = 3 * i;
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfTuples(3 * triangleCount);
+    vtkIdType* ids = connectivity->GetPointer(0);
+    const quint32* indices = reinterpret_cast<const quint32*>(data + header.indicesOffset);
+    for (vtkIdType i = 0; i < 3 * triangleCount; i++) {
+        if (indices[i] >= header.pointCount) {
+            valid = false;
+            break;
+        }
+        ids[i] = indices[i];
+    }
+
+    entry.unmap(const_cast<uchar*>(data));
+    entry.close();
+
+    if (!valid) {
+        removeEntry(path, size);
+        return nullptr;
+    }
+
+    /* Mark the entry as recently used */
+    if (entry.open(QIODevice::Append))
+        entry.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(points);
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(offsets, connectivity);
+
+    vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+    polyData->SetPoints(outputPoints);
+    polyData->SetPolys(polys);
+    polyData->GetPointData()->SetNormals(normals);
+    return polyData;
+}
+
+/**
+ * @brief This function returns the contents hash recorded in a file's entry, without reading the file.
+ * Only the header of the entry is read; its checksum is checked when the entry is loaded.
+ * @param fileName is the name of the STL file.
+ * @param contentHash receives the hash of the file contents.
+ * @return true if the file has an entry, false if the file must be hashed.
+ */
+bool GeometryCache::storedHash(const QString& fileName, quint64& contentHash) {
+    if (!isEnabled())
+        return false;
+
+    QFile entry(entryPath(fileName));
+    CacheHeader header;
+    if (!entry.open(QIODevice::ReadOnly)
+        || entry.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header)))
+        return false;
+    if (!headerIsValid(header, entry.size()) || !sourceMatches(header, QFileInfo(fileName)))
+        return false;
+
+    contentHash = header.contentHash;
+    return true;
+}
+
+/**
+ * @brief This function adds prepared geometry (triangles with point normals) to the cache.
+ * @param fileName is the name of the STL file the geometry was read from.
+ * @param contentHash is the hash of the file contents returned by load().
+ * @param polyData is the prepared geometry.
+ */
+void GeometryCache::store(const QString& fileName, quint64 contentHash, vtkPolyData* polyData) {
+    if (!isEnabled() || polyData == nullptr || polyData->GetPoints() == nullptr || polyData->GetPolys() == nullptr)
+        return;
+
+    vtkFloatArray* points = vtkFloatArray::FastDownCast(polyData->GetPoints()->GetData());
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(polyData->GetPointData()->GetNormals());
+    if (points == nullptr || normals == nullptr || normals->GetNumberOfTuples() != points->GetNumberOfTuples())
+        return;
+
+    quint64 pointCount = quint64(points->GetNumberOfTuples());
+    if (pointCount > quint64(std::numeric_limits<quint32>::max()))
+        return;
+
+    /* Only triangle meshes are cached, which is all MeshPreparation produces */
+    vtkNew<vtkIdTypeArray> legacy;
+    polyData->GetPolys()->ExportLegacyFormat(legacy);
+    const vtkIdType* cells = legacy->GetPointer(0);
+    vtkIdType cellsSize = legacy->GetNumberOfValues();
+
+    std::vector<quint32> indices;
+    indices.reserve(size_t(polyData->GetNumberOfPolys()) * 3);
+    for (vtkIdType i = 0; i < cellsSize; i += 4) {
+        if (cells[i] != 3)
+            return;
+        indices.push_back(quint32(cells[i + 1]));
+        indices.push_back(quint32(cells[i + 2]));
+        indices.push_back(quint32(cells[i + 3]));
+    }
+
+    QFileInfo source(fileName);
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.headerSize = quint32(alignUp(sizeof(CacheHeader)));
+    header.pathHash = hashString(source.absoluteFilePath());
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.contentHash = contentHash;
+    header.pointCount = pointCount;
+    header.triangleCount = indices.size() / 3;
+    polyData->GetBounds(header.bounds);
+
+    quint64 pointBytes = pointCount * 3 * sizeof(float);
+    header.pointsOffset = header.headerSize;
+    header.normalsOffset = alignUp(header.pointsOffset + pointBytes);
+    header.indicesOffset = alignUp(header.normalsOffset + pointBytes);
+    header.fileSize = header.indicesOffset + indices.size() * sizeof(quint32);
+
+    QByteArray buffer(qsizetype(header.fileSize), '\0');
+    uchar* data = reinterpret_cast<uchar*>(buffer.data());
+    std::memcpy(data + header.pointsOffset, points->GetPointer(0), pointBytes);
+    std::memcpy(data + header.normalsOffset, normals->GetPointer(0), pointBytes);
+    std::memcpy(data + header.indicesOffset, indices.data(), indices.size() * sizeof(quint32));
+    header.payloadHash = hashBytes(data + header.headerSize, qint64(header.fileSize - header.headerSize));
+    std::memcpy(data, &header, sizeof(header));
+
+    QString path = entryPath(fileName);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    /* QSaveFile writes a temporary file and renames it, so readers never see a partial entry */
+    QFileInfo replaced(path);
+    qint64 replacedSize = replaced.exists() ? replaced.size() : 0;
+    QSaveFile entry(path);
+    if (!entry.open(QIODevice::WriteOnly))
+        return;
+    entry.write(buffer);
+    if (!entry.commit())
+        return;
+
+    {
+        QMutexLocker lock(&cacheMutex);
+        if (cacheSize >= 0)
+            cacheSize += qint64(header.fileSize) - replacedSize;
+    }
+    evict();
+}
+
+/**
+ * @brief This function hashes the contents of a file.
+ * @param fileName is the name of the file.
+ * @param ok if not null, is set to false when the file could not be read.
+ * @return a 64 bit hash of the contents.
+ */
+quint64 GeometryCache::contentHash(const QString& fileName, bool* ok) {
+    if (ok != nullptr)
+        *ok = false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    qint64 size = file.size();
+    if (size == 0) {
+        if (ok != nullptr)
+            *ok = true;
+        return hashBytes(nullptr, 0);
+    }
+
+    const uchar* data = file.map(0, size);
+    if (data == nullptr)
+        return 0;
+
+    quint64 hash = hashBytes(data, size);
+    file.unmap(const_cast<uchar*>(data));
+
+    if (ok != nullptr)
+        *ok = true;
+    return hash;
+}
+
+/**
+ * @brief This function hashes a block of memory with the hash used for file contents and entry checksums.
+ * @param data is the start of the block.
+ * @param size is the size of the block in bytes.
+ * @return a 64 bit hash of the block.
+ */
+quint64 GeometryCache::hashData(const uchar* data, qint64 size) {
+    return hashBytes(data, size);
+}
+
+/**
+ * @brief This function turns the cache on or off (it is on by default).
+ * @param enabled is true to use the cache.
+ */
+void GeometryCache::setEnabled(bool enabled) {
+    cacheEnabled = enabled;
+}
+
+/**
+ * @brief This function returns true if the cache is in use.
+ * @return true if the cache is enabled.
+ */
+bool GeometryCache::isEnabled() {
+    return cacheEnabled.load();
+}
+
+/**
+ * @brief This function sets the directory entries are kept in, by default the "geometry" folder of the user cache location.
+ * @param directory is the cache directory.
+ */
+void GeometryCache::setDirectory(const QString& directory) {
+    QMutexLocker lock(&cacheMutex);
+    cacheDirectory = directory;
+    cacheSize = -1;
+}
+
+/**
+ * @brief This function returns the directory entries are kept in.
+ * @return the cache directory.
+ */
+QString GeometryCache::directory() {
+    QMutexLocker lock(&cacheMutex);
+    if (cacheDirectory.isEmpty())
+        cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/geometry";
+    return cacheDirectory;
+}
+
+/**
+ * @brief This function sets the size limit of the cache, least recently used entries are removed beyond it.
+ * @param bytes is the maximum size in bytes.
+ */
+void GeometryCache::setMaximumSize(qint64 bytes) {
+    cacheMaximumSize = bytes;
+    evict();
+}
+
+/**
+ * @brief This function returns the size limit of the cache.
+ * @return the maximum size in bytes.
+ */
+qint64 GeometryCache::maximumSize() {
+    return cacheMaximumSize.load();
+}
+
+/**
+ * @brief This function deletes every entry in the cache.
+ */
+void GeometryCache::clear() {
+    QDir dir(directory());
+    QMutexLocker lock(&cacheMutex);
+    cacheSize = 0;
+    for (const QFileInfo& info : dir.entryInfoList({ "*.geom" }, QDir::Files)) {
+        if (!QFile::remove(info.absoluteFilePath()))
+            cacheSize += info.size();
+    }
+}
+
+/**
+ * @brief This function returns the name of the entry for a source file.
+ * @param fileName is the name of the STL file.
+ * @return the path of the cache entry.
+ */
+QString GeometryCache::entryPath(const QString& fileName) {
+    QFileInfo source(fileName);
+    QString key = QString("%1|%2|%3").arg(source.absoluteFilePath()).arg(source.size())
+                                     .arg(source.lastModified().toMSecsSinceEpoch());
+    return directory() + "/" + QString::number(hashString(key), 16).rightJustified(16, '0') + ".geom";
+}
+
+/**
+ * @brief This function removes least recently used entries until the cache fits its size limit.
+ * The directory is listed once to learn the size of the cache, which is then kept up to date by
+ * store(), and listed again only when the cache is over its limit. Entries are then removed until
+ * the cache is a tenth under the limit, so the next few stores do not list it again.
+ */
+void GeometryCache::evict() {
+    QDir dir(directory());
+    QMutexLocker lock(&cacheMutex);
+
+    if (cacheSize < 0) {
+        cacheSize = 0;
+        for (const QFileInfo& info : dir.entryInfoList({ "*.geom" }, QDir::Files))
+            cacheSize += info.size();
+    }
+    if (cacheSize <= maximumSize())
+        return;
+
+    /* Oldest first, load() refreshes the modification time of entries it uses.
+     * The listing also corrects the total for entries changed by other processes */
+    QFileInfoList entries = dir.entryInfoList({ "*.geom" }, QDir::Files, QDir::Time | QDir::Reversed);
+    cacheSize = 0;
+    for (const QFileInfo& info : entries)
+        cacheSize += info.size();
+
+    qint64 target = maximumSize() - maximumSize() / 10;
+    for (const QFileInfo& info : entries) {
+        if (cacheSize <= target)
+            break;
+        if (QFile::remove(info.absoluteFilePath()))
+            cacheSize -= info.size();
+    }
+}
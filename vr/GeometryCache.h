@@ -0,0 +1,136 @@
+/** @file GeometryCache.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * On-disk cache of prepared part geometry so STL files are only parsed once.
+  */
+
+#ifndef VIEWER_GEOMETRYCACHE_H
+#define VIEWER_GEOMETRYCACHE_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @class GeometryCache
+ * @brief The GeometryCache class stores the welded vertices, triangle indices, normals and bounds
+ * of each loaded part in a compact binary file under the user cache directory.
+ *
+ * Entries are named after a hash of the source path, size and modification time and record a
+ * hash of the source contents. An entry is trusted without reading the source again while the
+ * source keeps the recorded size and modification time, and its contents hash is what the loader
+ * uses to tell copies apart (see storedHash()). Sections are 64-byte aligned so an entry is read
+ * by mapping it, with no parsing. Every entry carries a checksum and damaged entries are deleted
+ * and treated as a miss. The size of the cache is kept as a running total; when it grows past
+ * the limit the least recently used entries are evicted until it is a tenth under it, so the
+ * directory is only listed now and then. All functions are safe to call from the loader's
+ * worker threads.
+ */
+class GeometryCache {
+public:
+    /**
+     * @brief This function looks a file up in the cache.
+     * @param fileName is the name of the STL file.
+     * @param contentHash if not null, receives the hash of the file contents (needed by store()).
+     * @return the cached geometry, or nullptr on a miss.
+     */
+    static vtkSmartPointer<vtkPolyData> load(const QString& fileName, quint64* contentHash = nullptr);
+
+    /**
+     * @brief This function looks a file up in the cache when the hash of its contents is known already, so the file is not read again.
+     * @param fileName is the name of the STL file.
+     * @param contentHash is the hash of the file contents (see contentHash()).
+     * @return the cached geometry, or nullptr on a miss.
+     */
+    static vtkSmartPointer<vtkPolyData> load(const QString& fileName, quint64 contentHash);
+
+    /**
+     * @brief This function returns the contents hash recorded in a file's entry, without reading the file.
+     * The entry is trusted while the file has the same path, size and modification time as when it was stored.
+     * @param fileName is the name of the STL file.
+     * @param contentHash receives the hash of the file contents.
+     * @return true if the file has an entry, false if the file must be hashed.
+     */
+    static bool storedHash(const QString& fileName, quint64& contentHash);
+
+    /**
+     * @brief This function adds prepared geometry (triangles with point normals) to the cache.
+     * @param fileName is the name of the STL file the geometry was read from.
+     * @param contentHash is the hash of the file contents returned by load().
+     * @param polyData is the prepared geometry.
+     */
+    static void store(const QString& fileName, quint64 contentHash, vtkPolyData* polyData);
+
+    /**
+     * @brief This function hashes the contents of a file.
+     * @param fileName is the name of the file.
+     * @param ok if not null, is set to false when the file could not be read.
+     * @return a 64 bit hash of the contents.
+     */
+    static quint64 contentHash(const QString& fileName, bool* ok = nullptr);
+
+    /**
+     * @brief This function hashes a block of memory with the hash used for file contents and entry checksums.
+     * @param data is the start of the block.
+     * @param size is the size of the block in bytes.
+     * @return a 64 bit hash of the block.
+     */
+    static quint64 hashData(const uchar* data, qint64 size);
+
+    /**
+     * @brief This function turns the cache on or off (it is on by default).
+     * @param enabled is true to use the cache.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief This function returns true if the cache is in use.
+     * @return true if the cache is enabled.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief This function sets the directory entries are kept in, by default the "geometry" folder of the user cache location.
+     * @param directory is the cache directory.
+     */
+    static void setDirectory(const QString& directory);
+
+    /**
+     * @brief This function returns the directory entries are kept in.
+     * @return the cache directory.
+     */
+    static QString directory();
+
+    /**
+     * @brief This function sets the size limit of the cache, least recently used entries are removed beyond it.
+     * @param bytes is the maximum size in bytes.
+     */
+    static void setMaximumSize(qint64 bytes);
+
+    /**
+     * @brief This function returns the size limit of the cache.
+     * @return the maximum size in bytes.
+     */
+    static qint64 maximumSize();
+
+    /**
+     * @brief This function deletes every entry in the cache.
+     */
+    static void clear();
+
+private:
+    /**
+     * @brief This function returns the name of the entry for a source file.
+     * @param fileName is the name of the STL file.
+     * @return the path of the cache entry.
+     */
+    static QString entryPath(const QString& fileName);
+
+    /**
+     * @brief This function removes least recently used entries until the cache fits its size limit.
+     */
+    static void evict();
+};
+
+#endif
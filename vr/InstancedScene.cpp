@@ -0,0 +1,318 @@
+/** @file InstancedScene.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Draws copies of the same geometry with one instanced mapper.
+  */
+
+#include "InstancedScene.h"
+
+#include <algorithm>
+
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkProperty.h>
+#include <vtkUnsignedCharArray.h>
+
+namespace {
+
+/* A group goes back to separate actors once it has fewer than this fraction of the minimum,
+ * so a group at the threshold does not switch back and forth as copies come and go */
+const int SEPARATE_DIVISOR = 2;
+
+/* Names of the instance arrays read by the mapper */
+const char* const MATRIX_ARRAY = "Matrix";
+const char* const COLOUR_ARRAY = "Colour";
+const char* const MASK_ARRAY = "Visible";
+
+}
+
+/**
+ * @brief Constructor for the InstancedScene class.
+ * @param minimumCopies is the number of actors sharing geometry from which they are instanced.
+ */
+InstancedScene::InstancedScene(int minimumCopies)
+    : renderer(nullptr), minimum(std::max(minimumCopies, 2)), props(0) {
+}
+
+/**
+ * @brief This function sets the renderer actors are added to.
+ * @param renderer is the renderer.
+ */
+void InstancedScene::setRenderer(vtkRenderer* renderer) {
+    this->renderer = renderer;
+}
+
+/**
+ * @brief This function adds an actor to the scene.
+ * @param actor is the actor.
+ * @param source is the full detail geometry the actor renders, actors with the same source are instanced together.
+ */
+void InstancedScene::add(vtkActor* actor, vtkPolyData* source) {
+    if (actor == nullptr || renderer == nullptr || sources.count(actor) > 0)
+        return;
+
+    /* Without shared geometry the actor is drawn by itself */
+    if (source == nullptr) {
+        sources[actor] = nullptr;
+        renderer->AddActor(actor);
+        props++;
+        return;
+    }
+
+    sources[actor] = source;
+    Group& group = groups[source];
+    group.members.push_back(actor);
+    group.dirty = true;
+
+    if (group.batch != nullptr)
+        return;
+
+    if (int(group.members.size()) >= minimum) {
+        instance(group, source);
+    } else {
+        renderer->AddActor(actor);
+        props++;
+    }
+}
+
+/**
+ * @brief This function removes an actor from the scene.
+ * @param actor is the actor.
+ */
+void InstancedScene::remove(vtkActor* actor) {
+    auto it = sources.find(actor);
+    if (it == sources.end())
+        return;
+
+    vtkPolyData* source = it->second;
+    sources.erase(it);
+    if (source == nullptr) {
+        renderer->RemoveActor(actor);
+        props--;
+        return;
+    }
+
+    Group& group = groups[source];
+    auto member = std::find(group.members.begin(), group.members.end(), actor);
+    if (member != group.members.end())
+        group.members.erase(member);
+    group.dirty = true;
+
+    if (group.batch == nullptr) {
+        renderer->RemoveActor(actor);
+        props--;
+    } else if (int(group.members.size()) < minimum / SEPARATE_DIVISOR) {
+        separate(group);
+    }
+
+    if (group.members.empty())
+        groups.erase(source);
+}
+
+/**
+ * @brief This function removes every actor from the scene.
+ */
+void InstancedScene::clear() {
+    if (renderer != nullptr) {
+        for (auto& entry : sources) {
+            if (entry.second == nullptr || groups[entry.second].batch == nullptr)
+                renderer->RemoveActor(entry.first);
+        }
+        for (auto& entry : groups) {
+            if (entry.second.batch != nullptr)
+                renderer->RemoveActor(entry.second.batch);
+        }
+    }
+
+    groups.clear();
+    sources.clear();
+    props = 0;
+}
+
+/**
+ * @brief This function copies the instanced actors that changed since the last call into their instanced mappers.
+ */
+void InstancedScene::update() {
+    for (auto& entry : groups) {
+        Group& group = entry.second;
+        if (group.batch == nullptr)
+            continue;
+
+        /* An actor's time covers its matrix and its property, so one comparison per member finds any change */
+        vtkMTimeType newest = 0;
+        for (const vtkSmartPointer<vtkActor>& member : group.members)
+            newest = std::max(newest, member->GetMTime());
+
+        if (group.dirty || newest > group.built)
+            build(group);
+    }
+}
+
+/**
+ * @brief This function returns the geometry an actor was added with.
+ * @param actor is the actor.
+ * @return the source given to add(), nullptr if the actor is not in the scene.
+ */
+vtkPolyData* InstancedScene::source(vtkActor* actor) const {
+    auto it = sources.find(actor);
+    return it != sources.end() ? it->second : nullptr;
+}
+
+/**
+ * @brief This function checks if an actor is drawn by an instanced mapper rather than by itself.
+ * @param actor is the actor.
+ * @return true if the actor is instanced.
+ */
+bool InstancedScene::isInstanced(vtkActor* actor) const {
+    auto it = sources.find(actor);
+    if (it == sources.end() || it->second == nullptr)
+        return false;
+
+    auto group = groups.find(it->second);
+    return group != groups.end() && group->second.batch != nullptr;
+}
+
+/**
+ * @brief This function returns the number of props the scene has added to the renderer.
+ * @return the number of props.
+ */
+int InstancedScene::propCount() const {
+    return props;
+}
+
+/**
+ * @brief This function returns the number of actors in the scene.
+ * @return the number of actors.
+ */
+int InstancedScene::actorCount() const {
+    return int(sources.size());
+}
+
+/**
+ * @brief This function takes a group's members out of the renderer and draws them with one instanced actor.
+ * @param group is the group.
+ * @param source is the shared geometry.
+ */
+void InstancedScene::instance(Group& group, vtkPolyData* source) {
+    for (size_t i = 0; i + 1 < group.members.size(); i++) {
+        renderer->RemoveActor(group.members[i]);
+        props--;
+    }
+
+    group.instances = vtkSmartPointer<vtkPolyData>::New();
+
+    /* Each instance is placed by the 3x3 part of its member's matrix and its translation, the glyph
+     * scale is left at 1 since the matrix already holds any scaling */
+    group.mapper = vtkSmartPointer<vtkGlyph3DMapper>::New();
+    group.mapper->SetSourceData(source);
+    group.mapper->SetInputData(group.instances);
+    group.mapper->SetOrientationModeToMatrix();
+    group.mapper->SetOrientationArray(MATRIX_ARRAY);
+    group.mapper->ScalingOff();
+    group.mapper->SetMasking(true);
+    group.mapper->SetMaskArray(MASK_ARRAY);
+
+    /* The colour array holds the final RGBA of each instance */
+    group.mapper->ScalarVisibilityOn();
+    group.mapper->SetScalarModeToUsePointFieldData();
+    group.mapper->SelectColorArray(COLOUR_ARRAY);
+    group.mapper->SetColorModeToDirectScalars();
+
+    /* Lighting and surface settings are shared, they come from the first member */
+    group.batch = vtkSmartPointer<vtkActor>::New();
+    group.batch->SetMapper(group.mapper);
+    group.batch->GetProperty()->DeepCopy(group.members.front()->GetProperty());
+    group.batch->PickableOff();
+
+    build(group);
+    renderer->AddActor(group.batch);
+    props++;
+}
+
+/**
+ * @brief This function removes a group's instanced actor and adds its members to the renderer again.
+ * @param group is the group.
+ */
+void InstancedScene::separate(Group& group) {
+    renderer->RemoveActor(group.batch);
+    props--;
+
+    group.batch = nullptr;
+    group.mapper = nullptr;
+    group.instances = nullptr;
+
+    for (const vtkSmartPointer<vtkActor>& member : group.members) {
+        renderer->AddActor(member);
+        props++;
+    }
+}
+
+/**
+ * @brief This function copies every member of an instanced group into its instance points.
+ * @param group is the group.
+ */
+void InstancedScene::build(Group& group) {
+    vtkIdType count = vtkIdType(group.members.size());
+
+    vtkNew<vtkPoints> points;
+    points->SetDataTypeToDouble();
+    points->SetNumberOfPoints(count);
+
+    vtkNew<vtkDoubleArray> matrices;
+    matrices->SetName(MATRIX_ARRAY);
+    matrices->SetNumberOfComponents(9);
+    matrices->SetNumberOfTuples(count);
+
+    vtkNew<vtkUnsignedCharArray> colours;
+    colours->SetName(COLOUR_ARRAY);
+    colours->SetNumberOfComponents(4);
+    colours->SetNumberOfTuples(count);
+
+    vtkNew<vtkBitArray> visible;
+    visible->SetName(MASK_ARRAY);
+    visible->SetNumberOfTuples(count);
+
+    vtkNew<vtkMatrix4x4> matrix;
+    vtkMTimeType newest = 0;
+    for (vtkIdType i = 0; i < count; i++) {
+        vtkActor* member = group.members[size_t(i)];
+        newest = std::max(newest, member->GetMTime());
+
+        /* The same matrix the member would be drawn with: position, orientation, scale and user matrix */
+        member->GetMatrix(matrix);
+        points->SetPoint(i, matrix->GetElement(0, 3), matrix->GetElement(1, 3), matrix->GetElement(2, 3));
+
+        double rotation[9];
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                rotation[3 * row + column] = matrix->GetElement(row, column);
+        }
+        matrices->SetTypedTuple(i, rotation);
+
+        vtkProperty* property = member->GetProperty();
+        double colour[3];
+        property->GetColor(colour);
+        unsigned char rgba[4] = {
+            static_cast<unsigned char>(std::min(std::max(colour[0], 0.), 1.) * 255. + 0.5),
+            static_cast<unsigned char>(std::min(std::max(colour[1], 0.), 1.) * 255. + 0.5),
+            static_cast<unsigned char>(std::min(std::max(colour[2], 0.), 1.) * 255. + 0.5),
+            static_cast<unsigned char>(std::min(std::max(property->GetOpacity(), 0.), 1.) * 255. + 0.5)
+        };
+        colours->SetTypedTuple(i, rgba);
+
+        visible->SetValue(i, member->GetVisibility() ? 1 : 0);
+    }
+
+    group.instances->SetPoints(points);
+    vtkPointData* pointData = group.instances->GetPointData();
+    pointData->AddArray(matrices);
+    pointData->AddArray(colours);
+    pointData->AddArray(visible);
+    group.instances->Modified();
+
+    group.built = newest;
+    group.dirty = false;
+}
@@ -0,0 +1,139 @@
+/** @file InstancedScene.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Draws copies of the same geometry with one instanced mapper.
+  */
+
+#ifndef VIEWER_INSTANCEDSCENE_H
+#define VIEWER_INSTANCEDSCENE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <vtkActor.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+/**
+ * @class InstancedScene
+ * @brief The InstancedScene class adds part actors to a renderer, replacing the actors of parts
+ * that share their geometry with a single actor that draws every copy in one instanced draw call.
+ *
+ * Actors are grouped by the vtkPolyData of their full detail geometry, which parts read from
+ * identical files share (see STLLoader). Below a minimum number of copies the actors are added to
+ * the renderer as usual. From the minimum on they are taken out of the renderer and a
+ * vtkGlyph3DMapper draws the geometry once per copy, with each copy's matrix, colour, opacity and
+ * visibility read from its actor by update(). The part actors stay the ones the rest of the view
+ * works with (pick index, animation, colour and visibility changes); they are just not drawn
+ * themselves. Instanced copies are drawn at full detail and are not culled one by one.
+ *
+ * Actors are held by the scene until removed. It is not thread safe, each view has its own scene
+ * used by the thread that renders it.
+ */
+class InstancedScene {
+public:
+    /**
+     * @brief Constructor for the InstancedScene class.
+     * @param minimumCopies is the number of actors sharing geometry from which they are instanced.
+     */
+    explicit InstancedScene(int minimumCopies = 8);
+
+    /**
+     * @brief This function sets the renderer actors are added to. It must be set before the first add().
+     * @param renderer is the renderer.
+     */
+    void setRenderer(vtkRenderer* renderer);
+
+    /**
+     * @brief This function adds an actor to the scene.
+     * @param actor is the actor.
+     * @param source is the full detail geometry the actor renders, actors with the same source are instanced together.
+     */
+    void add(vtkActor* actor, vtkPolyData* source);
+
+    /**
+     * @brief This function removes an actor from the scene.
+     * @param actor is the actor.
+     */
+    void remove(vtkActor* actor);
+
+    /**
+     * @brief This function removes every actor from the scene.
+     */
+    void clear();
+
+    /**
+     * @brief This function copies the matrices, colours and visibility of instanced actors that changed
+     * since the last call into their instanced mappers. It is called before each render.
+     */
+    void update();
+
+    /**
+     * @brief This function returns the geometry an actor was added with.
+     * @param actor is the actor.
+     * @return the source given to add(), nullptr if the actor is not in the scene.
+     */
+    vtkPolyData* source(vtkActor* actor) const;
+
+    /**
+     * @brief This function checks if an actor is drawn by an instanced mapper rather than by itself.
+     * @param actor is the actor.
+     * @return true if the actor is instanced.
+     */
+    bool isInstanced(vtkActor* actor) const;
+
+    /**
+     * @brief This function returns the number of props the scene has added to the renderer, about one draw call each.
+     * @return the number of props.
+     */
+    int propCount() const;
+
+    /**
+     * @brief This function returns the number of actors in the scene.
+     * @return the number of actors.
+     */
+    int actorCount() const;
+
+private:
+    /**
+     * @struct Group
+     * @brief The Group structure holds the actors that share one geometry.
+     */
+    struct Group {
+        std::vector<vtkSmartPointer<vtkActor>>  members;        /**< Actors sharing the geometry */
+        vtkSmartPointer<vtkActor>               batch;          /**< Actor drawing every member, null while they are drawn one by one */
+        vtkSmartPointer<vtkGlyph3DMapper>       mapper;         /**< Instanced mapper of the batch */
+        vtkSmartPointer<vtkPolyData>            instances;      /**< One point per member with its matrix, colour and visibility */
+        vtkMTimeType                            built;          /**< Newest member time copied into instances */
+        bool                                    dirty;          /**< True if members were added or removed since the last copy */
+    };
+
+    /**
+     * @brief This function takes a group's members out of the renderer and draws them with one instanced actor.
+     * @param group is the group.
+     * @param source is the shared geometry.
+     */
+    void instance(Group& group, vtkPolyData* source);
+
+    /**
+     * @brief This function removes a group's instanced actor and adds its members to the renderer again.
+     * @param group is the group.
+     */
+    void separate(Group& group);
+
+    /**
+     * @brief This function copies every member of an instanced group into its instance points.
+     * @param group is the group.
+     */
+    void build(Group& group);
+
+    vtkRenderer*                                        renderer;       /**< Renderer the props are added to */
+    std::unordered_map<vtkPolyData*, Group>             groups;         /**< Actors by shared geometry */
+    std::unordered_map<vtkActor*, vtkPolyData*>         sources;        /**< Geometry each actor was added with */
+    int                                                 minimum;        /**< Copies from which actors are instanced */
+    int                                                 props;          /**< Props added to the renderer */
+};
+
+#endif
@@ -0,0 +1,214 @@
+/** @file LODSelector.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Chooses the level of detail each part is drawn at.
+  */
+
+#include "LODSelector.h"
+
+#include <cmath>
+
+#include <vtkCamera.h>
+#include <vtkMatrix4x4.h>
+
+namespace {
+
+/* A coarser level is only chosen once its error is below this fraction of the tolerance */
+const double HYSTERESIS = 0.7;
+
+}
+
+/**
+ * @brief Constructor for the LODSelector class.
+ */
+LODSelector::LODSelector()
+    : enabled(true), pixels(1.), triangles(0) {
+}
+
+/**
+ * @brief This function tells the selector which geometry an actor renders.
+ * @param actor is the actor, its current mapper is used for level 0.
+ * @param geometry is the geometry with its levels of detail.
+ */
+void LODSelector::setGeometry(vtkActor* actor, std::shared_ptr<const PartGeometry> geometry) {
+    if (actor == nullptr)
+        return;
+
+    auto it = index.find(actor);
+    if (it != index.end()) {
+        if (entries[it->second].geometry == geometry)
+            return;
+        remove(actor);
+    }
+
+    if (geometry == nullptr || geometry->levelCount() < 2)
+        return;
+
+    Entry entry;
+    entry.actor = actor;
+    entry.geometry = geometry;
+    entry.mappers.resize(size_t(geometry->levelCount()));
+    entry.mappers[0] = actor->GetMapper();
+    entry.level = 0;
+
+    index[actor] = entries.size();
+    entries.push_back(entry);
+}
+
+/**
+ * @brief This function stops switching an actor's levels and puts back its full detail mapper.
+ * @param actor is the actor.
+ */
+void LODSelector::remove(vtkActor* actor) {
+    auto it = index.find(actor);
+    if (it == index.end())
+        return;
+
+    size_t i = it->second;
+    setLevel(entries[i], 0);
+
+    if (i + 1 != entries.size()) {
+        entries[i] = entries.back();
+        index[entries[i].actor] = i;
+    }
+    entries.pop_back();
+    index.erase(it);
+}
+
+/**
+ * @brief This function forgets every actor, leaving each at its full detail mapper.
+ */
+void LODSelector::clear() {
+    for (Entry& entry : entries)
+        setLevel(entry, 0);
+    entries.clear();
+    index.clear();
+    triangles = 0;
+}
+
+/**
+ * @brief This function chooses the level of every tracked actor for the renderer's current camera.
+ * @param renderer is the renderer the actors are drawn by.
+ */
+void LODSelector::update(vtkRenderer* renderer) {
+    triangles = 0;
+    vtkCamera* camera = renderer != nullptr ? renderer->GetActiveCamera() : nullptr;
+    if (camera == nullptr)
+        return;
+
+    /* Pixels per model unit at distance 1: half the viewport height times the projection's y
+     * scale, taken from the projection matrix so an explicit projection is used if the camera has one */
+    int* size = renderer->GetSize();
+    double aspect[2];
+    renderer->GetAspect(aspect);
+    vtkMatrix4x4* projection = camera->GetProjectionTransformMatrix(aspect[0] / aspect[1], -1., 1.);
+    double scale = 0.5 * double(size[1]) * projection->GetElement(1, 1);
+    bool parallel = camera->GetParallelProjection() != 0;
+
+    double eye[3];
+    camera->GetPosition(eye);
+
+    for (Entry& entry : entries) {
+        const PartGeometry& geometry = *entry.geometry;
+        int levels = geometry.levelCount();
+        int level = entry.level;
+
+        if (!enabled) {
+            level = 0;
+        }
+        else {
+            /* Distance from the eye to the nearest point of the part's box, 0 inside it */
+            double* bounds = entry.actor->GetBounds();
+            double d2 = 0.;
+            for (int k = 0; k < 3; k++) {
+                double outside = eye[k] < bounds[2 * k] ? bounds[2 * k] - eye[k]
+                               : (eye[k] > bounds[2 * k + 1] ? eye[k] - bounds[2 * k + 1] : 0.);
+                d2 += outside * outside;
+            }
+            double perUnit = parallel ? scale : (d2 > 0. ? scale / std::sqrt(d2) : HUGE_VAL);
+
+            while (level > 0 && geometry.levelError(level) * perUnit > pixels)
+                level--;
+            while (level + 1 < levels && geometry.levelError(level + 1) * perUnit < pixels * HYSTERESIS)
+                level++;
+        }
+
+        setLevel(entry, level);
+        if (entry.actor->GetVisibility())
+            triangles += geometry.levelTriangleCount(level);
+    }
+}
+
+/**
+ * @brief This function turns level switching on or off.
+ * @param enabled is true to switch levels.
+ */
+void LODSelector::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+/**
+ * @brief This function checks if level switching is on.
+ * @return true if levels are switched.
+ */
+bool LODSelector::isEnabled() const {
+    return enabled;
+}
+
+/**
+ * @brief This function sets the largest error allowed on screen.
+ * @param pixels is the tolerance in pixels.
+ */
+void LODSelector::setTolerance(double pixels) {
+    this->pixels = pixels > 0. ? pixels : 1.;
+}
+
+/**
+ * @brief This function returns the largest error allowed on screen.
+ * @return the tolerance in pixels.
+ */
+double LODSelector::tolerance() const {
+    return pixels;
+}
+
+/**
+ * @brief This function returns the level an actor is drawn at.
+ * @param actor is the actor.
+ * @return the level, 0 if the actor is not tracked.
+ */
+int LODSelector::levelOf(vtkActor* actor) const {
+    auto it = index.find(actor);
+    return it != index.end() ? entries[it->second].level : 0;
+}
+
+/**
+ * @brief This function returns the number of triangles the tracked, visible actors were drawn with at the last update().
+ * @return the number of triangles.
+ */
+vtkIdType LODSelector::triangleCount() const {
+    return triangles;
+}
+
+/**
+ * @brief This function returns the number of tracked actors.
+ * @return the number of actors.
+ */
+int LODSelector::actorCount() const {
+    return int(entries.size());
+}
+
+/**
+ * @brief This function makes an actor draw one level.
+ * @param entry is the actor's entry.
+ * @param level is the level.
+ */
+void LODSelector::setLevel(Entry& entry, int level) {
+    if (level == entry.level)
+        return;
+
+    vtkSmartPointer<vtkMapper>& mapper = entry.mappers[size_t(level)];
+    if (mapper == nullptr)
+        mapper = entry.geometry->createMapper(level);
+
+    entry.actor->SetMapper(mapper);
+    entry.level = level;
+}
@@ -0,0 +1,133 @@
+/** @file LODSelector.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Chooses the level of detail each part is drawn at.
+  */
+
+#ifndef VIEWER_LODSELECTOR_H
+#define VIEWER_LODSELECTOR_H
+
+#include "PartGeometry.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkMapper.h>
+#include <vtkRenderer.h>
+
+/**
+ * @class LODSelector
+ * @brief The LODSelector class switches each actor's mapper to the coarsest level of detail whose error stays below a pixel tolerance on screen.
+ *
+ * The screen space error of a level is its geometric error projected at the distance of the
+ * part's bounding box from the camera. A part moves to a finer level as soon as its current
+ * level's error exceeds the tolerance, but only moves to a coarser level once that level's error
+ * is well below it (70%), so a part sitting at a boundary does not flicker between levels.
+ *
+ * Each view (desktop and VR) has its own selector, which creates that view's mappers for the
+ * levels on first use; the level geometry itself is shared through PartGeometry. A selector is
+ * not thread safe, it must only be used by the thread that renders its view.
+ */
+class LODSelector {
+public:
+    /**
+     * @brief Constructor for the LODSelector class.
+     */
+    LODSelector();
+
+    /**
+     * @brief This function tells the selector which geometry an actor renders. Actors whose geometry has a single level are not tracked.
+     * @param actor is the actor, its current mapper is used for level 0.
+     * @param geometry is the geometry with its levels of detail.
+     */
+    void setGeometry(vtkActor* actor, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function stops switching an actor's levels and puts back its full detail mapper.
+     * @param actor is the actor.
+     */
+    void remove(vtkActor* actor);
+
+    /**
+     * @brief This function forgets every actor, leaving each at its full detail mapper.
+     */
+    void clear();
+
+    /**
+     * @brief This function chooses the level of every tracked actor for the renderer's current camera, it is called before each render.
+     * @param renderer is the renderer the actors are drawn by.
+     */
+    void update(vtkRenderer* renderer);
+
+    /**
+     * @brief This function turns level switching on or off, when off every actor is drawn at full detail.
+     * @param enabled is true to switch levels.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief This function checks if level switching is on.
+     * @return true if levels are switched.
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief This function sets the largest error allowed on screen.
+     * @param pixels is the tolerance in pixels.
+     */
+    void setTolerance(double pixels);
+
+    /**
+     * @brief This function returns the largest error allowed on screen.
+     * @return the tolerance in pixels.
+     */
+    double tolerance() const;
+
+    /**
+     * @brief This function returns the level an actor is drawn at.
+     * @param actor is the actor.
+     * @return the level, 0 if the actor is not tracked.
+     */
+    int levelOf(vtkActor* actor) const;
+
+    /**
+     * @brief This function returns the number of triangles the tracked, visible actors were drawn with at the last update().
+     * @return the number of triangles.
+     */
+    vtkIdType triangleCount() const;
+
+    /**
+     * @brief This function returns the number of tracked actors.
+     * @return the number of actors.
+     */
+    int actorCount() const;
+
+private:
+    /**
+     * @struct Entry
+     * @brief The Entry structure holds one tracked actor.
+     */
+    struct Entry {
+        vtkSmartPointer<vtkActor>               actor;      /**< Actor whose mapper is switched */
+        std::shared_ptr<const PartGeometry>     geometry;   /**< Geometry with the levels */
+        std::vector<vtkSmartPointer<vtkMapper>> mappers;    /**< Mapper of each level, created on first use */
+        int                                     level;      /**< Level currently drawn */
+    };
+
+    /**
+     * @brief This function makes an actor draw one level.
+     * @param entry is the actor's entry.
+     * @param level is the level.
+     */
+    void setLevel(Entry& entry, int level);
+
+    std::vector<Entry>                          entries;    /**< Tracked actors */
+    std::unordered_map<vtkActor*, size_t>       index;      /**< Position of each actor in entries */
+    bool                                        enabled;    /**< True if levels are switched */
+    double                                      pixels;     /**< Error tolerance on screen */
+    vtkIdType                                   triangles;  /**< Triangles drawn at the last update */
+};
+
+#endif
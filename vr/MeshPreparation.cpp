@@ -0,0 +1,530 @@
+/** @file MeshPreparation.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Vertex welding and normal generation applied to parts after they are read.
+  */
+
+#include "MeshPreparation.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSMPTools.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MESH_PREPARATION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/* GCC and Clang only emit AVX2 instructions inside functions marked for it, MSVC needs no marking */
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE __attribute__((target("sse2")))
+#else
+#define TARGET_AVX2
+#define TARGET_SSE
+#endif
+
+namespace {
+
+/**
+ * @brief Computes the (area weighted) face normal of triangles [begin, end) into SoA arrays.
+ */
+typedef void (*FaceNormalKernel)(const float* points, const vtkIdType* triangles, vtkIdType begin, vtkIdType end,
+                                 float* fx, float* fy, float* fz);
+
+/**
+ * @brief Normalises SoA vectors [begin, end) and writes them interleaved, zero length vectors stay zero.
+ */
+typedef void (*NormaliseKernel)(const float* sx, const float* sy, const float* sz, vtkIdType begin, vtkIdType end,
+                                float* normals);
+
+/**
+ * @brief This function copies the corners of one triangle into lane i of the SoA scratch arrays.
+ */
+inline void gatherTriangle(const float* points, const vtkIdType* triangle, int i, float* a, float* b, float* c) {
+    const float* p0 = points + 3 * triangle[0];
+    const float* p1 = points + 3 * triangle[1];
+    const float* p2 = points + 3 * triangle[2];
+    for (int k = 0; k < 3; k++) {
+        a[8 * k + i] = p0[k];
+        b[8 * k + i] = p1[k];
+        c[8 * k + i] = p2[k];
+    }
+}
+
+void faceNormalsScalar(const float* points, const vtkIdType* triangles, vtkIdType begin, vtkIdType end,
+                       float* fx, float* fy, float* fz) {
+    for (vtkIdType t = begin; t < end; t++) {
+        const float* a = points + 3 * triangles[3 * t];
+        const float* b = points + 3 * triangles[3 * t + 1];
+        const float* c = points + 3 * triangles[3 * t + 2];
+        float ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+        float vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+        fx[t] = uy * vz - uz * vy;
+        fy[t] = uz * vx - ux * vz;
+        fz[t] = ux * vy - uy * vx;
+    }
+}
+
+void normaliseScalar(const float* sx, const float* sy, const float* sz, vtkIdType begin, vtkIdType end,
+                     float* normals) {
+    for (vtkIdType v = begin; v < end; v++) {
+        float length = std::sqrt(sx[v] * sx[v] + sy[v] * sy[v] + sz[v] * sz[v]);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        normals[3 * v] = sx[v] * scale;
+        normals[3 * v + 1] = sy[v] * scale;
+        normals[3 * v + 2] = sz[v] * scale;
+    }
+}
+
+#if defined(MESH_PREPARATION_X86)
+
+TARGET_SSE
+void faceNormalsSSE(const float* points, const vtkIdType* triangles, vtkIdType begin, vtkIdType end,
+                    float* fx, float* fy, float* fz) {
+    /* Corners are gathered into SoA lanes (x lanes, then y, then z) so the cross product runs 4 wide */
+    alignas(16) float a[24], b[24], c[24];
+    vtkIdType t = begin;
+    for (; t + 4 <= end; t += 4) {
+        for (int i = 0; i < 4; i++)
+            gatherTriangle(points, triangles + 3 * (t + i), i, a, b, c);
+
+        __m128 ux = _mm_sub_ps(_mm_load_ps(b), _mm_load_ps(a));
+        __m128 uy = _mm_sub_ps(_mm_load_ps(b + 8), _mm_load_ps(a + 8));
+        __m128 uz = _mm_sub_ps(_mm_load_ps(b + 16), _mm_load_ps(a + 16));
+        __m128 vx = _mm_sub_ps(_mm_load_ps(c), _mm_load_ps(a));
+        __m128 vy = _mm_sub_ps(_mm_load_ps(c + 8), _mm_load_ps(a + 8));
+        __m128 vz = _mm_sub_ps(_mm_load_ps(c + 16), _mm_load_ps(a + 16));
+
+        _mm_storeu_ps(fx + t, _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)));
+        _mm_storeu_ps(fy + t, _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)));
+        _mm_storeu_ps(fz + t, _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)));
+    }
+    faceNormalsScalar(points, triangles, t, end, fx, fy, fz);
+}
+
+TARGET_SSE
+void normaliseSSE(const float* sx, const float* sy, const float* sz, vtkIdType begin, vtkIdType end,
+                  float* normals) {
+    alignas(16) float x[4], y[4], z[4];
+    const __m128 zero = _mm_setzero_ps();
+    vtkIdType v = begin;
+    for (; v + 4 <= end; v += 4) {
+        __m128 nx = _mm_loadu_ps(sx + v);
+        __m128 ny = _mm_loadu_ps(sy + v);
+        __m128 nz = _mm_loadu_ps(sz + v);
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+        __m128 valid = _mm_cmpgt_ps(length2, zero);
+        __m128 scale = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2)));
+
+        _mm_store_ps(x, _mm_mul_ps(nx, scale));
+        _mm_store_ps(y, _mm_mul_ps(ny, scale));
+        _mm_store_ps(z, _mm_mul_ps(nz, scale));
+        for (int i = 0; i < 4; i++) {
+            normals[3 * (v + i)] = x[i];
+            normals[3 * (v + i) + 1] = y[i];
+            normals[3 * (v + i) + 2] = z[i];
+        }
+    }
+    normaliseScalar(sx, sy, sz, v, end, normals);
+}
+
+TARGET_AVX2
+void faceNormalsAVX2(const float* points, const vtkIdType* triangles, vtkIdType begin, vtkIdType end,
+                     float* fx, float* fy, float* fz) {
+    alignas(32) float a[24], b[24], c[24];
+    vtkIdType t = begin;
+    for (; t + 8 <= end; t += 8) {
+        for (int i = 0; i < 8; i++)
+            gatherTriangle(points, triangles + 3 * (t + i), i, a, b, c);
+
+        __m256 ux = _mm256_sub_ps(_mm256_load_ps(b), _mm256_load_ps(a));
+        __m256 uy = _mm256_sub_ps(_mm256_load_ps(b + 8), _mm256_load_ps(a + 8));
+        __m256 uz = _mm256_sub_ps(_mm256_load_ps(b + 16), _mm256_load_ps(a + 16));
+        __m256 vx = _mm256_sub_ps(_mm256_load_ps(c), _mm256_load_ps(a));
+        __m256 vy = _mm256_sub_ps(_mm256_load_ps(c + 8), _mm256_load_ps(a + 8));
+        __m256 vz = _mm256_sub_ps(_mm256_load_ps(c + 16), _mm256_load_ps(a + 16));
+
+        _mm256_storeu_ps(fx + t, _mm256_sub_ps(_mm256_mul_ps(uy, vz), _mm256_mul_ps(uz, vy)));
+        _mm256_storeu_ps(fy + t, _mm256_sub_ps(_mm256_mul_ps(uz, vx), _mm256_mul_ps(ux, vz)));
+        _mm256_storeu_ps(fz + t, _mm256_sub_ps(_mm256_mul_ps(ux, vy), _mm256_mul_ps(uy, vx)));
+    }
+    faceNormalsScalar(points, triangles, t, end, fx, fy, fz);
+}
+
+TARGET_AVX2
+void normaliseAVX2(const float* sx, const float* sy, const float* sz, vtkIdType begin, vtkIdType end,
+                   float* normals) {
+    alignas(32) float x[8], y[8], z[8];
+    const __m256 zero = _mm256_setzero_ps();
+    vtkIdType v = begin;
+    for (; v + 8 <= end; v += 8) {
+        __m256 nx = _mm256_loadu_ps(sx + v);
+        __m256 ny = _mm256_loadu_ps(sy + v);
+        __m256 nz = _mm256_loadu_ps(sz + v);
+        __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+        __m256 valid = _mm256_cmp_ps(length2, zero, _CMP_GT_OQ);
+        __m256 scale = _mm256_and_ps(valid, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length2)));
+
+        _mm256_store_ps(x, _mm256_mul_ps(nx, scale));
+        _mm256_store_ps(y, _mm256_mul_ps(ny, scale));
+        _mm256_store_ps(z, _mm256_mul_ps(nz, scale));
+        for (int i = 0; i < 8; i++) {
+            normals[3 * (v + i)] = x[i];
+            normals[3 * (v + i) + 1] = y[i];
+            normals[3 * (v + i) + 2] = z[i];
+        }
+    }
+    normaliseScalar(sx, sy, sz, v, end, normals);
+}
+
+#endif
+
+/**
+ * @brief This function asks the CPU which instruction sets it (and the OS) supports.
+ */
+MeshPreparation::Kernel detectKernel() {
+#if defined(MESH_PREPARATION_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    /* AVX registers are only usable if the OS saves them on context switches */
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+            return MeshPreparation::AVX2;
+    }
+    if (sse2)
+        return MeshPreparation::SSE;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return MeshPreparation::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return MeshPreparation::SSE;
+#endif
+#endif
+    return MeshPreparation::SCALAR;
+}
+
+std::atomic<int> selectedKernel(-1);        /**< Kernel in use, -1 until detected */
+
+/**
+ * @brief This function mixes the bit patterns of a vertex into a hash.
+ */
+inline std::uint64_t hashVertex(const std::uint32_t* bits) {
+    std::uint64_t h = bits[0] * 0x9E3779B97F4A7C15ull;
+    h ^= (h >> 29) ^ (bits[1] * 0xBF58476D1CE4E5B9ull);
+    h ^= (h >> 31) ^ (bits[2] * 0x94D049BB133111EBull);
+    return h ^ (h >> 32);
+}
+
+}
+
+
+/**
+ * @brief This function welds the geometry (if it is not already indexed) and adds point normals.
+ * @param input is the triangle geometry read from an STL file.
+ * @return the prepared geometry, the input is not modified.
+ */
+vtkSmartPointer<vtkPolyData> MeshPreparation::prepare(vtkPolyData* input) {
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    if (input == nullptr || input->GetPoints() == nullptr || input->GetPolys() == nullptr) {
+        if (input != nullptr)
+            output->ShallowCopy(input);
+        return output;
+    }
+
+    /* 1. Flatten the polygons to a triangle list (STL only has triangles, other polygons are fanned) */
+    vtkNew<vtkIdTypeArray> legacy;
+    input->GetPolys()->ExportLegacyFormat(legacy);
+    const vtkIdType* cells = legacy->GetPointer(0);
+    vtkIdType cellsSize = legacy->GetNumberOfValues();
+
+    std::vector<vtkIdType> triangles;
+    triangles.reserve(size_t(input->GetNumberOfPolys()) * 3);
+    for (vtkIdType i = 0; i < cellsSize; i += cells[i] + 1) {
+        for (vtkIdType k = 1; k + 1 < cells[i]; k++) {
+            triangles.push_back(cells[i + 1]);
+            triangles.push_back(cells[i + 1 + k]);
+            triangles.push_back(cells[i + 2 + k]);
+        }
+    }
+    vtkIdType triangleCount = vtkIdType(triangles.size() / 3);
+
+    /* 2. Points as floats, the kernels work in single precision like the STL file itself */
+    vtkSmartPointer<vtkFloatArray> points = vtkFloatArray::FastDownCast(input->GetPoints()->GetData());
+    if (points == nullptr) {
+        points = vtkSmartPointer<vtkFloatArray>::New();
+        points->DeepCopy(input->GetPoints()->GetData());
+    }
+
+    /* 3. Weld if every triangle still has its own three vertices */
+    if (triangleCount > 0 && points->GetNumberOfTuples() == vtkIdType(triangles.size())) {
+        std::vector<vtkIdType> remap(triangles.size());
+        std::vector<vtkIdType> unique;
+        weldVertices(points->GetPointer(0), vtkIdType(triangles.size()), remap.data(), unique);
+
+        vtkSmartPointer<vtkFloatArray> welded = vtkSmartPointer<vtkFloatArray>::New();
+        welded->SetNumberOfComponents(3);
+        welded->SetNumberOfTuples(vtkIdType(unique.size()));
+        const float* in = points->GetPointer(0);
+        float* out = welded->GetPointer(0);
+        for (size_t i = 0; i < unique.size(); i++)
+            std::memcpy(out + 3 * i, in + 3 * unique[i], 3 * sizeof(float));
+
+        for (vtkIdType& id : triangles)
+            id = remap[id];
+        points = welded;
+    }
+    vtkIdType pointCount = points->GetNumberOfTuples();
+
+    /* 4. Smooth normals */
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(pointCount);
+    computeNormals(points->GetPointer(0), pointCount, triangles.data(), triangleCount, normals->GetPointer(0));
+
+    /* 5. Indexed triangle cells */
+    vtkNew<vtkIdTypeArray> offsets;
+    offsets->SetNumberOfTuples(triangleCount + 1);
+    vtkIdType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangleCount; i++)
+        offset[i] = 3 * i;
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfTuples(vtkIdType(triangles.size()));
+    std::memcpy(connectivity->GetPointer(0), triangles.data(), triangles.size() * sizeof(vtkIdType));
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(offsets, connectivity);
+
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(points);
+    output->SetPoints(outputPoints);
+    output->SetPolys(polys);
+    output->GetPointData()->SetNormals(normals);
+    return output;
+}
+
+/**
+ * @brief This function builds a lower detail version of prepared geometry, with normals, for level of detail rendering.
+ * Edges are collapsed by quadric error (vtkQuadricDecimation) until the target is reached. The
+ * deviation is estimated as the typical edge length of the result, since each output triangle
+ * stands in for a patch of that size.
+ * @param input is the prepared (indexed triangle) geometry.
+ * @param targetTriangles is the number of triangles wanted.
+ * @param error receives an estimate of how far the result deviates from the input, in model units.
+ * @return the simplified geometry, or nullptr if the input already has no more than targetTriangles triangles.
+ */
+vtkSmartPointer<vtkPolyData> MeshPreparation::simplify(vtkPolyData* input, vtkIdType targetTriangles, double* error) {
+    if (error != nullptr)
+        *error = 0.;
+    if (input == nullptr || targetTriangles < 1 || input->GetNumberOfPolys() <= targetTriangles)
+        return nullptr;
+
+    /* The filter is given its own shallow copy so the pipeline never writes to an object the
+     * renderers are using */
+    vtkNew<vtkPolyData> source;
+    source->ShallowCopy(input);
+
+    vtkNew<vtkQuadricDecimation> decimation;
+    decimation->SetInputData(source);
+    decimation->SetTargetReduction(1. - double(targetTriangles) / double(input->GetNumberOfPolys()));
+    decimation->VolumePreservationOn();
+    decimation->Update();
+
+    vtkSmartPointer<vtkPolyData> output = prepare(decimation->GetOutput());
+    vtkIdType triangles = output->GetNumberOfPolys();
+    if (triangles == 0)
+        return nullptr;
+
+    if (error != nullptr)
+        *error = std::sqrt(2. * surfaceArea(output) / double(triangles));
+    return output;
+}
+
+/**
+ * @brief This function returns the total area of the triangles of prepared geometry.
+ * @param input is the prepared (indexed triangle) geometry.
+ * @return the area in square model units.
+ */
+double MeshPreparation::surfaceArea(vtkPolyData* input) {
+    if (input == nullptr || input->GetPoints() == nullptr || input->GetPolys() == nullptr)
+        return 0.;
+
+    /* Read the connectivity arrays directly, cell traversal keeps state in the shared cell array */
+    vtkCellArray* polys = input->GetPolys();
+    vtkPoints* points = input->GetPoints();
+    vtkIdType cells = polys->GetNumberOfCells();
+
+    auto area = [&](const auto* offsets, const auto* connectivity) {
+        double total = 0.;
+        for (vtkIdType c = 0; c < cells; c++) {
+            double a[3], b[3], p[3];
+            points->GetPoint(vtkIdType(connectivity[offsets[c]]), a);
+            for (auto k = offsets[c] + 1; k + 1 < offsets[c + 1]; k++) {
+                points->GetPoint(vtkIdType(connectivity[k]), b);
+                points->GetPoint(vtkIdType(connectivity[k + 1]), p);
+                double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                double v[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+                double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+                total += 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            }
+        }
+        return total;
+    };
+
+    if (polys->IsStorage64Bit())
+        return area(polys->GetOffsetsArray64()->GetPointer(0), polys->GetConnectivityArray64()->GetPointer(0));
+    return area(polys->GetOffsetsArray32()->GetPointer(0), polys->GetConnectivityArray32()->GetPointer(0));
+}
+
+/**
+ * @brief This function welds identical vertices using a hash of their coordinates.
+ * STL exporters write shared corners with identical coordinates, so an exact match (after
+ * folding -0.0 into 0.0) is enough and avoids merging genuinely distinct nearby vertices.
+ * @param points is the flat xyz array of unshared vertices.
+ * @param count is the number of vertices.
+ * @param remap receives the welded index of every input vertex.
+ * @param unique receives the input index of the first occurrence of each welded vertex.
+ */
+void MeshPreparation::weldVertices(const float* points, vtkIdType count, vtkIdType* remap, std::vector<vtkIdType>& unique) {
+    size_t capacity = 16;
+    while (capacity < size_t(count) * 2)
+        capacity <<= 1;
+    std::vector<vtkIdType> table(capacity, -1);
+    unique.clear();
+    unique.reserve(size_t(count) / 4);
+
+    for (vtkIdType i = 0; i < count; i++) {
+        /* Adding zero folds -0.0 into 0.0 so both hash the same */
+        float p[3] = { points[3 * i] + 0.0f, points[3 * i + 1] + 0.0f, points[3 * i + 2] + 0.0f };
+        std::uint32_t bits[3];
+        std::memcpy(bits, p, sizeof(bits));
+
+        size_t slot = hashVertex(bits) & (capacity - 1);
+        while (true) {
+            vtkIdType entry = table[slot];
+            if (entry < 0) {
+                table[slot] = vtkIdType(unique.size());
+                remap[i] = vtkIdType(unique.size());
+                unique.push_back(i);
+                break;
+            }
+            const float* candidate = points + 3 * unique[entry];
+            if (candidate[0] + 0.0f == p[0] && candidate[1] + 0.0f == p[1] && candidate[2] + 0.0f == p[2]) {
+                remap[i] = entry;
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+}
+
+/**
+ * @brief This function computes area weighted, normalised per-vertex normals for a triangle mesh.
+ * Face normals are computed in parallel over triangle ranges, then each vertex sums its faces
+ * through a vertex to triangle table in parallel over vertex ranges, so no two threads ever
+ * write to the same vertex and the result does not depend on the thread count.
+ * @param points is the flat xyz array of vertices.
+ * @param pointCount is the number of vertices.
+ * @param triangles is the connectivity, three vertex indices per triangle.
+ * @param triangleCount is the number of triangles.
+ * @param normals receives a flat xyz normal for every vertex.
+ */
+void MeshPreparation::computeNormals(const float* points, vtkIdType pointCount, const vtkIdType* triangles,
+                                     vtkIdType triangleCount, float* normals) {
+    FaceNormalKernel faceNormals = faceNormalsScalar;
+    NormaliseKernel normalise = normaliseScalar;
+#if defined(MESH_PREPARATION_X86)
+    switch (kernel()) {
+        case AVX2:
+            faceNormals = faceNormalsAVX2;
+            normalise = normaliseAVX2;
+            break;
+        case SSE:
+            faceNormals = faceNormalsSSE;
+            normalise = normaliseSSE;
+            break;
+        default:
+            break;
+    }
+#endif
+
+    /* 1. Face normals */
+    std::vector<float> fx(triangleCount), fy(triangleCount), fz(triangleCount);
+    vtkSMPTools::For(0, triangleCount, [&](vtkIdType begin, vtkIdType end) {
+        faceNormals(points, triangles, begin, end, fx.data(), fy.data(), fz.data());
+    });
+
+    /* 2. Vertex to triangle table (compressed rows) */
+    std::vector<vtkIdType> first(pointCount + 1, 0);
+    for (vtkIdType i = 0; i < 3 * triangleCount; i++)
+        first[triangles[i] + 1]++;
+    for (vtkIdType v = 0; v < pointCount; v++)
+        first[v + 1] += first[v];
+
+    std::vector<vtkIdType> faces(3 * triangleCount);
+    std::vector<vtkIdType> fill(first.begin(), first.end() - 1);
+    for (vtkIdType i = 0; i < 3 * triangleCount; i++)
+        faces[fill[triangles[i]]++] = i / 3;
+
+    /* 3. Sum the faces around each vertex and normalise */
+    std::vector<float> sx(pointCount), sy(pointCount), sz(pointCount);
+    vtkSMPTools::For(0, pointCount, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType v = begin; v < end; v++) {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (vtkIdType k = first[v]; k < first[v + 1]; k++) {
+                x += fx[faces[k]];
+                y += fy[faces[k]];
+                z += fz[faces[k]];
+            }
+            sx[v] = x;
+            sy[v] = y;
+            sz[v] = z;
+        }
+        normalise(sx.data(), sy.data(), sz.data(), begin, end, normals);
+    });
+}
+
+/**
+ * @brief This function returns the kernel the CPU supports, detected once at runtime.
+ * @return the kernel in use.
+ */
+MeshPreparation::Kernel MeshPreparation::kernel() {
+    int selected = selectedKernel.load();
+    if (selected < 0) {
+        selected = detectKernel();
+        selectedKernel = selected;
+    }
+    return Kernel(selected);
+}
+
+/**
+ * @brief This function forces a kernel, used to compare kernels against each other.
+ * Requesting a kernel the CPU does not support falls back to the detected one.
+ * @param kernel is the kernel to use.
+ */
+void MeshPreparation::setKernel(Kernel kernel) {
+    Kernel supported = detectKernel();
+    selectedKernel = kernel <= supported ? kernel : supported;
+}
@@ -0,0 +1,95 @@
+/** @file MeshPreparation.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Vertex welding and normal generation applied to parts after they are read.
+  */
+
+#ifndef VIEWER_MESHPREPARATION_H
+#define VIEWER_MESHPREPARATION_H
+
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkType.h>
+
+/**
+ * @class MeshPreparation
+ * @brief The MeshPreparation class turns the raw triangles read from an STL file into indexed,
+ * smooth-shaded geometry for the mappers.
+ *
+ * Vertices are welded with a hash of their coordinates and per-vertex normals are generated in
+ * parallel across triangle and vertex ranges (vtkSMPTools). The arithmetic kernels have AVX2 and
+ * SSE versions, the best one the CPU supports is picked the first time they are used.
+ * simplify() builds the decimated copies used as levels of detail.
+ */
+class MeshPreparation {
+public:
+    /**
+     * @enum Kernel
+     * @brief Instruction sets the normal kernels can use.
+     */
+    enum Kernel {
+        SCALAR,
+        SSE,
+        AVX2
+    };
+
+    /**
+     * @brief This function welds the geometry (if it is not already indexed) and adds point normals.
+     * @param input is the triangle geometry read from an STL file.
+     * @return the prepared geometry, the input is not modified.
+     */
+    static vtkSmartPointer<vtkPolyData> prepare(vtkPolyData* input);
+
+    /**
+     * @brief This function builds a lower detail version of prepared geometry, with normals, for level of detail rendering.
+     * It is safe to call from any thread, the input is only read.
+     * @param input is the prepared (indexed triangle) geometry.
+     * @param targetTriangles is the number of triangles wanted.
+     * @param error receives an estimate of how far the result deviates from the input, in model units.
+     * @return the simplified geometry, or nullptr if the input already has no more than targetTriangles triangles.
+     */
+    static vtkSmartPointer<vtkPolyData> simplify(vtkPolyData* input, vtkIdType targetTriangles, double* error = nullptr);
+
+    /**
+     * @brief This function returns the total area of the triangles of prepared geometry.
+     * @param input is the prepared (indexed triangle) geometry.
+     * @return the area in square model units.
+     */
+    static double surfaceArea(vtkPolyData* input);
+
+    /**
+     * @brief This function welds identical vertices using a hash of their coordinates.
+     * @param points is the flat xyz array of unshared vertices.
+     * @param count is the number of vertices.
+     * @param remap receives the welded index of every input vertex.
+     * @param unique receives the input index of the first occurrence of each welded vertex.
+     */
+    static void weldVertices(const float* points, vtkIdType count, vtkIdType* remap, std::vector<vtkIdType>& unique);
+
+    /**
+     * @brief This function computes area weighted, normalised per-vertex normals for a triangle mesh.
+     * @param points is the flat xyz array of vertices.
+     * @param pointCount is the number of vertices.
+     * @param triangles is the connectivity, three vertex indices per triangle.
+     * @param triangleCount is the number of triangles.
+     * @param normals receives a flat xyz normal for every vertex.
+     */
+    static void computeNormals(const float* points, vtkIdType pointCount, const vtkIdType* triangles,
+                               vtkIdType triangleCount, float* normals);
+
+    /**
+     * @brief This function returns the kernel the CPU supports, detected once at runtime.
+     * @return the kernel in use.
+     */
+    static Kernel kernel();
+
+    /**
+     * @brief This function forces a kernel, used to compare kernels against each other.
+     * Requesting a kernel the CPU does not support falls back to the detected one.
+     * @param kernel is the kernel to use.
+     */
+    static void setKernel(Kernel kernel);
+};
+
+#endif
@@ -4,18 +4,14 @@
   * P Evans 2022
   */
 #include "ModelPart.h"
+#include "STLLoader.h"
+
+#include <QDebug>
 
 /* Commented out for now, will be uncommented later when you have
  * installed the VTK library
  */
 #include <vtkSmartPointer.h>
-#include <vtkDataSetMapper.h>
-
-//for filters
-/*
-#include <vtkSTLReader.h>
-#include <vtkProperty.h>
-*/
 
 
 /**
@@ -24,15 +20,20 @@
  * @param parent is a pointer to the parent ModelPart item.
  */
 ModelPart::ModelPart(const QList<QVariant>& data, ModelPart* parent )
-    : m_itemData(data), m_parentItem(parent) {
-    /* You probably want to give the item a default colour */
+    : tree(parent != nullptr ? parent->tree : new PartTree), ownsTree(parent == nullptr), viewCount(0) {
+    /* The second column is the visibility flag, parts are visible unless it says otherwise */
+    node = tree->create(this, data.value(0).toString(), data.value(1, QVariant(true)).toBool());
 }
 
 /**
  * @brief Destructor for the ModelPart class.
  */
 ModelPart::~ModelPart() {
-    qDeleteAll(m_childItems);
+    for (int i = 0; i < tree->childCount(node); i++)
+        delete tree->part(tree->child(node, i));
+
+    if (ownsTree)
+        delete tree;
 }
 
 /**
@@ -43,8 +44,13 @@ void ModelPart::appendChild( ModelPart* item ) {
     /* Add another model part as a child of this part
      * (it will appear as a sub-branch in the treeview)
      */
-    item->m_parentItem = this;
-    m_childItems.append(item);
+    if (item->tree != tree) {
+        PartTree* previous = item->ownsTree ? item->tree : nullptr;
+        item->moveTo(tree);
+        item->ownsTree = false;
+        delete previous;
+    }
+    tree->append(node, item->node);
 }
 
 /**
@@ -55,9 +61,8 @@ void ModelPart::appendChild( ModelPart* item ) {
 ModelPart* ModelPart::child( int row ) {
     /* Return pointer to child item in row below this item.
      */
-    if (row < 0 || row >= m_childItems.size())
-        return nullptr;
-    return m_childItems.at(row);
+    int item = tree->child(node, row);
+    return item >= 0 ? tree->part(item) : nullptr;
 }
 
 /**
@@ -67,7 +72,7 @@ ModelPart* ModelPart::child( int row ) {
 int ModelPart::childCount() const {
     /* Count number of child items
      */
-    return m_childItems.count();
+    return tree->childCount(node);
 }
 
 /**
@@ -75,9 +80,9 @@ int ModelPart::childCount() const {
  * @return the number of columns (properties).
  */
 int ModelPart::columnCount() const {
-    /* Count number of columns (properties) that this item has.
+    /* Count number of columns (properties) that this item has: the name and the visibility flag.
      */
-    return m_itemData.count();
+    return 2;
 }
 
 /**
@@ -91,9 +96,11 @@ QVariant ModelPart::data(int column) const {
      *  that can take on the type of most Qt classes. It allows each
      *  column or property to store data of an arbitrary type.
      */
-    if (column < 0 || column >= m_itemData.size())
-        return QVariant();
-    return m_itemData.at(column);
+    if (column == 0)
+        return tree->name(node);
+    if (column == 1)
+        return QString(tree->visible(node) ? "true" : "false");
+    return QVariant();
 }
 
 /**
@@ -104,10 +111,10 @@ QVariant ModelPart::data(int column) const {
 void ModelPart::set(int column, const QVariant &value) {
     /* Set the data associated with a column of this item
      */
-    if (column < 0 || column >= m_itemData.size())
-        return;
-
-    m_itemData.replace(column, value);
+    if (column == 0)
+        tree->setName(node, value.toString());
+    else if (column == 1)
+        tree->setVisible(node, value.toBool());
 }
 
 /**
@@ -115,7 +122,16 @@ void ModelPart::set(int column, const QVariant &value) {
  * @return a pointer to the parent ModelPart item.
  */
 ModelPart* ModelPart::parentItem() {
-    return m_parentItem;
+    int parent = tree->parent(node);
+    return parent >= 0 ? tree->part(parent) : nullptr;
+}
+
+/**
+ * @brief This function returns the tree that stores the hierarchy this part belongs to.
+ * @return a pointer to the tree.
+ */
+PartTree* ModelPart::getTree() {
+    return tree;
 }
 
 /**
@@ -123,11 +139,9 @@ ModelPart* ModelPart::parentItem() {
  * @return the row index of this item.
  */
 int ModelPart::row() const {
-    /* Return the row index of this item, relative to it's parent.
+    /* Return the row index of this item, relative to it's parent (stored by the tree, not searched for).
      */
-    if (m_parentItem)
-        return m_parentItem->m_childItems.indexOf(const_cast<ModelPart*>(this));
-    return 0;
+    return tree->row(node);
 }
 
 /**
@@ -137,10 +151,7 @@ int ModelPart::row() const {
  * @param B is the blue component of the color.
  */
 void ModelPart::setColour(const unsigned char R, const unsigned char G, const unsigned char B) {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    colour.Set(R, G, B);
+    tree->setColour(node, vtkColor3ub(R, G, B));
     if (actor != nullptr) {
         actor->GetProperty()->SetColor(((double)R / 255.), ((double)G / 255.), ((double)B / 255.));
     }
@@ -151,10 +162,7 @@ void ModelPart::setColour(const unsigned char R, const unsigned char G, const un
  * @return the red component of the color.
  */
 unsigned char ModelPart::getColourR() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    return colour.GetRed();   // needs updating
+    return tree->colour(node).GetRed();
 }
 
 /**
@@ -162,10 +170,7 @@ unsigned char ModelPart::getColourR() {
  * @return the green component of the color.
  */
 unsigned char ModelPart::getColourG() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    return colour.GetGreen();   // needs updating
+    return tree->colour(node).GetGreen();
 }
 
 /**
@@ -173,10 +178,7 @@ unsigned char ModelPart::getColourG() {
  * @return the blue component of the color.
  */
 unsigned char ModelPart::getColourB() {
-   /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    return colour.GetBlue();   // needs updating
+    return tree->colour(node).GetBlue();
 }
 
 /**
@@ -184,10 +186,9 @@ unsigned char ModelPart::getColourB() {
  * @param isVisible is a boolean value that represents the visibility of the model part.
  */
 void ModelPart::setVisible(bool isVisible) {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-    //this->isVisible = isVisible;
-    actor->SetVisibility(isVisible);
-    /* As the name suggests ... */
+    tree->setVisible(node, isVisible);
+    if (actor != nullptr)
+        actor->SetVisibility(isVisible);
 }
 
 /**
@@ -195,10 +196,43 @@ void ModelPart::setVisible(bool isVisible) {
  * @return a boolean value that represents the visibility of the model part.
  */
 bool ModelPart::visible() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
+    return tree->visible(node);
+}
 
-    /* As the name suggests ... */
-    return isVisible;
+/**
+ * @brief This function places the part in the assembly. The matrix is applied to the part's actors as their user matrix.
+ * @param matrix is the 4x4 transform in row major order, or nullptr for none (the identity).
+ */
+void ModelPart::setTransform(const double matrix[16]) {
+    /* The identity is not stored, so untransformed parts keep actors without a user matrix */
+    bool identity = true;
+    for (int i = 0; matrix != nullptr && i < 16; i++)
+        identity = identity && matrix[i] == (i % 5 == 0 ? 1. : 0.);
+
+    if (identity) {
+        transform = nullptr;
+    }
+    else {
+        transform = vtkSmartPointer<vtkMatrix4x4>::New();
+        transform->DeepCopy(matrix);
+    }
+
+    if (actor != nullptr)
+        actor->SetUserMatrix(transform);
+}
+
+/**
+ * @brief This function returns the transform that places the part in the assembly.
+ * @param matrix receives the 4x4 transform in row major order, the identity if the part has none.
+ * @return true if the part has a transform other than the identity.
+ */
+bool ModelPart::getTransform(double matrix[16]) {
+    if (transform == nullptr) {
+        vtkMatrix4x4::Identity(matrix);
+        return false;
+    }
+    vtkMatrix4x4::DeepCopy(matrix, transform);
+    return true;
 }
 
 /**
@@ -206,87 +240,207 @@ bool ModelPart::visible() {
  * @param fileName is the name of the STL file.
  */
 void ModelPart::loadSTL( QString fileName ) {
-    /* This is a placeholder function that you will need to modify if you want to use it */
+    /* 1. Read the STL file (the same path the background loader uses, see FastSTLReader) */
+    setFileName(fileName);
+    vtkSmartPointer<vtkPolyData> geometry = STLLoader::readGeometry(fileName);
+    if (geometry == nullptr)
+        return;
 
-    /* 1. Use the vtkSTLReader class to load the STL file
-     *     https://vtk.org/doc/nightly/html/classvtkSTLReader.html
-     */
-    file = vtkSmartPointer<vtkSTLReader>::New();
-    file->SetFileName(fileName.toStdString().c_str());
-    file->Update();
-    /* 2. Initialise the part's vtkMapper */
-    mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    mapper->SetInputConnection(file->GetOutputPort());
+    /* 2. Initialise the part's vtkMapper and vtkActor */
+    setPolyData(geometry);
+}
 
-    /* 3. Initialise the part's vtkActor and link to the mapper */
-    actor = vtkSmartPointer<vtkActor>::New();
-    actor->SetMapper(mapper);
+/**
+ * @brief This function records the STL file the part's geometry is read from.
+ * @param fileName is the name of the STL file.
+ */
+void ModelPart::setFileName(const QString& fileName) {
+    tree->setSource(node, fileName);
+}
 
-    //for filters
-    /*
-    file = vtkSTLReader::New();
+/**
+ * @brief This function returns the STL file the part's geometry is read from.
+ * @return the file name, empty if the geometry did not come from a file.
+ */
+QString ModelPart::getFileName() {
+    return tree->source(node);
+}
 
-    mapper = vtkDataSetMapper::New();
-    actor = vtkActor::New();
-    */
+/**
+ * @brief This function records when a view last showed the part.
+ * @param stamp is a counter that grows with time.
+ */
+void ModelPart::setLastShown(uint32_t stamp) {
+    tree->touch(node, stamp);
+}
 
+/**
+ * @brief This function returns when a view last showed the part.
+ * @return the stamp given to setLastShown(), 0 if the part has never been shown.
+ */
+uint32_t ModelPart::lastShown() {
+    return tree->lastUse(node);
 }
 
 /**
- * @brief This function returns a smart pointer to the vtkActor to allow part to be rendered.
- * @return a smart pointer to the vtkActor.
+ * @brief This function gives the part its geometry and creates the mapper and actor used to render it.
+ * @param polyData is the geometry read from the part's STL file.
  */
-vtkSmartPointer<vtkActor> ModelPart::getActor() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
+void ModelPart::setPolyData(vtkSmartPointer<vtkPolyData> polyData) {
+    setGeometry(std::make_shared<const PartGeometry>(polyData));
+}
 
-    /* Needs to return a smart pointer to the vtkActor to allow
-     * part to be rendered.
-     */
-    return actor;
+/**
+ * @brief This function gives the part geometry that has already been prepared and creates its actor.
+ * @param geometry is the geometry, or nullptr to drop the geometry and the actor.
+ */
+void ModelPart::setGeometry(std::shared_ptr<const PartGeometry> geometry) {
+    this->geometry = geometry;
+    filtered = nullptr;
+
+    vtkSmartPointer<vtkActor> previous = actor;
+    if (geometry == nullptr) {
+        actor = nullptr;
+        mapper = nullptr;
+        viewCount = 0;
+        return;
+    }
+
+    /* Initialise the part's vtkActor and vtkMapper for the desktop view. Geometry that replaces
+     * other geometry (a preview refined, a proxy reloaded) keeps the colour the part was given,
+     * the first actor takes the colour in the tree (set before the geometry arrived, e.g. by a project) */
+    actor = geometry->createActor();
+    mapper = actor->GetMapper();
+    if (previous != nullptr) {
+        actor->SetProperty(previous->GetProperty());
+    }
+    else {
+        const vtkColor3ub& colour = tree->colour(node);
+        actor->GetProperty()->SetColor(colour.GetRed() / 255., colour.GetGreen() / 255., colour.GetBlue() / 255.);
+    }
+    actor->SetUserMatrix(transform);
+    actor->SetVisibility(tree->visible(node));
+    viewCount = 1;
 }
 
-//for filters
-/*
-vtkSmartPointer<vtkMapper> ModelPart::getMapper() {
-//This is a placeholder function that will be used in the next worksheet
-if(!mapper){
-    qDebug() << "mapper fail: " << data(0);
-    return nullptr;
+/**
+ * @brief This function adds decimated levels of detail to the part's geometry.
+ * @param levels are the levels, from finest to coarsest.
+ */
+void ModelPart::setLevels(const std::vector<PartGeometry::Level>& levels) {
+    if (geometry == nullptr)
+        return;
+
+    geometry = std::make_shared<const PartGeometry>(*geometry, levels);
 }
-qDebug() << "mapper: " << data(0);
-return mapper;
-//Needs to return a smart pointer to the vtkActor to allow
-     //part to be rendered.
+
+/**
+ * @brief This function returns the geometry shared by the desktop and VR views of the part.
+ * @return the geometry, or nullptr if the part has not been loaded.
+ */
+std::shared_ptr<const PartGeometry> ModelPart::getGeometry() {
+    return geometry;
 }
 
-vtkSmartPointer<vtkSTLReader> ModelPart::getSource() {
-    //This is a placeholder function that will be used in the next worksheet
-    if(!file){
-        qDebug() << "source fail: " << data(0);
-        return nullptr;
-    }
-    qDebug() << "source pass: " << data(0);
-    return file;
-    //Needs to return a smart pointer to the vtkActor to allow
-     //part to be rendered.
+/**
+ * @brief This function makes the part draw filtered geometry instead of its own.
+ * @param filtered is the filtered geometry, or nullptr to draw the part's own geometry again.
+ */
+void ModelPart::setFiltered(std::shared_ptr<const PartGeometry> filtered) {
+    if (geometry == nullptr)
+        return;
+
+    this->filtered = filtered;
+
+    /* The desktop actor keeps its mapper, only the mapper's input is swapped */
+    vtkPolyDataMapper* polyMapper = vtkPolyDataMapper::SafeDownCast(mapper);
+    if (polyMapper != nullptr)
+        polyMapper->SetInputData(getDisplayGeometry()->polyData());
 }
-*/
 
+/**
+ * @brief This function returns the filtered geometry the part draws.
+ * @return the geometry, or nullptr if the part is not filtered.
+ */
+std::shared_ptr<const PartGeometry> ModelPart::getFiltered() {
+    return filtered;
+}
+
+/**
+ * @brief This function returns the geometry the part's actors draw and are picked against.
+ * @return the geometry, or nullptr if the part has not been loaded.
+ */
+std::shared_ptr<const PartGeometry> ModelPart::getDisplayGeometry() {
+    return filtered != nullptr ? filtered : geometry;
+}
 
 /**
- * @brief This function returns a new actor for the model part.
- * @return a pointer to the new vtkActor.
+ * @brief This function returns the host memory held by the part's geometry.
+ * @return the size in bytes (0 if the part has not been loaded).
  */
-vtkActor* ModelPart::getNewActor() {
-    auto vrMapper = vtkSmartPointer<vtkDataSetMapper>::New();
-    if (file == nullptr) {
+size_t ModelPart::hostBytes() {
+    return geometry != nullptr ? geometry->hostBytes() : 0;
+}
+
+/**
+ * @brief This function estimates the GPU memory used by the part, over all views that render it.
+ * @return the estimated size in bytes.
+ */
+size_t ModelPart::gpuBytes() {
+    return geometry != nullptr ? geometry->gpuBytes() * size_t(viewCount) : 0;
+}
+
+/**
+ * @brief This function returns a smart pointer to the vtkActor to allow part to be rendered.
+ * @return a smart pointer to the vtkActor.
+ */
+vtkSmartPointer<vtkActor> ModelPart::getActor() {
+    /* Needs to return a smart pointer to the vtkActor to allow
+     * part to be rendered.
+     */
+    return actor;
+}
+
+/**
+ * @brief This function returns a new actor for the model part (for the VR view), sharing the part's geometry and copying its property.
+ * @return a smart pointer to the new vtkActor.
+ */
+vtkSmartPointer<vtkActor> ModelPart::getNewActor() {
+    if (geometry == nullptr) {
         qDebug() << "File render is null, aborting";
         return nullptr;
     }
 
-    vrMapper->SetInputConnection(file->GetOutputPort());
-    vtkActor* newActor = vtkActor::New();
-    newActor->SetMapper(vrMapper);
-    newActor->SetProperty(actor->GetProperty());
+    /* Same vtkPolyData as the desktop actor, only the actor and mapper are new. The property is
+     * copied rather than shared, the VR thread receives later changes through its command queue */
+    vtkSmartPointer<vtkActor> newActor = getDisplayGeometry()->createActor();
+    newActor->GetProperty()->DeepCopy(actor->GetProperty());
+    if (transform != nullptr) {
+        /* The VR view animates its own copy of the placement (see Animator) */
+        vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        matrix->DeepCopy(transform);
+        newActor->SetUserMatrix(matrix);
+    }
+    viewCount++;
     return newActor;
 }
+
+/**
+ * @brief This function moves the part and its children into another tree.
+ * @param target is the tree to move to.
+ */
+void ModelPart::moveTo(PartTree* target) {
+    PartTree* source = tree;
+    int previous = node;
+
+    node = target->create(this, source->name(previous), source->visible(previous));
+    target->setColour(node, source->colour(previous));
+    target->setSource(node, source->source(previous));
+    tree = target;
+
+    for (int i = 0; i < source->childCount(previous); i++) {
+        ModelPart* item = source->part(source->child(previous, i));
+        item->moveTo(target);
+        target->append(node, item->node);
+    }
+}
@@ -7,10 +7,15 @@
 #ifndef VIEWER_MODELPART_H
 #define VIEWER_MODELPART_H
 
+#include "PartGeometry.h"
+#include "PartTree.h"
+
 #include <QString>
 #include <QList>
 #include <QVariant>
 
+#include <memory>
+
 /* VTK headers - will be needed when VTK used in next worksheet,
  * commented out for now
  *
@@ -25,18 +30,24 @@
 #include <vtkColor.h>
 
 #include <vtkPolyDataMapper.h>
+#include <vtkPolyData.h>
 #include <vtkProperty.h>
+#include <vtkMatrix4x4.h>
 
 /**
  * @class ModelPart
  * @brief The ModelPart class represents a model part that will be added as a treeview item.
+ *
+ * The part's place in the tree, name, visibility and colour are kept in a PartTree shared by the
+ * whole tree (see PartTree), the part itself holds the geometry and actors that render it. A part
+ * made without a parent starts a tree of its own, which it moves out of when appended to another part.
  */
 class ModelPart {
 public:
     /**
      * @brief Constructor for the ModelPart class.
-     * @param data is a list of QVariant items that represent the data of the model part.
-     * @param parent is a pointer to the parent ModelPart item.
+     * @param data is a list of QVariant items that represent the data of the model part (name and visibility).
+     * @param parent is a pointer to the parent ModelPart item, the part is added to its tree but only becomes a child through appendChild().
      */
     ModelPart(const QList<QVariant>& data, ModelPart* parent = nullptr);
 
@@ -90,6 +101,12 @@ public:
      */
     ModelPart* parentItem();
 
+    /**
+     * @brief This function returns the tree that stores the hierarchy this part belongs to.
+     * @return a pointer to the tree.
+     */
+    PartTree* getTree();
+
     /**
      * @brief This function returns the row index of this item, relative to its parent.
      * @return the row index of this item.
@@ -134,48 +151,142 @@ public:
      */
     bool visible();
 
+    /**
+     * @brief This function places the part in the assembly. The matrix is applied to the part's actors as their user matrix.
+     * @param matrix is the 4x4 transform in row major order, or nullptr for none (the identity).
+     */
+    void setTransform(const double matrix[16]);
+
+    /**
+     * @brief This function returns the transform that places the part in the assembly.
+     * @param matrix receives the 4x4 transform in row major order, the identity if the part has none.
+     * @return true if the part has a transform other than the identity.
+     */
+    bool getTransform(double matrix[16]);
+
     /**
      * @brief This function loads an STL file.
      * @param fileName is the name of the STL file.
      */
     void loadSTL(QString fileName);
 
+    /**
+     * @brief This function records the STL file the part's geometry is read from, so it can be read again later.
+     * @param fileName is the name of the STL file.
+     */
+    void setFileName(const QString& fileName);
+
+    /**
+     * @brief This function returns the STL file the part's geometry is read from.
+     * @return the file name, empty if the geometry did not come from a file.
+     */
+    QString getFileName();
+
+    /**
+     * @brief This function records when a view last showed the part.
+     * @param stamp is a counter that grows with time.
+     */
+    void setLastShown(uint32_t stamp);
+
+    /**
+     * @brief This function returns when a view last showed the part.
+     * @return the stamp given to setLastShown(), 0 if the part has never been shown.
+     */
+    uint32_t lastShown();
+
+    /**
+     * @brief This function gives the part its geometry and creates the mapper and actor used to render it.
+     * Must be called from the GUI thread, the geometry itself may have been read on any thread.
+     * @param polyData is the geometry read from the part's STL file.
+     */
+    void setPolyData(vtkSmartPointer<vtkPolyData> polyData);
+
+    /**
+     * @brief This function gives the part geometry that has already been prepared (on a worker thread) and creates its actor.
+     * Must be called from the GUI thread. The new actor keeps the property (colour) of the one it replaces.
+     * @param geometry is the geometry, or nullptr to drop the geometry and the actor.
+     */
+    void setGeometry(std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function adds decimated levels of detail to the part's geometry. Must be called from the GUI thread.
+     * The geometry is replaced by a new PartGeometry sharing the same full resolution data, the actor is unchanged.
+     * @param levels are the levels, from finest to coarsest.
+     */
+    void setLevels(const std::vector<PartGeometry::Level>& levels);
+
+    /**
+     * @brief This function returns the geometry shared by the desktop and VR views of the part.
+     * @return the geometry, or nullptr if the part has not been loaded.
+     */
+    std::shared_ptr<const PartGeometry> getGeometry();
+
+    /**
+     * @brief This function makes the part draw filtered geometry instead of its own (see FilterPipeline). Must be called from the GUI thread.
+     * The actor is unchanged, its mapper is given the new input in one call so the next render shows the whole result.
+     * The filtered geometry is dropped when the part is given new geometry with setGeometry().
+     * @param filtered is the filtered geometry, or nullptr to draw the part's own geometry again.
+     */
+    void setFiltered(std::shared_ptr<const PartGeometry> filtered);
+
+    /**
+     * @brief This function returns the filtered geometry the part draws.
+     * @return the geometry, or nullptr if the part is not filtered.
+     */
+    std::shared_ptr<const PartGeometry> getFiltered();
+
+    /**
+     * @brief This function returns the geometry the part's actors draw and are picked against: the filtered geometry if there is one, else the part's own.
+     * @return the geometry, or nullptr if the part has not been loaded.
+     */
+    std::shared_ptr<const PartGeometry> getDisplayGeometry();
+
+    /**
+     * @brief This function returns the host memory held by the part's geometry.
+     * @return the size in bytes (0 if the part has not been loaded).
+     */
+    size_t hostBytes();
+
+    /**
+     * @brief This function estimates the GPU memory used by the part, over all views that render it.
+     * @return the estimated size in bytes.
+     */
+    size_t gpuBytes();
+
     /**
      * @brief This function returns a smart pointer to the vtkActor to allow part to be rendered.
      * @return a smart pointer to the vtkActor.
      */
     vtkSmartPointer<vtkActor> getActor();
 
-    //For the two filters
-    /*
-    vtkSmartPointer<vtkMapper> getMapper();
-
-    vtkSmartPointer<vtkSTLReader> getSource();*/
-
     /**
-     * @brief This function returns a new actor for the model part.
-     * @return a pointer to the new vtkActor.
+     * @brief This function returns a new actor for the model part (for the VR view), sharing the part's geometry and copying its property.
+     * @return a smart pointer to the new vtkActor.
      */
-    vtkActor* getNewActor();
+    vtkSmartPointer<vtkActor> getNewActor();
 
 private:
-    QList<ModelPart*>                           m_childItems;       /**< List (array) of child items */
-    QList<QVariant>                             m_itemData;         /**< List (array of column data for item */
-    ModelPart*                                  m_parentItem;       /**< Pointer to parent */
+    /**
+     * @brief This function moves the part and its children into another tree.
+     * @param target is the tree to move to.
+     */
+    void moveTo(PartTree* target);
+
+    PartTree*                                   tree;               /**< Tree holding the hierarchy, name, visibility and colour */
+    int                                         node;               /**< Handle of the part in the tree */
+    bool                                        ownsTree;           /**< True if the part made the tree and deletes it */
     vtkSmartPointer<vtkPolyDataMapper> m_mapper;
     vtkSmartPointer<vtkActor> m_actor;
-    /* These are some typical properties that I think the part will need, you might
-     * want to add you own.
-     */
-    bool                                        isVisible;          /**< True/false to indicate if should be visible in model rendering */
 
 	/* These are vtk properties that will be used to load/render a model of this part,
 	 * commented out for now but will be used later
 	 */
-	vtkSmartPointer<vtkSTLReader>               file;               /**< Datafile from which part loaded */
+	std::shared_ptr<const PartGeometry>         geometry;           /**< Geometry read from the part's STL file, shared by all views */
+    std::shared_ptr<const PartGeometry>         filtered;           /**< Clipped or shrunk geometry drawn instead, or nullptr */
+    int                                         viewCount;          /**< Number of views (actors) rendering the geometry */
+    vtkSmartPointer<vtkMatrix4x4>               transform;          /**< Placement in the assembly, nullptr for the identity */
     vtkSmartPointer<vtkMapper>                  mapper;             /**< Mapper for rendering */
     vtkSmartPointer<vtkActor>                   actor;              /**< Actor for rendering */
-    vtkColor3<unsigned char>                    colour;             /**< User defineable colour */
 };
 
 
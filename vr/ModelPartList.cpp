@@ -10,11 +10,26 @@
 #include "ModelPartList.h"
 #include "ModelPart.h"
 
-ModelPartList::ModelPartList( const QString& data, QObject* parent ) : QAbstractItemModel(parent) {
+#include <QMetaObject>
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/* Rows made into parts by each fetchMore() */
+const int FETCH_BLOCK = 256;
+
+}
+
+ModelPartList::ModelPartList( const QString& data, QObject* parent ) : QAbstractItemModel(parent), deferDepth(0),
+    useClock(0) {
     /* Have option to specify number of visible properties for each item in tree - the root item
      * acts as the column headers
      */
-    rootItem = new ModelPart( { tr("Part"), tr("Visible?") } );
+    headers = { tr("Part"), tr("Visible?") };
+    rootItem = new ModelPart( headers );
 }
 
 
@@ -62,7 +77,7 @@ Qt::ItemFlags ModelPartList::flags( const QModelIndex& index ) const {
 
 QVariant ModelPartList::headerData( int section, Qt::Orientation orientation, int role ) const {
     if( orientation == Qt::Horizontal && role == Qt::DisplayRole )
-        return rootItem->data( section );
+        return headers.value( section );
 
     return QVariant();
 }
@@ -113,6 +128,39 @@ int ModelPartList::rowCount( const QModelIndex& parent ) const {
 }
 
 
+bool ModelPartList::hasChildren( const QModelIndex& parent ) const {
+    return rowCount( parent ) > 0 || canFetchMore( parent );
+}
+
+
+bool ModelPartList::canFetchMore( const QModelIndex& parent ) const {
+    ModelPart* parentItem = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+
+    return pending.contains( parentItem );
+}
+
+
+void ModelPartList::fetchMore( const QModelIndex& parent ) {
+    ModelPart* parentItem = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    auto it = pending.find( parentItem );
+    if( it == pending.end() )
+        return;
+
+    /* The rows become parts a block at a time as the view scrolls down to them */
+    int first = it->next;
+    int count = std::min( FETCH_BLOCK, int(it->rows.size()) - first );
+    QList<ModelPart*> parts = appendChildren( parent, it->rows.mid( first, count ) );
+    for( int i = 0; i < parts.size(); i++ ) {
+        parts[i]->setFileName( it->fileNames[first + i] );
+        onDemand.insert( parts[i] );
+    }
+
+    it->next += count;
+    if( it->next >= int(it->rows.size()) )
+        pending.erase( it );
+}
+
+
 ModelPart* ModelPartList::getRootItem() {
     return rootItem; 
 }
@@ -120,27 +168,164 @@ ModelPart* ModelPartList::getRootItem() {
 
 
 QModelIndex ModelPartList::appendChild(QModelIndex& parent, const QList<QVariant>& data) {      
-    ModelPart* parentPart;
+    QList<ModelPart*> children = appendChildren( parent, { data } );
 
-    if (parent.isValid())
-        parentPart = static_cast<ModelPart*>(parent.internalPointer());
-    else {
-        parentPart = rootItem;
-        parent = createIndex(0, 0, rootItem );
-    }
+    return indexOf( children.first() );
+}
 
-    beginInsertRows( parent, rowCount(parent), rowCount(parent) ); 
 
-    ModelPart* childPart = new ModelPart( data, parentPart );
+QList<ModelPart*> ModelPartList::appendChildren(const QModelIndex& parent, const QList<QList<QVariant>>& rows) {
+    QList<ModelPart*> children;
+    if( rows.isEmpty() )
+        return children;
 
-    parentPart->appendChild(childPart);
+    ModelPart* parentPart = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
 
-    QModelIndex child = createIndex(0, 0, childPart);
+    /* One insertion for all rows: rowsInserted already tells the views where the rows went,
+     * so there is no need for a layoutChanged, which would make them lay out the whole tree again */
+    int first = parentPart->childCount();
+    beginInsertRows( parent, first, first + int(rows.size()) - 1 );
+
+    children.reserve( rows.size() );
+    for( const QList<QVariant>& data : rows ) {
+        ModelPart* childPart = new ModelPart( data, parentPart );
+        parentPart->appendChild( childPart );
+        children.append( childPart );
+    }
 
     endInsertRows();
 
-    emit layoutChanged();
+    return children;
+}
+
+
+void ModelPartList::appendLater( const QModelIndex& parent, const QList<QList<QVariant>>& rows, const QStringList& fileNames ) {
+    ModelPart* parentItem = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    if( rows.isEmpty() || rows.size() != fileNames.size() )
+        return;
 
-    return child;
+    /* Rows added while earlier ones are still pending go after them */
+    PendingRows& rowsLeft = pending[parentItem];
+    if( rowsLeft.rows.isEmpty() )
+        rowsLeft.next = 0;
+    rowsLeft.rows.append( rows );
+    rowsLeft.fileNames.append( fileNames );
+
+    if( parentItem->childCount() == 0 )
+        fetchMore( parent );
+}
+
+
+void ModelPartList::partShown( const QModelIndex& index ) {
+    if( !index.isValid() || index.model() != this )
+        return;
+
+    ModelPart* item = static_cast<ModelPart*>( index.internalPointer() );
+    item->setLastShown( ++useClock );
+    if( !onDemand.contains( item ) || item->getGeometry() != nullptr || requested.contains( item ) )
+        return;
+
+    /* Rows painted together are requested together */
+    requested.insert( item );
+    if( requests.isEmpty() )
+        QMetaObject::invokeMethod( this, [this]() { flushRequests(); }, Qt::QueuedConnection );
+    requests.append( item );
 }
 
+
+void ModelPartList::requestFailed( const QList<ModelPart*>& parts ) {
+    for( ModelPart* part : parts )
+        requested.remove( part );
+}
+
+
+void ModelPartList::flushRequests() {
+    QList<ModelPart*> parts;
+    parts.swap( requests );
+
+    emit partsRequested( parts );
+}
+
+
+QModelIndex ModelPartList::indexOf( ModelPart* part ) const {
+    if( part == nullptr || part == rootItem )
+        return QModelIndex();
+
+    return createIndex( part->row(), 0, part );
+}
+
+
+void ModelPartList::updatePart( ModelPart* part ) {
+    QModelIndex index = indexOf( part );
+    if( !index.isValid() )
+        return;
+
+    if( deferDepth > 0 ) {
+        deferred.insert( part );
+        return;
+    }
+
+    emit dataChanged( index, createIndex( index.row(), columnCount( index ) - 1, part ) );
+}
+
+
+void ModelPartList::memoryUsage( size_t& hostBytes, size_t& gpuBytes ) const {
+    hostBytes = 0;
+    gpuBytes = 0;
+
+    /* Every part is a node of the root's tree, so a flat pass over the tree visits them all.
+     * Copies of a file share their geometry, which is counted once */
+    std::unordered_set<const vtkPolyData*> counted;
+    const PartTree* tree = rootItem->getTree();
+    for( int node = 0; node < tree->size(); node++ ) {
+        ModelPart* part = tree->part( node );
+        if( part->getGeometry() == nullptr || !counted.insert( part->getGeometry()->polyData() ).second )
+            continue;
+        hostBytes += part->hostBytes();
+        gpuBytes += part->gpuBytes();
+    }
+}
+
+
+void ModelPartList::beginDeferredUpdates() {
+    deferDepth++;
+}
+
+
+void ModelPartList::endDeferredUpdates() {
+    if( deferDepth == 0 || --deferDepth > 0 )
+        return;
+
+    /* Sort the parts by parent and row, then announce each run of neighbouring rows at once */
+    std::vector<ModelPart*> parts( deferred.begin(), deferred.end() );
+    deferred.clear();
+    std::sort( parts.begin(), parts.end(), []( ModelPart* a, ModelPart* b ) {
+        if( a->parentItem() != b->parentItem() )
+            return a->parentItem() < b->parentItem();
+        return a->row() < b->row();
+    } );
+
+    int last = columnCount( QModelIndex() ) - 1;
+    size_t start = 0;
+    for( size_t i = 1; i <= parts.size(); i++ ) {
+        bool runContinues = i < parts.size() &&
+                            parts[i]->parentItem() == parts[start]->parentItem() &&
+                            parts[i]->row() == parts[i - 1]->row() + 1;
+        if( runContinues )
+            continue;
+
+        emit dataChanged( createIndex( parts[start]->row(), 0, parts[start] ),
+                          createIndex( parts[i - 1]->row(), last, parts[i - 1] ) );
+        start = i;
+    }
+}
+
+
+ModelPartList::DeferredUpdates::DeferredUpdates( ModelPartList* model ) : model(model) {
+    model->beginDeferredUpdates();
+}
+
+
+ModelPartList::DeferredUpdates::~DeferredUpdates() {
+    model->endDeferredUpdates();
+}
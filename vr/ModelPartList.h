@@ -13,17 +13,53 @@
 #include <QModelIndex>
 #include <QVariant>
 #include <QString>
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <QStringList>
+
+#include <cstdint>
 
 class ModelPart;
 
 /**
  * @class ModelPartList
  * @brief The ModelPartList class represents a list of model parts that will be used to create the treeview.
+ *
+ * Very large folders can be added lazily with appendLater(): their rows are kept as file names and
+ * only become parts when a view fetches them (canFetchMore() / fetchMore()), and those parts ask for
+ * their geometry with partsRequested() once a view shows them. Views report the rows they paint with
+ * partShown(), which stamps each part (ModelPart::lastShown()) for the ResidencyManager to choose what
+ * to evict. Parts whose load failed are passed to requestFailed(), so showing them asks again.
  */
 class ModelPartList : public QAbstractItemModel {
     Q_OBJECT        /**< A special Qt tag used to indicate that this is a special Qt class that might require preprocessing before compiling. */
 public:
+    /**
+     * @class DeferredUpdates
+     * @brief The DeferredUpdates class holds back the dataChanged signals of updatePart() for as long as it exists.
+     * The parts updated meanwhile are announced when the last scope ends, one signal per run of neighbouring rows.
+     */
+    class DeferredUpdates {
+    public:
+        /**
+         * @brief Constructor for the DeferredUpdates class, starts deferring.
+         * @param model is the model whose updates are deferred.
+         */
+        explicit DeferredUpdates( ModelPartList* model );
+
+        /**
+         * @brief Destructor for the DeferredUpdates class, ends deferring.
+         */
+        ~DeferredUpdates();
+
+        DeferredUpdates( const DeferredUpdates& ) = delete;
+        DeferredUpdates& operator=( const DeferredUpdates& ) = delete;
+
+    private:
+        ModelPartList* model;   /**< Model whose updates are deferred */
+    };
+
     /**
      * @brief Constructor for the ModelPartList class.
      * @param data is not used.
@@ -90,6 +126,26 @@ public:
      */
     int rowCount( const QModelIndex& parent ) const;
 
+    /**
+     * @brief This function tells the views whether an item has children, including rows not fetched yet.
+     * @param parent is the item.
+     * @return true if the item has children.
+     */
+    bool hasChildren( const QModelIndex& parent ) const override;
+
+    /**
+     * @brief This function tells the views whether an item has rows added by appendLater() that are not fetched yet.
+     * @param parent is the item.
+     * @return true if there are rows to fetch.
+     */
+    bool canFetchMore( const QModelIndex& parent ) const override;
+
+    /**
+     * @brief This function turns the next block of rows added by appendLater() into parts.
+     * @param parent is the item.
+     */
+    void fetchMore( const QModelIndex& parent ) override;
+
     /**
      * @brief This function returns a pointer to the root item of the tree.
      * @return the root item pointer.
@@ -98,13 +154,103 @@ public:
 
     /**
      * @brief This function appends a child to the parent item.
-     * @param parent is the parent item.
+     * @param parent is the parent item, invalid for the root.
      * @param data is the data of the child item.
      * @return the QModelIndex of the appended child.
      */
     QModelIndex appendChild( QModelIndex& parent, const QList<QVariant>& data );
 
+    /**
+     * @brief This function appends several children to the parent item as one insertion, so views lay out once.
+     * @param parent is the parent item, invalid for the root.
+     * @param rows are the data of the child items, in order.
+     * @return the appended children, in order.
+     */
+    QList<ModelPart*> appendChildren( const QModelIndex& parent, const QList<QList<QVariant>>& rows );
+
+    /**
+     * @brief This function adds children that are only made into parts when a view fetches them, and whose
+     * geometry is only requested when a view shows them. The first block is fetched straight away.
+     * @param parent is the parent item, invalid for the root.
+     * @param rows are the data of the child items, in order.
+     * @param fileNames are the STL files of the child items, in the same order.
+     */
+    void appendLater( const QModelIndex& parent, const QList<QList<QVariant>>& rows, const QStringList& fileNames );
+
+    /**
+     * @brief This function returns the index of a part in the tree.
+     * @param part is the part to find.
+     * @return the QModelIndex of the part (invalid for the root item).
+     */
+    QModelIndex indexOf( ModelPart* part ) const;
+
+    /**
+     * @brief This function tells the views (and the scene) that a part's data, colour, visibility or geometry has changed.
+     * @param part is the part that changed.
+     */
+    void updatePart( ModelPart* part );
+
+    /**
+     * @brief This function starts holding back the signals of updatePart(), see DeferredUpdates. Calls may be nested.
+     */
+    void beginDeferredUpdates();
+
+    /**
+     * @brief This function ends a beginDeferredUpdates() call, the last one announces every part updated meanwhile.
+     */
+    void endDeferredUpdates();
+
+    /**
+     * @brief This function adds up the geometry memory of every part in the tree.
+     * @param hostBytes receives the host memory in bytes.
+     * @param gpuBytes receives the estimated GPU memory in bytes, over all views.
+     */
+    void memoryUsage( size_t& hostBytes, size_t& gpuBytes ) const;
+
+    /**
+     * @brief This function tells the model a view has painted a row, it stamps the part and requests its geometry if it loads on demand.
+     * Views call it from their item delegate, which only paints the rows on screen.
+     * @param index is the row that was painted.
+     */
+    void partShown( const QModelIndex& index );
+
+    /**
+     * @brief This function forgets that the geometry of parts was requested, so they are requested again when next shown.
+     * @param parts are the parts whose load failed.
+     */
+    void requestFailed( const QList<ModelPart*>& parts );
+
+signals:
+    /**
+     * @brief This signal is emitted when views have shown parts whose geometry is loaded on demand and not yet loaded.
+     * @param parts are the parts whose geometry should be loaded, from getFileName().
+     */
+    void partsRequested( const QList<ModelPart*>& parts );
+
 private:
+    /**
+     * @struct PendingRows
+     * @brief The PendingRows structure holds the rows of one item that appendLater() has not made into parts yet.
+     */
+    struct PendingRows {
+        QList<QList<QVariant>> rows;        /**< Data of the rows */
+        QStringList fileNames;              /**< STL file of each row */
+        int next;                           /**< First row not fetched */
+    };
+
+    /**
+     * @brief This function emits partsRequested() for the parts shown since it last ran.
+     */
+    void flushRequests();
+
     ModelPart *rootItem;    /**< This is a pointer to the item at the base of the tree */
+    QList<QVariant> headers;    /**< Column titles */
+    int deferDepth;             /**< Number of open beginDeferredUpdates() calls */
+    QSet<ModelPart*> deferred;  /**< Parts updated while updates are deferred */
+    QHash<ModelPart*, PendingRows> pending;     /**< Rows not fetched yet, by parent */
+    QSet<ModelPart*> onDemand;                  /**< Parts whose geometry is loaded when shown */
+    QSet<ModelPart*> requested;                 /**< Parts whose geometry has been requested and not failed */
+    QList<ModelPart*> requests;                 /**< Parts to request at the next flushRequests() */
+    uint32_t useClock;                          /**< Stamp given to parts as views show them */
 };
 #endif
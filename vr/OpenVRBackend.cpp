@@ -0,0 +1,94 @@
+/** @file OpenVRBackend.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Renders the VR scene to a headset through OpenVR.
+  */
+
+#include "OpenVRBackend.h"
+
+/**
+ * @brief This function returns the name of the backend.
+ * @return "openvr".
+ */
+const char* OpenVRBackend::name() const {
+    return "openvr";
+}
+
+/**
+ * @brief This function creates the OpenVR renderer.
+ * @return the renderer.
+ */
+vtkRenderer* OpenVRBackend::createRenderer() {
+    renderer = vtkSmartPointer<vtkOpenVRRenderer>::New();
+    return renderer;
+}
+
+/**
+ * @brief This function starts OpenVR and creates the headset window, camera and interactor.
+ * @return false if no headset could be found.
+ */
+bool OpenVRBackend::initialize() {
+    /* The render window is the actual GUI window
+     * that appears on the computer screen
+     */
+    renderWindow = vtkSmartPointer<vtkOpenVRRenderWindow>::New();
+    renderWindow->Initialize();
+    if (renderWindow->GetHMD() == nullptr)
+        return false;
+    renderWindow->AddRenderer(renderer);
+
+    /* Create Open VR Camera */
+    camera = vtkSmartPointer<vtkOpenVRCamera>::New();
+    renderer->SetActiveCamera(camera);
+
+    /* The render window interactor captures mouse events
+     * and will perform appropriate camera or actor manipulation
+     * depending on the nature of the events.
+     */
+    windowInteractor = vtkSmartPointer<vtkOpenVRRenderWindowInteractor>::New();
+    windowInteractor->SetRenderWindow(renderWindow);
+    windowInteractor->Initialize();
+    return true;
+}
+
+/**
+ * @brief This function returns the headset render window.
+ * @return the window.
+ */
+vtkRenderWindow* OpenVRBackend::window() const {
+    return renderWindow;
+}
+
+/**
+ * @brief This function returns the OpenVR interactor.
+ * @return the interactor.
+ */
+vtkRenderWindowInteractor* OpenVRBackend::interactor() const {
+    return windowInteractor;
+}
+
+/**
+ * @brief This function checks if the OpenVR session has ended.
+ * @return true once the interactor is done.
+ */
+bool OpenVRBackend::done() const {
+    return windowInteractor->GetDone();
+}
+
+/**
+ * @brief This function polls OpenVR and renders both eyes, waiting for the compositor.
+ */
+void OpenVRBackend::processFrame() {
+    windowInteractor->DoOneEvent(renderWindow, renderer);
+}
+
+/**
+ * @brief This function places the physical space in the scene through the render window.
+ * @param translation is the physical translation.
+ * @param direction is the scene direction the user faces.
+ * @param up is the scene direction that is up for the user.
+ */
+void OpenVRBackend::setPhysicalPose(const double translation[3], const double direction[3], const double up[3]) {
+    renderWindow->SetPhysicalTranslation(translation[0], translation[1], translation[2]);
+    renderWindow->SetPhysicalViewDirection(direction[0], direction[1], direction[2]);
+    renderWindow->SetPhysicalViewUp(up[0], up[1], up[2]);
+}
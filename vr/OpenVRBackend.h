@@ -0,0 +1,82 @@
+/** @file OpenVRBackend.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Renders the VR scene to a headset through OpenVR.
+  */
+
+#ifndef VIEWER_OPENVRBACKEND_H
+#define VIEWER_OPENVRBACKEND_H
+
+#include "VRBackend.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkOpenVRRenderWindow.h>
+#include <vtkOpenVRRenderWindowInteractor.h>
+#include <vtkOpenVRRenderer.h>
+#include <vtkOpenVRCamera.h>
+
+/**
+ * @class OpenVRBackend
+ * @brief The OpenVRBackend class is the VRBackend for a real headset, using VTK's OpenVR classes.
+ *
+ * The interactor reads the controllers through the action manifest in vrbindings and the render
+ * window waits for the compositor, so a frame takes at least one refresh of the headset.
+ */
+class OpenVRBackend : public VRBackend {
+public:
+    /**
+     * @brief This function returns the name of the backend.
+     * @return "openvr".
+     */
+    const char* name() const override;
+
+    /**
+     * @brief This function creates the OpenVR renderer.
+     * @return the renderer.
+     */
+    vtkRenderer* createRenderer() override;
+
+    /**
+     * @brief This function starts OpenVR and creates the headset window, camera and interactor.
+     * @return false if no headset could be found.
+     */
+    bool initialize() override;
+
+    /**
+     * @brief This function returns the headset render window.
+     * @return the window.
+     */
+    vtkRenderWindow* window() const override;
+
+    /**
+     * @brief This function returns the OpenVR interactor.
+     * @return the interactor.
+     */
+    vtkRenderWindowInteractor* interactor() const override;
+
+    /**
+     * @brief This function checks if the OpenVR session has ended.
+     * @return true once the interactor is done.
+     */
+    bool done() const override;
+
+    /**
+     * @brief This function polls OpenVR and renders both eyes, waiting for the compositor.
+     */
+    void processFrame() override;
+
+    /**
+     * @brief This function places the physical space in the scene through the render window.
+     * @param translation is the physical translation.
+     * @param direction is the scene direction the user faces.
+     * @param up is the scene direction that is up for the user.
+     */
+    void setPhysicalPose(const double translation[3], const double direction[3], const double up[3]) override;
+
+private:
+    vtkSmartPointer<vtkOpenVRRenderWindow>              renderWindow;       /**< Headset render window */
+    vtkSmartPointer<vtkOpenVRRenderWindowInteractor>    windowInteractor;   /**< Reads the headset and controllers */
+    vtkSmartPointer<vtkOpenVRRenderer>                  renderer;           /**< Renderer of the scene */
+    vtkSmartPointer<vtkOpenVRCamera>                    camera;             /**< Camera that follows the headset */
+};
+
+#endif
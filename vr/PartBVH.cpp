@@ -0,0 +1,633 @@
+/** @file PartBVH.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Bounding volume hierarchy over the part actors of one view.
+  */
+
+#include "PartBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief This function returns half the surface area of a box, the cost used to choose where a leaf goes.
+ * @param box is the box.
+ * @return the half surface area.
+ */
+inline double surface(const double box[6]) {
+    double dx = box[1] - box[0];
+    double dy = box[3] - box[2];
+    double dz = box[5] - box[4];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/**
+ * @brief This function computes the box around two boxes.
+ * @param a is the first box.
+ * @param b is the second box.
+ * @param out receives the merged box, it may be a or b.
+ */
+inline void merge(const double a[6], const double b[6], double out[6]) {
+    for (int k = 0; k < 6; k += 2) {
+        out[k] = std::min(a[k], b[k]);
+        out[k + 1] = std::max(a[k + 1], b[k + 1]);
+    }
+}
+
+/**
+ * @brief This function checks if a box lies inside another.
+ * @param outer is the containing box.
+ * @param inner is the contained box.
+ * @return true if inner is inside outer.
+ */
+inline bool contains(const double outer[6], const double inner[6]) {
+    for (int k = 0; k < 6; k += 2) {
+        if (inner[k] < outer[k] || inner[k + 1] > outer[k + 1])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief This function finds where a ray enters a box (slab test).
+ * @param box is the box.
+ * @param origin is the start of the ray.
+ * @param inverse is one over each direction component (infinite for a zero component).
+ * @param limit is the furthest distance of interest.
+ * @param entry receives the distance the ray enters the box, 0 if it starts inside.
+ * @return true if the ray meets the box between 0 and limit.
+ */
+inline bool rayBox(const double box[6], const double origin[3], const double inverse[3], double limit, double& entry) {
+    double tNear = 0.;
+    double tFar = limit;
+    for (int k = 0; k < 3; k++) {
+        if (std::isinf(inverse[k])) {
+            /* Parallel to this slab, the origin must already be between its planes */
+            if (origin[k] < box[2 * k] || origin[k] > box[2 * k + 1])
+                return false;
+            continue;
+        }
+        double t0 = (box[2 * k] - origin[k]) * inverse[k];
+        double t1 = (box[2 * k + 1] - origin[k]) * inverse[k];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tNear = std::max(tNear, t0);
+        tFar = std::min(tFar, t1);
+        if (tNear > tFar)
+            return false;
+    }
+    entry = tNear;
+    return true;
+}
+
+}
+
+/**
+ * @brief Constructor for the PartBVH class.
+ * @param margin is how much each leaf box is enlarged, as a fraction of its size.
+ */
+PartBVH::PartBVH(double margin)
+    : root(-1), freeList(-1), stamp(0), stale(false), margin(margin > 0. ? margin : 0.) {
+}
+
+/**
+ * @brief This function adds an actor, or updates it if it is already indexed.
+ * @param prop is the actor.
+ */
+void PartBVH::insert(vtkProp3D* prop) {
+    if (prop == nullptr)
+        return;
+    if (leaves.count(prop) != 0) {
+        update(prop);
+        return;
+    }
+
+    double box[6], tight[6];
+    if (!fatBounds(prop, box, tight)) {
+        leaves[prop] = -1;
+        return;
+    }
+
+    int leaf = allocate();
+    Node& node = nodes[leaf];
+    std::copy(box, box + 6, node.box);
+    node.left = node.right = -1;
+    node.height = 0;
+    node.prop = prop;
+    node.stamp = stamp;
+    leaves[prop] = leaf;
+    insertLeaf(leaf);
+}
+
+/**
+ * @brief This function refits an actor after it has moved or its geometry has changed.
+ * @param prop is the actor.
+ * @param reinsert is true to move an actor that left its enlarged box to the best place in the tree.
+ * @return true if the leaf box changed.
+ */
+bool PartBVH::update(vtkProp3D* prop, bool reinsert) {
+    auto it = leaves.find(prop);
+    if (it == leaves.end())
+        return false;
+
+    double box[6], tight[6];
+    bool bounded = fatBounds(prop, box, tight);
+    int leaf = it->second;
+
+    if (leaf < 0) {
+        if (!bounded)
+            return false;
+        /* The actor has gained something to draw */
+        leaves.erase(it);
+        insert(prop);
+        return true;
+    }
+
+    if (!bounded) {
+        removeLeaf(leaf);
+        release(leaf);
+        it->second = -1;
+        return true;
+    }
+
+    if (::contains(nodes[leaf].box, tight))
+        return false;
+
+    if (!reinsert) {
+        std::copy(box, box + 6, nodes[leaf].box);
+        stale = true;
+        return true;
+    }
+
+    removeLeaf(leaf);
+    std::copy(box, box + 6, nodes[leaf].box);
+    insertLeaf(leaf);
+    return true;
+}
+
+/**
+ * @brief This function recomputes every inner box after leaf boxes were replaced without reinsertion.
+ */
+void PartBVH::refit() {
+    if (!stale || root < 0)
+        return;
+    stale = false;
+
+    /* Post-order walk: a node is pushed again after its children so it is merged once both are done */
+    std::vector<std::pair<int, bool>> stack;
+    stack.reserve(64);
+    stack.push_back({ root, false });
+    while (!stack.empty()) {
+        std::pair<int, bool> entry = stack.back();
+        stack.pop_back();
+        Node& node = nodes[entry.first];
+        if (node.left < 0)
+            continue;
+
+        if (entry.second) {
+            merge(nodes[node.left].box, nodes[node.right].box, node.box);
+        }
+        else {
+            stack.push_back({ entry.first, true });
+            stack.push_back({ node.left, false });
+            stack.push_back({ node.right, false });
+        }
+    }
+}
+
+/**
+ * @brief This function removes an actor.
+ * @param prop is the actor.
+ */
+void PartBVH::remove(vtkProp3D* prop) {
+    auto it = leaves.find(prop);
+    if (it == leaves.end())
+        return;
+
+    if (it->second >= 0) {
+        removeLeaf(it->second);
+        release(it->second);
+    }
+    leaves.erase(it);
+}
+
+/**
+ * @brief This function removes every actor.
+ */
+void PartBVH::clear() {
+    nodes.clear();
+    leaves.clear();
+    root = -1;
+    freeList = -1;
+    stale = false;
+}
+
+/**
+ * @brief This function checks if an actor is indexed.
+ * @param prop is the actor.
+ * @return true if the actor has been inserted.
+ */
+bool PartBVH::contains(const vtkProp* prop) const {
+    return leaves.count(prop) != 0;
+}
+
+/**
+ * @brief This function marks the actors whose boxes intersect a view frustum.
+ * @param planes are the six frustum planes (a, b, c, d), inside where ax + by + cz + d >= 0.
+ * @return the number of indexed actors inside the frustum.
+ */
+int PartBVH::cull(const double planes[24]) {
+    stamp++;
+    if (root < 0)
+        return 0;
+
+    /* Each entry carries the planes its box is not yet known to be inside, a branch that is
+     * inside every plane is marked without further tests */
+    struct Entry {
+        int node;
+        int planes;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ root, 0x3f });
+    int count = 0;
+
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[entry.node];
+
+        int mask = entry.planes;
+        bool outside = false;
+        for (int p = 0; p < 6 && mask != 0; p++) {
+            if ((mask & (1 << p)) == 0)
+                continue;
+            const double* plane = planes + 4 * p;
+
+            /* Distances of the box corners furthest along and against the plane normal */
+            double ahead = plane[3], behind = plane[3];
+            for (int k = 0; k < 3; k++) {
+                double lo = plane[k] * node.box[2 * k];
+                double hi = plane[k] * node.box[2 * k + 1];
+                ahead += std::max(lo, hi);
+                behind += std::min(lo, hi);
+            }
+            if (ahead < 0.) {
+                outside = true;
+                break;
+            }
+            if (behind >= 0.)
+                mask &= ~(1 << p);
+        }
+        if (outside)
+            continue;
+
+        if (node.left < 0) {
+            nodes[entry.node].stamp = stamp;
+            count++;
+        }
+        else {
+            stack.push_back({ node.left, mask });
+            stack.push_back({ node.right, mask });
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief This function checks if an actor was inside the frustum at the last cull().
+ * @param prop is the actor.
+ * @return true if it was inside, or if the actor is not indexed or has no bounds.
+ */
+bool PartBVH::inFrustum(const vtkProp* prop) const {
+    auto it = leaves.find(prop);
+    if (it == leaves.end() || it->second < 0)
+        return true;
+    return nodes[it->second].stamp == stamp;
+}
+
+/**
+ * @brief This function finds the first actor a ray hits.
+ * @param origin is the start of the ray.
+ * @param direction is the direction of the ray.
+ * @param distance receives the distance to the hit, if not nullptr.
+ * @param test is the precise test run on each candidate.
+ * @param visibleOnly is true to ignore actors that are hidden.
+ * @return the actor hit, nullptr if there is none.
+ */
+vtkProp3D* PartBVH::raycast(const double origin[3], const double direction[3], double* distance,
+                            const RayTest& test, bool visibleOnly) const {
+    if (root < 0)
+        return nullptr;
+
+    double inverse[3];
+    for (int k = 0; k < 3; k++)
+        inverse[k] = direction[k] != 0. ? 1. / direction[k] : HUGE_VAL;
+
+    double best = HUGE_VAL;
+    vtkProp3D* hit = nullptr;
+
+    struct Entry {
+        int node;
+        double entry;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+
+    double t;
+    if (rayBox(nodes[root].box, origin, inverse, best, t))
+        stack.push_back({ root, t });
+
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.entry >= best)
+            continue;
+
+        const Node& node = nodes[entry.node];
+        if (node.left < 0) {
+            if (visibleOnly && !node.prop->GetVisibility())
+                continue;
+
+            double d = best;
+            bool found;
+            if (test) {
+                found = test(node.prop, origin, direction, d);
+            }
+            else {
+                double* bounds = node.prop->GetBounds();
+                found = bounds != nullptr && rayBox(bounds, origin, inverse, best, d);
+            }
+            if (found && d < best) {
+                best = d;
+                hit = node.prop;
+            }
+            continue;
+        }
+
+        /* Visit the nearer child first, so the further one can often be skipped */
+        double tl, tr;
+        bool l = rayBox(nodes[node.left].box, origin, inverse, best, tl);
+        bool r = rayBox(nodes[node.right].box, origin, inverse, best, tr);
+        if (l && r) {
+            if (tl <= tr) {
+                stack.push_back({ node.right, tr });
+                stack.push_back({ node.left, tl });
+            }
+            else {
+                stack.push_back({ node.left, tl });
+                stack.push_back({ node.right, tr });
+            }
+        }
+        else if (l) {
+            stack.push_back({ node.left, tl });
+        }
+        else if (r) {
+            stack.push_back({ node.right, tr });
+        }
+    }
+
+    if (hit != nullptr && distance != nullptr)
+        *distance = best;
+    return hit;
+}
+
+/**
+ * @brief This function returns the box around every indexed actor.
+ * @param bounds receives xmin, xmax, ymin, ymax, zmin, zmax.
+ * @return false if no actor has bounds.
+ */
+bool PartBVH::getBounds(double bounds[6]) const {
+    if (root < 0)
+        return false;
+    std::copy(nodes[root].box, nodes[root].box + 6, bounds);
+    return true;
+}
+
+/**
+ * @brief This function returns the number of indexed actors.
+ * @return the number of actors.
+ */
+int PartBVH::size() const {
+    return int(leaves.size());
+}
+
+/**
+ * @brief This function returns the height of the tree.
+ * @return the height, 0 for an empty tree and 1 for a single actor.
+ */
+int PartBVH::height() const {
+    return root < 0 ? 0 : nodes[root].height + 1;
+}
+
+/**
+ * @brief This function takes a node from the free list, growing the pool if needed.
+ * @return the node index.
+ */
+int PartBVH::allocate() {
+    if (freeList < 0) {
+        nodes.push_back(Node());
+        return int(nodes.size()) - 1;
+    }
+    int node = freeList;
+    freeList = nodes[node].left;
+    return node;
+}
+
+/**
+ * @brief This function returns a node to the free list.
+ * @param node is the node index.
+ */
+void PartBVH::release(int node) {
+    nodes[node].left = freeList;
+    nodes[node].prop = nullptr;
+    freeList = node;
+}
+
+/**
+ * @brief This function links a leaf into the tree next to the sibling that adds the least surface area.
+ * @param leaf is the leaf node.
+ */
+void PartBVH::insertLeaf(int leaf) {
+    if (root < 0) {
+        root = leaf;
+        nodes[leaf].parent = -1;
+        return;
+    }
+
+    double box[6];
+    std::copy(nodes[leaf].box, nodes[leaf].box + 6, box);
+
+    /* Walk down while making one of the children the sibling is cheaper than pairing with this node */
+    int index = root;
+    while (nodes[index].left >= 0) {
+        const Node& node = nodes[index];
+        double combined[6];
+        merge(node.box, box, combined);
+        double combinedArea = surface(combined);
+
+        /* Cost of a new parent here, and the growth every ancestor below here pays for going deeper */
+        double cost = 2. * combinedArea;
+        double inheritance = 2. * (combinedArea - surface(node.box));
+
+        double childCost[2];
+        int children[2] = { node.left, node.right };
+        for (int c = 0; c < 2; c++) {
+            const Node& child = nodes[children[c]];
+            double merged[6];
+            merge(child.box, box, merged);
+            childCost[c] = surface(merged) + inheritance;
+            if (child.left >= 0)
+                childCost[c] -= surface(child.box);
+        }
+
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocate();
+
+    Node& parent = nodes[newParent];
+    parent.parent = oldParent;
+    parent.left = sibling;
+    parent.right = leaf;
+    parent.height = nodes[sibling].height + 1;
+    parent.prop = nullptr;
+    parent.stamp = 0;
+    merge(nodes[sibling].box, box, parent.box);
+
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent < 0)
+        root = newParent;
+    else if (nodes[oldParent].left == sibling)
+        nodes[oldParent].left = newParent;
+    else
+        nodes[oldParent].right = newParent;
+
+    refitUp(oldParent);
+}
+
+/**
+ * @brief This function unlinks a leaf from the tree, its sibling takes its parent's place.
+ * @param leaf is the leaf node.
+ */
+void PartBVH::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    nodes[sibling].parent = grandParent;
+    if (grandParent < 0) {
+        root = sibling;
+    }
+    else {
+        if (nodes[grandParent].left == parent)
+            nodes[grandParent].left = sibling;
+        else
+            nodes[grandParent].right = sibling;
+    }
+    release(parent);
+    refitUp(grandParent);
+}
+
+/**
+ * @brief This function refits the boxes and heights from a node up to the root, rebalancing on the way.
+ * @param node is the first node to refit, -1 for none.
+ */
+void PartBVH::refitUp(int node) {
+    while (node >= 0) {
+        node = balance(node);
+
+        Node& n = nodes[node];
+        n.height = 1 + std::max(nodes[n.left].height, nodes[n.right].height);
+        merge(nodes[n.left].box, nodes[n.right].box, n.box);
+
+        node = n.parent;
+    }
+}
+
+/**
+ * @brief This function rotates a node's higher child above it if the children's heights differ by more than one.
+ * @param a is the node.
+ * @return the node now in its place.
+ */
+int PartBVH::balance(int a) {
+    Node& A = nodes[a];
+    if (A.left < 0 || A.height < 2)
+        return a;
+
+    int b = A.left;
+    int c = A.right;
+    int difference = nodes[c].height - nodes[b].height;
+    if (difference >= -1 && difference <= 1)
+        return a;
+
+    /* Raise the higher child (up) above a, a keeps the other child (down) and the lower of up's children */
+    int up = difference > 1 ? c : b;
+    int down = difference > 1 ? b : c;
+    Node& U = nodes[up];
+    int f = U.left;
+    int g = U.right;
+    int keep = nodes[f].height > nodes[g].height ? f : g;
+    int give = keep == f ? g : f;
+
+    U.left = a;
+    U.parent = A.parent;
+    A.parent = up;
+
+    if (U.parent < 0)
+        root = up;
+    else if (nodes[U.parent].left == a)
+        nodes[U.parent].left = up;
+    else
+        nodes[U.parent].right = up;
+
+    U.right = keep;
+    if (difference > 1)
+        A.right = give;
+    else
+        A.left = give;
+    nodes[give].parent = a;
+
+    merge(nodes[down].box, nodes[give].box, A.box);
+    A.height = 1 + std::max(nodes[down].height, nodes[give].height);
+    merge(A.box, nodes[keep].box, U.box);
+    U.height = 1 + std::max(A.height, nodes[keep].height);
+
+    return up;
+}
+
+/**
+ * @brief This function reads an actor's world bounds and enlarges them by the margin.
+ * @param prop is the actor.
+ * @param box receives the enlarged box.
+ * @param tight receives the bounds before enlarging.
+ * @return false if the actor has no bounds.
+ */
+bool PartBVH::fatBounds(vtkProp3D* prop, double box[6], double tight[6]) const {
+    double* bounds = prop->GetBounds();
+    if (bounds == nullptr || bounds[0] > bounds[1] || bounds[2] > bounds[3] || bounds[4] > bounds[5])
+        return false;
+
+    /* Enlarged by a fraction of the largest side, so flat parts are enlarged too */
+    double size = std::max(bounds[1] - bounds[0], std::max(bounds[3] - bounds[2], bounds[5] - bounds[4]));
+    double pad = margin * size;
+    for (int k = 0; k < 6; k += 2) {
+        tight[k] = bounds[k];
+        tight[k + 1] = bounds[k + 1];
+        box[k] = bounds[k] - pad;
+        box[k + 1] = bounds[k + 1] + pad;
+    }
+    return true;
+}
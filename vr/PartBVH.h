@@ -0,0 +1,205 @@
+/** @file PartBVH.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Bounding volume hierarchy over the part actors of one view.
+  */
+
+#ifndef VIEWER_PARTBVH_H
+#define VIEWER_PARTBVH_H
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <vtkProp.h>
+#include <vtkProp3D.h>
+
+/**
+ * @class PartBVH
+ * @brief The PartBVH class keeps the world bounds of a view's part actors in a binary tree of
+ * axis aligned boxes, so frustum culling and ray picking visit only the branches they touch.
+ *
+ * Each part is a leaf holding its actor's world bounds enlarged by a margin, and each inner node
+ * holds the box around its two children. Parts are inserted next to the sibling that grows the
+ * tree's surface area least and the tree is rebalanced by rotations on the way back up, so it
+ * stays shallow whatever order parts arrive in. When an actor moves update() only restructures
+ * the tree if the actor has left its enlarged box, otherwise it costs one bounds computation.
+ *
+ * The part tree's own hierarchy is not used for the boxes: assemblies loaded from a folder are
+ * often flat lists of hundreds of parts, which would make a single node with hundreds of children.
+ *
+ * Actors are not reference counted by the index, they must be removed before they are deleted.
+ * It is not thread safe, each view has its own index used by the thread that renders it.
+ */
+class PartBVH {
+public:
+    /**
+     * @brief Type of the function that tests a ray against a part more precisely than its box.
+     * It receives the prop, the ray origin and direction and the distance of the nearest hit found so
+     * far, and returns true with the distance (in multiples of the direction) if the ray hits the part closer.
+     */
+    typedef std::function<bool(vtkProp3D* prop, const double origin[3], const double direction[3], double& distance)> RayTest;
+
+    /**
+     * @brief Constructor for the PartBVH class.
+     * @param margin is how much each leaf box is enlarged, as a fraction of its size.
+     */
+    explicit PartBVH(double margin = 0.1);
+
+    /**
+     * @brief This function adds an actor, or updates it if it is already indexed.
+     * Actors without bounds (nothing to draw) are kept outside the tree and are never culled.
+     * @param prop is the actor.
+     */
+    void insert(vtkProp3D* prop);
+
+    /**
+     * @brief This function refits an actor after it has moved or its geometry has changed.
+     * @param prop is the actor.
+     * @param reinsert is true to move an actor that left its enlarged box to the best place in the tree. When
+     * false only its leaf box is replaced, which is cheaper when most actors move together (a rigid motion
+     * keeps neighbours together), and refit() must be called before the next query.
+     * @return true if the leaf box changed, false if the actor is still inside its enlarged box or is not indexed.
+     */
+    bool update(vtkProp3D* prop, bool reinsert = true);
+
+    /**
+     * @brief This function recomputes every inner box after leaf boxes were replaced by update() without reinsertion.
+     * It does nothing if no box is out of date.
+     */
+    void refit();
+
+    /**
+     * @brief This function removes an actor.
+     * @param prop is the actor.
+     */
+    void remove(vtkProp3D* prop);
+
+    /**
+     * @brief This function removes every actor.
+     */
+    void clear();
+
+    /**
+     * @brief This function checks if an actor is indexed.
+     * @param prop is the actor.
+     * @return true if the actor has been inserted.
+     */
+    bool contains(const vtkProp* prop) const;
+
+    /**
+     * @brief This function marks the actors whose boxes intersect a view frustum, see inFrustum().
+     * @param planes are the six frustum planes as (a, b, c, d) with the inside where ax + by + cz + d >= 0, as returned by vtkCamera::GetFrustumPlanes().
+     * @return the number of indexed actors inside the frustum.
+     */
+    int cull(const double planes[24]);
+
+    /**
+     * @brief This function checks if an actor was inside the frustum at the last cull().
+     * @param prop is the actor.
+     * @return true if it was inside, or if the actor is not indexed or has no bounds.
+     */
+    bool inFrustum(const vtkProp* prop) const;
+
+    /**
+     * @brief This function finds the first actor a ray hits.
+     * Candidates are visited nearest box first and boxes further than the best hit are skipped.
+     * @param origin is the start of the ray.
+     * @param direction is the direction of the ray, its length is the unit of the returned distance.
+     * @param distance receives the distance to the hit, if not nullptr.
+     * @param test is the precise test run on each candidate, by default the ray hits an actor where it enters its bounds.
+     * @param visibleOnly is true to ignore actors that are hidden.
+     * @return the actor hit, nullptr if there is none.
+     */
+    vtkProp3D* raycast(const double origin[3], const double direction[3], double* distance = nullptr,
+                       const RayTest& test = RayTest(), bool visibleOnly = true) const;
+
+    /**
+     * @brief This function returns the box around every indexed actor (enlarged by the margin).
+     * @param bounds receives xmin, xmax, ymin, ymax, zmin, zmax.
+     * @return false if no actor has bounds.
+     */
+    bool getBounds(double bounds[6]) const;
+
+    /**
+     * @brief This function returns the number of indexed actors.
+     * @return the number of actors.
+     */
+    int size() const;
+
+    /**
+     * @brief This function returns the height of the tree, a balanced tree of n actors has a height close to log2(n).
+     * @return the height, 0 for an empty tree and 1 for a single actor.
+     */
+    int height() const;
+
+private:
+    /**
+     * @struct Node
+     * @brief The Node structure is one box of the tree, a leaf holds an actor.
+     */
+    struct Node {
+        double      box[6];         /**< xmin, xmax, ymin, ymax, zmin, zmax */
+        int         parent;         /**< Parent node, -1 for the root */
+        int         left;           /**< First child, -1 for a leaf (and next free node when unused) */
+        int         right;          /**< Second child, -1 for a leaf */
+        int         height;         /**< 0 for a leaf, one more than the higher child otherwise */
+        vtkProp3D*  prop;           /**< Actor of a leaf */
+        unsigned    stamp;          /**< Cull the leaf was last found inside the frustum */
+    };
+
+    /**
+     * @brief This function takes a node from the free list, growing the pool if needed.
+     * @return the node index.
+     */
+    int allocate();
+
+    /**
+     * @brief This function returns a node to the free list.
+     * @param node is the node index.
+     */
+    void release(int node);
+
+    /**
+     * @brief This function links a leaf into the tree.
+     * @param leaf is the leaf node.
+     */
+    void insertLeaf(int leaf);
+
+    /**
+     * @brief This function unlinks a leaf from the tree, the leaf node itself is kept.
+     * @param leaf is the leaf node.
+     */
+    void removeLeaf(int leaf);
+
+    /**
+     * @brief This function refits the boxes and heights from a node up to the root, rebalancing on the way.
+     * @param node is the first node to refit.
+     */
+    void refitUp(int node);
+
+    /**
+     * @brief This function rotates a node's higher child above it if the node is unbalanced.
+     * @param node is the node.
+     * @return the node now in its place.
+     */
+    int balance(int node);
+
+    /**
+     * @brief This function reads an actor's world bounds and enlarges them by the margin.
+     * @param prop is the actor.
+     * @param box receives the enlarged box.
+     * @param tight receives the bounds before enlarging.
+     * @return false if the actor has no bounds.
+     */
+    bool fatBounds(vtkProp3D* prop, double box[6], double tight[6]) const;
+
+    std::vector<Node>                           nodes;      /**< Node pool, leaves and inner nodes */
+    std::unordered_map<const vtkProp*, int>     leaves;     /**< Leaf of each actor, -1 for actors without bounds */
+    int                                         root;       /**< Root node, -1 when the tree is empty */
+    int                                         freeList;   /**< First unused node, -1 when the pool is full */
+    unsigned                                    stamp;      /**< Number of the last cull */
+    bool                                        stale;      /**< True if inner boxes need refit() */
+    double                                      margin;     /**< Leaf enlargement as a fraction of the leaf size */
+};
+
+#endif
@@ -0,0 +1,186 @@
+/** @file PartGeometry.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Immutable geometry shared by every view of a part.
+  */
+
+#include "PartGeometry.h"
+
+#include <vtkCubeSource.h>
+#include <vtkNew.h>
+#include <vtkPolyDataMapper.h>
+
+/**
+ * @brief Constructor for the PartGeometry class, builds the triangle index used for picking.
+ * @param polyData is the prepared geometry, it must not be modified afterwards.
+ */
+PartGeometry::PartGeometry(vtkSmartPointer<vtkPolyData> polyData)
+    : data(polyData) {
+    /* Compute everything that VTK would otherwise compute (and cache) lazily, so rendering
+     * from two threads never writes to the shared object */
+    data->GetBounds(bounds);
+    triangles = std::make_shared<const TriangleBVH>(data);
+    host = size_t(data->GetActualMemorySize()) * 1024 + triangles->hostBytes();
+}
+
+/**
+ * @brief Constructor for the PartGeometry class that adds levels of detail to existing geometry.
+ * @param base is the geometry, its vtkPolyData is shared rather than copied.
+ * @param levels are the decimated levels, from finest to coarsest, they must not be modified afterwards.
+ */
+PartGeometry::PartGeometry(const PartGeometry& base, const std::vector<Level>& levels)
+    : data(base.data), levels(levels), triangles(base.triangles), host(base.host) {
+    base.getBounds(bounds);
+    for (const Level& level : levels) {
+        /* As above, let VTK cache the bounds now rather than during a render */
+        double levelBounds[6];
+        level.data->GetBounds(levelBounds);
+        host += size_t(level.data->GetActualMemorySize()) * 1024;
+    }
+}
+
+/**
+ * @brief This function returns the geometry.
+ * @return a pointer to the vtkPolyData, which must be treated as read only.
+ */
+vtkPolyData* PartGeometry::polyData() const {
+    return data;
+}
+
+/**
+ * @brief This function creates a new actor and mapper that render this geometry.
+ * @return a smart pointer to the new vtkActor.
+ */
+vtkSmartPointer<vtkActor> PartGeometry::createActor() const {
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(createMapper(0));
+    return actor;
+}
+
+/**
+ * @brief This function creates a new mapper that renders one level of detail.
+ * @param level is the level, 0 for the full geometry.
+ * @return a smart pointer to the new mapper.
+ */
+vtkSmartPointer<vtkMapper> PartGeometry::createMapper(int level) const {
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputData(levelData(level));
+    /* The input never changes, so skip the pipeline update on every render */
+    mapper->StaticOn();
+    return mapper;
+}
+
+/**
+ * @brief This function creates a cheap stand-in for the geometry, rendered while the full geometry is evicted.
+ * @return new geometry made of the coarsest level of detail, or of the bounding box if there are no levels.
+ */
+std::shared_ptr<const PartGeometry> PartGeometry::createProxy() const {
+    /* The coarsest level keeps the part's silhouette for about 1.5% of its triangles */
+    if (!levels.empty())
+        return std::make_shared<const PartGeometry>(levels.back().data);
+
+    return createBox(bounds);
+}
+
+/**
+ * @brief This function creates geometry made of a box, used as a stand-in while the real geometry is not available.
+ * @param bounds are xmin, xmax, ymin, ymax, zmin, zmax of the box.
+ * @return the new geometry.
+ */
+std::shared_ptr<const PartGeometry> PartGeometry::createBox(const double bounds[6]) {
+    vtkNew<vtkCubeSource> box;
+    box->SetBounds(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+    box->Update();
+    return std::make_shared<const PartGeometry>(vtkSmartPointer<vtkPolyData>(box->GetOutput()));
+}
+
+/**
+ * @brief This function returns the number of levels of detail, including the full geometry.
+ * @return the number of levels.
+ */
+int PartGeometry::levelCount() const {
+    return int(levels.size()) + 1;
+}
+
+/**
+ * @brief This function returns the geometry of one level of detail.
+ * @param level is the level, 0 for the full geometry.
+ * @return a pointer to the vtkPolyData, which must be treated as read only.
+ */
+vtkPolyData* PartGeometry::levelData(int level) const {
+    if (level <= 0 || level > int(levels.size()))
+        return data;
+    return levels[level - 1].data;
+}
+
+/**
+ * @brief This function returns the estimated deviation of one level of detail from the full geometry.
+ * @param level is the level, 0 for the full geometry.
+ * @return the deviation in model units.
+ */
+double PartGeometry::levelError(int level) const {
+    if (level <= 0 || level > int(levels.size()))
+        return 0.;
+    return levels[level - 1].error;
+}
+
+/**
+ * @brief This function returns the number of triangles of one level of detail.
+ * @param level is the level, 0 for the full geometry.
+ * @return the number of triangles.
+ */
+vtkIdType PartGeometry::levelTriangleCount(int level) const {
+    return levelData(level)->GetNumberOfPolys();
+}
+
+/**
+ * @brief This function returns the number of triangles.
+ * @return the number of triangles.
+ */
+vtkIdType PartGeometry::triangleCount() const {
+    return data->GetNumberOfPolys();
+}
+
+/**
+ * @brief This function returns the number of vertices.
+ * @return the number of vertices.
+ */
+vtkIdType PartGeometry::pointCount() const {
+    return data->GetNumberOfPoints();
+}
+
+/**
+ * @brief This function returns the bounding box of the geometry.
+ * @param bounds receives xmin, xmax, ymin, ymax, zmin, zmax.
+ */
+void PartGeometry::getBounds(double bounds[6]) const {
+    for (int i = 0; i < 6; i++)
+        bounds[i] = this->bounds[i];
+}
+
+/**
+ * @brief This function returns the triangle index of the full geometry, used for exact ray picks.
+ * @return a pointer to the index.
+ */
+const TriangleBVH* PartGeometry::pickIndex() const {
+    return triangles.get();
+}
+
+/**
+ * @brief This function returns the host memory held by the geometry.
+ * @return the size in bytes.
+ */
+size_t PartGeometry::hostBytes() const {
+    return host;
+}
+
+/**
+ * @brief This function estimates the GPU memory one view uses for the geometry (vertex, normal and index buffers).
+ * @return the estimated size in bytes per view.
+ */
+size_t PartGeometry::gpuBytes() const {
+    /* float xyz position + float xyz normal per vertex, three 32 bit indices per triangle */
+    size_t bytes = 0;
+    for (int level = 0; level < levelCount(); level++)
+        bytes += size_t(levelData(level)->GetNumberOfPoints()) * 24 + size_t(levelTriangleCount(level)) * 12;
+    return bytes;
+}
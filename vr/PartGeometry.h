@@ -0,0 +1,163 @@
+/** @file PartGeometry.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Immutable geometry shared by every view of a part.
+  */
+
+#ifndef VIEWER_PARTGEOMETRY_H
+#define VIEWER_PARTGEOMETRY_H
+
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkActor.h>
+#include <vtkMapper.h>
+#include <vtkType.h>
+
+#include "TriangleBVH.h"
+
+/**
+ * @class PartGeometry
+ * @brief The PartGeometry class holds the mesh of a part once, for the desktop and VR views to share.
+ *
+ * The geometry is never modified after construction (bounds are computed up front), so the GUI
+ * and VR threads can both render it. Each view gets its own lightweight actor and
+ * vtkPolyDataMapper on the same vtkPolyData through createActor(); no geometry is copied on the
+ * host. Instances are held through std::shared_ptr<const PartGeometry>.
+ *
+ * Level 0 is the full geometry. Decimated levels of detail are built after the part is loaded
+ * and attached by creating a new PartGeometry from the old one (see LODSelector), so existing
+ * holders never see the object change.
+ *
+ * A TriangleBVH over the full geometry is built by the constructor, so when parts are loaded in
+ * the background it is built on the worker thread, and ray picks never have to walk the mesh.
+ */
+class PartGeometry {
+public:
+    /**
+     * @struct Level
+     * @brief The Level structure holds one decimated version of the geometry.
+     */
+    struct Level {
+        vtkSmartPointer<vtkPolyData>    data;       /**< Decimated geometry, read only */
+        double                          error;      /**< Estimated deviation from the full geometry, in model units */
+    };
+
+    /**
+     * @brief Constructor for the PartGeometry class, builds the triangle index used for picking.
+     * @param polyData is the prepared geometry, it must not be modified afterwards.
+     */
+    explicit PartGeometry(vtkSmartPointer<vtkPolyData> polyData);
+
+    /**
+     * @brief Constructor for the PartGeometry class that adds levels of detail to existing geometry.
+     * @param base is the geometry, its vtkPolyData is shared rather than copied.
+     * @param levels are the decimated levels, from finest to coarsest, they must not be modified afterwards.
+     */
+    PartGeometry(const PartGeometry& base, const std::vector<Level>& levels);
+
+    /**
+     * @brief This function returns the geometry.
+     * @return a pointer to the vtkPolyData, which must be treated as read only.
+     */
+    vtkPolyData* polyData() const;
+
+    /**
+     * @brief This function creates a new actor and mapper that render this geometry.
+     * @return a smart pointer to the new vtkActor.
+     */
+    vtkSmartPointer<vtkActor> createActor() const;
+
+    /**
+     * @brief This function creates a new mapper that renders one level of detail.
+     * @param level is the level, 0 for the full geometry.
+     * @return a smart pointer to the new mapper.
+     */
+    vtkSmartPointer<vtkMapper> createMapper(int level) const;
+
+    /**
+     * @brief This function creates a cheap stand-in for the geometry, rendered while the full geometry is evicted (see ResidencyManager).
+     * @return new geometry made of the coarsest level of detail, or of the bounding box if there are no levels.
+     */
+    std::shared_ptr<const PartGeometry> createProxy() const;
+
+    /**
+     * @brief This function creates geometry made of a box, used as a stand-in while the real geometry is not available.
+     * @param bounds are xmin, xmax, ymin, ymax, zmin, zmax of the box.
+     * @return the new geometry.
+     */
+    static std::shared_ptr<const PartGeometry> createBox(const double bounds[6]);
+
+    /**
+     * @brief This function returns the number of levels of detail, including the full geometry.
+     * @return the number of levels, 1 until the decimated levels have been built.
+     */
+    int levelCount() const;
+
+    /**
+     * @brief This function returns the geometry of one level of detail.
+     * @param level is the level, 0 for the full geometry.
+     * @return a pointer to the vtkPolyData, which must be treated as read only.
+     */
+    vtkPolyData* levelData(int level) const;
+
+    /**
+     * @brief This function returns the estimated deviation of one level of detail from the full geometry.
+     * @param level is the level, 0 for the full geometry.
+     * @return the deviation in model units (0 for level 0).
+     */
+    double levelError(int level) const;
+
+    /**
+     * @brief This function returns the number of triangles of one level of detail.
+     * @param level is the level, 0 for the full geometry.
+     * @return the number of triangles.
+     */
+    vtkIdType levelTriangleCount(int level) const;
+
+    /**
+     * @brief This function returns the number of triangles.
+     * @return the number of triangles.
+     */
+    vtkIdType triangleCount() const;
+
+    /**
+     * @brief This function returns the number of vertices.
+     * @return the number of vertices.
+     */
+    vtkIdType pointCount() const;
+
+    /**
+     * @brief This function returns the bounding box of the geometry.
+     * @param bounds receives xmin, xmax, ymin, ymax, zmin, zmax.
+     */
+    void getBounds(double bounds[6]) const;
+
+    /**
+     * @brief This function returns the triangle index of the full geometry, used for exact ray picks.
+     * @return a pointer to the index, which lives as long as this geometry.
+     */
+    const TriangleBVH* pickIndex() const;
+
+    /**
+     * @brief This function returns the host memory held by the geometry, including its levels of detail.
+     * @return the size in bytes.
+     */
+    size_t hostBytes() const;
+
+    /**
+     * @brief This function estimates the GPU memory one view uses for the geometry and its levels of detail (vertex, normal and index buffers).
+     * @return the estimated size in bytes per view.
+     */
+    size_t gpuBytes() const;
+
+private:
+    vtkSmartPointer<vtkPolyData>                data;               /**< Shared, read only geometry */
+    std::vector<Level>                          levels;             /**< Decimated levels of detail, finest first */
+    std::shared_ptr<const TriangleBVH>          triangles;          /**< Triangle index of the full geometry, shared with derived geometry */
+    double                                      bounds[6];          /**< Bounding box computed at construction */
+    size_t                                      host;               /**< Host bytes held by data, the levels and the triangle index */
+};
+
+#endif
@@ -0,0 +1,195 @@
+/** @file PartTree.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Flat storage for the hierarchy and tree view data of the model parts.
+  */
+
+#include "PartTree.h"
+
+/**
+ * @brief Constructor for the PartTree class, the tree starts empty.
+ */
+PartTree::PartTree() {
+}
+
+/**
+ * @brief This function adds a node that is not yet linked to a parent.
+ * @param part is the ModelPart the node belongs to.
+ * @param name is the text of the first column.
+ * @param visible is the visibility flag shown in the second column.
+ * @return the handle of the new node.
+ */
+int PartTree::create(ModelPart* part, const QString& name, bool visible) {
+    int node = int(parents.size());
+    parents.push_back(-1);
+    rows.push_back(0);
+    children.emplace_back();
+    names.push_back(name);
+    visibility.push_back(visible ? 1 : 0);
+    /* White, like a new actor, until the part is given a colour */
+    colours.emplace_back(255, 255, 255);
+    sources.emplace_back();
+    uses.push_back(0);
+    parts.push_back(part);
+    return node;
+}
+
+/**
+ * @brief This function links a node as the last child of another.
+ * @param parent is the parent node.
+ * @param node is the node, it must not have a parent yet.
+ */
+void PartTree::append(int parent, int node) {
+    if (parents[node] != -1)
+        return;
+
+    parents[node] = parent;
+    rows[node] = int(children[parent].size());
+    children[parent].push_back(node);
+}
+
+/**
+ * @brief This function returns the number of nodes.
+ * @return the number of nodes.
+ */
+int PartTree::size() const {
+    return int(parents.size());
+}
+
+/**
+ * @brief This function returns the parent of a node.
+ * @param node is the node.
+ * @return the parent, -1 if the node has none.
+ */
+int PartTree::parent(int node) const {
+    return parents[node];
+}
+
+/**
+ * @brief This function returns the row of a node within its parent.
+ * @param node is the node.
+ * @return the row, 0 if the node has no parent.
+ */
+int PartTree::row(int node) const {
+    return rows[node];
+}
+
+/**
+ * @brief This function returns the number of children of a node.
+ * @param node is the node.
+ * @return the number of children.
+ */
+int PartTree::childCount(int node) const {
+    return int(children[node].size());
+}
+
+/**
+ * @brief This function returns the child of a node in a given row.
+ * @param node is the node.
+ * @param row is the row of the child.
+ * @return the child, -1 if the row is out of range.
+ */
+int PartTree::child(int node, int row) const {
+    const std::vector<int>& list = children[node];
+    if (row < 0 || row >= int(list.size()))
+        return -1;
+    return list[row];
+}
+
+/**
+ * @brief This function returns the ModelPart a node belongs to.
+ * @param node is the node.
+ * @return the part.
+ */
+ModelPart* PartTree::part(int node) const {
+    return parts[node];
+}
+
+/**
+ * @brief This function returns the name of a node.
+ * @param node is the node.
+ * @return the name.
+ */
+const QString& PartTree::name(int node) const {
+    return names[node];
+}
+
+/**
+ * @brief This function sets the name of a node.
+ * @param node is the node.
+ * @param name is the new name.
+ */
+void PartTree::setName(int node, const QString& name) {
+    names[node] = name;
+}
+
+/**
+ * @brief This function returns the visibility flag of a node.
+ * @param node is the node.
+ * @return true if the part is visible.
+ */
+bool PartTree::visible(int node) const {
+    return visibility[node] != 0;
+}
+
+/**
+ * @brief This function sets the visibility flag of a node.
+ * @param node is the node.
+ * @param visible is true if the part is visible.
+ */
+void PartTree::setVisible(int node, bool visible) {
+    visibility[node] = visible ? 1 : 0;
+}
+
+/**
+ * @brief This function returns the colour of a node.
+ * @param node is the node.
+ * @return the colour.
+ */
+const vtkColor3ub& PartTree::colour(int node) const {
+    return colours[node];
+}
+
+/**
+ * @brief This function sets the colour of a node.
+ * @param node is the node.
+ * @param colour is the new colour.
+ */
+void PartTree::setColour(int node, const vtkColor3ub& colour) {
+    colours[node] = colour;
+}
+
+/**
+ * @brief This function returns the file a node's geometry is read from.
+ * @param node is the node.
+ * @return the file name, empty if the geometry did not come from a file.
+ */
+const QString& PartTree::source(int node) const {
+    return sources[node];
+}
+
+/**
+ * @brief This function sets the file a node's geometry is read from.
+ * @param node is the node.
+ * @param fileName is the file name.
+ */
+void PartTree::setSource(int node, const QString& fileName) {
+    sources[node] = fileName;
+}
+
+/**
+ * @brief This function returns when a node was last shown.
+ * @param node is the node.
+ * @return the stamp given to touch(), 0 if the node has never been shown.
+ */
+uint32_t PartTree::lastUse(int node) const {
+    return uses[node];
+}
+
+/**
+ * @brief This function records that a node has been shown.
+ * @param node is the node.
+ * @param stamp is a counter that grows with time.
+ */
+void PartTree::touch(int node, uint32_t stamp) {
+    uses[node] = stamp;
+}
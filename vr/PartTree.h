@@ -0,0 +1,179 @@
+/** @file PartTree.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Flat storage for the hierarchy and tree view data of the model parts.
+  */
+
+#ifndef VIEWER_PARTTREE_H
+#define VIEWER_PARTTREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QString>
+
+#include <vtkColor.h>
+
+class ModelPart;
+
+/**
+ * @class PartTree
+ * @brief The PartTree class stores the part hierarchy as parallel arrays indexed by a node handle.
+ *
+ * Each column (parent, row, children, name, visibility, colour, source file, last use and the
+ * ModelPart that holds the rendering state) is a separate array, so walking the tree or reading one
+ * column over many parts touches contiguous memory instead of chasing a pointer per part. The row of
+ * each node within its parent is stored rather than searched for, and each node keeps a table of its
+ * children by row, so finding a node's parent, row, child count or a child by row is constant time
+ * whatever the number of siblings.
+ *
+ * Handles are indices into the arrays and stay valid for the life of the tree, nodes are never moved.
+ * The tree is only used from the GUI thread.
+ */
+class PartTree {
+public:
+    /**
+     * @brief Constructor for the PartTree class, the tree starts empty.
+     */
+    PartTree();
+
+    /**
+     * @brief This function adds a node that is not yet linked to a parent.
+     * @param part is the ModelPart the node belongs to.
+     * @param name is the text of the first column.
+     * @param visible is the visibility flag shown in the second column.
+     * @return the handle of the new node.
+     */
+    int create(ModelPart* part, const QString& name, bool visible);
+
+    /**
+     * @brief This function links a node as the last child of another.
+     * @param parent is the parent node.
+     * @param node is the node, it must not have a parent yet.
+     */
+    void append(int parent, int node);
+
+    /**
+     * @brief This function returns the number of nodes.
+     * @return the number of nodes, handles run from 0 to size() - 1.
+     */
+    int size() const;
+
+    /**
+     * @brief This function returns the parent of a node.
+     * @param node is the node.
+     * @return the parent, -1 if the node has none.
+     */
+    int parent(int node) const;
+
+    /**
+     * @brief This function returns the row of a node within its parent.
+     * @param node is the node.
+     * @return the row, 0 if the node has no parent.
+     */
+    int row(int node) const;
+
+    /**
+     * @brief This function returns the number of children of a node.
+     * @param node is the node.
+     * @return the number of children.
+     */
+    int childCount(int node) const;
+
+    /**
+     * @brief This function returns the child of a node in a given row.
+     * @param node is the node.
+     * @param row is the row of the child.
+     * @return the child, -1 if the row is out of range.
+     */
+    int child(int node, int row) const;
+
+    /**
+     * @brief This function returns the ModelPart a node belongs to.
+     * @param node is the node.
+     * @return the part.
+     */
+    ModelPart* part(int node) const;
+
+    /**
+     * @brief This function returns the name of a node.
+     * @param node is the node.
+     * @return the name.
+     */
+    const QString& name(int node) const;
+
+    /**
+     * @brief This function sets the name of a node.
+     * @param node is the node.
+     * @param name is the new name.
+     */
+    void setName(int node, const QString& name);
+
+    /**
+     * @brief This function returns the visibility flag of a node.
+     * @param node is the node.
+     * @return true if the part is visible.
+     */
+    bool visible(int node) const;
+
+    /**
+     * @brief This function sets the visibility flag of a node.
+     * @param node is the node.
+     * @param visible is true if the part is visible.
+     */
+    void setVisible(int node, bool visible);
+
+    /**
+     * @brief This function returns the colour of a node.
+     * @param node is the node.
+     * @return the colour.
+     */
+    const vtkColor3ub& colour(int node) const;
+
+    /**
+     * @brief This function sets the colour of a node.
+     * @param node is the node.
+     * @param colour is the new colour.
+     */
+    void setColour(int node, const vtkColor3ub& colour);
+
+    /**
+     * @brief This function returns the file a node's geometry is read from.
+     * @param node is the node.
+     * @return the file name, empty if the geometry did not come from a file.
+     */
+    const QString& source(int node) const;
+
+    /**
+     * @brief This function sets the file a node's geometry is read from.
+     * @param node is the node.
+     * @param fileName is the file name.
+     */
+    void setSource(int node, const QString& fileName);
+
+    /**
+     * @brief This function returns when a node was last shown.
+     * @param node is the node.
+     * @return the stamp given to touch(), 0 if the node has never been shown.
+     */
+    uint32_t lastUse(int node) const;
+
+    /**
+     * @brief This function records that a node has been shown.
+     * @param node is the node.
+     * @param stamp is a counter that grows with time.
+     */
+    void touch(int node, uint32_t stamp);
+
+private:
+    std::vector<int>                    parents;        /**< Parent of each node, -1 for none */
+    std::vector<int>                    rows;           /**< Row of each node within its parent */
+    std::vector<std::vector<int>>       children;       /**< Children of each node by row */
+    std::vector<QString>                names;          /**< First column of each node */
+    std::vector<char>                   visibility;     /**< Visibility flag of each node */
+    std::vector<vtkColor3ub>            colours;        /**< Colour of each node */
+    std::vector<QString>                sources;        /**< File each node's geometry is read from */
+    std::vector<uint32_t>               uses;           /**< When each node was last shown */
+    std::vector<ModelPart*>             parts;          /**< Part holding each node's rendering state */
+};
+
+#endif
@@ -0,0 +1,688 @@
+/** @file ProjectFile.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Binary project files holding the part tree and, optionally, the prepared geometry of the parts.
+  */
+
+#include "ProjectFile.h"
+#include "GeometryCache.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "STLLoader.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+namespace {
+
+/**
+ * @struct ProjectHeader
+ * @brief The ProjectHeader structure is at the start of every project, the table of contents follows it.
+ */
+struct ProjectHeader {
+    char        magic[8];           /**< "VRPROJ" */
+    quint32     version;            /**< Format version, projects of other versions are refused */
+    quint32     headerSize;         /**< Bytes before the table of contents */
+    quint64     fileSize;           /**< Size of the whole project */
+    quint64     sectionCount;       /**< Entries in the table of contents */
+    quint64     contentsHash;       /**< Hash of the table of contents */
+};
+
+/**
+ * @struct SectionEntry
+ * @brief The SectionEntry structure is one entry of the table of contents. Sections of unknown types are skipped.
+ */
+struct SectionEntry {
+    quint32     type;               /**< NODE_SECTION, STRING_SECTION, MESH_SECTION or GEOMETRY_SECTION */
+    quint32     reserved;           /**< Zero */
+    quint64     offset;             /**< Start of the section, 64-byte aligned */
+    quint64     size;               /**< Size of the section in bytes */
+    quint64     count;              /**< Number of records in the section */
+    quint64     hash;               /**< Hash of the section, 0 for the geometry, whose meshes carry their own */
+};
+
+enum SectionType : quint32 {
+    NODE_SECTION = 1,               /**< A NodeRecord per part, in pre-order */
+    STRING_SECTION = 2,             /**< Names and file names, UTF-8 */
+    MESH_SECTION = 3,               /**< A MeshRecord per mesh */
+    GEOMETRY_SECTION = 4            /**< The arrays of every mesh */
+};
+
+/**
+ * @struct NodeRecord
+ * @brief The NodeRecord structure holds one part. Parts follow the part they are in, in row order.
+ */
+struct NodeRecord {
+    qint32      parent;             /**< Index of the part this one is in, -1 for a top level part */
+    quint32     flags;              /**< NODE_VISIBLE */
+    quint32     nameOffset;         /**< Name in the string section */
+    quint32     nameSize;           /**< Length of the name in bytes */
+    quint32     sourceOffset;       /**< Source STL file in the string section */
+    quint32     sourceSize;         /**< Length of the file name in bytes, 0 if the part has none */
+    qint32      mesh;               /**< Index of the part's mesh, -1 if its geometry is not stored */
+    quint8      colour[4];          /**< Red, green and blue, the last byte is unused */
+    double      transform[16];      /**< Placement in the assembly, row major */
+};
+
+const quint32 NODE_VISIBLE = 1;
+
+enum MeshEncoding : quint32 {
+    FLOAT_MESH = 1,                 /**< float xyz positions and normals */
+    QUANTIZED_MESH = 2              /**< quint16 xyz positions within the bounds, qint8 xyz normals */
+};
+
+/**
+ * @struct MeshRecord
+ * @brief The MeshRecord structure describes the arrays of one mesh, which are stored one after the other in the geometry section.
+ */
+struct MeshRecord {
+    quint32     encoding;           /**< FLOAT_MESH or QUANTIZED_MESH */
+    quint32     reserved;           /**< Zero */
+    quint64     pointCount;         /**< Number of welded vertices */
+    quint64     triangleCount;      /**< Number of triangles */
+    double      bounds[6];          /**< xmin, xmax, ymin, ymax, zmin, zmax */
+    quint64     pointsOffset;       /**< Positions, the start of the mesh data */
+    quint64     normalsOffset;      /**< Normals */
+    quint64     indicesOffset;      /**< quint32 x3 per triangle */
+    quint64     dataSize;           /**< Bytes from pointsOffset to the end of the indices */
+    quint64     dataHash;           /**< Hash of those bytes, checked when the mesh is read */
+};
+
+const char      projectMagic[8] = { 'V', 'R', 'P', 'R', 'O', 'J', 0, 0 };
+const quint32   projectVersion = 1;
+const quint64   sectionAlignment = 64;
+
+/* Largest quantized position and normal component */
+const double    positionSteps = 65535.;
+const double    normalSteps = 127.;
+
+/* Mixed into the hash of a mesh to make its loader key, so it cannot match the contents hash of an STL file */
+const quint64   meshKeySalt = 0x5652505230A1B2C3ull;
+
+quint64 alignUp(quint64 offset) {
+    return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+}
+
+bool fail(QString* error, const QString& message) {
+    if (error != nullptr)
+        *error = message;
+    return false;
+}
+
+/**
+ * @brief This function places the arrays of a mesh from an aligned offset.
+ * @return the end of the mesh data.
+ */
+quint64 layOut(MeshRecord& mesh, quint64 offset) {
+    bool quantized = mesh.encoding == QUANTIZED_MESH;
+    quint64 pointBytes = mesh.pointCount * 3 * (quantized ? sizeof(quint16) : sizeof(float));
+    quint64 normalBytes = mesh.pointCount * 3 * (quantized ? sizeof(qint8) : sizeof(float));
+
+    mesh.pointsOffset = offset;
+    mesh.normalsOffset = alignUp(mesh.pointsOffset + pointBytes);
+    mesh.indicesOffset = alignUp(mesh.normalsOffset + normalBytes);
+    mesh.dataSize = mesh.indicesOffset + mesh.triangleCount * 3 * sizeof(quint32) - mesh.pointsOffset;
+    return mesh.pointsOffset + mesh.dataSize;
+}
+
+/**
+ * @brief This function checks that a mesh record describes arrays that lie within the geometry section.
+ */
+bool meshIsValid(const MeshRecord& mesh, const SectionEntry& geometry) {
+    if (mesh.encoding != FLOAT_MESH && mesh.encoding != QUANTIZED_MESH)
+        return false;
+    if (mesh.pointCount == 0 || mesh.pointCount > quint64(std::numeric_limits<qint32>::max()))
+        return false;
+    if (mesh.triangleCount == 0 || mesh.triangleCount > geometry.size / (3 * sizeof(quint32)))
+        return false;
+    if (mesh.pointsOffset % sectionAlignment != 0 || mesh.pointsOffset < geometry.offset
+        || mesh.pointsOffset > geometry.offset + geometry.size)
+        return false;
+
+    /* The layout follows from the counts, so a record that disagrees with it is damaged */
+    MeshRecord expected = mesh;
+    quint64 end = layOut(expected, mesh.pointsOffset);
+    return expected.normalsOffset == mesh.normalsOffset && expected.indicesOffset == mesh.indicesOffset
+        && expected.dataSize == mesh.dataSize && end <= geometry.offset + geometry.size;
+}
+
+/**
+ * @brief This function checks that a section lies within the project, after the table of contents.
+ */
+bool sectionIsValid(const SectionEntry& section, quint64 contentsEnd, quint64 fileSize) {
+    return section.offset % sectionAlignment == 0 && section.offset >= contentsEnd
+        && section.size <= fileSize && section.offset <= fileSize - section.size;
+}
+
+/**
+ * @brief This function returns the first section of a type in the table of contents, or nullptr.
+ */
+const SectionEntry* findSection(const std::vector<SectionEntry>& sections, quint32 type) {
+    for (const SectionEntry& section : sections) {
+        if (section.type == type)
+            return &section;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief This function checks the triangles of a mesh against its point count and gives them to a cell array.
+ * Meshes that fit use 32-bit cell storage, half the memory of the default.
+ */
+template <typename Array>
+bool setTriangles(vtkCellArray* polys, const quint32* indices, vtkIdType triangles, quint64 points) {
+    typedef typename Array::ValueType Value;
+
+    vtkNew<Array> offsets;
+    offsets->SetNumberOfValues(triangles + 1);
+    Value* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangles; i++)
+        offset[i] = Value(3 * i);
+
+    vtkNew<Array> connectivity;
+    connectivity->SetNumberOfValues(3 * triangles);
+    Value* ids = connectivity->GetPointer(0);
+    for (vtkIdType i = 0; i < 3 * triangles; i++) {
+        if (indices[i] >= points)
+            return false;
+        ids[i] = Value(indices[i]);
+    }
+
+    polys->SetData(offsets, connectivity);
+    return true;
+}
+
+/**
+ * @brief This function turns the mapped arrays of a mesh into prepared geometry.
+ * @param mesh is the mesh record.
+ * @param data is the mesh data, from its pointsOffset.
+ * @return the geometry, or nullptr if the triangles do not match the points.
+ */
+vtkSmartPointer<vtkPolyData> decodeMesh(const MeshRecord& mesh, const uchar* data) {
+    vtkIdType pointCount = vtkIdType(mesh.pointCount);
+    vtkIdType triangleCount = vtkIdType(mesh.triangleCount);
+
+    vtkNew<vtkFloatArray> points;
+    points->SetNumberOfComponents(3);
+    points->SetNumberOfTuples(pointCount);
+    float* point = points->GetPointer(0);
+
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(pointCount);
+    float* normal = normals->GetPointer(0);
+
+    const uchar* normalData = data + (mesh.normalsOffset - mesh.pointsOffset);
+    if (mesh.encoding == FLOAT_MESH) {
+        std::memcpy(point, data, size_t(pointCount) * 3 * sizeof(float));
+        std::memcpy(normal, normalData, size_t(pointCount) * 3 * sizeof(float));
+    }
+    else {
+        double step[3];
+        for (int c = 0; c < 3; c++)
+            step[c] = (mesh.bounds[2 * c + 1] - mesh.bounds[2 * c]) / positionSteps;
+
+        const quint16* positions = reinterpret_cast<const quint16*>(data);
+        const qint8* directions = reinterpret_cast<const qint8*>(normalData);
+        for (vtkIdType i = 0; i < pointCount; i++) {
+            double n[3];
+            for (int c = 0; c < 3; c++) {
+                point[3 * i + c] = float(mesh.bounds[2 * c] + step[c] * positions[3 * i + c]);
+                n[c] = directions[3 * i + c] / normalSteps;
+            }
+            /* Rounding leaves the normal slightly off unit length */
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3; c++)
+                normal[3 * i + c] = float(length > 0. ? n[c] / length : n[c]);
+        }
+    }
+
+    const quint32* indices = reinterpret_cast<const quint32*>(data + (mesh.indicesOffset - mesh.pointsOffset));
+    vtkNew<vtkCellArray> polys;
+    bool valid = 3 * triangleCount <= vtkIdType(std::numeric_limits<qint32>::max())
+        ? setTriangles<vtkTypeInt32Array>(polys, indices, triangleCount, mesh.pointCount)
+        : setTriangles<vtkIdTypeArray>(polys, indices, triangleCount, mesh.pointCount);
+    if (!valid)
+        return nullptr;
+
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(points);
+
+    vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+    polyData->SetPoints(outputPoints);
+    polyData->SetPolys(polys);
+    polyData->GetPointData()->SetNormals(normals);
+    return polyData;
+}
+
+/**
+ * @brief This function maps one mesh of a project, checks it and decodes it. It is safe to call from any thread.
+ * @param fileName is the name of the project file.
+ * @param mesh is the mesh record.
+ * @return the geometry, or nullptr if the mesh cannot be read or is damaged.
+ */
+vtkSmartPointer<vtkPolyData> readMesh(const QString& fileName, const MeshRecord& mesh) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || quint64(file.size()) < mesh.pointsOffset + mesh.dataSize)
+        return nullptr;
+
+    const uchar* data = file.map(qint64(mesh.pointsOffset), qint64(mesh.dataSize));
+    if (data == nullptr)
+        return nullptr;
+
+    vtkSmartPointer<vtkPolyData> polyData;
+    if (GeometryCache::hashData(data, qint64(mesh.dataSize)) == mesh.dataHash)
+        polyData = decodeMesh(mesh, data);
+
+    file.unmap(const_cast<uchar*>(data));
+    return polyData;
+}
+
+/**
+ * @brief This function returns the triangles of prepared geometry as 32-bit indices.
+ * @return false if the geometry has cells other than triangles.
+ */
+bool exportTriangles(vtkCellArray* polys, std::vector<quint32>& indices) {
+    if (polys->GetNumberOfCells() > 0 && polys->IsHomogeneous() != 3)
+        return false;
+
+    vtkIdType count = polys->GetNumberOfConnectivityIds();
+    indices.resize(size_t(count));
+    if (polys->IsStorage64Bit()) {
+        const vtkTypeInt64* ids = polys->GetConnectivityArray64()->GetPointer(0);
+        for (vtkIdType i = 0; i < count; i++)
+            indices[size_t(i)] = quint32(ids[i]);
+    }
+    else {
+        const vtkTypeInt32* ids = polys->GetConnectivityArray32()->GetPointer(0);
+        for (vtkIdType i = 0; i < count; i++)
+            indices[size_t(i)] = quint32(ids[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief This function writes the arrays of a mesh into a buffer that starts at its pointsOffset.
+ * @return false if the geometry cannot be stored (points or normals that are not floats, cells that are not triangles).
+ */
+bool encodeMesh(vtkPolyData* polyData, const MeshRecord& mesh, uchar* data) {
+    vtkFloatArray* points = vtkFloatArray::FastDownCast(polyData->GetPoints()->GetData());
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(polyData->GetPointData()->GetNormals());
+    const float* point = points->GetPointer(0);
+    const float* normal = normals->GetPointer(0);
+    vtkIdType pointCount = vtkIdType(mesh.pointCount);
+
+    uchar* normalData = data + (mesh.normalsOffset - mesh.pointsOffset);
+    if (mesh.encoding == FLOAT_MESH) {
+        std::memcpy(data, point, size_t(pointCount) * 3 * sizeof(float));
+        std::memcpy(normalData, normal, size_t(pointCount) * 3 * sizeof(float));
+    }
+    else {
+        double scale[3];
+        for (int c = 0; c < 3; c++) {
+            double extent = mesh.bounds[2 * c + 1] - mesh.bounds[2 * c];
+            scale[c] = extent > 0. ? positionSteps / extent : 0.;
+        }
+
+        quint16* positions = reinterpret_cast<quint16*>(data);
+        qint8* directions = reinterpret_cast<qint8*>(normalData);
+        for (vtkIdType i = 0; i < pointCount; i++) {
+            for (int c = 0; c < 3; c++) {
+                double q = std::round((point[3 * i + c] - mesh.bounds[2 * c]) * scale[c]);
+                positions[3 * i + c] = quint16(std::min(std::max(q, 0.), positionSteps));
+                double n = std::round(std::min(std::max(double(normal[3 * i + c]), -1.), 1.) * normalSteps);
+                directions[3 * i + c] = qint8(n);
+            }
+        }
+    }
+
+    std::vector<quint32> indices;
+    if (!exportTriangles(polyData->GetPolys(), indices) || indices.size() != mesh.triangleCount * 3)
+        return false;
+    std::memcpy(data + (mesh.indicesOffset - mesh.pointsOffset), indices.data(), indices.size() * sizeof(quint32));
+    return true;
+}
+
+/**
+ * @brief This function tells whether geometry can be stored in a project: float points and normals, triangles only.
+ */
+bool canStore(vtkPolyData* polyData) {
+    if (polyData == nullptr || polyData->GetPoints() == nullptr || polyData->GetPolys() == nullptr)
+        return false;
+
+    vtkFloatArray* points = vtkFloatArray::FastDownCast(polyData->GetPoints()->GetData());
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(polyData->GetPointData()->GetNormals());
+    vtkIdType pointCount = polyData->GetNumberOfPoints();
+    return points != nullptr && normals != nullptr && normals->GetNumberOfTuples() == pointCount
+        && pointCount > 0 && pointCount <= vtkIdType(std::numeric_limits<qint32>::max())
+        && polyData->GetNumberOfPolys() > 0 && polyData->GetNumberOfCells() == polyData->GetNumberOfPolys()
+        && polyData->GetPolys()->IsHomogeneous() == 3;
+}
+
+/**
+ * @brief This function adds a string to the string section.
+ */
+void addString(QByteArray& strings, const QString& text, quint32& offset, quint32& size) {
+    QByteArray utf8 = text.toUtf8();
+    offset = quint32(strings.size());
+    size = quint32(utf8.size());
+    strings.append(utf8);
+}
+
+}
+
+
+/**
+ * @brief This function saves every part of a tree to a project file.
+ * The parts are written in pre-order, so each part follows the part it is in. Rows that a view has
+ * not fetched yet (see ModelPartList::appendLater()) are made into parts first, so they are saved too.
+ * @param fileName is the name of the project file, it is replaced only once it has been written in full.
+ * @param model is the tree.
+ * @param geometry is how the geometry of the parts is stored.
+ * @param complete if set, returns false for parts that show a stand-in (a preview or a proxy), their geometry is not stored.
+ * @param error if not null, receives a description of the problem when the project cannot be saved.
+ * @return true if the project was saved.
+ */
+bool ProjectFile::save(const QString& fileName, ModelPartList* model, Geometry geometry,
+                       const std::function<bool(ModelPart*)>& complete, QString* error) {
+    std::vector<NodeRecord> nodes;
+    QByteArray strings;
+    std::vector<MeshRecord> meshes;
+    std::vector<vtkSmartPointer<vtkPolyData>> meshData;
+    QHash<vtkPolyData*, int> meshIndex;
+    quint32 encoding = geometry == QUANTIZED_GEOMETRY ? QUANTIZED_MESH : FLOAT_MESH;
+
+    std::vector<std::pair<ModelPart*, int>> stack;
+    auto pushChildren = [&stack, model](ModelPart* part, int index) {
+        QModelIndex item = index < 0 ? QModelIndex() : model->indexOf(part);
+        while (model->canFetchMore(item))
+            model->fetchMore(item);
+        for (int row = part->childCount() - 1; row >= 0; row--)
+            stack.push_back({ part->child(row), index });
+    };
+    pushChildren(model->getRootItem(), -1);
+
+    while (!stack.empty()) {
+        ModelPart* part = stack.back().first;
+        int parent = stack.back().second;
+        stack.pop_back();
+
+        NodeRecord node;
+        std::memset(&node, 0, sizeof(node));
+        node.parent = parent;
+        node.flags = part->visible() ? NODE_VISIBLE : 0;
+        addString(strings, part->data(0).toString(), node.nameOffset, node.nameSize);
+        addString(strings, part->getFileName(), node.sourceOffset, node.sourceSize);
+        node.colour[0] = part->getColourR();
+        node.colour[1] = part->getColourG();
+        node.colour[2] = part->getColourB();
+        part->getTransform(node.transform);
+        node.mesh = -1;
+
+        /* Copies of a file share their geometry, and so one mesh */
+        std::shared_ptr<const PartGeometry> shown = part->getGeometry();
+        if (geometry != NO_GEOMETRY && shown != nullptr && (!complete || complete(part))) {
+            vtkPolyData* polyData = shown->polyData();
+            auto it = meshIndex.find(polyData);
+            if (it != meshIndex.end()) {
+                node.mesh = it.value();
+            }
+            else if (canStore(polyData)) {
+                MeshRecord mesh;
+                std::memset(&mesh, 0, sizeof(mesh));
+                mesh.encoding = encoding;
+                mesh.pointCount = quint64(polyData->GetNumberOfPoints());
+                mesh.triangleCount = quint64(polyData->GetNumberOfPolys());
+                polyData->GetBounds(mesh.bounds);
+
+                node.mesh = qint32(meshes.size());
+                meshIndex.insert(polyData, node.mesh);
+                meshes.push_back(mesh);
+                meshData.push_back(polyData);
+            }
+        }
+
+        int index = int(nodes.size());
+        nodes.push_back(node);
+        pushChildren(part, index);
+    }
+
+    if (quint64(strings.size()) > quint64(std::numeric_limits<quint32>::max()))
+        return fail(error, QString("The names of the parts are too long to be saved."));
+
+    /* The layout is fixed before anything is written: header, table of contents, then each section */
+    const int sectionCount = 4;
+    ProjectHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, projectMagic, sizeof(projectMagic));
+    header.version = projectVersion;
+    header.headerSize = quint32(alignUp(sizeof(ProjectHeader)));
+    header.sectionCount = sectionCount;
+
+    SectionEntry sections[sectionCount];
+    std::memset(sections, 0, sizeof(sections));
+    sections[0] = { NODE_SECTION, 0, 0, nodes.size() * sizeof(NodeRecord), nodes.size(), 0 };
+    sections[1] = { STRING_SECTION, 0, 0, quint64(strings.size()), 0, 0 };
+    sections[2] = { MESH_SECTION, 0, 0, meshes.size() * sizeof(MeshRecord), meshes.size(), 0 };
+    sections[3] = { GEOMETRY_SECTION, 0, 0, 0, meshes.size(), 0 };
+
+    quint64 offset = alignUp(header.headerSize + sizeof(sections));
+    for (int i = 0; i < 3; i++) {
+        sections[i].offset = offset;
+        offset = alignUp(offset + sections[i].size);
+    }
+    sections[3].offset = offset;
+    for (MeshRecord& mesh : meshes)
+        offset = alignUp(layOut(mesh, offset));
+    sections[3].size = offset - sections[3].offset;
+    header.fileSize = offset;
+
+    /* QSaveFile writes a temporary file and renames it, so an existing project is only replaced by a complete one */
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, QString("Cannot write %1: %2").arg(fileName, file.errorString()));
+
+    /* The meshes are written first, one at a time, so their checksums are known when the mesh table is written */
+    bool written = file.seek(qint64(sections[3].offset));
+    for (size_t i = 0; i < meshes.size() && written; i++) {
+        MeshRecord& mesh = meshes[i];
+        quint64 end = i + 1 < meshes.size() ? meshes[i + 1].pointsOffset : header.fileSize;
+        QByteArray buffer(qsizetype(end - mesh.pointsOffset), '\0');
+        uchar* data = reinterpret_cast<uchar*>(buffer.data());
+        if (!encodeMesh(meshData[i], mesh, data)) {
+            file.cancelWriting();
+            return fail(error, QString("The geometry of a part could not be saved."));
+        }
+        mesh.dataHash = GeometryCache::hashData(data, qint64(mesh.dataSize));
+        written = file.write(buffer) == buffer.size();
+    }
+
+    QByteArray front(qsizetype(sections[3].offset), '\0');
+    uchar* data = reinterpret_cast<uchar*>(front.data());
+    std::memcpy(data + sections[0].offset, nodes.data(), size_t(sections[0].size));
+    std::memcpy(data + sections[1].offset, strings.constData(), size_t(sections[1].size));
+    std::memcpy(data + sections[2].offset, meshes.data(), size_t(sections[2].size));
+    for (int i = 0; i < 3; i++)
+        sections[i].hash = GeometryCache::hashData(data + sections[i].offset, qint64(sections[i].size));
+
+    std::memcpy(data + header.headerSize, sections, sizeof(sections));
+    header.contentsHash = GeometryCache::hashData(data + header.headerSize, qint64(sizeof(sections)));
+    std::memcpy(data, &header, sizeof(header));
+
+    written = written && file.seek(0) && file.write(front) == front.size();
+    if (!written || !file.commit()) {
+        QString reason = file.errorString();
+        file.cancelWriting();
+        return fail(error, QString("Cannot write %1: %2").arg(fileName, reason));
+    }
+    return true;
+}
+
+/**
+ * @brief This function adds the parts of a project file to a tree and queues their geometry on a loader.
+ * Only the header, the table of contents and the small sections are read here, each mesh is mapped
+ * and checked by the loader's worker when its turn comes. The rows of each part are added in one
+ * insertion per parent.
+ * @param fileName is the name of the project file.
+ * @param model is the tree.
+ * @param parent is the item the top level parts of the project are added under, invalid for the root.
+ * @param loader is the loader that makes the geometry of the parts, or nullptr to only add the rows.
+ * @param error if not null, receives a description of the problem when the project cannot be opened.
+ * @return true if the project was opened, nothing is added to the tree otherwise.
+ */
+bool ProjectFile::open(const QString& fileName, ModelPartList* model, const QModelIndex& parent, STLLoader* loader,
+                       QString* error) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(error, QString("Cannot open %1: %2").arg(fileName, file.errorString()));
+
+    qint64 size = file.size();
+    const uchar* data = size >= qint64(sizeof(ProjectHeader)) ? file.map(0, size) : nullptr;
+    if (data == nullptr)
+        return fail(error, QString("%1 is not a project file.").arg(fileName));
+
+    /* Validate before trusting any offset */
+    ProjectHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, projectMagic, sizeof(projectMagic)) != 0) {
+        file.unmap(const_cast<uchar*>(data));
+        return fail(error, QString("%1 is not a project file.").arg(fileName));
+    }
+    if (header.version != projectVersion) {
+        file.unmap(const_cast<uchar*>(data));
+        return fail(error, QString("%1 was saved by another version of the program.").arg(fileName));
+    }
+
+    quint64 fileSize = quint64(size);
+    bool valid = header.fileSize == fileSize && header.headerSize >= sizeof(ProjectHeader)
+        && header.headerSize <= fileSize && header.sectionCount <= (fileSize - header.headerSize) / sizeof(SectionEntry);
+    quint64 contentsEnd = valid ? header.headerSize + header.sectionCount * sizeof(SectionEntry) : 0;
+    valid = valid && GeometryCache::hashData(data + header.headerSize, qint64(contentsEnd - header.headerSize)) == header.contentsHash;
+
+    std::vector<SectionEntry> sections(valid ? size_t(header.sectionCount) : 0);
+    if (valid)
+        std::memcpy(sections.data(), data + header.headerSize, sections.size() * sizeof(SectionEntry));
+
+    const SectionEntry* nodeSection = findSection(sections, NODE_SECTION);
+    const SectionEntry* stringSection = findSection(sections, STRING_SECTION);
+    const SectionEntry* meshSection = findSection(sections, MESH_SECTION);
+    const SectionEntry* geometrySection = findSection(sections, GEOMETRY_SECTION);
+    valid = valid && nodeSection != nullptr && stringSection != nullptr;
+
+    /* The geometry is checked mesh by mesh when it is read, the other sections now */
+    for (const SectionEntry* section : { nodeSection, stringSection, meshSection, geometrySection }) {
+        if (!valid || section == nullptr)
+            continue;
+        valid = sectionIsValid(*section, contentsEnd, fileSize)
+            && (section == geometrySection || GeometryCache::hashData(data + section->offset, qint64(section->size)) == section->hash);
+    }
+    valid = valid && nodeSection->size == nodeSection->count * sizeof(NodeRecord)
+        && (meshSection == nullptr || meshSection->size == meshSection->count * sizeof(MeshRecord));
+
+    std::vector<NodeRecord> nodes;
+    std::vector<MeshRecord> meshes;
+    QByteArray strings;
+    if (valid) {
+        nodes.resize(size_t(nodeSection->count));
+        std::memcpy(nodes.data(), data + nodeSection->offset, size_t(nodeSection->size));
+        strings = QByteArray(reinterpret_cast<const char*>(data + stringSection->offset), qsizetype(stringSection->size));
+        if (meshSection != nullptr) {
+            meshes.resize(size_t(meshSection->count));
+            std::memcpy(meshes.data(), data + meshSection->offset, size_t(meshSection->size));
+        }
+    }
+
+    file.unmap(const_cast<uchar*>(data));
+    file.close();
+
+    for (size_t i = 0; i < nodes.size() && valid; i++) {
+        const NodeRecord& node = nodes[i];
+        valid = node.parent >= -1 && node.parent < qint32(i) && node.mesh >= -1 && node.mesh < qint32(meshes.size())
+            && quint64(node.nameOffset) + node.nameSize <= quint64(strings.size())
+            && quint64(node.sourceOffset) + node.sourceSize <= quint64(strings.size());
+    }
+    if (!valid)
+        return fail(error, QString("%1 is damaged.").arg(fileName));
+
+    /* A damaged mesh table entry only costs its parts their stored geometry, they are read from their STL files instead */
+    std::vector<bool> meshValid(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+        meshValid[i] = geometrySection != nullptr && meshIsValid(meshes[i], *geometrySection);
+
+    std::vector<std::vector<int>> children(nodes.size());
+    std::vector<int> top;
+    for (size_t i = 0; i < nodes.size(); i++)
+        (nodes[i].parent < 0 ? top : children[size_t(nodes[i].parent)]).push_back(int(i));
+
+    std::vector<ModelPart*> parts(nodes.size(), nullptr);
+    auto addRows = [&](const QModelIndex& index, const std::vector<int>& members) {
+        QList<QList<QVariant>> rows;
+        rows.reserve(qsizetype(members.size()));
+        for (int member : members) {
+            const NodeRecord& node = nodes[size_t(member)];
+            QString name = QString::fromUtf8(strings.constData() + node.nameOffset, qsizetype(node.nameSize));
+            rows.append({ name, QString((node.flags & NODE_VISIBLE) != 0 ? "true" : "false") });
+        }
+        QList<ModelPart*> made = model->appendChildren(index, rows);
+        for (size_t k = 0; k < members.size(); k++)
+            parts[size_t(members[k])] = made[qsizetype(k)];
+    };
+
+    /* Parents come before their children, so each part exists by the time its children are added */
+    addRows(parent, top);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!children[i].empty())
+            addRows(model->indexOf(parts[i]), children[i]);
+    }
+
+    QString path = QFileInfo(fileName).absoluteFilePath();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const NodeRecord& node = nodes[i];
+        ModelPart* part = parts[i];
+        QString source = QString::fromUtf8(strings.constData() + node.sourceOffset, qsizetype(node.sourceSize));
+
+        part->setColour(node.colour[0], node.colour[1], node.colour[2]);
+        part->setTransform(node.transform);
+        if (!source.isEmpty())
+            part->setFileName(source);
+
+        if (loader == nullptr)
+            continue;
+
+        if (node.mesh >= 0 && meshValid[size_t(node.mesh)]) {
+            MeshRecord mesh = meshes[size_t(node.mesh)];
+            loader->load(part, mesh.dataHash ^ meshKeySalt, [path, mesh, source]() {
+                vtkSmartPointer<vtkPolyData> polyData = readMesh(path, mesh);
+                if (polyData == nullptr && !source.isEmpty()) {
+                    qDebug() << "Damaged mesh in" << path << "reading" << source;
+                    polyData = STLLoader::readGeometry(source);
+                }
+                return polyData;
+            });
+        }
+        else if (!source.isEmpty()) {
+            loader->load(part, source);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+/** @file ProjectFile.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Binary project files holding the part tree and, optionally, the prepared geometry of the parts.
+  */
+
+#ifndef VIEWER_PROJECTFILE_H
+#define VIEWER_PROJECTFILE_H
+
+#include <QModelIndex>
+#include <QString>
+
+#include <functional>
+
+class ModelPart;
+class ModelPartList;
+class STLLoader;
+
+/**
+ * @class ProjectFile
+ * @brief The ProjectFile class saves the whole part tree to a binary project file and adds it back to a tree.
+ *
+ * A project records every part's place in the tree, name, visibility, colour, transform and source
+ * STL file, and can also hold the prepared geometry of the parts, so opening it maps the file rather
+ * than parsing STL files again. The file starts with a header and a table of contents that gives the
+ * offset, size and checksum of each section: the parts, their strings, the mesh table and the geometry.
+ * Sections are 64-byte aligned and each mesh is stored as flat arrays, so it is read by mapping its
+ * range of the file. Geometry can be stored exactly as loaded, or quantized: positions as 16-bit
+ * fractions of the mesh bounds and normals as 8-bit components. Parts that are copies of one file
+ * share one mesh in the project, as they share it when loaded.
+ *
+ * Opening a project adds the rows straight away and queues the meshes on the STLLoader, which maps
+ * and checks them on its workers and builds their triangle indices and levels of detail like any
+ * file it reads. A mesh that turns out to be damaged is read from its source STL file instead, and
+ * so are parts saved without geometry.
+ */
+class ProjectFile {
+public:
+    /**
+     * @brief How the geometry of the parts is stored.
+     */
+    enum Geometry {
+        NO_GEOMETRY,            /**< Only the tree, the parts are read from their STL files when the project is opened */
+        FULL_GEOMETRY,          /**< The prepared geometry exactly as loaded, 32-bit floats */
+        QUANTIZED_GEOMETRY      /**< 16-bit positions within the mesh bounds and 8-bit normals */
+    };
+
+    /**
+     * @brief This function saves every part of a tree to a project file.
+     * @param fileName is the name of the project file, it is replaced only once it has been written in full.
+     * @param model is the tree.
+     * @param geometry is how the geometry of the parts is stored.
+     * @param complete if set, returns false for parts that show a stand-in (a preview or a proxy), their geometry is not stored.
+     * @param error if not null, receives a description of the problem when the project cannot be saved.
+     * @return true if the project was saved.
+     */
+    static bool save(const QString& fileName, ModelPartList* model, Geometry geometry,
+                     const std::function<bool(ModelPart*)>& complete = nullptr, QString* error = nullptr);
+
+    /**
+     * @brief This function adds the parts of a project file to a tree and queues their geometry on a loader.
+     * @param fileName is the name of the project file.
+     * @param model is the tree.
+     * @param parent is the item the top level parts of the project are added under, invalid for the root.
+     * @param loader is the loader that makes the geometry of the parts, or nullptr to only add the rows.
+     * @param error if not null, receives a description of the problem when the project cannot be opened.
+     * @return true if the project was opened, nothing is added to the tree otherwise.
+     */
+    static bool open(const QString& fileName, ModelPartList* model, const QModelIndex& parent, STLLoader* loader,
+                     QString* error = nullptr);
+};
+
+#endif
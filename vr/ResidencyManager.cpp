@@ -0,0 +1,221 @@
+/** @file ResidencyManager.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Keeps the parts' geometry within a host and GPU memory budget.
+  */
+
+#include "ResidencyManager.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/* A proxy part is only reloaded if the budget still has this much room left afterwards */
+const double RELOAD_HEADROOM = 0.9;
+
+/* A part the manager may evict or reload */
+struct Candidate {
+    ModelPart*  part;
+    double      importance;
+    uint32_t    shown;
+};
+
+}
+
+/**
+ * @brief Constructor for the ResidencyManager class, there is no budget until setBudget() is called.
+ * @param model is the part tree to manage.
+ * @param parent is a pointer to the parent QObject.
+ */
+ResidencyManager::ResidencyManager(ModelPartList* model, QObject* parent)
+    : QObject(parent), model(model), stats() {
+}
+
+/**
+ * @brief This function sets the memory budget, it applies at the next update().
+ * @param hostBytes is the host budget in bytes, 0 for no limit.
+ * @param gpuBytes is the GPU budget in bytes, 0 for no limit.
+ */
+void ResidencyManager::setBudget(size_t hostBytes, size_t gpuBytes) {
+    stats.hostBudget = hostBytes;
+    stats.gpuBudget = gpuBytes;
+}
+
+/**
+ * @brief This function sets how the importance of parts is measured.
+ * @param importance is the function.
+ */
+void ResidencyManager::setImportance(const Importance& importance) {
+    this->importance = importance;
+}
+
+/**
+ * @brief This function evicts or reloads geometry to meet the budget and updates the counters.
+ */
+void ResidencyManager::update() {
+    /* A part given other geometry since the last update has been reloaded */
+    for (auto it = proxies.begin(); it != proxies.end();) {
+        if (it.key()->getGeometry().get() != it->geometry)
+            it = proxies.erase(it);
+        else
+            ++it;
+    }
+
+    /* One flat pass over the tree for the totals and the parts that can change state. Copies of a
+     * file share their geometry, so each geometry is counted once, with the number of parts holding it */
+    std::vector<Candidate> full, proxied;
+    std::unordered_map<const vtkPolyData*, int> holders;
+    size_t host = 0, gpu = 0;
+    int loaded = 0;
+    const PartTree* tree = model->getRootItem()->getTree();
+    for (int node = 0; node < tree->size(); node++) {
+        ModelPart* part = tree->part(node);
+        if (part->getGeometry() == nullptr)
+            continue;
+
+        loaded++;
+        if (holders[part->getGeometry()->polyData()]++ == 0) {
+            host += part->hostBytes();
+            gpu += part->gpuBytes();
+        }
+        if (part->getFileName().isEmpty())
+            continue;
+
+        Candidate candidate = { part, importance ? importance(part) : 1., part->lastShown() };
+        if (proxies.contains(part))
+            proxied.push_back(candidate);
+        else
+            full.push_back(candidate);
+    }
+
+    auto fits = [this](size_t hostBytes, size_t gpuBytes, double fraction) {
+        return (stats.hostBudget == 0 || double(hostBytes) <= fraction * double(stats.hostBudget)) &&
+               (stats.gpuBudget == 0 || double(gpuBytes) <= fraction * double(stats.gpuBudget));
+    };
+
+    /* Over budget: the parts that matter least give up their full geometry */
+    QList<ModelPart*> replaced;
+    if (!fits(host, gpu, 1.)) {
+        std::sort(full.begin(), full.end(), [](const Candidate& a, const Candidate& b) {
+            if (a.importance != b.importance)
+                return a.importance < b.importance;
+            return a.shown < b.shown;
+        });
+
+        for (const Candidate& candidate : full) {
+            if (fits(host, gpu, 1.))
+                break;
+
+            ModelPart* part = candidate.part;
+            std::shared_ptr<const PartGeometry> geometry = part->getGeometry();
+            size_t fullHost = part->hostBytes();
+            size_t fullGpu = part->gpuBytes();
+            size_t views = geometry->gpuBytes() > 0 ? std::max<size_t>(fullGpu / geometry->gpuBytes(), 1) : 1;
+
+            std::shared_ptr<const PartGeometry> proxy = geometry->createProxy();
+            part->setGeometry(proxy);
+            proxies.insert(part, { proxy.get(), geometry->polyData(), fullHost, fullGpu, false });
+            replaced.append(part);
+            stats.evictions++;
+
+            /* Memory is only freed by the last part holding the geometry */
+            if (--holders[geometry->polyData()] == 0) {
+                host -= fullHost;
+                gpu -= fullGpu;
+            }
+            if (holders[proxy->polyData()]++ == 0) {
+                host += proxy->hostBytes();
+                gpu += proxy->gpuBytes() * views;
+            }
+        }
+    }
+
+    /* Under budget: the proxies that matter most come back while there is room to spare */
+    QList<ModelPart*> reloads;
+    if (replaced.isEmpty() && !proxied.empty()) {
+        std::sort(proxied.begin(), proxied.end(), [](const Candidate& a, const Candidate& b) {
+            if (a.importance != b.importance)
+                return a.importance > b.importance;
+            return a.shown > b.shown;
+        });
+
+        for (const Candidate& candidate : proxied) {
+            if (candidate.importance <= 0.)
+                break;
+
+            Proxy& proxy = proxies[candidate.part];
+            if (proxy.reloading)
+                continue;
+
+            /* A copy whose geometry another part still holds comes back for free */
+            const vtkPolyData* proxyData = candidate.part->getGeometry()->polyData();
+            bool lastProxy = holders[proxyData] == 1;
+            bool shared = holders[proxy.full] > 0;
+            size_t reloadHost = host - (lastProxy ? candidate.part->hostBytes() : 0) + (shared ? 0 : proxy.fullHost);
+            size_t reloadGpu = gpu - (lastProxy ? candidate.part->gpuBytes() : 0) + (shared ? 0 : proxy.fullGpu);
+            if (!fits(reloadHost, reloadGpu, RELOAD_HEADROOM))
+                continue;
+
+            host = reloadHost;
+            gpu = reloadGpu;
+            holders[proxyData]--;
+            holders[proxy.full]++;
+            proxy.reloading = true;
+            reloads.append(candidate.part);
+            stats.reloads++;
+        }
+    }
+
+    if (!replaced.isEmpty()) {
+        ModelPartList::DeferredUpdates deferred(model);
+        for (ModelPart* part : replaced)
+            model->updatePart(part);
+    }
+
+    stats.hostBytes = host;
+    stats.gpuBytes = gpu;
+    stats.proxyParts = int(proxies.size());
+    stats.fullParts = loaded - stats.proxyParts;
+
+    if (!replaced.isEmpty())
+        emit geometryReplaced(replaced);
+    if (!reloads.isEmpty())
+        emit reloadRequested(reloads);
+    emit countersChanged();
+}
+
+/**
+ * @brief This function checks if a part is rendering a proxy, or did until its full geometry was reloaded since the last update().
+ * @param part is the part.
+ * @return true if the part's full geometry was evicted.
+ */
+bool ResidencyManager::isProxy(ModelPart* part) const {
+    return proxies.contains(part);
+}
+
+/**
+ * @brief This function tells the manager that the full geometry of parts could not be read, a later update() may ask for it again.
+ * @param parts are the parts whose load failed.
+ */
+void ResidencyManager::reloadFailed(const QList<ModelPart*>& parts) {
+    for (ModelPart* part : parts) {
+        auto it = proxies.find(part);
+        if (it == proxies.end() || !it->reloading)
+            continue;
+
+        it->reloading = false;
+        stats.reloads--;
+    }
+}
+
+/**
+ * @brief This function returns the figures of the last update().
+ * @return the counters.
+ */
+const ResidencyManager::Counters& ResidencyManager::counters() const {
+    return stats;
+}
@@ -0,0 +1,148 @@
+/** @file ResidencyManager.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Keeps the parts' geometry within a host and GPU memory budget.
+  */
+
+#ifndef VIEWER_RESIDENCYMANAGER_H
+#define VIEWER_RESIDENCYMANAGER_H
+
+#include "PartGeometry.h"
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+
+#include <functional>
+
+class ModelPart;
+class ModelPartList;
+
+/**
+ * @class ResidencyManager
+ * @brief The ResidencyManager class swaps the full geometry of the parts that matter least for
+ * cheap proxies when the parts' memory goes over budget, and asks for it back when they matter again.
+ *
+ * Each update() adds up the host and estimated GPU bytes of every part in the tree. While either
+ * is over its budget the full geometry of parts is replaced by a proxy (the coarsest level of
+ * detail, or the bounding box, see PartGeometry::createProxy()): hidden and culled parts first,
+ * then the parts that look smallest on screen, then the parts the tree view showed longest ago.
+ * A proxy part whose importance rises again is reloaded from its file (usually straight from the
+ * GeometryCache) once its full size fits in the budget with some room to spare, so parts do not
+ * bounce between the two states. A reload that fails is passed to reloadFailed(), and the part keeps
+ * its proxy until a later update() asks for it again. Parts without a source file are never evicted. Copies of a file
+ * share one geometry, which is counted once and only freed once every copy has been evicted.
+ *
+ * How much a part matters is given by an importance function, so the manager can be run without
+ * any view (with a fake budget and synthetic parts) as well as from the desktop view, which
+ * reports each part's size on screen. It is only used from the GUI thread.
+ */
+class ResidencyManager : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @struct Counters
+     * @brief The Counters structure holds the figures shown to the user.
+     */
+    struct Counters {
+        size_t      hostBytes;      /**< Host memory of all parts' geometry */
+        size_t      gpuBytes;       /**< Estimated GPU memory of all parts' geometry, over all views */
+        size_t      hostBudget;     /**< Host budget, 0 for no limit */
+        size_t      gpuBudget;      /**< GPU budget, 0 for no limit */
+        int         fullParts;      /**< Parts rendering their full geometry */
+        int         proxyParts;     /**< Parts rendering a proxy */
+        int         evictions;      /**< Parts swapped for a proxy since the manager was created */
+        int         reloads;        /**< Parts reloaded since the manager was created */
+    };
+
+    /**
+     * @brief Type of the function that tells how much a part matters to the views.
+     * It returns 0 for a part that is not seen (hidden or culled) and larger values for parts that are
+     * seen larger, e.g. the part's height on screen in pixels.
+     */
+    typedef std::function<double(ModelPart* part)> Importance;
+
+    /**
+     * @brief Constructor for the ResidencyManager class, there is no budget until setBudget() is called.
+     * @param model is the part tree to manage.
+     * @param parent is a pointer to the parent QObject.
+     */
+    explicit ResidencyManager(ModelPartList* model, QObject* parent = nullptr);
+
+    /**
+     * @brief This function sets the memory budget, it applies at the next update().
+     * @param hostBytes is the host budget in bytes, 0 for no limit.
+     * @param gpuBytes is the GPU budget in bytes, 0 for no limit.
+     */
+    void setBudget(size_t hostBytes, size_t gpuBytes);
+
+    /**
+     * @brief This function sets how the importance of parts is measured, by default every part matters equally.
+     * @param importance is the function.
+     */
+    void setImportance(const Importance& importance);
+
+    /**
+     * @brief This function evicts or reloads geometry to meet the budget and updates the counters.
+     * Evicted parts are given their proxy straight away, see geometryReplaced(); reloads are asked for with reloadRequested().
+     */
+    void update();
+
+    /**
+     * @brief This function checks if a part is rendering a proxy, or did until its full geometry was reloaded since the last update().
+     * @param part is the part.
+     * @return true if the part's full geometry was evicted.
+     */
+    bool isProxy(ModelPart* part) const;
+
+    /**
+     * @brief This function tells the manager that the full geometry of parts could not be read, a later update() may ask for it again.
+     * Parts that were not being reloaded are ignored.
+     * @param parts are the parts whose load failed.
+     */
+    void reloadFailed(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This function returns the figures of the last update().
+     * @return the counters.
+     */
+    const Counters& counters() const;
+
+signals:
+    /**
+     * @brief This signal is emitted when parts have been given a proxy, views that keep their own actors must recreate them.
+     * @param parts are the parts.
+     */
+    void geometryReplaced(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This signal is emitted when proxy parts should have their full geometry read again, from ModelPart::getFileName().
+     * @param parts are the parts.
+     */
+    void reloadRequested(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This signal is emitted at the end of every update().
+     */
+    void countersChanged();
+
+private:
+    /**
+     * @struct Proxy
+     * @brief The Proxy structure remembers a part whose full geometry was evicted.
+     */
+    struct Proxy {
+        const PartGeometry*     geometry;       /**< Proxy given to the part, another pointer means the part was reloaded */
+        const vtkPolyData*      full;           /**< Full geometry the part held, which copies of it may still hold */
+        size_t                  fullHost;       /**< Host bytes of the full geometry */
+        size_t                  fullGpu;        /**< GPU bytes of the full geometry, over all views */
+        bool                    reloading;      /**< True once a reload has been asked for, until it succeeds or fails */
+    };
+
+    ModelPartList*                              model;          /**< Part tree */
+    Importance                                  importance;     /**< Measure of how much a part matters */
+    QHash<ModelPart*, Proxy>                    proxies;        /**< Parts rendering a proxy */
+    Counters                                    stats;          /**< Figures of the last update */
+};
+
+#endif
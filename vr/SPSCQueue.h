@@ -0,0 +1,100 @@
+/** @file SPSCQueue.h
+  * @brief EEEE2046 - Software Engineering & VR Project
+  * Lock-free single-producer / single-consumer ring buffer.
+  */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @class SPSCQueue
+ * @brief The SPSCQueue class is a fixed size ring buffer that one thread pushes to and one other thread pops from, without locks.
+ *
+ * The producer only writes the tail index and the consumer only writes the head index, each
+ * publishes with a release store and reads the other's index with an acquire load. Each side
+ * keeps a cached copy of the other's index so the shared cache lines are only read when the
+ * queue looks full (producer) or empty (consumer).
+ *
+ * @tparam T is the element type, it must be default constructible and move assignable.
+ * @tparam Capacity is the number of slots, it must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+public:
+    /**
+     * @brief Constructor for the SPSCQueue class.
+     */
+    SPSCQueue() : head(0), tail(0), cachedHead(0), cachedTail(0) {}
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    /**
+     * @brief This function adds an element, it must only be called from the producer thread.
+     * @param value is the element to add.
+     * @return false if the queue is full (nothing is added).
+     */
+    bool push(T value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == Capacity)
+                return false;
+        }
+
+        slots[t & (Capacity - 1)] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief This function removes the oldest element, it must only be called from the consumer thread.
+     * @param value receives the element.
+     * @return false if the queue is empty.
+     */
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+
+        /* Leave the slot empty so it does not keep resources alive until it is reused */
+        value = std::move(slots[h & (Capacity - 1)]);
+        slots[h & (Capacity - 1)] = T();
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief This function returns the number of elements waiting, it is exact only when both threads are idle.
+     * @return the approximate number of elements.
+     */
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief This function returns the number of slots.
+     * @return the capacity.
+     */
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+private:
+    alignas(64) std::atomic<size_t>     head;           /**< Next slot to pop, written by the consumer */
+    alignas(64) std::atomic<size_t>     tail;           /**< Next slot to push, written by the producer */
+    alignas(64) size_t                  cachedHead;     /**< Producer's copy of head */
+    alignas(64) size_t                  cachedTail;     /**< Consumer's copy of tail */
+    alignas(64) T                       slots[Capacity]; /**< Ring buffer storage */
+};
+
+#endif
@@ -0,0 +1,658 @@
+/** @file STLLoader.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Background loader that reads STL files on a pool of worker threads.
+  */
+
+#include "STLLoader.h"
+#include "ModelPart.h"
+#include "FastSTLReader.h"
+#include "MeshPreparation.h"
+#include "GeometryCache.h"
+
+#include <QFileInfo>
+#include <QThread>
+#include <QRunnable>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QDebug>
+
+/**
+ * @class STLLoadTask
+ * @brief The STLLoadTask class is the unit of work run by the pool, it parses one file.
+ */
+class STLLoadTask : public QRunnable {
+public:
+    STLLoadTask(STLLoader* loader, int generation, ModelPart* part, const QString& fileName,
+                const STLLoader::Reader& reader, quint64 key, const std::atomic<int>& current)
+        : loader(loader), generation(generation), part(part), fileName(fileName), reader(reader), key(key),
+          current(current) {
+    }
+
+    void run() override {
+        /* The batch may have been cancelled while this task was waiting in the queue */
+        if (current.load() != generation)
+            return;
+
+        /* Files with the same contents are only read once, their parts share the geometry.
+         * Geometry made by a reader is told apart by the key it was queued with, and a file
+         * that is in the cache by the hash its entry records, so it is not read to be hashed */
+        quint64 hash = key;
+        bool previewed = false;
+        if (!reader && !GeometryCache::storedHash(fileName, hash)) {
+            /* Hashing reads the whole file, so a large file is previewed first unless the cache has it ready */
+            loader->preview(generation, part, fileName);
+            previewed = true;
+
+            bool hashed = false;
+            hash = GeometryCache::contentHash(fileName, &hashed);
+            if (!hashed)
+                hash = 0;
+        }
+
+        std::shared_ptr<const PartGeometry> geometry;
+        STLLoader::Claim claim = hash != 0 ? loader->claim(hash, generation, geometry) : STLLoader::READ;
+
+        STLLoader* target = loader;
+        int gen = generation;
+        ModelPart* p = part;
+
+        /* Another task is reading the same contents, the part is given its geometry when that task delivers */
+        if (claim == STLLoader::WAIT) {
+            QMetaObject::invokeMethod(loader, [target, gen, p, hash]() {
+                target->deliverCopy(gen, p, hash);
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        if (claim == STLLoader::READ) {
+            /* The hash taken above is passed on, so the file is not hashed again for the cache.
+             * A file whose cache entry turns out to be damaged is previewed while it is parsed */
+            auto parsing = [this, previewed]() {
+                if (!previewed)
+                    loader->preview(generation, part, fileName);
+            };
+            vtkSmartPointer<vtkPolyData> polyData;
+            if (reader)
+                polyData = reader();
+            else if (hash != 0)
+                polyData = STLLoader::readGeometry(fileName, hash, parsing);
+            else
+                polyData = STLLoader::readGeometry(fileName, parsing);
+
+            /* The geometry builds its triangle index for picking here, off the GUI thread */
+            if (polyData != nullptr)
+                geometry = std::make_shared<const PartGeometry>(polyData);
+
+            if (hash != 0)
+                loader->publish(hash, geometry);
+        }
+
+        /* Hand the result back to the GUI thread, the loader drops it if the batch was cancelled */
+        QMetaObject::invokeMethod(loader, [target, gen, p, geometry, hash]() {
+            target->deliver(gen, p, geometry, hash);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    STLLoader*              loader;         /**< Loader that owns the task */
+    int                     generation;     /**< Batch the task belongs to */
+    ModelPart*              part;           /**< Part that receives the geometry */
+    QString                 fileName;       /**< File to read, when there is no reader */
+    STLLoader::Reader       reader;         /**< Makes the geometry instead of the file, or empty */
+    quint64                 key;            /**< Identifies the reader's geometry, 0 if it is never shared */
+    const std::atomic<int>& current;        /**< Loader's current batch */
+};
+
+/**
+ * @class LevelBuildTask
+ * @brief The LevelBuildTask class is the unit of work that builds one part's levels of detail.
+ */
+class LevelBuildTask : public QRunnable {
+public:
+    LevelBuildTask(STLLoader* loader, int generation, ModelPart* part, vtkSmartPointer<vtkPolyData> polyData,
+                   quint64 hash, const std::atomic<int>& current)
+        : loader(loader), generation(generation), part(part), polyData(polyData), hash(hash), current(current) {
+    }
+
+    void run() override {
+        if (current.load() != generation)
+            return;
+
+        std::vector<PartGeometry::Level> levels = STLLoader::buildLevels(polyData);
+        if (levels.empty())
+            return;
+
+        STLLoader* target = loader;
+        int gen = generation;
+        ModelPart* p = part;
+        vtkSmartPointer<vtkPolyData> data = polyData;
+        quint64 h = hash;
+        QMetaObject::invokeMethod(loader, [target, gen, p, data, h, levels]() {
+            target->deliverLevels(gen, p, data, h, levels);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    STLLoader*                      loader;         /**< Loader that owns the task */
+    int                             generation;     /**< Batch the part was loaded in */
+    ModelPart*                      part;           /**< Part that receives the levels */
+    vtkSmartPointer<vtkPolyData>    polyData;       /**< Full geometry to decimate */
+    quint64                         hash;           /**< Contents hash of the part's file, 0 if unknown */
+    const std::atomic<int>&         current;        /**< Loader's current batch */
+};
+
+namespace {
+
+/* Fraction of the full triangle count kept by each level of detail */
+const double LEVEL_FRACTIONS[] = { 0.25, 0.06, 0.015 };
+
+/* Parts smaller than this render fast enough at full detail */
+const vtkIdType LEVEL_THRESHOLD = 20000;
+
+/* No level is made smaller than this */
+const vtkIdType LEVEL_MINIMUM = 200;
+
+/* Files from this size are shown as a box and then a sample of their triangles while they are read */
+const qint64 PROGRESSIVE_SIZE = 16 * 1024 * 1024;
+
+/* Triangles sampled for the box, and for the preview that follows it */
+const vtkIdType BOX_SAMPLE = 4096;
+const vtkIdType PREVIEW_TRIANGLES = 50000;
+
+}
+
+
+/**
+ * @brief Constructor for the STLLoader class.
+ * @param parent is a pointer to the parent QObject.
+ */
+STLLoader::STLLoader(QObject* parent)
+    : QObject(parent), generation(0), total(0), done(0), progressive(true), flushPending(false) {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+/**
+ * @brief Destructor for the STLLoader class, cancels outstanding work and waits for the workers.
+ */
+STLLoader::~STLLoader() {
+    generation++;
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function queues an STL file to be read in the background.
+ * @param part is the placeholder part that will receive the geometry.
+ * @param fileName is the name of the STL file.
+ */
+void STLLoader::load(ModelPart* part, const QString& fileName) {
+    /* A file that failed in an earlier batch may be readable now */
+    if (total == 0)
+        failed.clear();
+
+    total++;
+    emit progressChanged(done, total);
+
+    pool.start(new STLLoadTask(this, generation.load(), part, fileName, Reader(), 0, generation));
+}
+
+/**
+ * @brief This function queues geometry to be made in the background by a function instead of read from an STL file.
+ * The geometry is treated like a file that has been read: it gets its triangle index and levels
+ * of detail on the workers, and parts queued with the same key share it.
+ * @param part is the placeholder part that will receive the geometry.
+ * @param key identifies the geometry, it must not be the contents hash of a file (0 if it is never shared).
+ * @param reader makes the prepared geometry (see MeshPreparation) on a worker thread, it returns nullptr if it cannot.
+ */
+void STLLoader::load(ModelPart* part, quint64 key, const Reader& reader) {
+    if (total == 0)
+        failed.clear();
+
+    total++;
+    emit progressChanged(done, total);
+
+    pool.start(new STLLoadTask(this, generation.load(), part, QString(), reader, key, generation));
+}
+
+/**
+ * @brief This function cancels all queued loads. Files already being parsed are discarded when they finish.
+ */
+void STLLoader::cancel() {
+    generation++;
+    pool.clear();
+
+    total = 0;
+    done = 0;
+    waiting.clear();
+    failed.clear();
+    /* Parts keep the preview they show, a later load replaces it */
+    previews.clear();
+    previewed.clear();
+    emit finished();
+}
+
+/**
+ * @brief This function returns true while there are loads that have not finished.
+ * @return true if the loader is busy.
+ */
+bool STLLoader::isBusy() const {
+    return done < total;
+}
+
+/**
+ * @brief This function tells whether a part shows a preview while its file is read.
+ * @param part is the part.
+ * @return true if the part's geometry is a box or a sample of its triangles.
+ */
+bool STLLoader::isPreview(ModelPart* part) const {
+    return previews.contains(part);
+}
+
+/**
+ * @brief This function turns progressive loading of large files on or off (it is on by default).
+ * @param enabled is true to show a box and then a sample of a large part's triangles while it is read.
+ */
+void STLLoader::setProgressive(bool enabled) {
+    progressive = enabled;
+}
+
+/**
+ * @brief This function returns the size from which files are loaded progressively.
+ * @return the size in bytes.
+ */
+qint64 STLLoader::progressiveSize() {
+    return PROGRESSIVE_SIZE;
+}
+
+/**
+ * @brief This function returns the number of worker threads used by the loader.
+ * @return the number of worker threads.
+ */
+int STLLoader::threadCount() const {
+    return pool.maxThreadCount();
+}
+
+/**
+ * @brief This function sets the number of worker threads used by the loader (one per core by default).
+ * @param count is the number of worker threads.
+ */
+void STLLoader::setThreadCount(int count) {
+    pool.setMaxThreadCount(count);
+}
+
+/**
+ * @brief This function blocks until all workers are idle (used on shutdown and by headless tools).
+ */
+void STLLoader::waitForDone() {
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function decides whether a worker reads a file or shares the geometry of the same contents. It is safe to call from any thread.
+ * @param hash is the hash of the file contents.
+ * @param generation is the batch the load belongs to.
+ * @param geometry receives the geometry to share, when the result is SHARE.
+ * @return READ if the worker must read the file, SHARE if the geometry is already loaded, WAIT if another worker is reading it.
+ */
+STLLoader::Claim STLLoader::claim(quint64 hash, int generation, std::shared_ptr<const PartGeometry>& geometry) {
+    QMutexLocker lock(&registryMutex);
+
+    geometry = registry.value(hash).lock();
+    if (geometry != nullptr)
+        return SHARE;
+
+    /* A claim left by a cancelled batch will never be delivered, so it is taken over */
+    auto it = claims.find(hash);
+    if (it != claims.end() && it.value() == generation)
+        return WAIT;
+
+    claims.insert(hash, generation);
+    return READ;
+}
+
+/**
+ * @brief This function records the geometry read for some contents, so later copies share it. It is safe to call from any thread.
+ * @param hash is the hash of the file contents.
+ * @param geometry is the geometry, or nullptr if the file could not be read.
+ */
+void STLLoader::publish(quint64 hash, std::shared_ptr<const PartGeometry> geometry) {
+    QMutexLocker lock(&registryMutex);
+
+    claims.remove(hash);
+    if (geometry != nullptr)
+        registry.insert(hash, geometry);
+    else
+        registry.remove(hash);
+}
+
+/**
+ * @brief This function reads an STL file into welded, smooth-shaded vtkPolyData (see MeshPreparation). It is safe to call from any thread.
+ * @param fileName is the name of the STL file.
+ * @param parsing if set, is called once the file is known not to be in the cache, before it is parsed.
+ * @return the geometry, or nullptr if the file could not be read.
+ */
+vtkSmartPointer<vtkPolyData> STLLoader::readGeometry(const QString& fileName, const std::function<void()>& parsing) {
+    /* Parts opened before come straight from the cache */
+    quint64 contentHash = 0;
+    vtkSmartPointer<vtkPolyData> cached = GeometryCache::load(fileName, &contentHash);
+    if (cached != nullptr)
+        return cached;
+
+    return parseGeometry(fileName, contentHash, parsing);
+}
+
+/**
+ * @brief This function reads an STL file whose contents hash is known already, so the file is only read to be parsed. It is safe to call from any thread.
+ * @param fileName is the name of the STL file.
+ * @param contentHash is the hash of the file contents (see GeometryCache::contentHash()), it finds the file in the cache and stores it there.
+ * @param parsing if set, is called once the file is known not to be in the cache, before it is parsed.
+ * @return the geometry, or nullptr if the file could not be read.
+ */
+vtkSmartPointer<vtkPolyData> STLLoader::readGeometry(const QString& fileName, quint64 contentHash,
+                                                     const std::function<void()>& parsing) {
+    vtkSmartPointer<vtkPolyData> cached = GeometryCache::load(fileName, contentHash);
+    if (cached != nullptr)
+        return cached;
+
+    return parseGeometry(fileName, contentHash, parsing);
+}
+
+/**
+ * @brief This function parses an STL file, prepares it and adds it to the cache. It is safe to call from any thread.
+ * @param fileName is the name of the STL file.
+ * @param contentHash is the hash of the file contents, the geometry is cached under it.
+ * @param parsing if set, is called before the file is parsed.
+ * @return the geometry, or nullptr if the file could not be read.
+ */
+vtkSmartPointer<vtkPolyData> STLLoader::parseGeometry(const QString& fileName, quint64 contentHash,
+                                                      const std::function<void()>& parsing) {
+    if (parsing)
+        parsing();
+
+    /* Each call uses its own reader so workers never share pipeline state.
+     * Welding is left to the preparation stage, which also generates the normals. */
+    vtkSmartPointer<FastSTLReader> reader = vtkSmartPointer<FastSTLReader>::New();
+    reader->SetFileName(fileName.toStdString());
+    reader->MergePointsOff();
+    reader->Update();
+
+    if (reader->GetErrorCode() != 0) {
+        qDebug() << "Failed to read" << fileName;
+        return nullptr;
+    }
+
+    vtkSmartPointer<vtkPolyData> polyData = MeshPreparation::prepare(reader->GetOutput());
+    GeometryCache::store(fileName, contentHash, polyData);
+    return polyData;
+}
+
+/**
+ * @brief This function builds the decimated levels of detail of prepared geometry. It is safe to call from any thread.
+ * Each level is decimated from the one before it, which is much cheaper than starting from the
+ * full geometry every time.
+ * @param polyData is the full geometry.
+ * @return the levels from finest to coarsest, empty if the geometry is too small to need them.
+ */
+std::vector<PartGeometry::Level> STLLoader::buildLevels(vtkPolyData* polyData) {
+    std::vector<PartGeometry::Level> levels;
+    if (polyData == nullptr || polyData->GetNumberOfPolys() < LEVEL_THRESHOLD)
+        return levels;
+
+    vtkIdType full = polyData->GetNumberOfPolys();
+    vtkPolyData* source = polyData;
+    double error = 0.;
+
+    for (double fraction : LEVEL_FRACTIONS) {
+        vtkIdType target = vtkIdType(double(full) * fraction);
+        if (target < LEVEL_MINIMUM)
+            break;
+
+        double levelError = 0.;
+        vtkSmartPointer<vtkPolyData> level = MeshPreparation::simplify(source, target, &levelError);
+        if (level == nullptr)
+            break;
+
+        /* Errors must grow with the level for the selection to make sense */
+        error = levelError > error ? levelError : error;
+        levels.push_back({ level, error });
+        source = level;
+    }
+    return levels;
+}
+
+/**
+ * @brief This function returns the number of triangles below which no levels of detail are built.
+ * @return the number of triangles.
+ */
+vtkIdType STLLoader::levelThreshold() {
+    return LEVEL_THRESHOLD;
+}
+
+/**
+ * @brief This function shows a box and then a sample of a large file's triangles while the file is read. It runs on the worker reading the file.
+ * The box is taken around a few thousand triangles spread over the file, so it may fall slightly
+ * short of the part. Files that are not binary STL cannot be sampled and get no preview.
+ * @param generation is the batch the load belongs to.
+ * @param part is the part the previews are for.
+ * @param fileName is the name of the STL file.
+ */
+void STLLoader::preview(int generation, ModelPart* part, const QString& fileName) {
+    if (!progressive.load() || QFileInfo(fileName).size() < PROGRESSIVE_SIZE)
+        return;
+
+    auto post = [this, generation, part](std::shared_ptr<const PartGeometry> geometry) {
+        STLLoader* target = this;
+        QMetaObject::invokeMethod(this, [target, generation, part, geometry]() {
+            target->deliverPreview(generation, part, geometry);
+        }, Qt::QueuedConnection);
+    };
+
+    vtkIdType fileTriangles = 0;
+    vtkSmartPointer<vtkPolyData> sample = FastSTLReader::ReadSample(fileName.toStdString(), BOX_SAMPLE, &fileTriangles);
+    if (sample == nullptr || sample->GetNumberOfPolys() == 0)
+        return;
+
+    double bounds[6];
+    sample->GetBounds(bounds);
+    post(PartGeometry::createBox(bounds));
+
+    /* The sample is prepared like the full geometry, so it is lit the same way */
+    if (fileTriangles < 2 * PREVIEW_TRIANGLES || this->generation.load() != generation)
+        return;
+
+    sample = FastSTLReader::ReadSample(fileName.toStdString(), PREVIEW_TRIANGLES);
+    if (sample != nullptr)
+        post(std::make_shared<const PartGeometry>(MeshPreparation::prepare(sample)));
+}
+
+/**
+ * @brief This function runs on the GUI thread when a worker has made a preview of a file.
+ * @param generation is the batch the load belongs to.
+ * @param part is the part the preview is for.
+ * @param geometry is the preview.
+ */
+void STLLoader::deliverPreview(int generation, ModelPart* part, std::shared_ptr<const PartGeometry> geometry) {
+    if (generation != this->generation.load())
+        return;
+
+    /* A part that shows geometry already (a proxy being reloaded) keeps it until the full geometry arrives */
+    if (part->getGeometry() != nullptr && !previews.contains(part))
+        return;
+
+    part->setGeometry(geometry);
+    previews.insert(part);
+    if (!previewed.contains(part))
+        previewed.append(part);
+    scheduleFlush();
+}
+
+/**
+ * @brief This function runs on the GUI thread when a worker has finished reading a file.
+ * @param generation is the batch the load belongs to.
+ * @param part is the part the geometry is for.
+ * @param geometry is the geometry that was read, or nullptr if the file could not be read.
+ * @param hash is the hash of the file contents, 0 if it is unknown.
+ */
+void STLLoader::deliver(int generation, ModelPart* part, std::shared_ptr<const PartGeometry> geometry, quint64 hash) {
+    if (generation != this->generation.load())
+        return;
+
+    assign(part, geometry, hash);
+
+    /* Parts waiting for the same contents get the same geometry, or fail with it */
+    if (hash != 0) {
+        if (geometry == nullptr)
+            failed.insert(hash);
+
+        QList<ModelPart*> waiters = waiting.values(hash);
+        waiting.remove(hash);
+        for (ModelPart* copy : waiters)
+            assign(copy, geometry, hash);
+    }
+}
+
+/**
+ * @brief This function runs on the GUI thread for a part whose contents another worker is reading.
+ * @param generation is the batch the load belongs to.
+ * @param part is the part the geometry is for.
+ * @param hash is the hash of the file contents.
+ */
+void STLLoader::deliverCopy(int generation, ModelPart* part, quint64 hash) {
+    if (generation != this->generation.load())
+        return;
+
+    /* The reading task may have finished since the worker checked */
+    std::shared_ptr<const PartGeometry> geometry;
+    {
+        QMutexLocker lock(&registryMutex);
+        geometry = registry.value(hash).lock();
+    }
+
+    if (geometry == nullptr && !failed.contains(hash)) {
+        waiting.insert(hash, part);
+        return;
+    }
+
+    assign(part, geometry, hash);
+}
+
+/**
+ * @brief This function gives a part its geometry, counts the load as done and starts building the levels of detail if needed.
+ * The part is announced by the next flushDelivered().
+ * @param part is the part.
+ * @param geometry is the geometry, or nullptr if the file could not be read.
+ * @param hash is the hash of the file contents, 0 if it is unknown.
+ */
+void STLLoader::assign(ModelPart* part, std::shared_ptr<const PartGeometry> geometry, quint64 hash) {
+    done++;
+    scheduleFlush();
+
+    /* The full geometry replaces the preview, which need not be announced any more */
+    bool previewedPart = previews.remove(part);
+    if (previewedPart)
+        previewed.removeOne(part);
+
+    if (geometry == nullptr) {
+        /* A preview must not outlive a file that turned out to be unreadable */
+        if (previewedPart) {
+            part->setGeometry(nullptr);
+            delivered.append(part);
+        }
+        unreadable.append(part);
+        return;
+    }
+
+    part->setGeometry(geometry);
+    delivered.append(part);
+
+    /* Copies share one set of levels, built for the first of them */
+    bool first = hash == 0 || !copies.contains(hash);
+    if (hash != 0 && !copies.contains(hash, part))
+        copies.insert(hash, part);
+
+    /* Levels of detail wait behind any files still to be read */
+    vtkSmartPointer<vtkPolyData> polyData = geometry->polyData();
+    if (first && geometry->levelCount() < 2 && polyData->GetNumberOfPolys() >= LEVEL_THRESHOLD)
+        pool.start(new LevelBuildTask(this, generation.load(), part, polyData, hash, generation), -1);
+}
+
+/**
+ * @brief This function runs on the GUI thread when a worker has finished building a part's levels of detail.
+ * @param generation is the batch the part was loaded in.
+ * @param part is the part the levels are for.
+ * @param polyData is the full geometry the levels were built from.
+ * @param hash is the hash of the part's file contents, 0 if it is unknown.
+ * @param levels are the levels.
+ */
+void STLLoader::deliverLevels(int generation, ModelPart* part, vtkSmartPointer<vtkPolyData> polyData, quint64 hash,
+                              std::vector<PartGeometry::Level> levels) {
+    if (generation != this->generation.load())
+        return;
+
+    QList<ModelPart*> parts = hash != 0 ? copies.values(hash) : QList<ModelPart*>({ part });
+    std::shared_ptr<const PartGeometry> levelled;
+    for (ModelPart* copy : parts) {
+        /* The part may have been given other geometry since */
+        std::shared_ptr<const PartGeometry> geometry = copy->getGeometry();
+        if (geometry == nullptr || geometry->polyData() != polyData || geometry->levelCount() > 1)
+            continue;
+
+        copy->setLevels(levels);
+        levelled = copy->getGeometry();
+        emit levelsBuilt(copy);
+    }
+
+    /* Copies read later get the levels straight away */
+    if (hash != 0 && levelled != nullptr) {
+        QMutexLocker lock(&registryMutex);
+        registry.insert(hash, levelled);
+    }
+}
+
+/**
+ * @brief This function announces the parts delivered since it last ran, and the progress of the batch.
+ */
+void STLLoader::flushDelivered() {
+    flushPending = false;
+
+    if (!previewed.isEmpty()) {
+        QList<ModelPart*> parts;
+        parts.swap(previewed);
+        emit partsPreviewed(parts);
+    }
+
+    if (!delivered.isEmpty()) {
+        QList<ModelPart*> parts;
+        parts.swap(delivered);
+        emit partsLoaded(parts);
+    }
+
+    if (!unreadable.isEmpty()) {
+        QList<ModelPart*> parts;
+        parts.swap(unreadable);
+        emit partsFailed(parts);
+    }
+
+    /* A batch cancelled meanwhile has already reported that it finished */
+    if (total == 0)
+        return;
+
+    emit progressChanged(done, total);
+
+    if (done == total) {
+        total = 0;
+        done = 0;
+        emit finished();
+    }
+}
+
+/**
+ * @brief This function queues flushDelivered(), unless it is queued already.
+ * Results already queued behind the current one are delivered before the flush runs.
+ */
+void STLLoader::scheduleFlush() {
+    if (!flushPending) {
+        flushPending = true;
+        QMetaObject::invokeMethod(this, [this]() { flushDelivered(); }, Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,321 @@
+/** @file STLLoader.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Background loader that reads STL files on a pool of worker threads.
+  */
+
+#ifndef VIEWER_STLLOADER_H
+#define VIEWER_STLLOADER_H
+
+#include "PartGeometry.h"
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+class ModelPart;
+
+/**
+ * @class STLLoader
+ * @brief The STLLoader class reads STL files on a worker pool sized to the number of cores.
+ *
+ * Parts are added to the tree straight away as placeholders, the file is parsed on a worker
+ * thread and the finished vtkPolyData is handed back to the GUI thread, where the part's
+ * mapper and actor are created (VTK rendering objects must only be touched by the GUI thread).
+ * Large parts then get their levels of detail built by a lower priority task, so they never
+ * hold up the files still waiting to be read. Parts that finish in the same event loop iteration
+ * are announced together, so the tree and the scene are updated once per batch rather than once per file.
+ *
+ * Large binary files are loaded progressively: the part first shows a box around a sample of its
+ * triangles, then an evenly spaced sample of about 50,000 of them, and finally the full mesh. The
+ * samples only read the pages of the file they need and are prepared on the worker thread like
+ * the full mesh, so each stage reaches the screen without the GUI thread waiting on the file.
+ *
+ * Files are told apart by a hash of their contents: copies of a file that has been read already,
+ * or is being read, share its geometry and levels of detail instead of being read again, which
+ * also lets the views draw them as instances of one mesh (see InstancedScene). Geometry can also be
+ * made by a function instead of read from a file, such as the meshes stored in a project (see
+ * ProjectFile), and goes through the same steps.
+ */
+class STLLoader : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief A function that makes a part's geometry on a worker thread, returning nullptr if it cannot.
+     */
+    typedef std::function<vtkSmartPointer<vtkPolyData>()> Reader;
+
+    /**
+     * @brief Constructor for the STLLoader class.
+     * @param parent is a pointer to the parent QObject.
+     */
+    STLLoader(QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor for the STLLoader class, cancels outstanding work and waits for the workers.
+     */
+    ~STLLoader();
+
+    /**
+     * @brief This function queues an STL file to be read in the background.
+     * @param part is the placeholder part that will receive the geometry.
+     * @param fileName is the name of the STL file.
+     */
+    void load(ModelPart* part, const QString& fileName);
+
+    /**
+     * @brief This function queues geometry to be made in the background by a function instead of read from an STL file.
+     * @param part is the placeholder part that will receive the geometry.
+     * @param key identifies the geometry, it must not be the contents hash of a file (0 if it is never shared).
+     * @param reader makes the prepared geometry (see MeshPreparation) on a worker thread, it returns nullptr if it cannot.
+     */
+    void load(ModelPart* part, quint64 key, const Reader& reader);
+
+    /**
+     * @brief This function cancels all queued loads. Files already being parsed are discarded when they finish.
+     */
+    void cancel();
+
+    /**
+     * @brief This function returns true while there are loads that have not finished.
+     * @return true if the loader is busy.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief This function tells whether a part shows a preview while its file is read.
+     * @param part is the part.
+     * @return true if the part's geometry is a box or a sample of its triangles.
+     */
+    bool isPreview(ModelPart* part) const;
+
+    /**
+     * @brief This function turns progressive loading of large files on or off (it is on by default).
+     * @param enabled is true to show a box and then a sample of a large part's triangles while it is read.
+     */
+    void setProgressive(bool enabled);
+
+    /**
+     * @brief This function returns the size from which files are loaded progressively.
+     * @return the size in bytes.
+     */
+    static qint64 progressiveSize();
+
+    /**
+     * @brief This function returns the number of worker threads used by the loader.
+     * @return the number of worker threads.
+     */
+    int threadCount() const;
+
+    /**
+     * @brief This function sets the number of worker threads used by the loader (one per core by default).
+     * @param count is the number of worker threads.
+     */
+    void setThreadCount(int count);
+
+    /**
+     * @brief This function blocks until all workers are idle (used on shutdown and by headless tools).
+     */
+    void waitForDone();
+
+    /**
+     * @brief This function reads an STL file into welded, smooth-shaded vtkPolyData (see MeshPreparation). It is safe to call from any thread.
+     * @param fileName is the name of the STL file.
+     * @param parsing if set, is called once the file is known not to be in the cache, before it is parsed.
+     * @return the geometry, or nullptr if the file could not be read.
+     */
+    static vtkSmartPointer<vtkPolyData> readGeometry(const QString& fileName, const std::function<void()>& parsing = nullptr);
+
+    /**
+     * @brief This function reads an STL file whose contents hash is known already, so the file is only read to be parsed. It is safe to call from any thread.
+     * @param fileName is the name of the STL file.
+     * @param contentHash is the hash of the file contents (see GeometryCache::contentHash()), it finds the file in the cache and stores it there.
+     * @param parsing if set, is called once the file is known not to be in the cache, before it is parsed.
+     * @return the geometry, or nullptr if the file could not be read.
+     */
+    static vtkSmartPointer<vtkPolyData> readGeometry(const QString& fileName, quint64 contentHash,
+                                                     const std::function<void()>& parsing = nullptr);
+
+    /**
+     * @brief This function builds the decimated levels of detail of prepared geometry (25%, 6% and 1.5% of the triangles). It is safe to call from any thread.
+     * @param polyData is the full geometry.
+     * @return the levels from finest to coarsest, empty if the geometry is too small to need them.
+     */
+    static std::vector<PartGeometry::Level> buildLevels(vtkPolyData* polyData);
+
+    /**
+     * @brief This function returns the number of triangles below which no levels of detail are built.
+     * @return the number of triangles.
+     */
+    static vtkIdType levelThreshold();
+
+signals:
+    /**
+     * @brief This signal is emitted on the GUI thread once parts being loaded progressively have been given a preview (a box, then a sample of their triangles).
+     * @param parts are the parts given a preview since the last signal.
+     */
+    void partsPreviewed(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This signal is emitted on the GUI thread once parts have received their geometry, or lost their preview because the file could not be read.
+     * @param parts are the parts that were loaded since the last signal.
+     */
+    void partsLoaded(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This signal is emitted on the GUI thread once the files of parts could not be read, after partsLoaded() for the same flush.
+     * @param parts are the parts that failed since the last signal.
+     */
+    void partsFailed(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This signal is emitted on the GUI thread once a part's levels of detail have been added to its geometry.
+     * @param part is the part.
+     */
+    void levelsBuilt(ModelPart* part);
+
+    /**
+     * @brief This signal is emitted whenever a load completes or is queued.
+     * @param done is the number of finished loads in the current batch.
+     * @param total is the number of loads in the current batch.
+     */
+    void progressChanged(int done, int total);
+
+    /**
+     * @brief This signal is emitted when the last load of a batch has completed or the batch was cancelled.
+     */
+    void finished();
+
+private:
+    friend class STLLoadTask;
+    friend class LevelBuildTask;
+
+    /**
+     * @brief What a worker does with a file, depending on whether its contents are already loaded.
+     */
+    enum Claim {
+        READ,       /**< Read the file, no other worker has these contents */
+        SHARE,      /**< Share the geometry already loaded for these contents */
+        WAIT        /**< Another worker is reading these contents, wait for its geometry */
+    };
+
+    /**
+     * @brief This function decides whether a worker reads a file or shares the geometry of the same contents. It is safe to call from any thread.
+     * @param hash is the hash of the file contents.
+     * @param generation is the batch the load belongs to.
+     * @param geometry receives the geometry to share, when the result is SHARE.
+     * @return READ if the worker must read the file, SHARE if the geometry is already loaded, WAIT if another worker is reading it.
+     */
+    Claim claim(quint64 hash, int generation, std::shared_ptr<const PartGeometry>& geometry);
+
+    /**
+     * @brief This function records the geometry read for some contents, so later copies share it. It is safe to call from any thread.
+     * @param hash is the hash of the file contents.
+     * @param geometry is the geometry, or nullptr if the file could not be read.
+     */
+    void publish(quint64 hash, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function parses an STL file, prepares it and adds it to the cache. It is safe to call from any thread.
+     * @param fileName is the name of the STL file.
+     * @param contentHash is the hash of the file contents, the geometry is cached under it.
+     * @param parsing if set, is called before the file is parsed.
+     * @return the geometry, or nullptr if the file could not be read.
+     */
+    static vtkSmartPointer<vtkPolyData> parseGeometry(const QString& fileName, quint64 contentHash,
+                                                      const std::function<void()>& parsing);
+
+    /**
+     * @brief This function shows a box and then a sample of a large file's triangles while the file is read. It runs on the worker reading the file.
+     * @param generation is the batch the load belongs to.
+     * @param part is the part the previews are for.
+     * @param fileName is the name of the STL file.
+     */
+    void preview(int generation, ModelPart* part, const QString& fileName);
+
+    /**
+     * @brief This function runs on the GUI thread when a worker has made a preview of a file.
+     * @param generation is the batch the load belongs to.
+     * @param part is the part the preview is for.
+     * @param geometry is the preview.
+     */
+    void deliverPreview(int generation, ModelPart* part, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function runs on the GUI thread when a worker has finished reading a file.
+     * @param generation is the batch the load belongs to.
+     * @param part is the part the geometry is for.
+     * @param geometry is the geometry that was read, with its triangle index, or nullptr if the file could not be read.
+     * @param hash is the hash of the file contents, 0 if it is unknown.
+     */
+    void deliver(int generation, ModelPart* part, std::shared_ptr<const PartGeometry> geometry, quint64 hash);
+
+    /**
+     * @brief This function runs on the GUI thread for a part whose contents another worker is reading.
+     * @param generation is the batch the load belongs to.
+     * @param part is the part the geometry is for.
+     * @param hash is the hash of the file contents.
+     */
+    void deliverCopy(int generation, ModelPart* part, quint64 hash);
+
+    /**
+     * @brief This function gives a part its geometry, counts the load as done and starts building the levels of detail if needed.
+     * @param part is the part.
+     * @param geometry is the geometry, or nullptr if the file could not be read.
+     * @param hash is the hash of the file contents, 0 if it is unknown.
+     */
+    void assign(ModelPart* part, std::shared_ptr<const PartGeometry> geometry, quint64 hash);
+
+    /**
+     * @brief This function runs on the GUI thread when a worker has finished building the levels of detail of a part and its copies.
+     * @param generation is the batch the part was loaded in.
+     * @param part is the part the levels were built for.
+     * @param polyData is the full geometry the levels were built from.
+     * @param hash is the hash of the part's file contents, 0 if it is unknown.
+     * @param levels are the levels.
+     */
+    void deliverLevels(int generation, ModelPart* part, vtkSmartPointer<vtkPolyData> polyData, quint64 hash,
+                       std::vector<PartGeometry::Level> levels);
+
+    /**
+     * @brief This function announces the parts delivered since it last ran, and the progress of the batch.
+     */
+    void flushDelivered();
+
+    /**
+     * @brief This function queues flushDelivered(), unless it is queued already.
+     */
+    void scheduleFlush();
+
+    QThreadPool                                         pool;               /**< Worker threads, one per core */
+    std::atomic<int>                                    generation;         /**< Incremented on cancel so stale results are dropped */
+    int                                                 total;              /**< Number of loads queued in the current batch */
+    int                                                 done;               /**< Number of loads finished in the current batch */
+    std::atomic<bool>                                   progressive;        /**< True to preview large files while they are read */
+    QList<ModelPart*>                                   delivered;          /**< Parts loaded but not yet announced */
+    QList<ModelPart*>                                   previewed;          /**< Parts given a preview but not yet announced */
+    QList<ModelPart*>                                   unreadable;         /**< Parts whose file could not be read but not yet announced */
+    QSet<ModelPart*>                                    previews;           /**< Parts showing a preview, until their full geometry arrives */
+    bool                                                flushPending;       /**< True if flushDelivered() is queued */
+    QMutex                                              registryMutex;      /**< Guards registry and claims, which workers use */
+    QHash<quint64, std::weak_ptr<const PartGeometry>>   registry;           /**< Geometry loaded for each file contents hash */
+    QHash<quint64, int>                                 claims;             /**< Contents being read, with the batch reading them */
+    QMultiHash<quint64, ModelPart*>                     waiting;            /**< Parts waiting for contents another worker is reading */
+    QMultiHash<quint64, ModelPart*>                     copies;             /**< Parts given the geometry of each contents hash */
+    QSet<quint64>                                       failed;             /**< Contents that could not be read in the current batch */
+};
+
+#endif
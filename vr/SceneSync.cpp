@@ -0,0 +1,465 @@
+/** @file SceneSync.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Keeps the desktop renderer in step with the part tree.
+  */
+
+#include "SceneSync.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+
+#include <vtkCallbackCommand.h>
+#include <vtkCamera.h>
+#include <vtkCullerCollection.h>
+#include <vtkFrustumCoverageCuller.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+
+/**
+ * @brief Constructor for the SceneSync class.
+ * @param model is the part tree to follow.
+ * @param renderer is the renderer the parts' actors are added to.
+ * @param parent is a pointer to the parent QObject.
+ */
+SceneSync::SceneSync(ModelPartList* model, vtkRenderer* renderer, QObject* parent)
+    : QObject(parent), model(model), renderer(renderer), renderObserver(0), renderPending(false), highlighted(nullptr) {
+    connect(model, &QAbstractItemModel::rowsInserted, this, &SceneSync::handleRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SceneSync::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::dataChanged, this, &SceneSync::handleDataChanged);
+    connect(model, &QAbstractItemModel::modelReset, this, &SceneSync::rebuild);
+
+    vtkNew<vtkCallbackCommand> onRender;
+    onRender->SetCallback(beforeRender);
+    onRender->SetClientData(this);
+    renderObserver = renderer->AddObserver(vtkCommand::StartEvent, onRender);
+
+    /* The index replaces the default frustum coverage culler, which tests every prop each render */
+    culler = vtkSmartPointer<BVHCuller>::New();
+    culler->SetIndex(&bounds);
+    renderer->GetCullers()->RemoveAllItems();
+    renderer->AddCuller(culler);
+
+    instances.setRenderer(renderer);
+
+    /* The outline is drawn unlit on top of the part colours and is added once a part is highlighted */
+    outline = vtkSmartPointer<vtkOutlineSource>::New();
+    vtkNew<vtkPolyDataMapper> outlineMapper;
+    outlineMapper->SetInputConnection(outline->GetOutputPort());
+    outlineActor = vtkSmartPointer<vtkActor>::New();
+    outlineActor->SetMapper(outlineMapper);
+    outlineActor->GetProperty()->SetColor(1., 0.85, 0.);
+    outlineActor->GetProperty()->SetLineWidth(2.);
+    outlineActor->GetProperty()->LightingOff();
+    outlineActor->PickableOff();
+
+    sections.setRenderer(renderer);
+    sections.exclude(outlineActor);
+}
+
+/**
+ * @brief Destructor for the SceneSync class, it takes its render observer and culler off the renderer, which may outlive it.
+ * Both point into this object. The renderer gets back the default culler it had before.
+ */
+SceneSync::~SceneSync() {
+    renderer->RemoveObserver(renderObserver);
+
+    culler->SetIndex(nullptr);
+    renderer->RemoveCuller(culler);
+    vtkNew<vtkFrustumCoverageCuller> frustum;
+    renderer->AddCuller(frustum);
+
+    if (highlighted != nullptr)
+        renderer->RemoveActor(outlineActor);
+}
+
+/**
+ * @brief This function removes the actors added by this class and adds them again from the whole tree.
+ */
+void SceneSync::rebuild() {
+    setHighlight(nullptr);
+    sections.clearCaps();
+    instances.clear();
+    actors.clear();
+    parts.clear();
+    lods.clear();
+    bounds.clear();
+
+    syncSubtree(model->getRootItem());
+    requestRender();
+}
+
+/**
+ * @brief This function returns the number of part actors in the scene.
+ * @return the number of actors.
+ */
+int SceneSync::actorCount() const {
+    return actors.size();
+}
+
+/**
+ * @brief This function gives access to the level of detail selection of the desktop view.
+ * @return a reference to the selector.
+ */
+LODSelector& SceneSync::levelOfDetail() {
+    return lods;
+}
+
+/**
+ * @brief This function gives access to the bounding volume index of the desktop view's part actors.
+ * @return a reference to the index.
+ */
+const PartBVH& SceneSync::boundsIndex() const {
+    return bounds;
+}
+
+/**
+ * @brief This function gives access to the section planes of the desktop view.
+ * @return a reference to the planes.
+ */
+const SectionPlanes& SceneSync::sectionPlanes() const {
+    return sections;
+}
+
+/**
+ * @brief This function moves, turns on or turns off one section plane of the desktop view.
+ * @param index is the plane.
+ * @param enabled is true to cut the parts with the plane.
+ * @param origin is a point on the plane, in world coordinates.
+ * @param normal is the normal of the plane, the side it points to is kept.
+ */
+void SceneSync::setSectionPlane(int index, bool enabled, const double origin[3], const double normal[3]) {
+    sections.setPlane(index, enabled, origin, normal);
+    requestRender();
+}
+
+/**
+ * @brief This function gives a part the faces cut by the section planes, replacing its previous cap.
+ * @param part is the part.
+ * @param cap is the cap in the part's model coordinates, or nullptr to remove it.
+ */
+void SceneSync::setCap(ModelPart* part, std::shared_ptr<const PartGeometry> cap) {
+    vtkActor* actor = actors.value(part).Get();
+    if (actor == nullptr)
+        return;
+
+    sections.setCap(actor, cap);
+    requestRender();
+}
+
+/**
+ * @brief This function leaves a prop added to the renderer by someone else uncut by the section planes.
+ * @param prop is the prop.
+ */
+void SceneSync::excludeFromSection(vtkProp* prop) {
+    sections.exclude(prop);
+}
+
+/**
+ * @brief This function finds the visible part a ray in world coordinates hits first, tested against the part's triangles.
+ * @param origin is the start of the ray.
+ * @param direction is the direction of the ray.
+ * @param distance receives the distance to the hit in multiples of direction, if not nullptr.
+ * @return the part hit, nullptr if there is none.
+ */
+ModelPart* SceneSync::pick(const double origin[3], const double direction[3], double* distance) const {
+    /* Only the stretch of the ray the section planes keep can hit anything */
+    double enter, leave;
+    if (!sections.clipRay(origin, direction, enter, leave))
+        return nullptr;
+    double start[3];
+    for (int k = 0; k < 3; k++)
+        start[k] = origin[k] + enter * direction[k];
+    double length = leave - enter;
+
+    /* Parts are tested nearest box first, each against its own triangles in model coordinates */
+    PartBVH::RayTest test = [this, length](vtkProp3D* prop, const double o[3], const double d[3], double& t) {
+        t = std::min(t, length);
+        ModelPart* part = parts.value(prop);
+        std::shared_ptr<const PartGeometry> geometry = part != nullptr ? part->getDisplayGeometry() : nullptr;
+        const TriangleBVH* triangles = geometry != nullptr ? geometry->pickIndex() : nullptr;
+        if (triangles == nullptr)
+            return false;
+
+        vtkMatrix4x4* matrix = prop->GetMatrix();
+        if (matrix->IsIdentity())
+            return triangles->intersect(o, d, t);
+
+        /* An affine transform keeps distances along the ray in the same units */
+        vtkNew<vtkMatrix4x4> inverse;
+        vtkMatrix4x4::Invert(matrix, inverse);
+        double worldOrigin[4] = { o[0], o[1], o[2], 1. };
+        double worldDirection[4] = { d[0], d[1], d[2], 0. };
+        double localOrigin[4], localDirection[4];
+        inverse->MultiplyPoint(worldOrigin, localOrigin);
+        inverse->MultiplyPoint(worldDirection, localDirection);
+        return triangles->intersect(localOrigin, localDirection, t);
+    };
+
+    vtkProp3D* hit = bounds.raycast(start, direction, distance, test);
+    if (hit != nullptr && distance != nullptr)
+        *distance += enter;
+    return hit != nullptr ? parts.value(hit) : nullptr;
+}
+
+/**
+ * @brief This function finds the visible part under a point of the view.
+ * @param x is the horizontal display coordinate.
+ * @param y is the vertical display coordinate.
+ * @return the part hit, nullptr if there is none.
+ */
+ModelPart* SceneSync::pickAt(int x, int y) const {
+    /* The ray runs from the near to the far clipping plane through the pixel */
+    double nearPoint[4], farPoint[4];
+    renderer->SetDisplayPoint(x, y, 0.);
+    renderer->DisplayToWorld();
+    renderer->GetWorldPoint(nearPoint);
+    renderer->SetDisplayPoint(x, y, 1.);
+    renderer->DisplayToWorld();
+    renderer->GetWorldPoint(farPoint);
+    if (nearPoint[3] == 0. || farPoint[3] == 0.)
+        return nullptr;
+
+    double origin[3], direction[3];
+    for (int k = 0; k < 3; k++) {
+        origin[k] = nearPoint[k] / nearPoint[3];
+        direction[k] = farPoint[k] / farPoint[3] - origin[k];
+    }
+    return pick(origin, direction);
+}
+
+/**
+ * @brief This function estimates how large a part appears in the view at the last render.
+ * @param part is the part.
+ * @return the height of the part's bounding box on screen in pixels, 0 if the part is hidden, has no actor or was culled.
+ */
+double SceneSync::screenSize(ModelPart* part) const {
+    vtkActor* actor = actors.value(part).Get();
+    if (actor == nullptr || !actor->GetVisibility() || !bounds.inFrustum(actor))
+        return 0.;
+
+    double* box = actor->GetBounds();
+    if (box == nullptr)
+        return 0.;
+
+    double diagonal = 0., centre[3];
+    for (int k = 0; k < 3; k++) {
+        double extent = box[2 * k + 1] - box[2 * k];
+        diagonal += extent * extent;
+        centre[k] = 0.5 * (box[2 * k] + box[2 * k + 1]);
+    }
+    diagonal = std::sqrt(diagonal);
+
+    vtkCamera* camera = renderer->GetActiveCamera();
+    double height = double(renderer->GetSize()[1]);
+    if (camera->GetParallelProjection())
+        return height * diagonal / (2. * camera->GetParallelScale());
+
+    double* eye = camera->GetPosition();
+    double distance = std::sqrt(vtkMath::Distance2BetweenPoints(eye, centre));
+    double halfAngle = vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.;
+
+    /* Parts around the eye fill the view */
+    if (distance <= 0.5 * diagonal)
+        return height;
+    return height * diagonal / (2. * distance * std::tan(halfAngle));
+}
+
+/**
+ * @brief This function outlines the bounding box of one part, replacing any previous outline.
+ * @param part is the part to outline, or nullptr to remove the outline.
+ */
+void SceneSync::setHighlight(ModelPart* part) {
+    if (part == highlighted)
+        return;
+
+    if (highlighted == nullptr)
+        renderer->AddActor(outlineActor);
+    else if (part == nullptr)
+        renderer->RemoveActor(outlineActor);
+
+    highlighted = part;
+    updateHighlight();
+    requestRender();
+}
+
+/**
+ * @brief This function adds the actors of newly inserted rows.
+ * @param parent is the parent of the new rows.
+ * @param first is the first new row.
+ * @param last is the last new row.
+ */
+void SceneSync::handleRowsInserted(const QModelIndex& parent, int first, int last) {
+    for (int row = first; row <= last; row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (index.isValid())
+            syncSubtree(static_cast<ModelPart*>(index.internalPointer()));
+    }
+    requestRender();
+}
+
+/**
+ * @brief This function removes the actors of rows that are about to be removed.
+ * @param parent is the parent of the rows.
+ * @param first is the first row to be removed.
+ * @param last is the last row to be removed.
+ */
+void SceneSync::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    for (int row = first; row <= last; row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (index.isValid())
+            removeSubtree(static_cast<ModelPart*>(index.internalPointer()));
+    }
+    requestRender();
+}
+
+/**
+ * @brief This function updates the actors of changed rows.
+ * @param topLeft is the first changed index.
+ * @param bottomRight is the last changed index.
+ */
+void SceneSync::handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (index.isValid())
+            syncPart(static_cast<ModelPart*>(index.internalPointer()));
+    }
+    requestRender();
+}
+
+/**
+ * @brief This function makes the scene match one part: adds, swaps or removes its actor.
+ * Visibility and colour live on the actor itself, so they need no scene change, only a render.
+ * @param part is the part to synchronise.
+ */
+void SceneSync::syncPart(ModelPart* part) {
+    vtkSmartPointer<vtkActor> actor = part->getActor();
+    vtkSmartPointer<vtkActor> current = actors.value(part);
+    if (actor == current) {
+        /* Same actor, but the geometry may have gained levels of detail or been filtered. Filtered
+         * geometry is no longer a copy of the part's file, so the actor is instanced by what it draws */
+        if (actor != nullptr) {
+            std::shared_ptr<const PartGeometry> shown = part->getDisplayGeometry();
+            lods.setGeometry(actor, shown);
+            if (instances.source(actor) != shown->polyData()) {
+                sections.removeCap(actor);
+                instances.remove(actor);
+                instances.add(actor, shown->polyData());
+            }
+            bounds.update(actor);
+        }
+        if (part == highlighted)
+            updateHighlight();
+        return;
+    }
+
+    if (current != nullptr) {
+        sections.removeCap(current);
+        lods.remove(current);
+        bounds.remove(current);
+        instances.remove(current);
+        actors.remove(part);
+        parts.remove(current);
+    }
+
+    if (actor != nullptr) {
+        bool first = actors.isEmpty();
+        std::shared_ptr<const PartGeometry> shown = part->getDisplayGeometry();
+        instances.add(actor, shown != nullptr ? shown->polyData() : nullptr);
+        actors.insert(part, actor);
+        parts.insert(actor, part);
+        lods.setGeometry(actor, shown);
+        bounds.insert(actor);
+
+        /* Frame the first part shown, after that the camera is left where the user put it */
+        if (first) {
+            renderer->ResetCamera();
+            renderer->ResetCameraClippingRange();
+        }
+    }
+
+    if (part == highlighted)
+        updateHighlight();
+}
+
+/**
+ * @brief This function synchronises a part and all of its children.
+ * @param part is the top of the subtree.
+ */
+void SceneSync::syncSubtree(ModelPart* part) {
+    syncPart(part);
+    for (int i = 0; i < part->childCount(); i++)
+        syncSubtree(part->child(i));
+}
+
+/**
+ * @brief This function removes the actors of a part and all of its children.
+ * @param part is the top of the subtree.
+ */
+void SceneSync::removeSubtree(ModelPart* part) {
+    vtkSmartPointer<vtkActor> current = actors.take(part);
+    if (current != nullptr) {
+        sections.removeCap(current);
+        lods.remove(current);
+        bounds.remove(current);
+        instances.remove(current);
+        parts.remove(current);
+    }
+    if (part == highlighted)
+        setHighlight(nullptr);
+
+    for (int i = 0; i < part->childCount(); i++)
+        removeSubtree(part->child(i));
+}
+
+/**
+ * @brief This function schedules one render for all changes made in this event loop iteration.
+ */
+void SceneSync::requestRender() {
+    if (renderPending)
+        return;
+
+    renderPending = true;
+    QTimer::singleShot(0, this, [this]() {
+        renderPending = false;
+        if (renderer->GetRenderWindow() != nullptr)
+            renderer->GetRenderWindow()->Render();
+    });
+}
+
+/**
+ * @brief This function is called by the renderer before it renders, it chooses the parts' levels of detail, updates the instances and gives the mappers the section planes.
+ * @param caller is the renderer.
+ * @param eventId is the event (StartEvent).
+ * @param clientData is a pointer to the SceneSync.
+ * @param callData is unused.
+ */
+void SceneSync::beforeRender(vtkObject* caller, unsigned long eventId, void* clientData, void* callData) {
+    SceneSync* sync = static_cast<SceneSync*>(clientData);
+    sync->lods.update(sync->renderer);
+    sync->instances.update();
+    sync->sections.update();
+}
+
+/**
+ * @brief This function fits the outline to the highlighted part's actor, or hides it if the part has no visible actor.
+ */
+void SceneSync::updateHighlight() {
+    vtkActor* actor = highlighted != nullptr ? actors.value(highlighted).Get() : nullptr;
+    double* actorBounds = actor != nullptr ? actor->GetBounds() : nullptr;
+    if (actorBounds == nullptr || !actor->GetVisibility()) {
+        outlineActor->VisibilityOff();
+        return;
+    }
+
+    outline->SetBounds(actorBounds);
+    outlineActor->VisibilityOn();
+}
@@ -0,0 +1,217 @@
+/** @file SceneSync.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Keeps the desktop renderer in step with the part tree.
+  */
+
+#ifndef VIEWER_SCENESYNC_H
+#define VIEWER_SCENESYNC_H
+
+#include "LODSelector.h"
+#include "PartBVH.h"
+#include "BVHCuller.h"
+#include "InstancedScene.h"
+#include "SectionPlanes.h"
+
+#include <QObject>
+#include <QHash>
+#include <QModelIndex>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkOutlineSource.h>
+#include <vtkRenderer.h>
+
+class ModelPart;
+class ModelPartList;
+
+/**
+ * @class SceneSync
+ * @brief The SceneSync class listens to the ModelPartList model signals and applies only the
+ * change to the renderer: one actor is added, removed or updated per changed part.
+ *
+ * Nothing else in the scene is touched and the camera is only framed the first time a part
+ * appears in an empty scene. Renders requested by several changes in the same event loop
+ * iteration are merged into one. Parts with levels of detail are switched between them by a
+ * LODSelector before every render, and the part actors are kept in a PartBVH that culls the
+ * parts out of view and answers ray picks. Picks are exact: the candidate parts the ray reaches
+ * are tested against the triangle index of their geometry, nearest first. Parts sharing their
+ * geometry are drawn through an InstancedScene, one draw call for all copies. Section planes
+ * cut every part while it is drawn (SectionPlanes), and picks only hit what the planes keep.
+ */
+class SceneSync : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor for the SceneSync class.
+     * @param model is the part tree to follow.
+     * @param renderer is the renderer the parts' actors are added to.
+     * @param parent is a pointer to the parent QObject.
+     */
+    SceneSync(ModelPartList* model, vtkRenderer* renderer, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor for the SceneSync class, it takes its render observer and culler off the renderer, which may outlive it.
+     */
+    ~SceneSync();
+
+    /**
+     * @brief This function removes the actors added by this class and adds them again from the whole tree.
+     */
+    void rebuild();
+
+    /**
+     * @brief This function returns the number of part actors in the scene.
+     * @return the number of actors.
+     */
+    int actorCount() const;
+
+    /**
+     * @brief This function gives access to the level of detail selection of the desktop view.
+     * @return a reference to the selector.
+     */
+    LODSelector& levelOfDetail();
+
+    /**
+     * @brief This function gives access to the bounding volume index of the desktop view's part actors.
+     * @return a reference to the index.
+     */
+    const PartBVH& boundsIndex() const;
+
+    /**
+     * @brief This function gives access to the section planes of the desktop view.
+     * @return a reference to the planes.
+     */
+    const SectionPlanes& sectionPlanes() const;
+
+    /**
+     * @brief This function moves, turns on or turns off one section plane of the desktop view.
+     * @param index is the plane, 0 to SectionPlanes::MAX_PLANES - 1.
+     * @param enabled is true to cut the parts with the plane.
+     * @param origin is a point on the plane, in world coordinates.
+     * @param normal is the normal of the plane, the side it points to is kept.
+     */
+    void setSectionPlane(int index, bool enabled, const double origin[3], const double normal[3]);
+
+    /**
+     * @brief This function gives a part the faces cut by the section planes, replacing its previous cap.
+     * @param part is the part.
+     * @param cap is the cap in the part's model coordinates (see SectionCapper), or nullptr to remove it.
+     */
+    void setCap(ModelPart* part, std::shared_ptr<const PartGeometry> cap);
+
+    /**
+     * @brief This function leaves a prop added to the renderer by someone else uncut by the section planes, e.g. a background.
+     * @param prop is the prop.
+     */
+    void excludeFromSection(vtkProp* prop);
+
+    /**
+     * @brief This function finds the visible part a ray in world coordinates hits first, tested against the part's triangles.
+     * @param origin is the start of the ray.
+     * @param direction is the direction of the ray.
+     * @param distance receives the distance to the hit in multiples of direction, if not nullptr.
+     * @return the part hit, nullptr if there is none.
+     */
+    ModelPart* pick(const double origin[3], const double direction[3], double* distance = nullptr) const;
+
+    /**
+     * @brief This function finds the visible part under a point of the view.
+     * @param x is the horizontal display coordinate, in pixels from the left.
+     * @param y is the vertical display coordinate, in pixels from the bottom (as reported by the interactor).
+     * @return the part hit, nullptr if there is none.
+     */
+    ModelPart* pickAt(int x, int y) const;
+
+    /**
+     * @brief This function estimates how large a part appears in the view at the last render.
+     * @param part is the part.
+     * @return the height of the part's bounding box on screen in pixels, 0 if the part is hidden, has no actor or was culled.
+     */
+    double screenSize(ModelPart* part) const;
+
+    /**
+     * @brief This function outlines the bounding box of one part, replacing any previous outline.
+     * @param part is the part to outline, or nullptr to remove the outline.
+     */
+    void setHighlight(ModelPart* part);
+
+private slots:
+    /**
+     * @brief This function adds the actors of newly inserted rows.
+     * @param parent is the parent of the new rows.
+     * @param first is the first new row.
+     * @param last is the last new row.
+     */
+    void handleRowsInserted(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief This function removes the actors of rows that are about to be removed.
+     * @param parent is the parent of the rows.
+     * @param first is the first row to be removed.
+     * @param last is the last row to be removed.
+     */
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief This function updates the actors of changed rows.
+     * @param topLeft is the first changed index.
+     * @param bottomRight is the last changed index.
+     */
+    void handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+private:
+    /**
+     * @brief This function makes the scene match one part: adds, swaps or removes its actor.
+     * @param part is the part to synchronise.
+     */
+    void syncPart(ModelPart* part);
+
+    /**
+     * @brief This function synchronises a part and all of its children.
+     * @param part is the top of the subtree.
+     */
+    void syncSubtree(ModelPart* part);
+
+    /**
+     * @brief This function removes the actors of a part and all of its children.
+     * @param part is the top of the subtree.
+     */
+    void removeSubtree(ModelPart* part);
+
+    /**
+     * @brief This function schedules one render for all changes made in this event loop iteration.
+     */
+    void requestRender();
+
+    /**
+     * @brief This function fits the outline to the highlighted part's actor, or hides it if the part has no visible actor.
+     */
+    void updateHighlight();
+
+    /**
+     * @brief This function is called by the renderer before it renders, it chooses the parts' levels of detail, updates the instances and gives the mappers the section planes.
+     * @param caller is the renderer.
+     * @param eventId is the event (StartEvent).
+     * @param clientData is a pointer to the SceneSync.
+     * @param callData is unused.
+     */
+    static void beforeRender(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
+
+    ModelPartList*                                  model;          /**< Part tree being followed */
+    vtkSmartPointer<vtkRenderer>                    renderer;       /**< Desktop renderer */
+    unsigned long                                   renderObserver; /**< Tag of the StartEvent observer that calls beforeRender() */
+    QHash<ModelPart*, vtkSmartPointer<vtkActor>>    actors;         /**< Actor currently in the scene for each part */
+    QHash<vtkProp*, ModelPart*>                     parts;          /**< Part of each actor in the scene */
+    bool                                            renderPending;  /**< True if a render has been scheduled */
+    LODSelector                                     lods;           /**< Level of detail of each part's actor */
+    PartBVH                                         bounds;         /**< World bounds of each part's actor */
+    InstancedScene                                  instances;      /**< Adds the part actors to the renderer, instancing copies */
+    SectionPlanes                                   sections;       /**< Planes cutting the parts, and their caps */
+    vtkSmartPointer<BVHCuller>                      culler;         /**< Culls the renderer's props with bounds */
+    ModelPart*                                      highlighted;    /**< Part outlined, or nullptr */
+    vtkSmartPointer<vtkOutlineSource>               outline;        /**< Box around the highlighted part */
+    vtkSmartPointer<vtkActor>                       outlineActor;   /**< Actor drawing the outline */
+};
+
+#endif
@@ -0,0 +1,580 @@
+/** @file SectionCapper.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Faces cut by the section planes, computed in the background once the planes stop moving.
+  */
+
+#include "SectionCapper.h"
+#include "SectionPlanes.h"
+#include "FilterPipeline.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+#include <QRunnable>
+#include <QMetaObject>
+
+#include <algorithm>
+#include <cstdint>
+
+#include <vtkAppendPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkContourTriangulator.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+namespace {
+
+/* Time the planes must stay still before the caps are cut */
+const int SETTLE_MS = 300;
+
+/**
+ * @struct Edge
+ * @brief The Edge structure names an edge of the mesh by its two points, lowest first.
+ */
+struct Edge {
+    vtkIdType   low;    /**< Lower point index */
+    vtkIdType   high;   /**< Higher point index */
+
+    bool operator<(const Edge& other) const {
+        return low < other.low || (low == other.low && high < other.high);
+    }
+    bool operator==(const Edge& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+/* The edge between two points, whichever order they come in */
+Edge edge(vtkIdType a, vtkIdType b) {
+    return a < b ? Edge{ a, b } : Edge{ b, a };
+}
+
+/* Lowest and highest value of a plane equation over a box */
+void planeRange(const double plane[4], const double bounds[6], double& low, double& high) {
+    low = high = plane[3];
+    for (int k = 0; k < 3; k++) {
+        low += plane[k] * (plane[k] >= 0. ? bounds[2 * k] : bounds[2 * k + 1]);
+        high += plane[k] * (plane[k] >= 0. ? bounds[2 * k + 1] : bounds[2 * k]);
+    }
+}
+
+/* True if at least one plane runs through the geometry's box and none cuts all of it away */
+bool needsCap(const PartGeometry& geometry, const std::vector<double>& planes) {
+    double bounds[6];
+    geometry.getBounds(bounds);
+    bool crossed = false;
+    for (size_t i = 0; i + 3 < planes.size(); i += 4) {
+        double low, high;
+        planeRange(&planes[i], bounds, low, high);
+        if (high < 0.)
+            return false;
+        crossed = crossed || low < 0.;
+    }
+    return crossed;
+}
+
+/* The faces of one part: its section by each plane, trimmed by the other planes */
+std::shared_ptr<const PartGeometry> cutPart(vtkPolyData* source, const std::vector<double>& planes) {
+    vtkNew<vtkAppendPolyData> append;
+    vtkSmartPointer<vtkPolyData> faces;
+    int pieces = 0;
+    for (size_t i = 0; i + 3 < planes.size(); i += 4) {
+        vtkSmartPointer<vtkPolyData> piece = SectionCapper::section(source, &planes[i]);
+        for (size_t j = 0; j + 3 < planes.size() && piece->GetNumberOfCells() > 0; j += 4) {
+            if (j == i)
+                continue;
+            const double* other = &planes[j];
+            double origin[3] = { -other[3] * other[0], -other[3] * other[1], -other[3] * other[2] };
+            piece = FilterPipeline::clip(piece, origin, other);
+        }
+        if (piece->GetNumberOfCells() == 0)
+            continue;
+        append->AddInputData(piece);
+        faces = piece;
+        pieces++;
+    }
+
+    if (pieces == 0)
+        return nullptr;
+    if (pieces > 1) {
+        append->Update();
+        faces = append->GetOutput();
+    }
+
+    /* The views check the cap is still where it was cut before they show it */
+    vtkNew<vtkDoubleArray> cut;
+    cut->SetName(SectionPlanes::CAP_PLANES);
+    cut->SetNumberOfComponents(4);
+    cut->SetNumberOfTuples(vtkIdType(planes.size() / 4));
+    std::copy(planes.begin(), planes.end(), cut->GetPointer(0));
+    faces->GetFieldData()->AddArray(cut);
+
+    /* The geometry computes its bounds now, on this thread, as every shared geometry does */
+    return std::make_shared<const PartGeometry>(faces);
+}
+
+}
+
+/**
+ * @class CapTask
+ * @brief The CapTask class is the unit of work run by the pool, it cuts the parts of one request.
+ */
+class CapTask : public QRunnable {
+public:
+    CapTask(SectionCapper* capper, const SectionCapper::Job& job, std::shared_ptr<std::atomic<int>> current)
+        : capper(capper), job(job), current(current) {
+    }
+
+    void run() override {
+        /* The planes may move again at any time, the rest of the parts are then left uncut */
+        for (SectionCapper::Entry& entry : job.entries) {
+            if (current->load() != job.request)
+                return;
+            entry.cap = cutPart(entry.source->polyData(), entry.planes);
+        }
+
+        SectionCapper* target = capper;
+        SectionCapper::Job result = job;
+        QMetaObject::invokeMethod(capper, [target, result]() {
+            target->deliver(result);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SectionCapper*                      capper;         /**< Capper that owns the task */
+    SectionCapper::Job                  job;            /**< Parts to cut, and their caps */
+    std::shared_ptr<std::atomic<int>>   current;        /**< Latest request */
+};
+
+/**
+ * @brief Constructor for the SectionCapper class.
+ * @param model is the part tree, parts are cut again when they change.
+ * @param planes are the planes of the desktop view, which the caps are cut with.
+ * @param parent is a pointer to the parent QObject.
+ */
+SectionCapper::SectionCapper(ModelPartList* model, const SectionPlanes* planes, QObject* parent)
+    : QObject(parent), model(model), planes(planes), current(std::make_shared<std::atomic<int>>(0)),
+      requests(0), pending(false), enabled(false) {
+    /* One job at a time, each part's section is split across the cores */
+    pool.setMaxThreadCount(1);
+
+    settle.setSingleShot(true);
+    settle.setInterval(SETTLE_MS);
+    connect(&settle, &QTimer::timeout, this, &SectionCapper::update);
+
+    connect(model, &QAbstractItemModel::dataChanged, this, &SectionCapper::handleDataChanged);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &SectionCapper::handleDataChanged);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SectionCapper::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelReset, this, &SectionCapper::handleModelReset);
+}
+
+/**
+ * @brief Destructor for the SectionCapper class, cancels outstanding work and waits for the worker.
+ */
+SectionCapper::~SectionCapper() {
+    current->store(0);
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function turns caps on or off, turning them off removes every cap.
+ * @param enabled is true to compute caps.
+ */
+void SectionCapper::setEnabled(bool enabled) {
+    if (enabled == this->enabled)
+        return;
+
+    this->enabled = enabled;
+    if (enabled)
+        update();
+    else
+        replace(QHash<ModelPart*, Entry>());
+}
+
+/**
+ * @brief This function checks if caps are on.
+ * @return true if caps are computed.
+ */
+bool SectionCapper::isEnabled() const {
+    return enabled;
+}
+
+/**
+ * @brief This function sets how long the planes and parts must stay still before caps are computed.
+ * @param milliseconds is the delay.
+ */
+void SectionCapper::setSettleTime(int milliseconds) {
+    settle.setInterval(std::max(milliseconds, 0));
+}
+
+/**
+ * @brief This function tells the capper that the planes or parts changed: caps are computed again once they settle.
+ */
+void SectionCapper::schedule() {
+    if (!enabled)
+        return;
+
+    /* Work on planes that have already moved on is dropped straight away */
+    current->store(++requests);
+    pending = false;
+    settle.start();
+}
+
+/**
+ * @brief This function computes the caps now, without waiting for the planes to settle.
+ * Parts whose geometry and planes (in their model coordinates) have not changed keep their caps,
+ * the others are sent to the worker in one job.
+ */
+void SectionCapper::update() {
+    settle.stop();
+    Job job;
+    job.request = ++requests;
+    current->store(job.request);
+    pending = false;
+
+    std::vector<double> world = planes->activePlanes();
+    if (enabled && !world.empty()) {
+        QList<ModelPart*> parts = { model->getRootItem() };
+        while (!parts.isEmpty()) {
+            ModelPart* part = parts.takeLast();
+            for (int i = 0; i < part->childCount(); i++)
+                parts.append(part->child(i));
+
+            vtkSmartPointer<vtkActor> actor = part->getActor();
+            std::shared_ptr<const PartGeometry> geometry = part->getDisplayGeometry();
+            if (actor == nullptr || geometry == nullptr || !part->visible())
+                continue;
+
+            Entry entry;
+            entry.source = geometry;
+            entry.planes = SectionPlanes::toModel(actor->GetMatrix(), world);
+            if (!needsCap(*geometry, entry.planes))
+                continue;
+
+            auto it = caps.constFind(part);
+            if (it != caps.constEnd() && it->source == entry.source && it->planes == entry.planes) {
+                job.kept.insert(part, *it);
+                continue;
+            }
+            job.parts.append(part);
+            job.entries.push_back(entry);
+        }
+    }
+
+    if (job.parts.isEmpty()) {
+        replace(job.kept);
+        return;
+    }
+
+    pending = true;
+    pool.start(new CapTask(this, job, current));
+}
+
+/**
+ * @brief This function returns the cap of a part.
+ * @param part is the part.
+ * @return the cap in the part's model coordinates, nullptr if the part has none.
+ */
+std::shared_ptr<const PartGeometry> SectionCapper::cap(ModelPart* part) const {
+    auto it = caps.constFind(part);
+    return it != caps.constEnd() ? it->cap : nullptr;
+}
+
+/**
+ * @brief This function returns true while caps are waiting for the planes to settle or being computed.
+ * @return true if the capper is busy.
+ */
+bool SectionCapper::isBusy() const {
+    return pending || settle.isActive();
+}
+
+/**
+ * @brief This function blocks until the worker is idle.
+ */
+void SectionCapper::waitForDone() {
+    pool.waitForDone();
+}
+
+/**
+ * @brief This function computes the faces a plane cuts through closed geometry.
+ * Points are classified in parallel, then each triangle the plane crosses adds one segment, written
+ * in a second pass after a prefix sum. A segment runs from the edge where the triangle's boundary
+ * leaves the kept side to the edge where it comes back, so the loops of a closed, outward facing
+ * mesh all turn the same way. Crossed edges are sorted and made unique so both triangles of an edge
+ * share its point, which is what lets the triangulator join the segments into loops.
+ * @param input is the prepared (indexed triangle) geometry, it is only read.
+ * @param plane is the plane equation: unit normal and offset, the side the normal points to is kept.
+ * @return the faces, facing the side that is cut away, with point normals.
+ */
+vtkSmartPointer<vtkPolyData> SectionCapper::section(vtkPolyData* input, const double plane[4]) {
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    if (input == nullptr || input->GetPoints() == nullptr || input->GetPolys() == nullptr)
+        return output;
+
+    vtkSmartPointer<vtkFloatArray> pointArray = vtkFloatArray::FastDownCast(input->GetPoints()->GetData());
+    if (pointArray == nullptr || pointArray->GetNumberOfComponents() != 3) {
+        pointArray = vtkSmartPointer<vtkFloatArray>::New();
+        pointArray->DeepCopy(input->GetPoints()->GetData());
+    }
+    const float* points = pointArray->GetPointer(0);
+    vtkIdType pointCount = input->GetNumberOfPoints();
+
+    /* 1. Signed distance of every point from the plane, points at zero distance are kept */
+    std::vector<double> distance(pointCount);
+    vtkSMPTools::For(0, pointCount, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; i++) {
+            const float* p = points + 3 * i;
+            distance[size_t(i)] = plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+        }
+    });
+
+    vtkCellArray* polys = input->GetPolys();
+    vtkIdType cellCount = polys->GetNumberOfCells();
+    std::vector<uint8_t> crossed(cellCount);
+    std::vector<vtkIdType> firstSegment(size_t(cellCount) + 1);
+    std::vector<Edge> ends;
+
+    auto run = [&](const auto* offsets, const auto* ids) {
+        /* 2. Triangles with corners on both sides add one segment each */
+        vtkSMPTools::For(0, cellCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; c++) {
+                int kept = 0;
+                if (offsets[c + 1] - offsets[c] == 3) {
+                    for (int v = 0; v < 3; v++)
+                        kept += distance[size_t(ids[offsets[c] + v])] >= 0. ? 1 : 0;
+                }
+                crossed[size_t(c)] = kept == 1 || kept == 2;
+            }
+        });
+
+        for (vtkIdType c = 0; c < cellCount; c++)
+            firstSegment[size_t(c) + 1] = firstSegment[size_t(c)] + crossed[size_t(c)];
+
+        /* 3. The edge each segment starts and ends on */
+        ends.resize(2 * size_t(firstSegment[size_t(cellCount)]));
+        vtkSMPTools::For(0, cellCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; c++) {
+                if (!crossed[size_t(c)])
+                    continue;
+                size_t s = 2 * size_t(firstSegment[size_t(c)]);
+                for (int v = 0; v < 3; v++) {
+                    vtkIdType a = vtkIdType(ids[offsets[c] + v]);
+                    vtkIdType b = vtkIdType(ids[offsets[c] + (v + 1) % 3]);
+                    bool keptA = distance[size_t(a)] >= 0.;
+                    bool keptB = distance[size_t(b)] >= 0.;
+                    if (keptA && !keptB)
+                        ends[s] = edge(a, b);
+                    else if (!keptA && keptB)
+                        ends[s + 1] = edge(a, b);
+                }
+            }
+        });
+    };
+
+    if (polys->IsStorage64Bit())
+        run(polys->GetOffsetsArray64()->GetPointer(0), polys->GetConnectivityArray64()->GetPointer(0));
+    else
+        run(polys->GetOffsetsArray32()->GetPointer(0), polys->GetConnectivityArray32()->GetPointer(0));
+
+    vtkIdType segmentCount = vtkIdType(ends.size() / 2);
+    if (segmentCount == 0)
+        return output;
+
+    /* 4. One point per crossed edge */
+    std::vector<Edge> edges(ends);
+    vtkSMPTools::Sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    vtkIdType edgeCount = vtkIdType(edges.size());
+
+    vtkNew<vtkDoubleArray> crossings;
+    crossings->SetNumberOfComponents(3);
+    crossings->SetNumberOfTuples(edgeCount);
+    double* crossing = crossings->GetPointer(0);
+    vtkSMPTools::For(0, edgeCount, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType e = begin; e < end; e++) {
+            const Edge& crossedEdge = edges[size_t(e)];
+            double low = distance[size_t(crossedEdge.low)];
+            double t = low / (low - distance[size_t(crossedEdge.high)]);
+            const float* a = points + 3 * crossedEdge.low;
+            const float* b = points + 3 * crossedEdge.high;
+            for (int k = 0; k < 3; k++)
+                crossing[3 * e + k] = a[k] + t * (double(b[k]) - a[k]);
+        }
+    });
+
+    /* 5. The segments as lines between the crossing points */
+    vtkNew<vtkIdTypeArray> lineOffsets;
+    lineOffsets->SetNumberOfTuples(segmentCount + 1);
+    vtkNew<vtkIdTypeArray> lineIds;
+    lineIds->SetNumberOfTuples(2 * segmentCount);
+    vtkIdType* lineOffset = lineOffsets->GetPointer(0);
+    vtkIdType* lineId = lineIds->GetPointer(0);
+    vtkSMPTools::For(0, 2 * segmentCount, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; i++) {
+            lineId[i] = vtkIdType(std::lower_bound(edges.begin(), edges.end(), ends[size_t(i)]) - edges.begin());
+            if (i % 2 == 0)
+                lineOffset[i / 2] = i;
+        }
+    });
+    lineOffset[segmentCount] = 2 * segmentCount;
+
+    vtkNew<vtkPoints> contourPoints;
+    contourPoints->SetData(crossings);
+    vtkNew<vtkCellArray> lines;
+    lines->SetData(lineOffsets, lineIds);
+    vtkNew<vtkPolyData> contours;
+    contours->SetPoints(contourPoints);
+    contours->SetLines(lines);
+
+    /* 6. The loops filled, holes left open */
+    vtkNew<vtkCellArray> filled;
+    double normal[3] = { plane[0], plane[1], plane[2] };
+    vtkContourTriangulator::TriangulateContours(contours, 0, segmentCount, filled, normal);
+    vtkIdType triangleCount = filled->GetNumberOfCells();
+    if (triangleCount == 0)
+        return output;
+
+    /* 7. The prepared layout: float points, one normal per point and triangles facing the cut away side */
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfTuples(3 * triangleCount);
+    vtkIdType* triangles = connectivity->GetPointer(0);
+    vtkIdType written = 0;
+    for (vtkIdType t = 0; t < triangleCount; t++) {
+        vtkIdType size;
+        const vtkIdType* corners;
+        filled->GetCellAtId(t, size, corners);
+        if (size != 3)
+            continue;
+
+        const double* a = crossing + 3 * corners[0];
+        const double* b = crossing + 3 * corners[1];
+        const double* c = crossing + 3 * corners[2];
+        double facing = 0.;
+        for (int k = 0; k < 3; k++) {
+            int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+            facing += normal[k] * ((b[k1] - a[k1]) * (c[k2] - a[k2]) - (b[k2] - a[k2]) * (c[k1] - a[k1]));
+        }
+        triangles[3 * written] = corners[0];
+        triangles[3 * written + 1] = facing > 0. ? corners[2] : corners[1];
+        triangles[3 * written + 2] = facing > 0. ? corners[1] : corners[2];
+        written++;
+    }
+    connectivity->SetNumberOfTuples(3 * written);
+
+    vtkNew<vtkIdTypeArray> offsets;
+    offsets->SetNumberOfTuples(written + 1);
+    for (vtkIdType t = 0; t <= written; t++)
+        offsets->SetValue(t, 3 * t);
+
+    vtkNew<vtkFloatArray> capPoints;
+    capPoints->SetNumberOfComponents(3);
+    capPoints->SetNumberOfTuples(edgeCount);
+    vtkNew<vtkFloatArray> capNormals;
+    capNormals->SetName("Normals");
+    capNormals->SetNumberOfComponents(3);
+    capNormals->SetNumberOfTuples(edgeCount);
+    float* capPoint = capPoints->GetPointer(0);
+    float* capNormal = capNormals->GetPointer(0);
+    for (vtkIdType i = 0; i < 3 * edgeCount; i++) {
+        capPoint[i] = float(crossing[i]);
+        capNormal[i] = float(-normal[i % 3]);
+    }
+
+    vtkNew<vtkCellArray> faces;
+    faces->SetData(offsets, connectivity);
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(capPoints);
+    output->SetPoints(outputPoints);
+    output->SetPolys(faces);
+    output->GetPointData()->SetNormals(capNormals);
+    return output;
+}
+
+/**
+ * @brief This function cuts the parts again once their geometry, visibility or place changed.
+ * Parts that did not change keep their caps, so this is cheap when only a colour changed.
+ */
+void SectionCapper::handleDataChanged() {
+    if (enabled && planes->activeCount() > 0)
+        schedule();
+}
+
+/**
+ * @brief This function forgets the caps of rows that are about to be removed.
+ * @param parent is the parent of the rows.
+ * @param first is the first row to be removed.
+ * @param last is the last row to be removed.
+ */
+void SectionCapper::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    /* A job running now may hold these parts, its result is dropped */
+    current->store(++requests);
+    pending = false;
+
+    for (int row = first; row <= last; row++) {
+        QModelIndex index = model->index(row, 0, parent);
+        if (index.isValid())
+            forgetSubtree(static_cast<ModelPart*>(index.internalPointer()));
+    }
+    schedule();
+}
+
+/**
+ * @brief This function forgets every cap when the model is reset.
+ */
+void SectionCapper::handleModelReset() {
+    current->store(++requests);
+    pending = false;
+    caps.clear();
+    schedule();
+}
+
+/**
+ * @brief This function runs on the GUI thread when the worker has cut the parts.
+ * @param job is the finished job.
+ */
+void SectionCapper::deliver(const Job& job) {
+    /* The planes or parts changed while the job ran, the next job replaces it */
+    if (job.request != current->load())
+        return;
+    pending = false;
+
+    QHash<ModelPart*, Entry> next = job.kept;
+    for (int i = 0; i < job.parts.size(); i++)
+        next.insert(job.parts[i], job.entries[size_t(i)]);
+    replace(next);
+}
+
+/**
+ * @brief This function replaces the caps and tells the views which parts changed.
+ * @param caps are the new caps of every capped part.
+ */
+void SectionCapper::replace(const QHash<ModelPart*, Entry>& caps) {
+    QList<ModelPart*> changed;
+    for (auto it = this->caps.constBegin(); it != this->caps.constEnd(); ++it) {
+        if (it->cap != nullptr && !caps.contains(it.key()))
+            changed.append(it.key());
+    }
+    for (auto it = caps.constBegin(); it != caps.constEnd(); ++it) {
+        if (it->cap != cap(it.key()))
+            changed.append(it.key());
+    }
+
+    this->caps = caps;
+    if (!changed.isEmpty())
+        emit capsChanged(changed);
+}
+
+/**
+ * @brief This function forgets the caps of a part and all of its children.
+ * @param part is the top of the subtree.
+ */
+void SectionCapper::forgetSubtree(ModelPart* part) {
+    caps.remove(part);
+    for (int i = 0; i < part->childCount(); i++)
+        forgetSubtree(part->child(i));
+}
@@ -0,0 +1,197 @@
+/** @file SectionCapper.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Faces cut by the section planes, computed in the background once the planes stop moving.
+  */
+
+#ifndef VIEWER_SECTIONCAPPER_H
+#define VIEWER_SECTIONCAPPER_H
+
+#include "PartGeometry.h"
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QModelIndex>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+class ModelPart;
+class ModelPartList;
+class SectionPlanes;
+
+/**
+ * @class SectionCapper
+ * @brief The SectionCapper class computes the cut faces (caps) that close the parts cut open by the section planes.
+ *
+ * The planes themselves are applied on the GPU (see SectionPlanes) and can move every frame.
+ * Caps need the part's triangles, so they are only computed once the planes have stopped moving
+ * for a moment: every change restarts a short timer, and a change while caps are being computed
+ * drops that work. The caps are computed on a worker thread and handed back to the GUI thread,
+ * where capsChanged() tells the views to show them.
+ *
+ * Each part's cap is cut in its model coordinates: the section of the part by each plane,
+ * filled where the cut is closed and trimmed by the other planes. It is kept with the geometry
+ * and planes it was cut from, so parts that did not move relative to the planes keep their caps
+ * when the others are cut again, and a cap is also valid for a view whose parts are placed
+ * differently (the VR view) as long as the planes are placed the same way relative to the parts.
+ */
+class SectionCapper : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor for the SectionCapper class.
+     * @param model is the part tree, parts are cut again when they change.
+     * @param planes are the planes of the desktop view, which the caps are cut with.
+     * @param parent is a pointer to the parent QObject.
+     */
+    SectionCapper(ModelPartList* model, const SectionPlanes* planes, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor for the SectionCapper class, cancels outstanding work and waits for the worker.
+     */
+    ~SectionCapper();
+
+    /**
+     * @brief This function turns caps on or off, turning them off removes every cap.
+     * @param enabled is true to compute caps.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief This function checks if caps are on.
+     * @return true if caps are computed.
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief This function sets how long the planes and parts must stay still before caps are computed.
+     * @param milliseconds is the delay.
+     */
+    void setSettleTime(int milliseconds);
+
+    /**
+     * @brief This function tells the capper that the planes or parts changed: caps are computed again once they settle.
+     */
+    void schedule();
+
+    /**
+     * @brief This function computes the caps now, without waiting for the planes to settle.
+     */
+    void update();
+
+    /**
+     * @brief This function returns the cap of a part.
+     * @param part is the part.
+     * @return the cap in the part's model coordinates, nullptr if the part has none.
+     */
+    std::shared_ptr<const PartGeometry> cap(ModelPart* part) const;
+
+    /**
+     * @brief This function returns true while caps are waiting for the planes to settle or being computed.
+     * @return true if the capper is busy.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief This function blocks until the worker is idle. The caps are delivered by the event loop afterwards.
+     */
+    void waitForDone();
+
+    /**
+     * @brief This function computes the faces a plane cuts through closed geometry. It is safe to call from any thread.
+     * The crossed edges become points shared by the triangles on both sides, the segments are joined
+     * into loops and the loops filled, holes included. Loops that do not close (open meshes) are dropped.
+     * @param input is the prepared (indexed triangle) geometry, it is only read.
+     * @param plane is the plane equation: unit normal and offset, the side the normal points to is kept.
+     * @return the faces, facing the side that is cut away, with point normals.
+     */
+    static vtkSmartPointer<vtkPolyData> section(vtkPolyData* input, const double plane[4]);
+
+signals:
+    /**
+     * @brief This signal is emitted on the GUI thread when parts gain, lose or change their caps.
+     * @param parts are the parts.
+     */
+    void capsChanged(const QList<ModelPart*>& parts);
+
+private slots:
+    /**
+     * @brief This function cuts the parts again once their geometry, visibility or place changed.
+     */
+    void handleDataChanged();
+
+    /**
+     * @brief This function forgets the caps of rows that are about to be removed.
+     * @param parent is the parent of the rows.
+     * @param first is the first row to be removed.
+     * @param last is the last row to be removed.
+     */
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief This function forgets every cap when the model is reset.
+     */
+    void handleModelReset();
+
+private:
+    friend class CapTask;
+
+    /**
+     * @struct Entry
+     * @brief The Entry structure holds the cap of one part and what it was cut from.
+     */
+    struct Entry {
+        std::shared_ptr<const PartGeometry>     source;         /**< Geometry the cap was cut from */
+        std::vector<double>                     planes;         /**< Planes it was cut with, in model coordinates */
+        std::shared_ptr<const PartGeometry>     cap;            /**< Cap, nullptr if the planes miss the part */
+    };
+
+    /**
+     * @struct Job
+     * @brief The Job structure holds the parts sent to the worker, and the caps it sends back.
+     */
+    struct Job {
+        int                                     request;        /**< Request the job belongs to */
+        QList<ModelPart*>                       parts;          /**< Parts to cut */
+        std::vector<Entry>                      entries;        /**< Geometry and planes of each part, the worker fills in the caps */
+        QHash<ModelPart*, Entry>                kept;           /**< Caps that are still valid */
+    };
+
+    /**
+     * @brief This function runs on the GUI thread when the worker has cut the parts.
+     * @param job is the finished job.
+     */
+    void deliver(const Job& job);
+
+    /**
+     * @brief This function replaces the caps and tells the views which parts changed.
+     * @param caps are the new caps of every capped part.
+     */
+    void replace(const QHash<ModelPart*, Entry>& caps);
+
+    /**
+     * @brief This function forgets the caps of a part and all of its children.
+     * @param part is the top of the subtree.
+     */
+    void forgetSubtree(ModelPart* part);
+
+    ModelPartList*                              model;          /**< Part tree */
+    const SectionPlanes*                        planes;         /**< Planes the caps are cut with */
+    QThreadPool                                 pool;           /**< Worker that cuts the parts */
+    QTimer                                      settle;         /**< Waits for the planes to stop moving */
+    QHash<ModelPart*, Entry>                    caps;           /**< Cap of each capped part */
+    std::shared_ptr<std::atomic<int>>           current;        /**< Latest request, read by the worker to drop stale jobs */
+    int                                         requests;       /**< Requests made so far */
+    bool                                        pending;        /**< True while the worker cuts the latest request */
+    bool                                        enabled;        /**< True if caps are computed */
+};
+
+#endif
@@ -0,0 +1,347 @@
+/** @file SectionPlanes.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Section planes applied to every part of a view when it is drawn.
+  */
+
+#include "SectionPlanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkMapper.h>
+#include <vtkNew.h>
+#include <vtkPropCollection.h>
+#include <vtkProperty.h>
+
+namespace {
+
+/* A plane that is off is parked this far below everything, facing up, so it keeps every point */
+const double PARKED_DISTANCE = 1e20;
+
+/* Caps are drawn a little darker than their part, so the cut faces read as cut */
+const double CAP_SHADE = 0.75;
+
+/* Relative difference between two plane equations still taken as the same plane */
+const double PLANE_TOLERANCE = 1e-6;
+
+}
+
+const char* const SectionPlanes::CAP_PLANES = "SectionPlanes";
+
+/**
+ * @brief Constructor for the SectionPlanes class.
+ */
+SectionPlanes::SectionPlanes()
+    : renderer(nullptr), version(0), shownCaps(0) {
+    collection = vtkSmartPointer<vtkPlaneCollection>::New();
+    for (int i = 0; i < MAX_PLANES; i++) {
+        enabled[i] = false;
+        for (int k = 0; k < 3; k++) {
+            origins[i][k] = 0.;
+            normals[i][k] = k == 0 ? -1. : 0.;
+        }
+        planes[i] = vtkSmartPointer<vtkPlane>::New();
+        planes[i]->SetOrigin(0., 0., -PARKED_DISTANCE);
+        planes[i]->SetNormal(0., 0., 1.);
+        collection->AddItem(planes[i]);
+    }
+}
+
+/**
+ * @brief Destructor for the SectionPlanes class, removes the caps from the renderer.
+ */
+SectionPlanes::~SectionPlanes() {
+    clearCaps();
+}
+
+/**
+ * @brief This function sets the renderer whose mappers are cut and caps are added to.
+ * @param renderer is the renderer.
+ */
+void SectionPlanes::setRenderer(vtkRenderer* renderer) {
+    this->renderer = renderer;
+
+    /* Caps given before the view had a renderer */
+    if (renderer != nullptr) {
+        for (auto& entry : caps)
+            renderer->AddActor(entry.second.actor);
+    }
+}
+
+/**
+ * @brief This function moves, turns on or turns off one plane.
+ * @param index is the plane, 0 to MAX_PLANES - 1.
+ * @param enabled is true to cut the view with the plane.
+ * @param origin is a point on the plane, in world coordinates.
+ * @param normal is the normal of the plane, the side it points to is kept.
+ */
+void SectionPlanes::setPlane(int index, bool enabled, const double origin[3], const double normal[3]) {
+    if (index < 0 || index >= MAX_PLANES)
+        return;
+
+    double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    if (length <= 0.)
+        return;
+
+    for (int k = 0; k < 3; k++) {
+        origins[index][k] = origin[k];
+        normals[index][k] = normal[k] / length;
+    }
+    this->enabled[index] = enabled;
+
+    /* The plane moves in place, the mappers only see new shader values */
+    if (enabled) {
+        planes[index]->SetOrigin(origins[index]);
+        planes[index]->SetNormal(normals[index]);
+    } else {
+        planes[index]->SetOrigin(0., 0., -PARKED_DISTANCE);
+        planes[index]->SetNormal(0., 0., 1.);
+    }
+    version++;
+}
+
+/**
+ * @brief This function checks if a plane is on.
+ * @param index is the plane.
+ * @return true if the plane cuts the view.
+ */
+bool SectionPlanes::isEnabled(int index) const {
+    return index >= 0 && index < MAX_PLANES && enabled[index];
+}
+
+/**
+ * @brief This function returns where a plane is, whether or not it is on.
+ * @param index is the plane.
+ * @param origin receives a point on the plane.
+ * @param normal receives the unit normal of the plane.
+ */
+void SectionPlanes::getPlane(int index, double origin[3], double normal[3]) const {
+    index = std::min(std::max(index, 0), MAX_PLANES - 1);
+    for (int k = 0; k < 3; k++) {
+        origin[k] = origins[index][k];
+        normal[k] = normals[index][k];
+    }
+}
+
+/**
+ * @brief This function returns the number of planes that are on.
+ * @return the number of planes.
+ */
+int SectionPlanes::activeCount() const {
+    return int(std::count(enabled, enabled + MAX_PLANES, true));
+}
+
+/**
+ * @brief This function returns the equations of the planes that are on, in index order.
+ * @return four values per plane: the unit normal and the offset, points with a positive or zero value are kept.
+ */
+std::vector<double> SectionPlanes::activePlanes() const {
+    std::vector<double> equations;
+    for (int i = 0; i < MAX_PLANES; i++) {
+        if (!enabled[i])
+            continue;
+        const double* n = normals[i];
+        const double* o = origins[i];
+        equations.insert(equations.end(), { n[0], n[1], n[2], -(n[0] * o[0] + n[1] * o[1] + n[2] * o[2]) });
+    }
+    return equations;
+}
+
+/**
+ * @brief This function limits a ray to the part of space the planes keep.
+ * @param origin is the start of the ray.
+ * @param direction is the direction of the ray.
+ * @param enter receives the distance at which the ray enters the kept space.
+ * @param leave receives the distance at which the ray leaves it, HUGE_VAL if it never does.
+ * @return false if the ray never reaches the kept space.
+ */
+bool SectionPlanes::clipRay(const double origin[3], const double direction[3], double& enter, double& leave) const {
+    enter = 0.;
+    leave = HUGE_VAL;
+
+    /* The kept space is convex, the intersection of one half space per plane */
+    std::vector<double> equations = activePlanes();
+    for (size_t i = 0; i < equations.size(); i += 4) {
+        const double* e = &equations[i];
+        double rate = e[0] * direction[0] + e[1] * direction[1] + e[2] * direction[2];
+        double value = e[0] * origin[0] + e[1] * origin[1] + e[2] * origin[2] + e[3];
+        if (rate == 0.) {
+            if (value < 0.)
+                return false;
+        } else if (rate > 0.) {
+            enter = std::max(enter, -value / rate);
+        } else {
+            leave = std::min(leave, -value / rate);
+        }
+    }
+    return enter <= leave;
+}
+
+/**
+ * @brief This function leaves a prop of the renderer uncut.
+ * @param prop is the prop.
+ */
+void SectionPlanes::exclude(vtkProp* prop) {
+    if (prop != nullptr)
+        excluded.insert(prop);
+}
+
+/**
+ * @brief This function gives a part the faces cut by the planes, replacing its previous cap.
+ * @param part is the part's actor in this view.
+ * @param cap is the cap in the part's model coordinates, with the planes it was cut with, or nullptr to remove it.
+ */
+void SectionPlanes::setCap(vtkActor* part, std::shared_ptr<const PartGeometry> cap) {
+    removeCap(part);
+    if (part == nullptr || cap == nullptr)
+        return;
+
+    /* A cap that does not say where it was cut can never be checked, so it is never shown */
+    vtkDoubleArray* cut = vtkDoubleArray::SafeDownCast(cap->polyData()->GetFieldData()->GetArray(CAP_PLANES));
+    if (cut == nullptr)
+        return;
+
+    Cap entry;
+    entry.part = part;
+    entry.geometry = cap;
+    entry.planes.assign(cut->GetPointer(0), cut->GetPointer(0) + cut->GetNumberOfValues());
+    entry.actor = cap->createActor();
+    entry.actor->PickableOff();
+    entry.actor->GetProperty()->DeepCopy(part->GetProperty());
+    vtkNew<vtkMatrix4x4> matrix;
+    entry.actor->SetUserMatrix(matrix);
+    entry.checked = 0;
+    entry.version = version - 1;
+
+    excluded.insert(entry.actor);
+    if (renderer != nullptr)
+        renderer->AddActor(entry.actor);
+
+    check(entry);
+    caps[part] = entry;
+}
+
+/**
+ * @brief This function removes the cap of a part, if it has one.
+ * @param part is the part's actor in this view.
+ */
+void SectionPlanes::removeCap(vtkActor* part) {
+    auto it = caps.find(part);
+    if (it == caps.end())
+        return;
+
+    if (renderer != nullptr)
+        renderer->RemoveActor(it->second.actor);
+    excluded.erase(it->second.actor);
+    caps.erase(it);
+}
+
+/**
+ * @brief This function removes every cap.
+ */
+void SectionPlanes::clearCaps() {
+    for (auto& entry : caps) {
+        if (renderer != nullptr)
+            renderer->RemoveActor(entry.second.actor);
+        excluded.erase(entry.second.actor);
+    }
+    caps.clear();
+    shownCaps = 0;
+}
+
+/**
+ * @brief This function returns the number of caps shown at the last update().
+ * @return the number of caps.
+ */
+int SectionPlanes::visibleCaps() const {
+    return shownCaps;
+}
+
+/**
+ * @brief This function gives every mapper of the renderer the planes and shows the caps that are still valid.
+ * The mappers are checked every time because levels of detail and instancing swap them at any render;
+ * a mapper that already has the planes is left alone.
+ */
+void SectionPlanes::update() {
+    if (renderer == nullptr)
+        return;
+
+    vtkPlaneCollection* wanted = activeCount() > 0 ? collection.Get() : nullptr;
+    vtkPropCollection* props = renderer->GetViewProps();
+    vtkCollectionSimpleIterator it;
+    props->InitTraversal(it);
+    while (vtkProp* prop = props->GetNextProp(it)) {
+        if (excluded.count(prop) > 0)
+            continue;
+
+        vtkActor* actor = vtkActor::SafeDownCast(prop);
+        vtkMapper* mapper = actor != nullptr ? actor->GetMapper() : nullptr;
+        if (mapper != nullptr && mapper->GetClippingPlanes() != wanted)
+            mapper->SetClippingPlanes(wanted);
+    }
+
+    shownCaps = 0;
+    for (auto& entry : caps) {
+        check(entry.second);
+        if (entry.second.actor->GetVisibility())
+            shownCaps++;
+    }
+}
+
+/**
+ * @brief This function expresses plane equations in the model coordinates of an actor.
+ * A plane is a row vector that multiplies points, so in model coordinates it is the plane times the matrix.
+ * @param matrix is the actor's matrix, from model to world coordinates.
+ * @param world are the equations in world coordinates, four values per plane.
+ * @return the equations in model coordinates, with unit normals.
+ */
+std::vector<double> SectionPlanes::toModel(vtkMatrix4x4* matrix, const std::vector<double>& world) {
+    std::vector<double> model(world.size());
+    for (size_t i = 0; i + 3 < world.size(); i += 4) {
+        double* m = &model[i];
+        for (int column = 0; column < 4; column++) {
+            m[column] = 0.;
+            for (int row = 0; row < 4; row++)
+                m[column] += world[i + size_t(row)] * matrix->GetElement(row, column);
+        }
+
+        double length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+        if (length > 0.) {
+            for (int k = 0; k < 4; k++)
+                m[k] /= length;
+        }
+    }
+    return model;
+}
+
+/**
+ * @brief This function shows a cap if its part is visible and still cut where it was, and gives it the part's matrix and colour.
+ * @param cap is the cap.
+ */
+void SectionPlanes::check(Cap& cap) {
+    vtkActor* part = cap.part;
+    if (cap.checked == part->GetMTime() && cap.version == version)
+        return;
+    cap.checked = part->GetMTime();
+    cap.version = version;
+
+    bool valid = part->GetVisibility() != 0 && activeCount() > 0;
+    if (valid) {
+        std::vector<double> current = toModel(part->GetMatrix(), activePlanes());
+        valid = current.size() == cap.planes.size();
+        for (size_t i = 0; valid && i < current.size(); i++)
+            valid = std::abs(current[i] - cap.planes[i]) <= PLANE_TOLERANCE * (1. + std::abs(cap.planes[i]));
+    }
+
+    cap.actor->SetVisibility(valid);
+    if (!valid)
+        return;
+
+    cap.actor->GetUserMatrix()->DeepCopy(part->GetMatrix());
+    double colour[3];
+    part->GetProperty()->GetColor(colour);
+    cap.actor->GetProperty()->SetColor(colour[0] * CAP_SHADE, colour[1] * CAP_SHADE, colour[2] * CAP_SHADE);
+    cap.actor->GetProperty()->SetOpacity(part->GetProperty()->GetOpacity());
+}
@@ -0,0 +1,195 @@
+/** @file SectionPlanes.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Section planes applied to every part of a view when it is drawn.
+  */
+
+#ifndef VIEWER_SECTIONPLANES_H
+#define VIEWER_SECTIONPLANES_H
+
+#include "PartGeometry.h"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+#include <vtkRenderer.h>
+
+/**
+ * @class SectionPlanes
+ * @brief The SectionPlanes class cuts away the parts of a view on the far side of up to six planes, on the GPU.
+ *
+ * Every mapper in the view's renderer is given the same vtkPlaneCollection, so the planes are
+ * evaluated per fragment while drawing and no geometry is ever regenerated. Moving a plane only
+ * moves one vtkPlane in place: the collection itself does not change, so mappers keep their
+ * buffers and only the plane values they pass to the shader change. The collection always holds
+ * all six planes while any plane is on, unused planes are parked where they keep everything, so
+ * turning a second plane on or off costs nothing either. Only turning the first plane on and the
+ * last plane off changes the mappers (they then rebuild their buffers once).
+ *
+ * Cut faces (caps) are not drawn by the planes. They are computed in the background by the
+ * SectionCapper once the planes stop moving and given to the view with setCap(). A cap is drawn
+ * with its part's matrix and colour and is only shown while the part and the planes are where
+ * they were when it was cut, which is checked against the planes stored with the cap, so stale
+ * caps disappear as soon as a plane or the part moves.
+ *
+ * Mappers are brought in step by update(), which the view calls before every render, so mappers
+ * created later (levels of detail, instanced copies) are cut too. Each view (desktop and VR) has
+ * its own planes and caps. The class is not thread safe, it must only be used by the thread that
+ * renders its view.
+ */
+class SectionPlanes {
+public:
+    /**
+     * @brief Number of planes, the most an OpenGL mapper supports.
+     */
+    static const int MAX_PLANES = 6;
+
+    /**
+     * @brief Name of the field data array of a cap that holds the planes it was cut with, in its part's model coordinates.
+     */
+    static const char* const CAP_PLANES;
+
+    /**
+     * @brief Constructor for the SectionPlanes class.
+     */
+    SectionPlanes();
+
+    /**
+     * @brief Destructor for the SectionPlanes class, removes the caps from the renderer.
+     */
+    ~SectionPlanes();
+
+    /**
+     * @brief This function sets the renderer whose mappers are cut and caps are added to.
+     * @param renderer is the renderer.
+     */
+    void setRenderer(vtkRenderer* renderer);
+
+    /**
+     * @brief This function moves, turns on or turns off one plane.
+     * @param index is the plane, 0 to MAX_PLANES - 1.
+     * @param enabled is true to cut the view with the plane.
+     * @param origin is a point on the plane, in world coordinates.
+     * @param normal is the normal of the plane, the side it points to is kept.
+     */
+    void setPlane(int index, bool enabled, const double origin[3], const double normal[3]);
+
+    /**
+     * @brief This function checks if a plane is on.
+     * @param index is the plane.
+     * @return true if the plane cuts the view.
+     */
+    bool isEnabled(int index) const;
+
+    /**
+     * @brief This function returns where a plane is, whether or not it is on.
+     * @param index is the plane.
+     * @param origin receives a point on the plane.
+     * @param normal receives the unit normal of the plane.
+     */
+    void getPlane(int index, double origin[3], double normal[3]) const;
+
+    /**
+     * @brief This function returns the number of planes that are on.
+     * @return the number of planes.
+     */
+    int activeCount() const;
+
+    /**
+     * @brief This function returns the equations of the planes that are on, in index order.
+     * @return four values per plane: the unit normal and the offset, points with a positive or zero value are kept.
+     */
+    std::vector<double> activePlanes() const;
+
+    /**
+     * @brief This function limits a ray to the part of space the planes keep.
+     * @param origin is the start of the ray.
+     * @param direction is the direction of the ray.
+     * @param enter receives the distance (in multiples of direction) at which the ray enters the kept space.
+     * @param leave receives the distance at which the ray leaves it, HUGE_VAL if it never does.
+     * @return false if the ray never reaches the kept space.
+     */
+    bool clipRay(const double origin[3], const double direction[3], double& enter, double& leave) const;
+
+    /**
+     * @brief This function leaves a prop of the renderer uncut, e.g. an outline or a background.
+     * @param prop is the prop.
+     */
+    void exclude(vtkProp* prop);
+
+    /**
+     * @brief This function gives a part the faces cut by the planes, replacing its previous cap.
+     * @param part is the part's actor in this view.
+     * @param cap is the cap in the part's model coordinates, with the planes it was cut with (see CAP_PLANES), or nullptr to remove it.
+     */
+    void setCap(vtkActor* part, std::shared_ptr<const PartGeometry> cap);
+
+    /**
+     * @brief This function removes the cap of a part, if it has one.
+     * @param part is the part's actor in this view.
+     */
+    void removeCap(vtkActor* part);
+
+    /**
+     * @brief This function removes every cap.
+     */
+    void clearCaps();
+
+    /**
+     * @brief This function returns the number of caps shown at the last update().
+     * @return the number of caps.
+     */
+    int visibleCaps() const;
+
+    /**
+     * @brief This function gives every mapper of the renderer the planes and shows the caps that are still valid, it is called before each render.
+     */
+    void update();
+
+    /**
+     * @brief This function expresses plane equations in the model coordinates of an actor.
+     * @param matrix is the actor's matrix, from model to world coordinates.
+     * @param world are the equations in world coordinates, four values per plane.
+     * @return the equations in model coordinates, with unit normals.
+     */
+    static std::vector<double> toModel(vtkMatrix4x4* matrix, const std::vector<double>& world);
+
+private:
+    /**
+     * @struct Cap
+     * @brief The Cap structure holds the cut faces of one part.
+     */
+    struct Cap {
+        vtkSmartPointer<vtkActor>               part;           /**< Part actor the cap follows */
+        std::shared_ptr<const PartGeometry>     geometry;       /**< Faces, in the part's model coordinates */
+        std::vector<double>                     planes;         /**< Planes the faces were cut with, in model coordinates */
+        vtkSmartPointer<vtkActor>               actor;          /**< Actor drawing the faces */
+        vtkMTimeType                            checked;        /**< Part time when the cap was last checked */
+        int                                     version;        /**< Plane version when the cap was last checked */
+    };
+
+    /**
+     * @brief This function shows a cap if its part is visible and still cut where it was, and gives it the part's matrix and colour.
+     * @param cap is the cap.
+     */
+    void check(Cap& cap);
+
+    vtkRenderer*                                        renderer;       /**< Renderer whose mappers are cut */
+    vtkSmartPointer<vtkPlane>                           planes[MAX_PLANES]; /**< Every plane, parked where it keeps everything while off */
+    bool                                                enabled[MAX_PLANES]; /**< True for the planes that are on */
+    double                                              origins[MAX_PLANES][3]; /**< Point on each plane */
+    double                                              normals[MAX_PLANES][3]; /**< Unit normal of each plane */
+    vtkSmartPointer<vtkPlaneCollection>                 collection;     /**< Planes given to the mappers while any plane is on */
+    int                                                 version;        /**< Incremented whenever a plane changes */
+    std::unordered_set<vtkProp*>                        excluded;       /**< Props left uncut */
+    std::unordered_map<vtkActor*, Cap>                  caps;           /**< Cap of each part actor */
+    int                                                 shownCaps;      /**< Caps shown at the last update */
+};
+
+#endif
@@ -0,0 +1,28 @@
+/** @file ShownPartDelegate.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Item delegate that tells the part tree which rows a view paints.
+  */
+
+#include "ShownPartDelegate.h"
+#include "ModelPartList.h"
+
+/**
+ * @brief Constructor for the ShownPartDelegate class.
+ * @param model is the model told about the painted rows, the view's model.
+ * @param parent is a pointer to the parent QObject, usually the view.
+ */
+ShownPartDelegate::ShownPartDelegate(ModelPartList* model, QObject* parent)
+    : QStyledItemDelegate(parent), model(model) {
+}
+
+/**
+ * @brief This function paints a row and tells the model its part is shown.
+ * @param painter is the painter.
+ * @param option is the style of the item.
+ * @param index is the item.
+ */
+void ShownPartDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    if (index.column() == 0)
+        model->partShown(index);
+    QStyledItemDelegate::paint(painter, option, index);
+}
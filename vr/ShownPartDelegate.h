@@ -0,0 +1,42 @@
+/** @file ShownPartDelegate.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Item delegate that tells the part tree which rows a view paints.
+  */
+
+#ifndef VIEWER_SHOWNPARTDELEGATE_H
+#define VIEWER_SHOWNPARTDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+class ModelPartList;
+
+/**
+ * @class ShownPartDelegate
+ * @brief The ShownPartDelegate class paints the tree's rows as usual and tells the model which parts are on screen.
+ *
+ * Views only paint the rows in their viewport, so ModelPartList::partShown() is called for exactly
+ * the parts the user can see: it stamps them for the ResidencyManager and requests the geometry of
+ * parts added lazily.
+ */
+class ShownPartDelegate : public QStyledItemDelegate {
+public:
+    /**
+     * @brief Constructor for the ShownPartDelegate class.
+     * @param model is the model told about the painted rows, the view's model.
+     * @param parent is a pointer to the parent QObject, usually the view.
+     */
+    ShownPartDelegate(ModelPartList* model, QObject* parent = nullptr);
+
+    /**
+     * @brief This function paints a row and tells the model its part is shown.
+     * @param painter is the painter.
+     * @param option is the style of the item.
+     * @param index is the item.
+     */
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+private:
+    ModelPartList* model;   /**< Model told about the painted rows */
+};
+
+#endif
@@ -0,0 +1,566 @@
+/** @file SimulatedHMD.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * A headset that renders offscreen and plays back scripted poses and controller actions.
+  */
+
+#include "SimulatedHMD.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <vtkGenericRenderWindowInteractor.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+
+namespace {
+
+/* The manifest the application ships, built into the resources */
+const char* const ACTION_MANIFEST = ":/vrbindings/vtk_openvr_actions.json";
+
+/* Length of the built-in script and the time between its actions, in seconds */
+const double DEFAULT_SECONDS = 10.;
+const double ACTION_INTERVAL = 0.5;
+
+/* The eyes converge this far in front of the head. With the default separation the angle between
+ * them is the same as for a 64 mm IPD focused at 2 m; the parts are placed about this far away */
+const double FOCAL_DISTANCE = 200.;
+const double DEFAULT_EYE_SEPARATION = 6.4;
+
+/* Vertical field of view of each eye, in degrees */
+const double VIEW_ANGLE = 100.;
+
+/**
+ * @struct Binding
+ * @brief The Binding structure gives the controller input an action is bound to on a typical controller.
+ */
+struct Binding {
+    const char*                 action;     /**< Action name */
+    vtkEventDataDeviceInput     input;      /**< Input reported with its events */
+};
+
+const Binding BINDINGS[] = {
+    { "/actions/vtk/in/TriggerAction",      vtkEventDataDeviceInput::Trigger },
+    { "/actions/vtk/in/LeftGripAction",     vtkEventDataDeviceInput::Grip },
+    { "/actions/vtk/in/RightGripAction",    vtkEventDataDeviceInput::Grip },
+    { "/actions/vtk/in/PositionProp",       vtkEventDataDeviceInput::Grip },
+    { "/actions/vtk/in/ShowMenu",           vtkEventDataDeviceInput::ApplicationMenu },
+    { "/actions/vtk/in/NextCameraPose",     vtkEventDataDeviceInput::ApplicationMenu },
+    { "/actions/vtk/in/StartMovement",      vtkEventDataDeviceInput::TrackPad },
+    { "/actions/vtk/in/StartElevation",     vtkEventDataDeviceInput::TrackPad },
+    { "/actions/vtk/in/Movement",           vtkEventDataDeviceInput::TrackPad },
+    { "/actions/vtk/in/Elevation",          vtkEventDataDeviceInput::TrackPad }
+};
+
+/**
+ * @brief This function returns the input an action is bound to, Unknown if it has no binding.
+ */
+vtkEventDataDeviceInput boundInput(const QString& action) {
+    for (const Binding& binding : BINDINGS) {
+        if (action == binding.action)
+            return binding.input;
+    }
+    return vtkEventDataDeviceInput::Unknown;
+}
+
+/**
+ * @brief This function returns the controller that performs an action when a script does not say.
+ */
+vtkEventDataDevice defaultHand(const QString& action) {
+    return action.contains("Left") ? vtkEventDataDevice::LeftController : vtkEventDataDevice::RightController;
+}
+
+/**
+ * @brief This function reads a vector of three numbers, leaving the output unchanged if the value is not one.
+ */
+bool readVector(const QJsonValue& value, double out[3]) {
+    QJsonArray array = value.toArray();
+    if (array.size() != 3)
+        return false;
+    for (int i = 0; i < 3; i++)
+        out[i] = array[i].toDouble();
+    return true;
+}
+
+/**
+ * @brief This function sets a pose that looks down -Z with +Y up, from a position.
+ */
+SimulatedHMD::Pose facingForward(double x, double y, double z) {
+    return { { x, y, z }, { 0., 0., -1. }, { 0., 1., 0. } };
+}
+
+/**
+ * @brief This function reads a track of keyframes, each with a time, a position and optionally a direction and up.
+ */
+bool readTrack(const QJsonValue& value, std::vector<SimulatedHMD::Keyframe>& track) {
+    track.clear();
+    for (const QJsonValue& entry : value.toArray()) {
+        QJsonObject object = entry.toObject();
+        SimulatedHMD::Keyframe keyframe = { object.value("time").toDouble(), facingForward(0., 0., 0.) };
+        if (!readVector(object.value("position"), keyframe.pose.position))
+            return false;
+        readVector(object.value("direction"), keyframe.pose.direction);
+        readVector(object.value("up"), keyframe.pose.up);
+        vtkMath::Normalize(keyframe.pose.direction);
+        vtkMath::Normalize(keyframe.pose.up);
+        track.push_back(keyframe);
+    }
+
+    std::stable_sort(track.begin(), track.end(), [](const SimulatedHMD::Keyframe& a, const SimulatedHMD::Keyframe& b) {
+        return a.time < b.time;
+    });
+    return true;
+}
+
+/**
+ * @brief This function returns a direction turned by a yaw (about +Y) and a pitch, from looking down -Z.
+ */
+void yawPitch(double yawDegrees, double pitchDegrees, double out[3]) {
+    double yaw = vtkMath::RadiansFromDegrees(yawDegrees);
+    double pitch = vtkMath::RadiansFromDegrees(pitchDegrees);
+    out[0] = std::sin(yaw) * std::cos(pitch);
+    out[1] = std::sin(pitch);
+    out[2] = -std::cos(yaw) * std::cos(pitch);
+}
+
+}
+
+/**
+ * @brief Constructor for the SimulatedHMD class.
+ * @param eyeWidth is the width of each eye's image in pixels.
+ * @param eyeHeight is the height of each eye's image in pixels.
+ * @param refreshRate is the simulated display refresh rate in Hz.
+ */
+SimulatedHMD::SimulatedHMD(int eyeWidth, int eyeHeight, double refreshRate)
+    : eyeWidth(eyeWidth), eyeHeight(eyeHeight), refreshRate(refreshRate > 0. ? refreshRate : 90.),
+      eyeSeparation(DEFAULT_EYE_SEPARATION), paced(false), frames(0), nextAction(0), frame(0), measured() {
+    const double origin[3] = { 0., 0., 0. };
+    const double forward[3] = { 0., 0., -1. };
+    const double up[3] = { 0., 1., 0. };
+    setPhysicalPose(origin, forward, up);
+
+    leftPose = facingForward(0., 0., 0.);
+    rightPose = facingForward(0., 0., 0.);
+
+    loadActions(ACTION_MANIFEST);
+    setDefaultScript(DEFAULT_SECONDS);
+}
+
+/**
+ * @brief This function reads the actions scripts may use from an OpenVR action manifest.
+ * @param fileName is the manifest, the one in the resources is used by default.
+ * @return false if the file could not be read.
+ */
+bool SimulatedHMD::loadActions(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to read" << fileName;
+        return false;
+    }
+
+    QJsonArray list = QJsonDocument::fromJson(file.readAll()).object().value("actions").toArray();
+    if (list.isEmpty()) {
+        qDebug() << "No actions in" << fileName;
+        return false;
+    }
+
+    actionTypes.clear();
+    for (const QJsonValue& entry : list) {
+        QJsonObject action = entry.toObject();
+        actionTypes.insert(action.value("name").toString(), action.value("type").toString());
+    }
+    return true;
+}
+
+/**
+ * @brief This function reads a script of head and controller keyframes and actions from a JSON file.
+ *
+ * The script is an object with "head", "left" and "right" arrays of keyframes ({"time", "position",
+ * "direction", "up"}), an "actions" array ({"time", "action", "hand", "pressed"} for boolean actions,
+ * {"time", "action", "hand", "value": [x, y]} for vector2 actions) and optionally "rate" (Hz) and
+ * "duration" (seconds, by default until the last keyframe or action).
+ * @param fileName is the script.
+ * @return false if the file could not be read or uses an action the manifest does not have.
+ */
+bool SimulatedHMD::loadScript(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to read" << fileName;
+        return false;
+    }
+    QJsonObject script = QJsonDocument::fromJson(file.readAll()).object();
+
+    std::vector<Keyframe> headTrack, leftTrack, rightTrack;
+    if (!readTrack(script.value("head"), headTrack) || !readTrack(script.value("left"), leftTrack) ||
+        !readTrack(script.value("right"), rightTrack)) {
+        qDebug() << "A keyframe has no position in" << fileName;
+        return false;
+    }
+
+    std::vector<Action> scriptActions;
+    for (const QJsonValue& entry : script.value("actions").toArray()) {
+        QJsonObject object = entry.toObject();
+        Action action = { object.value("time").toDouble(), object.value("action").toString(),
+                          vtkEventDataDevice::RightController, object.value("pressed").toBool(true), { 0., 0. } };
+
+        if (!actionTypes.contains(action.name)) {
+            qDebug() << "The action manifest has no" << action.name;
+            return false;
+        }
+
+        QString hand = object.value("hand").toString();
+        action.device = hand == "left" ? vtkEventDataDevice::LeftController :
+                        hand == "right" ? vtkEventDataDevice::RightController : defaultHand(action.name);
+
+        if (actionTypes.value(action.name) == "vector2") {
+            QJsonArray value = object.value("value").toArray();
+            if (value.size() != 2) {
+                qDebug() << action.name << "needs a value of two numbers";
+                return false;
+            }
+            action.value[0] = value[0].toDouble();
+            action.value[1] = value[1].toDouble();
+        }
+        scriptActions.push_back(action);
+    }
+    std::stable_sort(scriptActions.begin(), scriptActions.end(), [](const Action& a, const Action& b) {
+        return a.time < b.time;
+    });
+
+    if (script.value("rate").toDouble() > 0.)
+        refreshRate = script.value("rate").toDouble();
+
+    double duration = script.value("duration").toDouble();
+    if (duration <= 0.) {
+        for (const std::vector<Keyframe>* track : { &headTrack, &leftTrack, &rightTrack }) {
+            if (!track->empty())
+                duration = std::max(duration, track->back().time);
+        }
+        if (!scriptActions.empty())
+            duration = std::max(duration, scriptActions.back().time);
+    }
+
+    head.swap(headTrack);
+    left.swap(leftTrack);
+    right.swap(rightTrack);
+    actions.swap(scriptActions);
+    frames = uint64_t(std::ceil(duration * refreshRate)) + 1;
+    return true;
+}
+
+/**
+ * @brief This function replaces the script with the built-in one.
+ * The head looks left and right and up and down in front of the parts, the right controller sweeps across
+ * them, and every half second the next action of the manifest is pressed and released (or pushed and let go).
+ * @param seconds is the length of the script.
+ */
+void SimulatedHMD::setDefaultScript(double seconds) {
+    head.clear();
+    left.clear();
+    right.clear();
+    actions.clear();
+
+    for (double t = 0.; t <= seconds + 0.25; t += 0.25) {
+        Keyframe keyframe = { t, facingForward(0., 0., 0.) };
+        yawPitch(20. * std::sin(2. * vtkMath::Pi() * t / 8.), -15. + 10. * std::sin(2. * vtkMath::Pi() * t / 5.),
+                 keyframe.pose.direction);
+        head.push_back(keyframe);
+
+        keyframe.pose = facingForward(60., -100., -100.);
+        yawPitch(-30. + 30. * std::sin(2. * vtkMath::Pi() * t / 6.), 0., keyframe.pose.direction);
+        right.push_back(keyframe);
+    }
+    left.push_back({ 0., facingForward(-60., -100., -100.) });
+
+    QStringList names = actionTypes.keys();
+    names.sort();
+    for (int i = 0; !names.isEmpty() && (i + 1) * ACTION_INTERVAL < seconds; i++) {
+        const QString& name = names[i % names.size()];
+        double time = (i + 1) * ACTION_INTERVAL;
+
+        if (actionTypes.value(name) == "vector2") {
+            actions.push_back({ time, name, defaultHand(name), true, { 0., 1. } });
+            actions.push_back({ time + 0.5 * ACTION_INTERVAL, name, defaultHand(name), false, { 0., 0. } });
+        } else {
+            actions.push_back({ time, name, defaultHand(name), true, { 0., 0. } });
+            actions.push_back({ time + 0.2 * ACTION_INTERVAL, name, defaultHand(name), false, { 0., 0. } });
+        }
+    }
+
+    frames = uint64_t(std::ceil(seconds * refreshRate));
+}
+
+/**
+ * @brief This function sets whether frames wait for the simulated vsync.
+ * @param paced is true to wait, false to run frames back to back.
+ */
+void SimulatedHMD::setPaced(bool paced) {
+    this->paced = paced;
+}
+
+/**
+ * @brief This function sets the distance between the eyes, in scene units.
+ * @param separation is the distance.
+ */
+void SimulatedHMD::setEyeSeparation(double separation) {
+    eyeSeparation = separation;
+}
+
+/**
+ * @brief This function returns the number of frames the script lasts.
+ * @return the number of frames.
+ */
+uint64_t SimulatedHMD::frameCount() const {
+    return frames;
+}
+
+/**
+ * @brief This function returns what the simulated headset measured.
+ * @return the timings.
+ */
+SimulatedHMD::Timing SimulatedHMD::timing() const {
+    return measured;
+}
+
+/**
+ * @brief This function returns the name of the backend.
+ * @return "simulated".
+ */
+const char* SimulatedHMD::name() const {
+    return "simulated";
+}
+
+/**
+ * @brief This function creates the renderer.
+ * @return the renderer.
+ */
+vtkRenderer* SimulatedHMD::createRenderer() {
+    renderer = vtkSmartPointer<vtkRenderer>::New();
+    return renderer;
+}
+
+/**
+ * @brief This function creates the offscreen stereo window, the head camera and the interactor the controller events are fired from.
+ * @return true, the simulated headset is always there.
+ */
+bool SimulatedHMD::initialize() {
+    /* One window for both eyes, the renderer draws the left eye in the left half and the right eye in the right half */
+    renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
+    renderWindow->SetOffScreenRendering(1);
+    renderWindow->SetSize(2 * eyeWidth, eyeHeight);
+    renderWindow->SetStereoTypeToSplitViewportHorizontal();
+    renderWindow->SetStereoRender(1);
+    renderWindow->AddRenderer(renderer);
+
+    camera = vtkSmartPointer<vtkCamera>::New();
+    camera->SetViewAngle(VIEW_ANGLE);
+    camera->SetEyeAngle(vtkMath::DegreesFromRadians(2. * std::atan(0.5 * eyeSeparation / FOCAL_DISTANCE)));
+    renderer->SetActiveCamera(camera);
+
+    /* Never started, it only passes the controller events to the observers */
+    windowInteractor = vtkSmartPointer<vtkGenericRenderWindowInteractor>::New();
+    windowInteractor->SetRenderWindow(renderWindow);
+
+    frame = 0;
+    nextAction = 0;
+    measured = Timing();
+    return true;
+}
+
+/**
+ * @brief This function returns the offscreen render window.
+ * @return the window.
+ */
+vtkRenderWindow* SimulatedHMD::window() const {
+    return renderWindow;
+}
+
+/**
+ * @brief This function returns the interactor the controller events are fired from.
+ * @return the interactor.
+ */
+vtkRenderWindowInteractor* SimulatedHMD::interactor() const {
+    return windowInteractor;
+}
+
+/**
+ * @brief This function checks if the script has finished.
+ * @return true once every frame of the script has been rendered.
+ */
+bool SimulatedHMD::done() const {
+    return frame >= frames;
+}
+
+/**
+ * @brief This function moves the head and controllers to this frame's poses, fires the actions that are due and renders both eyes.
+ */
+void SimulatedHMD::processFrame() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (frame == 0)
+        start = now;
+
+    /* The compositor hands out a new frame once per refresh */
+    if (paced) {
+        std::chrono::steady_clock::time_point vsync =
+            start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(double(frame) / refreshRate));
+        if (now < vsync) {
+            std::this_thread::sleep_until(vsync);
+            measured.waitMs += std::chrono::duration<double, std::milli>(vsync - now).count();
+        }
+    }
+
+    double time = double(frame) / refreshRate;
+
+    Pose headPose = facingForward(0., 0., 0.);
+    interpolate(head, time, headPose);
+    double eye[3], direction[3], up[3], focus[3];
+    toWorld(headPose.position, eye, false);
+    toWorld(headPose.direction, direction, true);
+    toWorld(headPose.up, up, true);
+    vtkMath::Normalize(direction);
+    for (int i = 0; i < 3; i++)
+        focus[i] = eye[i] + FOCAL_DISTANCE * direction[i];
+
+    camera->SetPosition(eye);
+    camera->SetFocalPoint(focus);
+    camera->SetViewUp(up);
+    renderer->ResetCameraClippingRange();
+
+    interpolate(left, time, leftPose);
+    interpolate(right, time, rightPose);
+    moveController(vtkEventDataDevice::LeftController, leftPose);
+    moveController(vtkEventDataDevice::RightController, rightPose);
+
+    while (nextAction < actions.size() && actions[nextAction].time <= time)
+        fire(actions[nextAction++]);
+
+    std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
+    renderWindow->Render();
+    std::chrono::steady_clock::time_point renderEnd = std::chrono::steady_clock::now();
+
+    double renderMs = std::chrono::duration<double, std::milli>(renderEnd - renderStart).count();
+    measured.renderMs += renderMs;
+    measured.maxRenderMs = std::max(measured.maxRenderMs, renderMs);
+    measured.seconds = std::chrono::duration<double>(renderEnd - start).count();
+    measured.frames = ++frame;
+}
+
+/**
+ * @brief This function places the physical space in the scene, in the same way as the OpenVR render window.
+ * Scene = [right, up, -direction] * physical - translation, with right = direction x up.
+ * @param translation is the physical translation.
+ * @param direction is the scene direction the user faces.
+ * @param up is the scene direction that is up for the user.
+ */
+void SimulatedHMD::setPhysicalPose(const double translation[3], const double direction[3], const double up[3]) {
+    double right[3];
+    vtkMath::Cross(direction, up, right);
+    for (int i = 0; i < 3; i++) {
+        physical[i][0] = right[i];
+        physical[i][1] = up[i];
+        physical[i][2] = -direction[i];
+        physical[i][3] = -translation[i];
+    }
+}
+
+/**
+ * @brief This function returns the pose of a track at a script time.
+ * @param track is the keyframes, in time order.
+ * @param time is the script time.
+ * @param pose is set to the pose, interpolated between the keyframes either side.
+ */
+void SimulatedHMD::interpolate(const std::vector<Keyframe>& track, double time, Pose& pose) {
+    if (track.empty())
+        return;
+
+    auto after = std::upper_bound(track.begin(), track.end(), time, [](double t, const Keyframe& keyframe) {
+        return t < keyframe.time;
+    });
+    if (after == track.begin()) {
+        pose = track.front().pose;
+        return;
+    }
+    if (after == track.end()) {
+        pose = track.back().pose;
+        return;
+    }
+
+    const Pose& a = (after - 1)->pose;
+    const Pose& b = after->pose;
+    double span = after->time - (after - 1)->time;
+    double f = span > 0. ? (time - (after - 1)->time) / span : 1.;
+    for (int i = 0; i < 3; i++) {
+        pose.position[i] = a.position[i] + f * (b.position[i] - a.position[i]);
+        pose.direction[i] = a.direction[i] + f * (b.direction[i] - a.direction[i]);
+        pose.up[i] = a.up[i] + f * (b.up[i] - a.up[i]);
+    }
+    vtkMath::Normalize(pose.direction);
+    vtkMath::Normalize(pose.up);
+}
+
+/**
+ * @brief This function turns a physical position or direction into scene coordinates.
+ * @param in is the physical position or direction.
+ * @param out is set to the scene position or direction.
+ * @param isDirection is true for a direction, which is not translated.
+ */
+void SimulatedHMD::toWorld(const double in[3], double out[3], bool isDirection) const {
+    for (int i = 0; i < 3; i++) {
+        out[i] = physical[i][0] * in[0] + physical[i][1] * in[1] + physical[i][2] * in[2];
+        if (!isDirection)
+            out[i] += physical[i][3];
+    }
+}
+
+/**
+ * @brief This function fires the event of a controller action.
+ * Boolean actions fire a Button3DEvent (press or release), vector2 actions a Move3DEvent with the track pad position.
+ * @param action is the action.
+ */
+void SimulatedHMD::fire(const Action& action) {
+    const Pose& pose = action.device == vtkEventDataDevice::LeftController ? leftPose : rightPose;
+    double position[3], direction[3];
+    toWorld(pose.position, position, false);
+    toWorld(pose.direction, direction, true);
+
+    vtkNew<vtkEventDataDevice3D> data;
+    data->SetDevice(action.device);
+    data->SetInput(boundInput(action.name));
+    data->SetWorldPosition(position);
+    data->SetWorldDirection(direction);
+
+    if (actionTypes.value(action.name) == "vector2") {
+        data->SetAction(action.pressed ? vtkEventDataAction::Touch : vtkEventDataAction::Untouch);
+        data->SetTrackPadPosition(action.value[0], action.value[1]);
+        windowInteractor->InvokeEvent(vtkCommand::Move3DEvent, data);
+    } else {
+        data->SetAction(action.pressed ? vtkEventDataAction::Press : vtkEventDataAction::Release);
+        windowInteractor->InvokeEvent(vtkCommand::Button3DEvent, data);
+    }
+    measured.actions++;
+}
+
+/**
+ * @brief This function fires a Move3DEvent with a controller's pose, as the OpenVR interactor does every frame.
+ * @param device is the controller.
+ * @param pose is its physical pose.
+ */
+void SimulatedHMD::moveController(vtkEventDataDevice device, const Pose& pose) {
+    double position[3], direction[3];
+    toWorld(pose.position, position, false);
+    toWorld(pose.direction, direction, true);
+
+    vtkNew<vtkEventDataDevice3D> data;
+    data->SetDevice(device);
+    data->SetWorldPosition(position);
+    data->SetWorldDirection(direction);
+    windowInteractor->InvokeEvent(vtkCommand::Move3DEvent, data);
+}
@@ -0,0 +1,245 @@
+/** @file SimulatedHMD.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * A headset that renders offscreen and plays back scripted poses and controller actions.
+  */
+
+#ifndef VIEWER_SIMULATEDHMD_H
+#define VIEWER_SIMULATEDHMD_H
+
+#include "VRBackend.h"
+
+#include <QHash>
+#include <QString>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkCamera.h>
+#include <vtkEventData.h>
+
+/**
+ * @class SimulatedHMD
+ * @brief The SimulatedHMD class is a VRBackend that needs no headset, so the VR loop can be run and profiled anywhere.
+ *
+ * Both eyes are rendered offscreen into one window (left half and right half) by a camera that
+ * follows a scripted head; two scripted controllers fire the same Button3DEvent and Move3DEvent
+ * events as the OpenVR interactor. The actions a script may use are read from the OpenVR action
+ * manifest (vrbindings/vtk_openvr_actions.json), so a script cannot use an action the real
+ * bindings do not have.
+ *
+ * Script time advances by one refresh per frame, so the same script gives the same poses and
+ * actions on the same frames however long each frame takes. When pacing is on each frame also
+ * waits for the next simulated vsync, as the OpenVR compositor does; when it is off frames run
+ * back to back and their times measure the cost of the VR loop alone.
+ *
+ * The setup functions are called before the VR thread starts, timing() after it has finished;
+ * everything else is called by the VR thread.
+ */
+class SimulatedHMD : public VRBackend {
+public:
+    /**
+     * @struct Pose
+     * @brief The Pose structure holds where a tracked device is and where it points, in physical coordinates.
+     */
+    struct Pose {
+        double      position[3];    /**< Position */
+        double      direction[3];   /**< Direction the device points (the view direction for the head) */
+        double      up[3];          /**< Up direction of the device */
+    };
+
+    /**
+     * @struct Keyframe
+     * @brief The Keyframe structure holds a pose at a script time, poses between keyframes are interpolated.
+     */
+    struct Keyframe {
+        double      time;           /**< Script time in seconds */
+        Pose        pose;           /**< Pose at that time */
+    };
+
+    /**
+     * @struct Action
+     * @brief The Action structure holds one controller action of the script.
+     */
+    struct Action {
+        double              time;       /**< Script time in seconds */
+        QString             name;       /**< Action name from the manifest, e.g. /actions/vtk/in/TriggerAction */
+        vtkEventDataDevice  device;     /**< Controller that performs it */
+        bool                pressed;    /**< New state of a boolean action */
+        double              value[2];   /**< New position of a vector2 action */
+    };
+
+    /**
+     * @struct Timing
+     * @brief The Timing structure holds what the simulated headset measured.
+     */
+    struct Timing {
+        uint64_t    frames;         /**< Frames rendered */
+        uint64_t    actions;        /**< Actions fired */
+        double      renderMs;       /**< Total time spent rendering both eyes */
+        double      maxRenderMs;    /**< Longest render of both eyes */
+        double      waitMs;         /**< Total time spent waiting for the simulated vsync */
+        double      seconds;        /**< Wall clock time from the first frame to the last */
+    };
+
+    /**
+     * @brief Constructor for the SimulatedHMD class.
+     * @param eyeWidth is the width of each eye's image in pixels.
+     * @param eyeHeight is the height of each eye's image in pixels.
+     * @param refreshRate is the simulated display refresh rate in Hz.
+     */
+    SimulatedHMD(int eyeWidth = 1080, int eyeHeight = 1200, double refreshRate = 90.);
+
+    /**
+     * @brief This function reads the actions scripts may use from an OpenVR action manifest.
+     * @param fileName is the manifest, the one in the resources is used by default.
+     * @return false if the file could not be read.
+     */
+    bool loadActions(const QString& fileName);
+
+    /**
+     * @brief This function reads a script of head and controller keyframes and actions from a JSON file.
+     * @param fileName is the script.
+     * @return false if the file could not be read or uses an action the manifest does not have.
+     */
+    bool loadScript(const QString& fileName);
+
+    /**
+     * @brief This function replaces the script with the built-in one: the head looks around the scene and the controllers fire every action of the manifest in turn.
+     * @param seconds is the length of the script.
+     */
+    void setDefaultScript(double seconds);
+
+    /**
+     * @brief This function sets whether frames wait for the simulated vsync.
+     * @param paced is true to wait, false to run frames back to back.
+     */
+    void setPaced(bool paced);
+
+    /**
+     * @brief This function sets the distance between the eyes, in scene units.
+     * @param separation is the distance.
+     */
+    void setEyeSeparation(double separation);
+
+    /**
+     * @brief This function returns the number of frames the script lasts.
+     * @return the number of frames.
+     */
+    uint64_t frameCount() const;
+
+    /**
+     * @brief This function returns what the simulated headset measured, it must only be called once the VR thread has finished.
+     * @return the timings.
+     */
+    Timing timing() const;
+
+    /**
+     * @brief This function returns the name of the backend.
+     * @return "simulated".
+     */
+    const char* name() const override;
+
+    /**
+     * @brief This function creates the renderer.
+     * @return the renderer.
+     */
+    vtkRenderer* createRenderer() override;
+
+    /**
+     * @brief This function creates the offscreen stereo window, the head camera and the interactor the controller events are fired from.
+     * @return true, the simulated headset is always there.
+     */
+    bool initialize() override;
+
+    /**
+     * @brief This function returns the offscreen render window.
+     * @return the window.
+     */
+    vtkRenderWindow* window() const override;
+
+    /**
+     * @brief This function returns the interactor the controller events are fired from.
+     * @return the interactor.
+     */
+    vtkRenderWindowInteractor* interactor() const override;
+
+    /**
+     * @brief This function checks if the script has finished.
+     * @return true once every frame of the script has been rendered.
+     */
+    bool done() const override;
+
+    /**
+     * @brief This function moves the head and controllers to this frame's poses, fires the actions that are due and renders both eyes.
+     */
+    void processFrame() override;
+
+    /**
+     * @brief This function places the physical space in the scene, in the same way as the OpenVR render window.
+     * @param translation is the physical translation.
+     * @param direction is the scene direction the user faces.
+     * @param up is the scene direction that is up for the user.
+     */
+    void setPhysicalPose(const double translation[3], const double direction[3], const double up[3]) override;
+
+private:
+    /**
+     * @brief This function returns the pose of a track at a script time.
+     * @param track is the keyframes, in time order.
+     * @param time is the script time.
+     * @param pose is set to the pose, interpolated between the keyframes either side.
+     */
+    static void interpolate(const std::vector<Keyframe>& track, double time, Pose& pose);
+
+    /**
+     * @brief This function turns a physical position or direction into scene coordinates.
+     * @param in is the physical position or direction.
+     * @param out is set to the scene position or direction.
+     * @param isDirection is true for a direction, which is not translated.
+     */
+    void toWorld(const double in[3], double out[3], bool isDirection) const;
+
+    /**
+     * @brief This function fires the event of a controller action.
+     * @param action is the action.
+     */
+    void fire(const Action& action);
+
+    /**
+     * @brief This function fires a Move3DEvent with a controller's pose, as the OpenVR interactor does every frame.
+     * @param device is the controller.
+     * @param pose is its physical pose.
+     */
+    void moveController(vtkEventDataDevice device, const Pose& pose);
+
+    int                                         eyeWidth;           /**< Width of each eye's image */
+    int                                         eyeHeight;          /**< Height of each eye's image */
+    double                                      refreshRate;        /**< Simulated refresh rate in Hz */
+    double                                      eyeSeparation;      /**< Distance between the eyes in scene units */
+    bool                                        paced;              /**< True to wait for the simulated vsync */
+
+    QHash<QString, QString>                     actionTypes;        /**< Type (boolean, vector2) of each action in the manifest */
+    uint64_t                                    frames;             /**< Frames the script lasts */
+    std::vector<Keyframe>                       head;               /**< Head keyframes */
+    std::vector<Keyframe>                       left;               /**< Left controller keyframes */
+    std::vector<Keyframe>                       right;              /**< Right controller keyframes */
+    std::vector<Action>                         actions;            /**< Actions in time order */
+    size_t                                      nextAction;         /**< First action not fired yet */
+
+    double                                      physical[3][4];     /**< Physical to scene transform, rows of a 3x4 matrix */
+    Pose                                        leftPose;           /**< Left controller pose this frame */
+    Pose                                        rightPose;          /**< Right controller pose this frame */
+
+    uint64_t                                    frame;              /**< Frames rendered so far */
+    Timing                                      measured;           /**< Timings so far */
+    std::chrono::steady_clock::time_point       start;              /**< Time the first frame started */
+
+    vtkSmartPointer<vtkRenderWindow>            renderWindow;       /**< Offscreen window, left eye in the left half */
+    vtkSmartPointer<vtkRenderWindowInteractor>  windowInteractor;   /**< Source of the controller events */
+    vtkSmartPointer<vtkRenderer>                renderer;           /**< Renderer of the scene */
+    vtkSmartPointer<vtkCamera>                  camera;             /**< Head camera */
+};
+
+#endif
@@ -0,0 +1,417 @@
+/** @file TriangleBVH.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Bounding volume hierarchy over the triangles of one part, for exact ray picks.
+  */
+
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+
+namespace {
+
+/* Leaves hold at most this many triangles unless splitting them costs more */
+const uint32_t LEAF_SIZE = 4;
+
+/* Leaves are split whatever the cost above this size */
+const uint32_t MAX_LEAF_SIZE = 16;
+
+/* Number of bins the centroids are sorted into to evaluate splits */
+const int BINS = 16;
+
+/* Below this depth nodes are split at the median, which bounds the depth of the tree */
+const int MEDIAN_DEPTH = 40;
+
+/* Enough for MEDIAN_DEPTH levels plus median splits of 2^32 triangles */
+const int STACK_SIZE = 128;
+
+/**
+ * @brief This function returns half the surface area of a box.
+ * @param box is xmin, xmax, ymin, ymax, zmin, zmax.
+ * @return the half surface area, 0 for an empty box.
+ */
+inline float surface(const float box[6]) {
+    float dx = box[1] - box[0];
+    float dy = box[3] - box[2];
+    float dz = box[5] - box[4];
+    if (dx < 0.f)
+        return 0.f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/**
+ * @brief This function sets a box to empty, so that growing it by any box gives that box.
+ * @param box is the box.
+ */
+inline void empty(float box[6]) {
+    for (int k = 0; k < 6; k += 2) {
+        box[k] = HUGE_VALF;
+        box[k + 1] = -HUGE_VALF;
+    }
+}
+
+/**
+ * @brief This function grows a box to contain another.
+ * @param box is the box to grow.
+ * @param other is the box to contain.
+ */
+inline void grow(float box[6], const float other[6]) {
+    for (int k = 0; k < 6; k += 2) {
+        box[k] = std::min(box[k], other[k]);
+        box[k + 1] = std::max(box[k + 1], other[k + 1]);
+    }
+}
+
+/**
+ * @brief This function checks if a ray meets a box before a distance (slab test).
+ * @param lo is the minimum corner.
+ * @param hi is the maximum corner.
+ * @param origin is the start of the ray.
+ * @param inverse is one over each direction component (infinite for a zero component).
+ * @param limit is the furthest distance of interest.
+ * @return true if the ray meets the box between 0 and limit.
+ */
+inline bool rayBox(const float lo[3], const float hi[3], const double origin[3], const double inverse[3], double limit) {
+    double tNear = 0.;
+    double tFar = limit;
+    for (int k = 0; k < 3; k++) {
+        if (std::isinf(inverse[k])) {
+            if (origin[k] < lo[k] || origin[k] > hi[k])
+                return false;
+            continue;
+        }
+        double t0 = (double(lo[k]) - origin[k]) * inverse[k];
+        double t1 = (double(hi[k]) - origin[k]) * inverse[k];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tNear = std::max(tNear, t0);
+        tFar = std::min(tFar, t1);
+        if (tNear > tFar)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief This function intersects a ray with a triangle (Moller-Trumbore), both sides count.
+ * @param origin is the start of the ray.
+ * @param direction is the direction of the ray.
+ * @param a is the first vertex.
+ * @param b is the second vertex.
+ * @param c is the third vertex.
+ * @param t receives the distance to the hit.
+ * @return true if the ray hits the triangle at a distance of 0 or more.
+ */
+inline bool rayTriangle(const double origin[3], const double direction[3],
+                        const float* a, const float* b, const float* c, double& t) {
+    double e1[3], e2[3], s[3];
+    for (int k = 0; k < 3; k++) {
+        e1[k] = double(b[k]) - a[k];
+        e2[k] = double(c[k]) - a[k];
+        s[k] = origin[k] - a[k];
+    }
+
+    double p[3] = { direction[1] * e2[2] - direction[2] * e2[1],
+                    direction[2] * e2[0] - direction[0] * e2[2],
+                    direction[0] * e2[1] - direction[1] * e2[0] };
+    double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (det == 0.)
+        return false;
+    double inverse = 1. / det;
+
+    double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (u < 0. || u > 1.)
+        return false;
+
+    double q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                    s[2] * e1[0] - s[0] * e1[2],
+                    s[0] * e1[1] - s[1] * e1[0] };
+    double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (v < 0. || u + v > 1.)
+        return false;
+
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+    return t >= 0.;
+}
+
+}
+
+/**
+ * @brief Constructor for the TriangleBVH class, builds the tree.
+ * @param polyData is the mesh, its polygons are split into triangles.
+ */
+TriangleBVH::TriangleBVH(vtkPolyData* polyData) {
+    if (polyData == nullptr || polyData->GetPoints() == nullptr)
+        return;
+
+    vtkPoints* source = polyData->GetPoints();
+    vtkIdType pointCount = source->GetNumberOfPoints();
+    points.resize(size_t(pointCount) * 3);
+    for (vtkIdType i = 0; i < pointCount; i++) {
+        double p[3];
+        source->GetPoint(i, p);
+        for (int k = 0; k < 3; k++)
+            points[size_t(i) * 3 + k] = float(p[k]);
+    }
+
+    /* Polygons with more than three corners are split into a fan */
+    vtkCellArray* polys = polyData->GetPolys();
+    triangles.reserve(size_t(polys->GetNumberOfConnectivityIds()));
+    vtkSmartPointer<vtkCellArrayIterator> it = vtk::TakeSmartPointer(polys->NewIterator());
+    for (it->GoToFirstCell(); !it->IsDoneWithTraversal(); it->GoToNextCell()) {
+        vtkIdType count;
+        const vtkIdType* ids;
+        it->GetCurrentCell(count, ids);
+        for (vtkIdType j = 2; j < count; j++) {
+            triangles.push_back(uint32_t(ids[0]));
+            triangles.push_back(uint32_t(ids[j - 1]));
+            triangles.push_back(uint32_t(ids[j]));
+        }
+    }
+
+    build();
+}
+
+/**
+ * @brief This function finds the first triangle a ray hits.
+ * @param origin is the start of the ray.
+ * @param direction is the direction of the ray.
+ * @param distance is the furthest distance of interest on input and receives the distance to the hit.
+ * @return true if a triangle is hit closer than distance.
+ */
+bool TriangleBVH::intersect(const double origin[3], const double direction[3], double& distance) const {
+    if (nodes.empty())
+        return false;
+
+    double inverse[3];
+    for (int k = 0; k < 3; k++)
+        inverse[k] = direction[k] != 0. ? 1. / direction[k] : HUGE_VAL;
+
+    double best = distance;
+    bool hit = false;
+
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!rayBox(node.lo, node.hi, origin, inverse, best))
+            continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.index; i < node.index + node.count; i++) {
+                const uint32_t* t = &triangles[size_t(i) * 3];
+                double d;
+                if (rayTriangle(origin, direction, &points[size_t(t[0]) * 3], &points[size_t(t[1]) * 3],
+                                &points[size_t(t[2]) * 3], d) && d < best) {
+                    best = d;
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        /* Visit the child on the ray's side first, so the other can often be skipped */
+        uint32_t nearChild = direction[node.axis] < 0. ? node.index + 1 : node.index;
+        uint32_t farChild = nearChild == node.index ? node.index + 1 : node.index;
+        stack[top++] = farChild;
+        stack[top++] = nearChild;
+    }
+
+    if (hit)
+        distance = best;
+    return hit;
+}
+
+/**
+ * @brief This function returns the number of triangles in the tree.
+ * @return the number of triangles.
+ */
+vtkIdType TriangleBVH::triangleCount() const {
+    return vtkIdType(triangles.size() / 3);
+}
+
+/**
+ * @brief This function returns the number of nodes in the tree.
+ * @return the number of nodes.
+ */
+int TriangleBVH::nodeCount() const {
+    return int(nodes.size());
+}
+
+/**
+ * @brief This function returns the host memory held by the tree.
+ * @return the size in bytes.
+ */
+size_t TriangleBVH::hostBytes() const {
+    return nodes.capacity() * sizeof(Node) + points.capacity() * sizeof(float)
+           + triangles.capacity() * sizeof(uint32_t);
+}
+
+/**
+ * @brief This function builds the tree over the triangles read by the constructor and puts them in leaf order.
+ */
+void TriangleBVH::build() {
+    const uint32_t n = uint32_t(triangles.size() / 3);
+    if (n == 0)
+        return;
+
+    /* Box and centroid of each triangle */
+    std::vector<float> boxes(size_t(n) * 6);
+    std::vector<float> centres(size_t(n) * 3);
+    for (uint32_t i = 0; i < n; i++) {
+        float* box = &boxes[size_t(i) * 6];
+        empty(box);
+        for (int v = 0; v < 3; v++) {
+            const float* p = &points[size_t(triangles[size_t(i) * 3 + v]) * 3];
+            for (int k = 0; k < 3; k++) {
+                box[2 * k] = std::min(box[2 * k], p[k]);
+                box[2 * k + 1] = std::max(box[2 * k + 1], p[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            centres[size_t(i) * 3 + k] = 0.5f * (box[2 * k] + box[2 * k + 1]);
+    }
+
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+
+    struct Task {
+        uint32_t    node;
+        uint32_t    begin;
+        uint32_t    end;
+        int         depth;
+    };
+    std::vector<Task> tasks;
+    tasks.push_back({ 0, 0, n, 0 });
+    nodes.reserve(size_t(n) / 2 + 1);
+    nodes.push_back(Node());
+
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        uint32_t count = task.end - task.begin;
+
+        float box[6], centreBox[6];
+        empty(box);
+        empty(centreBox);
+        for (uint32_t i = task.begin; i < task.end; i++) {
+            uint32_t t = order[i];
+            grow(box, &boxes[size_t(t) * 6]);
+            const float* c = &centres[size_t(t) * 3];
+            float point[6] = { c[0], c[0], c[1], c[1], c[2], c[2] };
+            grow(centreBox, point);
+        }
+
+        Node& node = nodes[task.node];
+        for (int k = 0; k < 3; k++) {
+            node.lo[k] = box[2 * k];
+            node.hi[k] = box[2 * k + 1];
+        }
+        node.index = task.begin;
+        node.count = uint16_t(count);
+        node.axis = 0;
+
+        if (count <= LEAF_SIZE)
+            continue;
+
+        /* Split along the axis the centroids spread most */
+        int axis = 0;
+        for (int k = 1; k < 3; k++) {
+            if (centreBox[2 * k + 1] - centreBox[2 * k] > centreBox[2 * axis + 1] - centreBox[2 * axis])
+                axis = k;
+        }
+        float lo = centreBox[2 * axis];
+        float extent = centreBox[2 * axis + 1] - lo;
+
+        uint32_t mid = task.begin;
+        if (extent > 0.f && task.depth < MEDIAN_DEPTH) {
+            /* Sort the centroids into bins and cost every split between bins */
+            float scale = float(BINS) * 0.9999f / extent;
+            uint32_t binCount[BINS] = {};
+            float binBox[BINS][6];
+            for (int b = 0; b < BINS; b++)
+                empty(binBox[b]);
+            for (uint32_t i = task.begin; i < task.end; i++) {
+                uint32_t t = order[i];
+                int b = std::min(BINS - 1, int((centres[size_t(t) * 3 + axis] - lo) * scale));
+                binCount[b]++;
+                grow(binBox[b], &boxes[size_t(t) * 6]);
+            }
+
+            float rightArea[BINS];
+            uint32_t rightCount[BINS];
+            float accumulated[6];
+            empty(accumulated);
+            uint32_t total = 0;
+            for (int b = BINS - 1; b > 0; b--) {
+                grow(accumulated, binBox[b]);
+                total += binCount[b];
+                rightArea[b] = surface(accumulated);
+                rightCount[b] = total;
+            }
+
+            int bestSplit = -1;
+            float bestCost = HUGE_VALF;
+            empty(accumulated);
+            total = 0;
+            for (int b = 1; b < BINS; b++) {
+                grow(accumulated, binBox[b - 1]);
+                total += binCount[b - 1];
+                if (total == 0 || rightCount[b] == 0)
+                    continue;
+                float cost = surface(accumulated) * float(total) + rightArea[b] * float(rightCount[b]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = b;
+                }
+            }
+
+            /* Keep small nodes whole when no split beats testing every triangle */
+            if (bestSplit >= 0 && bestCost >= surface(box) * float(count) && count <= MAX_LEAF_SIZE)
+                continue;
+
+            if (bestSplit >= 0) {
+                mid = uint32_t(std::partition(order.begin() + task.begin, order.begin() + task.end,
+                    [&](uint32_t t) {
+                        return std::min(BINS - 1, int((centres[size_t(t) * 3 + axis] - lo) * scale)) < bestSplit;
+                    }) - order.begin());
+            }
+        }
+
+        /* Coincident centroids, deep nodes or no useful split: halve at the median */
+        if (mid == task.begin || mid == task.end) {
+            mid = task.begin + count / 2;
+            std::nth_element(order.begin() + task.begin, order.begin() + mid, order.begin() + task.end,
+                [&](uint32_t a, uint32_t b) {
+                    return centres[size_t(a) * 3 + axis] < centres[size_t(b) * 3 + axis];
+                });
+        }
+
+        uint32_t left = uint32_t(nodes.size());
+        nodes[task.node].index = left;
+        nodes[task.node].count = 0;
+        nodes[task.node].axis = uint16_t(axis);
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+
+        tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+        tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+    }
+
+    /* Store the triangles in leaf order, so each leaf reads one contiguous run */
+    std::vector<uint32_t> sorted(triangles.size());
+    for (uint32_t i = 0; i < n; i++) {
+        for (int v = 0; v < 3; v++)
+            sorted[size_t(i) * 3 + v] = triangles[size_t(order[i]) * 3 + v];
+    }
+    triangles.swap(sorted);
+    nodes.shrink_to_fit();
+}
@@ -0,0 +1,87 @@
+/** @file TriangleBVH.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Bounding volume hierarchy over the triangles of one part, for exact ray picks.
+  */
+
+#ifndef VIEWER_TRIANGLEBVH_H
+#define VIEWER_TRIANGLEBVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vtkPolyData.h>
+#include <vtkType.h>
+
+/**
+ * @class TriangleBVH
+ * @brief The TriangleBVH class finds where a ray first hits a mesh by visiting only the triangles near the ray.
+ *
+ * It is built once from the prepared geometry when a part is loaded, on the loader's worker
+ * thread, and never changes afterwards, so it can be shared like the rest of PartGeometry. The
+ * tree is split by the surface area heuristic over 16 bins per node, with up to 4 triangles per
+ * leaf. Nodes are 32 bytes and the two children of a node are stored next to each other; the
+ * triangles are stored in leaf order as indices into a float copy of the vertex positions, so a
+ * query touches a few cache lines per level and never goes through VTK (about 37 bytes per triangle).
+ *
+ * Rays are given in the model coordinates of the mesh, both sides of each triangle are hit.
+ */
+class TriangleBVH {
+public:
+    /**
+     * @brief Constructor for the TriangleBVH class, builds the tree.
+     * @param polyData is the mesh, its polygons are split into triangles.
+     */
+    explicit TriangleBVH(vtkPolyData* polyData);
+
+    /**
+     * @brief This function finds the first triangle a ray hits.
+     * @param origin is the start of the ray.
+     * @param direction is the direction of the ray, its length is the unit of distance.
+     * @param distance is the furthest distance of interest on input and receives the distance to the hit.
+     * @return true if a triangle is hit closer than distance.
+     */
+    bool intersect(const double origin[3], const double direction[3], double& distance) const;
+
+    /**
+     * @brief This function returns the number of triangles in the tree.
+     * @return the number of triangles.
+     */
+    vtkIdType triangleCount() const;
+
+    /**
+     * @brief This function returns the number of nodes in the tree.
+     * @return the number of nodes.
+     */
+    int nodeCount() const;
+
+    /**
+     * @brief This function returns the host memory held by the tree.
+     * @return the size in bytes.
+     */
+    size_t hostBytes() const;
+
+private:
+    /**
+     * @struct Node
+     * @brief The Node structure is one box of the tree.
+     */
+    struct Node {
+        float       lo[3];          /**< Minimum corner of the box */
+        float       hi[3];          /**< Maximum corner of the box */
+        uint32_t    index;          /**< First child (the second follows it), or first triangle of a leaf */
+        uint16_t    count;          /**< Number of triangles of a leaf, 0 for an inner node */
+        uint16_t    axis;           /**< Axis the children were split along */
+    };
+
+    /**
+     * @brief This function builds the tree over the triangles read by the constructor and puts them in leaf order.
+     */
+    void build();
+
+    std::vector<Node>                           nodes;      /**< Tree, node 0 is the root */
+    std::vector<float>                          points;     /**< Vertex positions, three coordinates each */
+    std::vector<uint32_t>                       triangles;  /**< Three vertex indices per triangle, in leaf order */
+};
+
+#endif
@@ -0,0 +1,12 @@
+/** @file VRBackend.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * The headset, window and controllers the VR thread renders to.
+  */
+
+#include "VRBackend.h"
+
+/**
+ * @brief Destructor for the VRBackend class.
+ */
+VRBackend::~VRBackend() {
+}
@@ -0,0 +1,82 @@
+/** @file VRBackend.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * The headset, window and controllers the VR thread renders to.
+  */
+
+#ifndef VIEWER_VRBACKEND_H
+#define VIEWER_VRBACKEND_H
+
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+
+/**
+ * @class VRBackend
+ * @brief The VRBackend class is the interface between the VR thread and a headset runtime.
+ *
+ * The VR thread only sees a renderer to put actors in, a render window to time, an interactor
+ * that fires the controller events (Button3DEvent, Move3DEvent) and a call that processes one
+ * frame of events and renders both eyes. OpenVRBackend drives a real headset; SimulatedHMD
+ * renders offscreen and plays back a script, so the VR loop can run without a headset.
+ *
+ * A backend is created on the GUI thread and handed to the VRRenderThread before it starts;
+ * every other function is called on the VR thread.
+ */
+class VRBackend {
+public:
+    /**
+     * @brief Destructor for the VRBackend class.
+     */
+    virtual ~VRBackend();
+
+    /**
+     * @brief This function returns the name of the backend, for messages and reports.
+     * @return the name.
+     */
+    virtual const char* name() const = 0;
+
+    /**
+     * @brief This function creates the renderer the scene is added to, it is called first.
+     * @return the renderer, owned by the backend.
+     */
+    virtual vtkRenderer* createRenderer() = 0;
+
+    /**
+     * @brief This function creates the render window, camera and interactor and adds the renderer to the window.
+     * @return false if the headset could not be started, the VR thread then ends.
+     */
+    virtual bool initialize() = 0;
+
+    /**
+     * @brief This function returns the render window, valid after initialize().
+     * @return the window.
+     */
+    virtual vtkRenderWindow* window() const = 0;
+
+    /**
+     * @brief This function returns the interactor that fires the controller events, valid after initialize().
+     * @return the interactor.
+     */
+    virtual vtkRenderWindowInteractor* interactor() const = 0;
+
+    /**
+     * @brief This function checks if the session has ended (the headset was taken off or the script finished).
+     * @return true once no more frames should be rendered.
+     */
+    virtual bool done() const = 0;
+
+    /**
+     * @brief This function processes the pending headset and controller events and renders one frame for both eyes.
+     */
+    virtual void processFrame() = 0;
+
+    /**
+     * @brief This function places the physical space (the room the user stands in) in the scene.
+     * @param translation is the physical translation.
+     * @param direction is the scene direction the user faces.
+     * @param up is the scene direction that is up for the user.
+     */
+    virtual void setPhysicalPose(const double translation[3], const double direction[3], const double up[3]) = 0;
+};
+
+#endif
@@ -5,13 +5,12 @@
   */
 
 #include "VRRenderThread.h"
+#include "BVHCuller.h"
+
+#include <QDebug>
 
 /* Vtk headers */
 #include <vtkActor.h>
-#include <vtkOpenVRRenderWindow.h>				
-#include <vtkOpenVRRenderWindowInteractor.h>	
-#include <vtkOpenVRRenderer.h>					
-#include <vtkOpenVRCamera.h>	
 
 #include <vtkNew.h>
 #include <vtkSmartPointer.h>
@@ -20,8 +19,28 @@
 #include <vtkPolyDataMapper.h>
 #include <vtkProperty.h>
 #include <vtkSTLReader.h>
-#include <vtkDataSetmapper.h>
 #include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkDataSet.h>
+#include <vtkMapper.h>
+#include <vtkCullerCollection.h>
+#include <vtkEventData.h>
+#include <vtkPolyData.h>
+#include <vtkTransform.h>
+
+namespace {
+
+/* Placement of the VR scene relative to the desktop one: a rotation about X, then an offset */
+const double PLACEMENT_ROTATION_X = -90.;
+const double PLACEMENT_OFFSET[3] = { 0., -100., -200. };
+
+/* The geometry an actor is added with. Levels of detail are only switched once the actor is in the
+ * scene, so its mapper still draws the full detail geometry, which copies of a part share */
+vtkPolyData* fullDetail(vtkActor* actor) {
+	return actor->GetMapper() ? vtkPolyData::SafeDownCast(actor->GetMapper()->GetInputAsDataSet()) : nullptr;
+}
+
+}
 
 /**
  * @brief Constructor for the VRRenderThread class.
@@ -30,11 +49,14 @@
 VRRenderThread::VRRenderThread( QObject* parent ) {
 	/* Initialise actor list */
 	actors = vtkActorCollection::New();
+	uploadBudget = 250000;
+	renderMs = 0.;
+
+	/* Picked actors are passed to the GUI thread through a queued signal */
+	qRegisterMetaType<vtkActor*>();
 
 	/* Initialise command variables */
-	rotateX = 0.;
-	rotateY = 0.;
-	rotateZ = 0.;
+	endRender = false;
 }
 
 /**
@@ -44,6 +66,24 @@ VRRenderThread::~VRRenderThread() {
 
 }
 
+/**
+ * @brief This function sets the headset the thread renders to, it must be called before the thread is started.
+ * @param backend is the backend, the thread takes ownership of it.
+ */
+void VRRenderThread::setBackend( VRBackend* backend ) {
+
+	if (!this->isRunning())
+		vrBackend.reset(backend);
+}
+
+/**
+ * @brief This function returns the headset the thread renders to.
+ * @return the backend, nullptr if none has been set.
+ */
+VRBackend* VRRenderThread::backend() const {
+	return vrBackend.get();
+}
+
 /**
  * @brief This function adds an actor to the actor collection.
  * @param actor is a pointer to the vtkActor to be added.
@@ -52,18 +92,188 @@ void VRRenderThread::addActorOffline( vtkActor* actor ) {
 
 	/* Check to see if render thread is running */
 	if (!this->isRunning()) {
-		double* ac = actor->GetOrigin();
-	
-		/* I have found that these initial transforms will position the FS
-		 * car model in a sensible position but you can experiment
-		 */
-		actor->RotateX(-90);
-		actor->AddPosition(-ac[0]+0, -ac[1]-100, -ac[2]-200);
-
+		placeActor(actor);
 		actors->AddItem(actor);
 	}
 }
 
+/**
+ * @brief This function adds an actor to the VR scene whether or not the VR session is running.
+ * @param actor is a pointer to the vtkActor to be added.
+ */
+void VRRenderThread::addActor( vtkActor* actor ) {
+
+	if (!this->isRunning()) {
+		addActorOffline(actor);
+		return;
+	}
+
+	/* The actor is not in the VR scene yet, so the GUI thread can still position it */
+	placeActor(actor);
+	issueCommand(ADD_PART, actor);
+}
+
+/**
+ * @brief This function removes an actor from the VR scene whether or not the VR session is running.
+ * @param actor is a pointer to the vtkActor to be removed.
+ */
+void VRRenderThread::removeActor( vtkActor* actor ) {
+
+	if (!this->isRunning()) {
+		actors->RemoveItem(actor);
+		return;
+	}
+
+	issueCommand(REMOVE_PART, actor);
+}
+
+/**
+ * @brief This function sets how many triangles of newly added actors may enter the VR scene per frame.
+ * @param triangles is the number of triangles per frame.
+ */
+void VRRenderThread::setUploadBudget( vtkIdType triangles ) {
+	uploadBudget = triangles;
+}
+
+/**
+ * @brief This function tells the VR thread which geometry an actor renders.
+ * @param actor is the VR actor.
+ * @param geometry is the geometry the actor draws, the part's own or its filtered geometry.
+ */
+void VRRenderThread::setActorGeometry( vtkActor* actor, std::shared_ptr<const PartGeometry> geometry ) {
+
+	if (!this->isRunning()) {
+		lods.setGeometry(actor, geometry);
+		return;
+	}
+
+	VRCommand command;
+	command.type = SET_GEOMETRY;
+	command.actor = actor;
+	command.geometry = geometry;
+	pushCommand(std::move(command));
+}
+
+/**
+ * @brief This function moves, turns on or turns off one section plane of the VR view.
+ * @param index is the plane.
+ * @param enabled is true to cut the parts with the plane.
+ * @param origin is a point on the plane, in desktop world coordinates.
+ * @param normal is the normal of the plane, the side it points to is kept.
+ */
+void VRRenderThread::setSectionPlane( int index, bool enabled, const double origin[3], const double normal[3] ) {
+
+	double values[8] = { double(index), enabled ? 1. : 0., origin[0], origin[1], origin[2], normal[0], normal[1], normal[2] };
+	if (!this->isRunning()) {
+		placeSectionPlane(values);
+		return;
+	}
+	issueCommand(SECTION_PLANE, nullptr, values, 8);
+}
+
+/**
+ * @brief This function gives an actor the faces cut by the section planes.
+ * @param actor is the VR actor.
+ * @param cap is the cap in the part's model coordinates, or nullptr to remove it.
+ */
+void VRRenderThread::setActorCap( vtkActor* actor, std::shared_ptr<const PartGeometry> cap ) {
+
+	if (!this->isRunning()) {
+		sections.setCap(actor, cap);
+		return;
+	}
+
+	VRCommand command;
+	command.type = SECTION_CAP;
+	command.actor = actor;
+	command.geometry = cap;
+	pushCommand(std::move(command));
+}
+
+/**
+ * @brief This function gives access to the frame timings recorded by the VR thread.
+ * @return a reference to the statistics.
+ */
+FrameStats& VRRenderThread::frameStats() {
+	return stats;
+}
+
+/**
+ * @brief This function applies the initial placement used for all actors in the VR scene.
+ * @param actor is a pointer to the vtkActor to be placed.
+ */
+void VRRenderThread::placeActor( vtkActor* actor ) {
+	double* ac = actor->GetOrigin();
+
+	/* I have found that these initial transforms will position the FS
+	 * car model in a sensible position but you can experiment
+	 */
+	actor->RotateX(PLACEMENT_ROTATION_X);
+	actor->AddPosition(-ac[0]+PLACEMENT_OFFSET[0], -ac[1]+PLACEMENT_OFFSET[1], -ac[2]+PLACEMENT_OFFSET[2]);
+}
+
+/**
+ * @brief This function applies a section plane given in desktop coordinates to the VR view, with the same placement as the actors.
+ * @param values are the plane index, on (1) or off (0), origin and normal.
+ */
+void VRRenderThread::placeSectionPlane( const double* values ) {
+	vtkNew<vtkTransform> placement;
+	placement->PostMultiply();
+	placement->RotateX(PLACEMENT_ROTATION_X);
+	placement->Translate(PLACEMENT_OFFSET);
+
+	double origin[3], normal[3];
+	placement->TransformPoint(values + 2, origin);
+	placement->TransformNormal(values + 5, normal);
+	sections.setPlane(int(values[0]), values[1] != 0., origin, normal);
+}
+
+/**
+ * @brief This function is called by the render window when a render starts, it records the time.
+ * @param caller is the render window.
+ * @param eventId is the event (StartEvent).
+ * @param clientData is a pointer to the VRRenderThread.
+ * @param callData is unused.
+ */
+void VRRenderThread::renderStarted( vtkObject* caller, unsigned long eventId, void* clientData, void* callData ) {
+	static_cast<VRRenderThread*>(clientData)->renderStart = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief This function is called by the render window when a render ends, it adds the render's duration to the frame's render time.
+ * @param caller is the render window.
+ * @param eventId is the event (EndEvent).
+ * @param clientData is a pointer to the VRRenderThread.
+ * @param callData is unused.
+ */
+void VRRenderThread::renderEnded( vtkObject* caller, unsigned long eventId, void* clientData, void* callData ) {
+	VRRenderThread* thread = static_cast<VRRenderThread*>(clientData);
+	thread->renderMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - thread->renderStart).count();
+}
+
+/**
+ * @brief This function is called by the interactor for controller buttons, a trigger press picks the part the controller points at.
+ * @param caller is the interactor.
+ * @param eventId is the event (Button3DEvent).
+ * @param clientData is a pointer to the VRRenderThread.
+ * @param callData is the vtkEventDataDevice3D of the button.
+ */
+void VRRenderThread::controllerButton( vtkObject* caller, unsigned long eventId, void* clientData, void* callData ) {
+	VRRenderThread* thread = static_cast<VRRenderThread*>(clientData);
+	vtkEventData* data = static_cast<vtkEventData*>(callData);
+	vtkEventDataDevice3D* device = data ? data->GetAsEventDataDevice3D() : nullptr;
+	if (device == nullptr || device->GetInput() != vtkEventDataDeviceInput::Trigger || device->GetAction() != vtkEventDataAction::Press)
+		return;
+
+	double origin[3], direction[3];
+	device->GetWorldPosition(origin);
+	device->GetWorldDirection(direction);
+
+	vtkProp3D* hit = thread->bounds.raycast(origin, direction);
+	if (hit != nullptr)
+		emit thread->partPicked(static_cast<vtkActor*>(hit));
+}
+
 /**
  * @brief This function issues a command to the VR thread.
  * @param cmd is the command to be issued.
@@ -71,24 +281,191 @@ void VRRenderThread::addActorOffline( vtkActor* actor ) {
  */
 void VRRenderThread::issueCommand( int cmd, double value ) {
 
-	/* Update class variables according to command */
-	switch (cmd) {
-		/* These are just a few basic examples */
-		case END_RENDER:
-			this->endRender = true;
-			break;
+	/* Queue the command, the VR thread updates its own variables when it applies it */
+	VRCommand command;
+	command.type = cmd;
+	command.values[0] = value;
+	pushCommand(std::move(command));
+}
 
-		case ROTATE_X:
-			this->rotateX = value;
-			break;
+/**
+ * @brief This function queues a command that applies to an actor or takes several values.
+ * @param cmd is the command to be issued.
+ * @param actor is the VR actor the command applies to, or nullptr.
+ * @param values is the array of values associated with the command, or nullptr.
+ * @param count is the number of values (at most 16).
+ */
+void VRRenderThread::issueCommand( int cmd, vtkActor* actor, const double* values, int count ) {
 
-		case ROTATE_Y:
-			this->rotateY = value;
-			break;
+	VRCommand command;
+	command.type = cmd;
+	command.actor = actor;
+	for (int i = 0; i < count && i < 16; i++)
+		command.values[i] = values[i];
+	pushCommand(std::move(command));
+}
+
+/**
+ * @brief This function adds a command to the queue, waiting for space if the VR thread has fallen behind.
+ * @param command is the command to queue.
+ */
+void VRRenderThread::pushCommand( VRCommand command ) {
+
+	/* Only the GUI waits here, never the render loop. If the VR thread is not running
+	 * nothing will make space, so the command is dropped rather than hanging the GUI. */
+	while (!commands.push(command)) {
+		if (!this->isRunning())
+			return;
+		QThread::yieldCurrentThread();
+	}
+}
+
+/**
+ * @brief This function applies every queued command, it is called by the VR thread once per frame.
+ */
+void VRRenderThread::drainCommands() {
+
+	VRCommand command;
+	while (commands.pop(command)) {
+		vtkActor* actor = command.actor;
+		const double* v = command.values;
+
+		switch (command.type) {
+			case END_RENDER:
+				this->endRender = true;
+				break;
+
+			/* Rotation values are degrees per 20 ms step, the animator works in degrees per second */
+			case ROTATE_X:
+				animator.setRotation(0, v[0] / 0.02);
+				break;
+
+			case ROTATE_Y:
+				animator.setRotation(1, v[0] / 0.02);
+				break;
+
+			case ROTATE_Z:
+				animator.setRotation(2, v[0] / 0.02);
+				break;
+
+			case TRANSFORM:
+				if (actor && animator.hasPart(actor)) {
+					animator.setTransform(actor, v);
+				}
+				else if (actor) {
+					/* Not in the scene yet, the animator picks the matrix up when the actor is added */
+					vtkNew<vtkMatrix4x4> matrix;
+					matrix->DeepCopy(v);
+					actor->SetUserMatrix(matrix);
+				}
+				break;
+
+			case COLOUR:
+				if (actor)
+					actor->GetProperty()->SetColor(v[0], v[1], v[2]);
+				break;
+
+			case VISIBILITY:
+				if (actor)
+					actor->SetVisibility(v[0] != 0.);
+				break;
+
+			case ADD_PART:
+				/* Staged, addStagedActors() spreads new geometry over several frames */
+				if (actor)
+					stagedActors.push_back(actor);
+				break;
 
-		case ROTATE_Z:
-			this->rotateZ = value;
+			case REMOVE_PART:
+				if (actor) {
+					for (auto it = stagedActors.begin(); it != stagedActors.end(); ++it) {
+						if (*it == actor) {
+							stagedActors.erase(it);
+							break;
+						}
+					}
+					animator.removePart(actor);
+					sections.removeCap(actor);
+					lods.remove(actor);
+					bounds.remove(actor);
+					instances.remove(actor);
+				}
+				break;
+
+			case CAMERA_POSE:
+				vrBackend->setPhysicalPose(v, v + 3, v + 6);
+				break;
+
+			case PART_MOTION:
+				if (actor)
+					animator.setPartMotion(actor, v, v + 3);
+				break;
+
+			case EXPLODE:
+				animator.setExplode(v[0], v[1]);
+				break;
+
+			case SET_GEOMETRY:
+				if (actor) {
+					lods.setGeometry(actor, command.geometry);
+
+					/* Filtered geometry (see FilterPipeline) replaces what the full detail mapper draws,
+					 * an actor already in the scene is then instanced by its new geometry */
+					vtkPolyData* shown = command.geometry ? command.geometry->polyData() : nullptr;
+					vtkPolyDataMapper* mapper = vtkPolyDataMapper::SafeDownCast(actor->GetMapper());
+					if (shown && mapper && mapper->GetInput() != shown) {
+						mapper->SetInputData(shown);
+						if (bounds.contains(actor)) {
+							instances.remove(actor);
+							instances.add(actor, shown);
+							bounds.update(actor);
+						}
+					}
+				}
+				break;
+
+			case LEVEL_OF_DETAIL:
+				lods.setEnabled(v[0] != 0.);
+				if (v[1] > 0.)
+					lods.setTolerance(v[1]);
+				break;
+
+			case SECTION_PLANE:
+				placeSectionPlane(v);
+				break;
+
+			case SECTION_CAP:
+				/* Caps are only shown while their planes match the actor's, animated parts drop theirs */
+				if (actor)
+					sections.setCap(actor, command.geometry);
+				break;
+		}
+	}
+}
+
+/**
+ * @brief This function moves staged actors into the scene, up to the upload budget, it is called by the VR thread once per frame.
+ * An actor's geometry is uploaded to the GPU the first time it is rendered, so limiting how many
+ * triangles join the scene per frame limits how long that frame's render can take.
+ */
+void VRRenderThread::addStagedActors() {
+
+	vtkIdType budget = uploadBudget.load();
+	vtkIdType used = 0;
+
+	while (!stagedActors.empty()) {
+		vtkActor* actor = stagedActors.front();
+		vtkDataSet* data = actor->GetMapper() ? actor->GetMapper()->GetInputAsDataSet() : nullptr;
+		vtkIdType triangles = data ? data->GetNumberOfCells() : 0;
+
+		if (used > 0 && used + triangles > budget)
 			break;
+
+		instances.add(actor, fullDetail(actor));
+		animator.addPart(actor);
+		bounds.insert(actor);
+		used += triangles;
+		stagedActors.pop_front();
 	}
 }
 
@@ -103,6 +480,12 @@ void VRRenderThread::run() {
 	 * so there needs to be a mechanism to pass data from the GUi thread to the VR thread.
 	 */
 
+	/* The headset (or the simulated one) supplies the renderer, window, camera and interactor */
+	if (vrBackend == nullptr) {
+		qDebug() << "No VR backend has been set";
+		return;
+	}
+
 	vtkNew<vtkNamedColors> colors;
 
 	// Set the background color.
@@ -112,36 +495,42 @@ void VRRenderThread::run() {
 	// The renderer generates the image
 	// which is then displayed on the render window.
 	// It can be thought of as a scene to which the actor is added
-	renderer = vtkOpenVRRenderer::New();	
+	renderer = vrBackend->createRenderer();
 	
 	renderer->SetBackground(colors->GetColor3d("BkgColor").GetData());
 	
 	/* Loop through list of actors provided and add to scene */
+	instances.setRenderer(renderer);
 	vtkActor* a;
 	actors->InitTraversal();
 	while( (a = (vtkActor*)actors->GetNextActor() ) ) {
-		renderer->AddActor(a);
+		instances.add(a, fullDetail(a));
+		animator.addPart(a);
+		bounds.insert(a);
 	}
 
-	/* The render window is the actual GUI window
-	 * that appears on the computer screen
-	 */
-	window = vtkOpenVRRenderWindow::New();
+	/* The section planes cut every mapper of the renderer, caps included once they are given */
+	sections.setRenderer(renderer);
 
-	window->Initialize();
-	window->AddRenderer(renderer);
-	
-	/* Create Open VR Camera */
-	camera = vtkOpenVRCamera::New();				
-	renderer->SetActiveCamera(camera);			
+	/* Cull with the bounds index instead of testing every prop for each eye */
+	vtkNew<BVHCuller> culler;
+	culler->SetIndex(&bounds);
+	renderer->GetCullers()->RemoveAllItems();
+	renderer->AddCuller(culler);
+
+	/* The backend creates the render window, camera and interactor */
+	if (!vrBackend->initialize()) {
+		qDebug() << "The" << vrBackend->name() << "VR backend could not be started";
+		return;
+	}
+	vtkRenderWindow* window = vrBackend->window();
+
+	/* Pressing the trigger selects the part the controller points at */
+	vtkNew<vtkCallbackCommand> onButton;
+	onButton->SetCallback(controllerButton);
+	onButton->SetClientData(this);
+	vrBackend->interactor()->AddObserver(vtkCommand::Button3DEvent, onButton);
 
-	/* The render window interactor captures mouse events
-	 * and will perform appropriate camera or actor manipulation
-	 * depending on the nature of the events.
-	 */
-	interactor = vtkOpenVRRenderWindowInteractor::New();
-	interactor->SetRenderWindow(window);
-	interactor->Initialize();
 	window->Render();
 
 
@@ -150,48 +539,83 @@ void VRRenderThread::run() {
 	 * (i.e. to implement animation)
 	 */
 	endRender = false;
-	t_last = std::chrono::steady_clock::now();
-
-	while (!interactor->GetDone() && !this->endRender) {
-		interactor->DoOneEvent(window, renderer);
-
-		/* Check to see if enough time has elapsed since last update
-		 * This looks overcomplicated (and it is, C++ loves to make things unecessarily complicated!) but
-		 * is really just checking if more than 20ms have elaspsed since the last animation step. The
-		 * complications comes from the fact that numbers representing time on computers don't usually have
-		 * standard second/millisecond units. Because everything is a class in C++, the converion from
-		 * computer units to seconds/milliseconds ends up looking like what you see below.
-		 *
-		 * My choice of 20ms is arbitrary, if this value is too small the animation calculations could begin to
-		 * interfere with the interator processes and make the simulation unresponsive. If it is too large
-		 * the animations will be jerky. Play with the value to see what works best.
+	const std::chrono::steady_clock::time_point t_start = std::chrono::steady_clock::now();
+
+#ifdef VR_FRAME_STATS
+	/* processFrame() processes events and renders in one call, so the render is timed from the
+	 * window's own start/end events and the rest of the call is counted as event processing */
+	vtkNew<vtkCallbackCommand> onRenderStart;
+	onRenderStart->SetCallback(renderStarted);
+	onRenderStart->SetClientData(this);
+	window->AddObserver(vtkCommand::StartEvent, onRenderStart);
+
+	vtkNew<vtkCallbackCommand> onRenderEnd;
+	onRenderEnd->SetCallback(renderEnded);
+	onRenderEnd->SetClientData(this);
+	window->AddObserver(vtkCommand::EndEvent, onRenderEnd);
+#endif
+
+	while (!vrBackend->done() && !this->endRender) {
+#ifdef VR_FRAME_STATS
+		const std::chrono::steady_clock::time_point t_frame = std::chrono::steady_clock::now();
+		renderMs = 0.;
+#endif
+
+		/* Apply everything the GUI has asked for since the last frame */
+		drainCommands();
+		addStagedActors();
+#ifdef VR_FRAME_STATS
+		const std::chrono::steady_clock::time_point t_commands = std::chrono::steady_clock::now();
+#endif
+
+		/* Levels of detail for where the headset was last frame, both eyes use the same choice */
+		lods.update(renderer);
+
+		/* Copies of the same part are drawn by one instanced mapper, with this frame's matrices and colours */
+		instances.update();
+
+		/* Mappers swapped above are given the section planes, caps of moved parts are hidden */
+		sections.update();
+#ifdef VR_FRAME_STATS
+		const std::chrono::steady_clock::time_point t_scene = std::chrono::steady_clock::now();
+#endif
+
+		vrBackend->processFrame();
+
+		const std::chrono::steady_clock::time_point t_events = std::chrono::steady_clock::now();
+
+		/* Animations run on a fixed 20 ms simulation step rather than once per frame, so they move
+		 * at the same speed whatever the frame rate. The animator takes as many steps as the time
+		 * since the last frame covers and shows the pose interpolated between the last two, then
+		 * writes each moving actor's matrix once.
 		 */
-		if (std::chrono::duration_cast <std::chrono::milliseconds> (std::chrono::steady_clock::now() - t_last).count() > 20) {
-
-			/* Do things that might need doing ... */
-			vtkActorCollection* actorList = renderer->GetActors();
-			vtkActor* a;
-
-			/* X Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateX(rotateX);
-			}
-
-			/* Y Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateY(rotateY);
-			}
-
-			/* Z Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateZ(rotateZ);
-			}
-
-			/* Remember time now */
-			t_last = std::chrono::steady_clock::now();
-		}
+		animator.update(std::chrono::duration<double>(t_events - t_start).count());
+#ifdef VR_FRAME_STATS
+		const std::chrono::steady_clock::time_point t_animation = std::chrono::steady_clock::now();
+#endif
+
+		/* Only the parts that moved are refitted. When most of them move together (a global
+		 * rotation) their leaf boxes are replaced and the tree refitted in one pass, rather than
+		 * each part being re-inserted. */
+		const std::vector<vtkActor*>& moved = animator.movedParts();
+		bool reinsert = moved.size() * 4 < size_t(bounds.size());
+		for (vtkActor* actor : moved)
+			bounds.update(actor, reinsert);
+		bounds.refit();
+
+#ifdef VR_FRAME_STATS
+		const std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+		typedef std::chrono::duration<float, std::milli> Milliseconds;
+
+		float ms[FrameStats::PHASE_COUNT];
+		ms[FrameStats::COMMANDS] = Milliseconds(t_commands - t_frame).count();
+		ms[FrameStats::SCENE] = Milliseconds(t_scene - t_commands).count();
+		ms[FrameStats::RENDER] = float(renderMs);
+		ms[FrameStats::EVENTS] = Milliseconds(t_events - t_scene).count() - ms[FrameStats::RENDER];
+		ms[FrameStats::ANIMATION] = Milliseconds(t_animation - t_events).count();
+		ms[FrameStats::BOUNDS] = Milliseconds(t_end - t_animation).count();
+		ms[FrameStats::FRAME] = Milliseconds(t_end - t_frame).count();
+		stats.addFrame(std::chrono::duration<double>(t_frame - t_start).count(), ms);
+#endif
 	}
 }
\ No newline at end of file
@@ -8,18 +8,28 @@
 #define VR_RENDER_THREAD_H
 
 /* Project headers */
+#include "SPSCQueue.h"
+#include "FrameStats.h"
+#include "Animator.h"
+#include "LODSelector.h"
+#include "PartBVH.h"
+#include "InstancedScene.h"
+#include "SectionPlanes.h"
+#include "VRBackend.h"
 
 /* Qt headers */
 #include <QThread>
-#include <QMutex>
-#include <QWaitCondition>
+
+/* Standard headers */
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 
 /* Vtk headers */
 #include <vtkActor.h>
-#include <vtkOpenVRRenderWindow.h>				
-#include <vtkOpenVRRenderWindowInteractor.h>	
-#include <vtkOpenVRRenderer.h>					
-#include <vtkOpenVRCamera.h>	
+#include <vtkSmartPointer.h>
+#include <vtkRenderer.h>
 #include <vtkActorCollection.h>
 #include <vtkCommand.h>
 
@@ -37,11 +47,34 @@ public:
      */
     enum {
         END_RENDER,
-        ROTATE_X,
-        ROTATE_Y,
-        ROTATE_Z
+        ROTATE_X,           /**< Rotate every actor around its model X axis (degrees per 20 ms) */
+        ROTATE_Y,           /**< Rotate every actor around its model Y axis (degrees per 20 ms) */
+        ROTATE_Z,           /**< Rotate every actor around its model Z axis (degrees per 20 ms) */
+        TRANSFORM,          /**< Set an actor's user matrix (16 values, row major) */
+        COLOUR,             /**< Set an actor's colour (3 values, 0-1) */
+        VISIBILITY,         /**< Show (1) or hide (0) an actor */
+        ADD_PART,           /**< Add an actor to the VR scene */
+        REMOVE_PART,        /**< Remove an actor from the VR scene */
+        CAMERA_POSE,        /**< Place the physical space: translation, view direction, view up (9 values) */
+        PART_MOTION,        /**< Animate one actor: rotation rates in degrees/s then translation rates in units/s (6 values) */
+        EXPLODE,            /**< Move towards an exploded view: amount (0 assembled, 1 exploded) and optional change per second */
+        SET_GEOMETRY,       /**< Tell the VR thread which geometry (and levels of detail) an actor renders */
+        LEVEL_OF_DETAIL,    /**< Turn level of detail switching on (1) or off (0), with an optional pixel tolerance */
+        SECTION_PLANE,      /**< Move a section plane: index, on (1) or off (0), origin then normal in desktop coordinates (8 values) */
+        SECTION_CAP         /**< Give an actor the faces cut by the section planes, or remove them (no geometry) */
     } Command;
 
+    /**
+     * @struct VRCommand
+     * @brief The VRCommand structure is one entry of the queue that carries commands from the GUI thread to the VR thread.
+     */
+    struct VRCommand {
+        int                         type = END_RENDER;  /**< One of the Command values */
+        vtkSmartPointer<vtkActor>   actor;              /**< Actor the command applies to, if any */
+        double                      values[16] = {};    /**< Command arguments */
+        std::shared_ptr<const PartGeometry> geometry;   /**< Geometry for SET_GEOMETRY and SECTION_CAP */
+    };
+
     /**
      * @brief Constructor for the VRRenderThread class.
      * @param parent is a pointer to the parent QObject.
@@ -53,6 +86,18 @@ public:
      */
     ~VRRenderThread();
 
+    /**
+     * @brief This function sets the headset the thread renders to, it must be called before the thread is started.
+     * @param backend is the backend (an OpenVRBackend or a SimulatedHMD), the thread takes ownership of it.
+     */
+    void setBackend(VRBackend* backend);
+
+    /**
+     * @brief This function returns the headset the thread renders to.
+     * @return the backend, nullptr if none has been set.
+     */
+    VRBackend* backend() const;
+
     /**
      * @brief This function allows actors to be added to the VR renderer BEFORE the VR interactor has been started.
      * @param actor is a pointer to the vtkActor to be added.
@@ -60,12 +105,81 @@ public:
     void addActorOffline(vtkActor* actor);
 
     /**
-     * @brief This function allows commands to be issued to the VR thread in a thread safe way. Function will set variables within the class to indicate the type of action / animation / etc to perform. The rendering thread will then implement this.
+     * @brief This function adds an actor to the VR scene whether or not the VR session is running.
+     * While running the actor is staged and the VR thread adds it at a safe point in its loop; staged
+     * actors are added a few at a time (see setUploadBudget) so uploading their geometry never stalls a frame.
+     * @param actor is a pointer to the vtkActor to be added, it must not be used by the GUI thread afterwards.
+     */
+    void addActor(vtkActor* actor);
+
+    /**
+     * @brief This function removes an actor from the VR scene whether or not the VR session is running.
+     * @param actor is a pointer to the vtkActor to be removed.
+     */
+    void removeActor(vtkActor* actor);
+
+    /**
+     * @brief This function sets how many triangles of newly added actors may enter the VR scene per frame (at least one actor is always added).
+     * @param triangles is the number of triangles per frame.
+     */
+    void setUploadBudget(vtkIdType triangles);
+
+    /**
+     * @brief This function tells the VR thread which geometry an actor renders, so it can switch the actor between the geometry's levels of detail.
+     * It can be called whether or not the VR session is running, and again when the geometry gains levels or is filtered.
+     * @param actor is the VR actor.
+     * @param geometry is the geometry the actor draws, the part's own or its filtered geometry.
+     */
+    void setActorGeometry(vtkActor* actor, std::shared_ptr<const PartGeometry> geometry);
+
+    /**
+     * @brief This function moves, turns on or turns off one section plane of the VR view, whether or not the VR session is running.
+     * The plane is given where it is in the desktop view, the VR thread places it with the parts.
+     * @param index is the plane, 0 to SectionPlanes::MAX_PLANES - 1.
+     * @param enabled is true to cut the parts with the plane.
+     * @param origin is a point on the plane, in desktop world coordinates.
+     * @param normal is the normal of the plane, the side it points to is kept.
+     */
+    void setSectionPlane(int index, bool enabled, const double origin[3], const double normal[3]);
+
+    /**
+     * @brief This function gives an actor the faces cut by the section planes, whether or not the VR session is running.
+     * @param actor is the VR actor.
+     * @param cap is the cap in the part's model coordinates (see SectionCapper), or nullptr to remove it.
+     */
+    void setActorCap(vtkActor* actor, std::shared_ptr<const PartGeometry> cap);
+
+    /**
+     * @brief This function allows commands to be issued to the VR thread in a thread safe way. The command is queued and the rendering thread applies it at the start of its next frame.
      * @param cmd is the command to be issued.
      * @param value is the value associated with the command.
      */
     void issueCommand( int cmd, double value );
 
+    /**
+     * @brief This function queues a command that applies to an actor (TRANSFORM, COLOUR, VISIBILITY, ADD_PART, REMOVE_PART) or takes several values (CAMERA_POSE).
+     * Commands must only be issued from one thread (the GUI thread).
+     * @param cmd is the command to be issued.
+     * @param actor is the VR actor the command applies to, or nullptr.
+     * @param values is the array of values associated with the command, or nullptr.
+     * @param count is the number of values (at most 16).
+     */
+    void issueCommand( int cmd, vtkActor* actor, const double* values = nullptr, int count = 0 );
+
+    /**
+     * @brief This function gives access to the frame timings recorded by the VR thread (when built with VR_FRAME_STATS).
+     * The VR thread is the only writer, the statistics may be read (and the trace collected) from one other thread.
+     * @return a reference to the statistics.
+     */
+    FrameStats& frameStats();
+
+signals:
+    /**
+     * @brief This signal is emitted when the controller trigger is pressed with its ray on a part, it is delivered to the GUI thread.
+     * @param actor is the VR actor hit, it is only meant to be compared with the VR actors the GUI created.
+     */
+    void partPicked(vtkActor* actor);
+
 protected:
     /**
      * @brief This function is a re-implementation of a QThread function.
@@ -73,29 +187,103 @@ protected:
     void run() override;
 
 private:
-    /* Standard VTK VR Classes */
-    vtkSmartPointer<vtkOpenVRRenderWindow>              window; /**< A smart pointer to the VR render window. */
-    vtkSmartPointer<vtkOpenVRRenderWindowInteractor>    interactor; /**< A smart pointer to the VR render window interactor. */
-    vtkSmartPointer<vtkOpenVRRenderer>                  renderer; /**< A smart pointer to the VR renderer. */
-    vtkSmartPointer<vtkOpenVRCamera>                    camera; /**< A smart pointer to the VR camera. */
+    /**
+     * @brief This function adds a command to the queue, waiting for space if the VR thread has fallen behind.
+     * @param command is the command to queue.
+     */
+    void pushCommand( VRCommand command );
+
+    /**
+     * @brief This function applies every queued command, it is called by the VR thread once per frame.
+     */
+    void drainCommands();
+
+    /**
+     * @brief This function moves staged actors into the scene, up to the upload budget, it is called by the VR thread once per frame.
+     */
+    void addStagedActors();
+
+    /**
+     * @brief This function applies the initial placement used for all actors in the VR scene.
+     * @param actor is a pointer to the vtkActor to be placed.
+     */
+    void placeActor(vtkActor* actor);
+
+    /**
+     * @brief This function applies a section plane given in desktop coordinates to the VR view, with the same placement as the actors.
+     * @param values are the plane index, on (1) or off (0), origin and normal.
+     */
+    void placeSectionPlane(const double* values);
+
+    /**
+     * @brief This function is called by the render window when a render starts, it records the time.
+     * @param caller is the render window.
+     * @param eventId is the event (StartEvent).
+     * @param clientData is a pointer to the VRRenderThread.
+     * @param callData is unused.
+     */
+    static void renderStarted( vtkObject* caller, unsigned long eventId, void* clientData, void* callData );
+
+    /**
+     * @brief This function is called by the render window when a render ends, it adds the render's duration to the frame's render time.
+     * @param caller is the render window.
+     * @param eventId is the event (EndEvent).
+     * @param clientData is a pointer to the VRRenderThread.
+     * @param callData is unused.
+     */
+    static void renderEnded( vtkObject* caller, unsigned long eventId, void* clientData, void* callData );
+
+    /**
+     * @brief This function is called by the interactor for controller buttons, a trigger press picks the part the controller points at.
+     * @param caller is the interactor.
+     * @param eventId is the event (Button3DEvent).
+     * @param clientData is a pointer to the VRRenderThread.
+     * @param callData is the vtkEventDataDevice3D of the button.
+     */
+    static void controllerButton( vtkObject* caller, unsigned long eventId, void* clientData, void* callData );
+
+    /* The headset, its window, interactor and camera */
+    std::unique_ptr<VRBackend>                          vrBackend; /**< The headset the scene is rendered to, owned by the thread. */
+    vtkSmartPointer<vtkRenderer>                        renderer; /**< A smart pointer to the VR renderer, created by the backend. */
 
     /* Use to synchronise passing of data to VR thread */
-    QMutex                                              mutex; /**< A mutex for synchronising passing of data to VR thread. */
-    QWaitCondition                                      condition; /**< A wait condition for synchronising passing of data to VR thread. */
+    SPSCQueue<VRCommand, 1024>                          commands; /**< Lock-free queue of commands from the GUI thread, drained once per frame. */
 
     /** List of actors that will need to be added to the VR scene */
     vtkSmartPointer<vtkActorCollection>                 actors; /**< A smart pointer to the list of actors that will need to be added to the VR scene. */
 
-    /** A timer to help implement animations and visual effects */
-    std::chrono::time_point<std::chrono::steady_clock>  t_last; /**< A timer to help implement animations and visual effects. */
+    /** Actors added while running, waiting for their turn to enter the scene. Only the VR thread uses it. */
+    std::deque<vtkSmartPointer<vtkActor>>               stagedActors; /**< Actors waiting to be added to the running VR scene. */
 
-    /** This will be set to false by the constructor, if it is set to true by the GUI then the rendering will end. */
-    bool                                                endRender; /**< A boolean value that indicates whether the rendering will end. */
+    /** Triangles of staged actors that may be added per frame */
+    std::atomic<vtkIdType>                              uploadBudget; /**< Number of triangles of staged actors added per frame. */
 
-    /* Some variables to indicate animation actions to apply. */
-    double rotateX; /**< Degrees to rotate around X axis (per time-step). */
-    double rotateY; /**< Degrees to rotate around Y axis (per time-step). */
-    double rotateZ; /**< Degrees to rotate around Z axis (per time-step). */
+    /** Frame timings, written by the VR thread only */
+    FrameStats                                          stats; /**< Per-frame timings and histograms. */
+
+    /** Start of the current render and the render time of the current frame. Only the VR thread uses them. */
+    std::chrono::steady_clock::time_point               renderStart; /**< Time the current render started. */
+    double                                              renderMs; /**< Milliseconds spent rendering in the current frame. */
+
+    /** Level of detail of every actor with decimated levels. Only the VR thread uses it while running. */
+    LODSelector                                         lods; /**< Level of detail selection for the VR view. */
+
+    /** World bounds of every actor in the scene, for culling and controller picks. Only the VR thread uses it. */
+    PartBVH                                             bounds; /**< Bounding volume index of the VR view. */
+
+    /** Adds the actors to the renderer, drawing copies of the same geometry with one instanced mapper. Only the VR thread uses it. */
+    InstancedScene                                      instances; /**< Actors of the VR scene, instanced by geometry. */
+
+    /** Section planes of the VR view and the caps they cut. Only the VR thread uses it while running. */
+    SectionPlanes                                       sections; /**< Section planes and caps of the VR view. */
+
+    /** Fixed timestep animation of every actor in the scene. Only the VR thread uses it. */
+    Animator                                            animator; /**< Animation tracks and clock. */
+
+    /** This will be set to false by the constructor, it is set to true when the END_RENDER command is applied. Only the VR thread uses it. */
+    bool                                                endRender; /**< A boolean value that indicates whether the rendering will end. */
 };
 
+Q_DECLARE_METATYPE(vtkActor*)
+
 #endif
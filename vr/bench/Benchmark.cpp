@@ -0,0 +1,2377 @@
+/** @file Benchmark.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Scripted, headless scenarios that time the load and render pipeline.
+  */
+
+#include "Benchmark.h"
+#include "SyntheticAssembly.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "STLLoader.h"
+#include "SceneSync.h"
+#include "GeometryCache.h"
+#include "PartBVH.h"
+#include "ResidencyManager.h"
+#include "InstancedScene.h"
+#include "VRRenderThread.h"
+#include "SimulatedHMD.h"
+#include "FilterPipeline.h"
+#include "SectionPlanes.h"
+#include "SectionCapper.h"
+#include "DirectoryScanner.h"
+#include "ProjectFile.h"
+#include "Animator.h"
+#include "FastSTLReader.h"
+#include "MeshPreparation.h"
+#include "ShownPartDelegate.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QAbstractItemModelTester>
+#include <QThread>
+#include <QTreeView>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <unordered_set>
+#include <utility>
+
+#include <vtkCamera.h>
+#include <vtkCleanPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkCubeSource.h>
+#include <vtkDataSetMapper.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkPropCollection.h>
+#include <vtkSTLReader.h>
+#include <vtkVersion.h>
+
+namespace {
+
+/* Sizes of the PartBVH scenario */
+const int INDEX_SIZES[] = { 1000, 10000, 100000 };
+
+/* Culls and rays per size of the PartBVH scenario */
+const int INDEX_CULLS = 100;
+const int INDEX_RAYS = 10000;
+
+/* Sizes in MB of the files of the STL reader scenario, up to the largest asked for */
+const int READER_SIZES[] = { 1, 16, 256, 2048 };
+
+/* Triangles of the parts of the mesh preparation scenario */
+const int PREPARATION_SIZES[] = { 10000, 100000, 1000000 };
+
+/* Shape of the part tree scenario: folders of parts, then one lazy folder */
+const int TREE_FOLDERS = 10;
+const int TREE_FOLDER_SIZE = 10000;
+const int TREE_LAZY_SIZE = 50000;
+
+/* Shape of the tree the part tree scenario checks with QAbstractItemModelTester, which checks every row on every change */
+const int TESTER_FOLDERS = 5;
+const int TESTER_FOLDER_SIZE = 200;
+const int TESTER_LAZY_SIZE = 2000;
+
+/* Parts of the view memory scenario, each drawn by a desktop and a VR actor */
+const int VIEW_MEMORY_PARTS = 200;
+
+/* Size of the tree of the colour edit scenario, and of each of its parts */
+const int EDIT_PARTS = 5000;
+const int EDIT_TRIANGLES = 200;
+
+/* Rays of the pick scenario, through the assembly and through a single part */
+const int ASSEMBLY_PICKS = 1000;
+const int PART_PICKS = 100000;
+
+/* Shape of the directory scan scenario: subassemblies of folders of small parts */
+const int SCAN_GROUPS = 20;
+const int SCAN_FOLDERS = 10;
+const int SCAN_TRIANGLES = 48;
+
+/* Files of one folder that the directory scan scenario makes into parts straight away, as the application does */
+const int SCAN_LAZY_SIZE = 2000;
+
+/* The large folder scenario: files in one folder, and the most the tree and view may add to the
+ * resident memory and take to paint the first part once the scan starts */
+const int LARGE_FOLDER_FILES = 50000;
+const double LARGE_FOLDER_RSS_MB = 64.;
+const double LARGE_FOLDER_FIRST_PAINT_MS = 1000.;
+const int LARGE_FOLDER_TIMEOUT_MS = 30000;
+
+/* Interval of the timer that measures how long the event loop of the progressive load scenario is held up */
+const int STALL_TICK_MS = 5;
+
+/* Parts of the residency scenario */
+const int RESIDENCY_PARTS = 1000;
+
+/* Parts and simulated seconds of the animation scenario, played at 90 frames a second */
+const int ANIMATION_PARTS = 10000;
+const double ANIMATION_SECONDS = 10.;
+const double ANIMATION_FRAME = 1. / 90.;
+
+/* Frames rendered per mode by the instancing scenario */
+const int INSTANCING_FRAMES = 20;
+
+/* Parts per group of the tree saved by the project scenario */
+const int PROJECT_GROUP_SIZE = 50;
+
+/* Errors allowed by the project scenario for quantized geometry: a few steps of the 16-bit position
+ * grid, which also covers rounding the positions back to floats, and one step of the 8-bit normals */
+const double QUANTIZED_POSITION_TOLERANCE = 5e-5;
+const double QUANTIZED_NORMAL_TOLERANCE = 1. / 127.;
+
+/* Scenarios that need an OpenGL context */
+const char* const RENDER_SCENARIOS[] = { "first_frame", "orbit", "colour_edits", "instancing", "view_memory", "vr_frames", "sections" };
+
+/**
+ * @brief This function returns the time since a timer was started, in milliseconds.
+ */
+double elapsedMs(const QElapsedTimer& timer) {
+    return double(timer.nsecsElapsed()) / 1e6;
+}
+
+/**
+ * @brief This function summarises a series of times.
+ */
+QJsonObject summary(std::vector<double> ms) {
+    QJsonObject result;
+    result["count"] = int(ms.size());
+    if (ms.empty())
+        return result;
+
+    std::sort(ms.begin(), ms.end());
+    double total = 0.;
+    for (double t : ms)
+        total += t;
+
+    auto percentile = [&ms](double p) {
+        size_t i = size_t(std::ceil(p * double(ms.size()))) - 1;
+        return ms[std::min(i, ms.size() - 1)];
+    };
+
+    result["mean_ms"] = total / double(ms.size());
+    result["p50_ms"] = percentile(0.5);
+    result["p95_ms"] = percentile(0.95);
+    result["max_ms"] = ms.back();
+    return result;
+}
+
+/**
+ * @class FirstPaintDelegate
+ * @brief The FirstPaintDelegate class is the tree's ShownPartDelegate, and also reports each part row it paints.
+ */
+class FirstPaintDelegate : public ShownPartDelegate {
+public:
+    FirstPaintDelegate(ModelPartList* model, QObject* parent, const std::function<void()>& painted)
+        : ShownPartDelegate(model, parent), painted(painted) {}
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override {
+        ShownPartDelegate::paint(painter, option, index);
+        if (index.parent().isValid())
+            painted();
+    }
+
+private:
+    std::function<void()> painted;  /**< Called after a part row is painted */
+};
+
+/**
+ * @struct LegacyItem
+ * @brief The LegacyItem structure is a tree item as parts were before PartTree: a child list per item, and the row found in the parent's list.
+ */
+struct LegacyItem {
+    LegacyItem*         parent = nullptr;   /**< Parent item, nullptr for the root */
+    QList<LegacyItem*>  children;           /**< Child items, in order */
+    QList<QVariant>     itemData;           /**< Name and visibility */
+
+    ~LegacyItem() {
+        qDeleteAll(children);
+    }
+
+    /**
+     * @brief This function returns the row of the item in its parent, as ModelPart::row() did.
+     */
+    int row() const {
+        return parent != nullptr ? int(parent->children.indexOf(const_cast<LegacyItem*>(this))) : 0;
+    }
+};
+
+/* Failed checks reported by QAbstractItemModelTester, which warns in its own logging category */
+int modelTestFailures = 0;
+QtMessageHandler defaultMessageHandler = nullptr;
+
+/**
+ * @brief This function counts the warnings of QAbstractItemModelTester and passes every message on.
+ */
+void countModelTestFailures(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    if (type != QtDebugMsg && type != QtInfoMsg && context.category != nullptr
+        && std::strcmp(context.category, "qt.modeltest") == 0)
+        modelTestFailures++;
+    if (defaultMessageHandler != nullptr)
+        defaultMessageHandler(type, context, message);
+}
+
+/**
+ * @brief This function returns the resident memory of the process, as the kernel reports it.
+ * @return the memory in MB, or -1 where /proc/self/status cannot be read.
+ */
+double residentMegabytes() {
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1.;
+
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toDouble() / 1024.;
+    }
+    return -1.;
+}
+
+/**
+ * @brief This function adds the arrays holding a mesh to a set, so arrays shared by several meshes are counted once.
+ */
+void addArrays(vtkPolyData* polyData, std::unordered_set<vtkAbstractArray*>& arrays) {
+    if (polyData == nullptr)
+        return;
+
+    if (polyData->GetPoints() != nullptr)
+        arrays.insert(polyData->GetPoints()->GetData());
+    for (vtkCellArray* cells : { polyData->GetVerts(), polyData->GetLines(), polyData->GetPolys(), polyData->GetStrips() }) {
+        if (cells != nullptr) {
+            arrays.insert(cells->GetConnectivityArray());
+            arrays.insert(cells->GetOffsetsArray());
+        }
+    }
+    for (int i = 0; i < polyData->GetPointData()->GetNumberOfArrays(); i++)
+        arrays.insert(polyData->GetPointData()->GetAbstractArray(i));
+    for (int i = 0; i < polyData->GetCellData()->GetNumberOfArrays(); i++)
+        arrays.insert(polyData->GetCellData()->GetAbstractArray(i));
+}
+
+/**
+ * @brief This function adds up the host memory of a set of arrays.
+ */
+double arrayBytes(const std::unordered_set<vtkAbstractArray*>& arrays) {
+    double bytes = 0.;
+    for (vtkAbstractArray* array : arrays) {
+        if (array != nullptr)
+            bytes += 1024. * double(array->GetActualMemorySize());
+    }
+    return bytes;
+}
+
+/**
+ * @brief This function estimates the GPU buffers one mapper makes for a mesh: positions, normals if it has them, and triangle indices.
+ */
+double meshGpuBytes(vtkPolyData* polyData) {
+    if (polyData == nullptr)
+        return 0.;
+    double perPoint = polyData->GetPointData()->GetNormals() != nullptr ? 24. : 12.;
+    return perPoint * double(polyData->GetNumberOfPoints()) + 12. * double(polyData->GetNumberOfPolys());
+}
+
+/**
+ * @brief This function returns the parts of a tree that have geometry.
+ */
+std::vector<ModelPart*> loadedParts(ModelPartList* model) {
+    std::vector<ModelPart*> parts;
+    const PartTree* tree = model->getRootItem()->getTree();
+    for (int node = 0; node < tree->size(); node++) {
+        if (tree->part(node)->getGeometry() != nullptr)
+            parts.push_back(tree->part(node));
+    }
+    return parts;
+}
+
+}
+
+/**
+ * @brief This function returns the options used when none are given.
+ * @return the options.
+ */
+Benchmark::Options Benchmark::defaults() {
+    Options options;
+    options.parts = 500;
+    options.triangles = 2000;
+    options.copies = 0.25;
+    options.frames = 120;
+    options.edits = 100;
+    options.instances = 5000;
+    options.vrSeconds = 5.;
+    options.filterSize = 5000000;
+    options.scanFiles = 20000;
+    options.largeSize = 2000000;
+    options.readerSize = 2048;
+    options.width = 1280;
+    options.height = 720;
+    options.render = true;
+    options.cache = false;
+    options.seed = 1;
+    return options;
+}
+
+/**
+ * @brief This function returns the name of every scenario, in the order they run.
+ * @return the names.
+ */
+QStringList Benchmark::scenarios() {
+    return { "load", "first_frame", "orbit", "colour_edits", "picks", "part_index", "stl_readers", "mesh_preparation",
+             "part_tree", "directory_scan", "large_folder", "progressive_load", "residency", "animation",
+             "instancing", "view_memory", "vr_frames", "filters", "sections", "project" };
+}
+
+/**
+ * @brief Constructor for the Benchmark class.
+ * @param options are the sizes to run with.
+ */
+Benchmark::Benchmark(const Options& options)
+    : options(options), model(nullptr), loader(nullptr), sync(nullptr) {
+    if (options.directory.isEmpty()) {
+        temporary.reset(new QTemporaryDir());
+        directory = temporary->path();
+    } else {
+        directory = options.directory;
+    }
+}
+
+/**
+ * @brief Destructor for the Benchmark class, removes the generated files unless a directory was given.
+ */
+Benchmark::~Benchmark() {
+    delete sync;
+    delete loader;
+    delete model;
+}
+
+/**
+ * @brief This function runs scenarios and collects their figures.
+ * @param names are the scenarios to run, every scenario if empty.
+ * @return an object with the options, the environment, one object of figures per scenario and the checks that failed.
+ */
+QJsonObject Benchmark::run(const QStringList& names) {
+    QJsonObject settings;
+    settings["parts"] = options.parts;
+    settings["triangles"] = options.triangles;
+    settings["copies"] = options.copies;
+    settings["frames"] = options.frames;
+    settings["edits"] = options.edits;
+    settings["instances"] = options.instances;
+    settings["vr_seconds"] = options.vrSeconds;
+    settings["filter_triangles"] = options.filterSize;
+    settings["scan_files"] = options.scanFiles;
+    settings["progressive_triangles"] = options.largeSize;
+    settings["reader_mb"] = options.readerSize;
+    settings["width"] = options.width;
+    settings["height"] = options.height;
+    settings["render"] = options.render;
+    settings["cache"] = options.cache;
+    settings["seed"] = int(options.seed);
+
+    QJsonObject environment;
+    environment["qt"] = QString(qVersion());
+    environment["vtk"] = QString(vtkVersion::GetVTKVersion());
+    environment["threads"] = QThread::idealThreadCount();
+
+    QJsonObject results;
+    for (const QString& name : scenarios()) {
+        if (!names.isEmpty() && !names.contains(name))
+            continue;
+
+        bool needsRender = std::find(std::begin(RENDER_SCENARIOS), std::end(RENDER_SCENARIOS), name) !=
+                           std::end(RENDER_SCENARIOS);
+        if (needsRender && !options.render) {
+            results[name] = QJsonObject({ { "skipped", "rendering is off" } });
+            continue;
+        }
+
+        QJsonObject result;
+        if (name == "load")
+            result = load();
+        else if (name == "first_frame")
+            result = firstFrame();
+        else if (name == "orbit")
+            result = orbit();
+        else if (name == "colour_edits")
+            result = colourEdits();
+        else if (name == "picks")
+            result = picks();
+        else if (name == "part_index")
+            result = partIndex();
+        else if (name == "stl_readers")
+            result = stlReaders();
+        else if (name == "mesh_preparation")
+            result = meshPreparation();
+        else if (name == "part_tree")
+            result = partTree();
+        else if (name == "directory_scan")
+            result = directoryScan();
+        else if (name == "large_folder")
+            result = largeFolder();
+        else if (name == "progressive_load")
+            result = progressiveLoad();
+        else if (name == "residency")
+            result = residency();
+        else if (name == "animation")
+            result = animation();
+        else if (name == "instancing")
+            result = instancing();
+        else if (name == "view_memory")
+            result = viewMemory();
+        else if (name == "vr_frames")
+            result = vrFrames();
+        else if (name == "filters")
+            result = filters();
+        else if (name == "sections")
+            result = sections();
+        else if (name == "project")
+            result = project();
+        results[name] = result;
+    }
+
+    if (window != nullptr)
+        environment["render_window"] = QString(window->GetClassName());
+
+    QJsonObject report;
+    report["options"] = settings;
+    report["environment"] = environment;
+    report["scenarios"] = results;
+    report["failures"] = QJsonArray::fromStringList(failures);
+    return report;
+}
+
+/**
+ * @brief This function returns the checks that failed in the scenarios run so far.
+ * @return a description of each failed check, empty if they all passed.
+ */
+QStringList Benchmark::failedChecks() const {
+    return failures;
+}
+
+/**
+ * @brief This function generates the synthetic assembly and loads it through the STLLoader.
+ * The parts are added to the tree in one batch and their files queued, as Open Directory does.
+ * The files are then loaded again into new trees, once by a single worker and once by one worker
+ * per core, to time what the pool gains over reading the files one after another.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::load() {
+    QJsonObject result;
+    if (model != nullptr) {
+        result["skipped"] = "the assembly is already loaded";
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QStringList fileNames = SyntheticAssembly::write(directory, options.parts, options.triangles, options.copies);
+    if (fileNames.isEmpty()) {
+        result["error"] = QString("could not write the assembly to %1").arg(directory);
+        return result;
+    }
+    result["write_ms"] = elapsedMs(timer);
+
+    /* The cache lives with the generated files so runs never touch the user's cache */
+    GeometryCache::setDirectory(QDir(directory).filePath("cache"));
+    GeometryCache::setEnabled(options.cache);
+
+    model = new ModelPartList("PartsList");
+    loader = new STLLoader();
+    QObject::connect(loader, &STLLoader::partsLoaded, [this](const QList<ModelPart*>& parts) {
+        ModelPartList::DeferredUpdates deferred(model);
+        for (ModelPart* part : parts)
+            model->updatePart(part);
+    });
+    QObject::connect(loader, &STLLoader::levelsBuilt, [this](ModelPart* part) {
+        model->updatePart(part);
+    });
+
+    QList<QList<QVariant>> rows;
+    for (const QString& fileName : fileNames)
+        rows.append({ QFileInfo(fileName).fileName(), true });
+
+    timer.restart();
+    QList<ModelPart*> parts = model->appendChildren(QModelIndex(), rows);
+    result["insert_ms"] = elapsedMs(timer);
+
+    QEventLoop loop;
+    QObject::connect(loader, &STLLoader::finished, &loop, &QEventLoop::quit);
+
+    timer.restart();
+    for (int i = 0; i < parts.size(); i++) {
+        parts[i]->setFileName(fileNames[i]);
+        loader->load(parts[i], fileNames[i]);
+    }
+    if (loader->isBusy())
+        loop.exec();
+    double loadMs = elapsedMs(timer);
+
+    /* Levels of detail are built after the batch has finished */
+    loader->waitForDone();
+    QCoreApplication::processEvents();
+    double levelsMs = elapsedMs(timer);
+
+    std::vector<ModelPart*> done = loadedParts(model);
+    std::unordered_set<const vtkPolyData*> distinct;
+    vtkIdType triangles = 0;
+    for (ModelPart* part : done) {
+        distinct.insert(part->getGeometry()->polyData());
+        triangles += part->getGeometry()->triangleCount();
+    }
+
+    size_t hostBytes = 0, gpuBytes = 0;
+    model->memoryUsage(hostBytes, gpuBytes);
+
+    result["threads"] = loader->threadCount();
+    result["load_ms"] = loadMs;
+    result["levels_ms"] = levelsMs;
+    result["parts_loaded"] = int(done.size());
+    result["distinct_geometry"] = int(distinct.size());
+    result["triangles"] = double(triangles);
+    result["parts_per_s"] = loadMs > 0. ? 1000. * double(done.size()) / loadMs : 0.;
+    result["triangles_per_s"] = loadMs > 0. ? 1000. * double(triangles) / loadMs : 0.;
+    result["host_bytes"] = double(hostBytes);
+
+    /* The same files again with one worker and with one per core, the cache off so both parse every file */
+    bool cache = GeometryCache::isEnabled();
+    GeometryCache::setEnabled(false);
+    auto timedLoad = [&fileNames, &rows](int threads) {
+        ModelPartList tree("PartsList");
+        STLLoader passLoader;
+        passLoader.setThreadCount(threads);
+        QList<ModelPart*> passParts = tree.appendChildren(QModelIndex(), rows);
+
+        QEventLoop passLoop;
+        QObject::connect(&passLoader, &STLLoader::finished, &passLoop, &QEventLoop::quit);
+        QElapsedTimer passTimer;
+        passTimer.start();
+        for (int i = 0; i < passParts.size(); i++)
+            passLoader.load(passParts[i], fileNames[i]);
+        if (passLoader.isBusy())
+            passLoop.exec();
+        double ms = elapsedMs(passTimer);
+
+        passLoader.cancel();
+        passLoader.waitForDone();
+        return ms;
+    };
+    double serialMs = timedLoad(1);
+    double parallelMs = timedLoad(QThread::idealThreadCount());
+    GeometryCache::setEnabled(cache);
+
+    result["serial_ms"] = serialMs;
+    result["parallel_ms"] = parallelMs;
+    result["parallel_speedup"] = serialMs / std::max(parallelMs, 1e-3);
+    return result;
+}
+
+/**
+ * @brief This function renders the loaded assembly for the first time.
+ * The scene is built from the whole tree, then rendered twice: the first render uploads the geometry.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::firstFrame() {
+    QJsonObject result;
+    if (!requireAssembly()) {
+        result["error"] = "the assembly could not be loaded";
+        return result;
+    }
+    createWindow();
+
+    QElapsedTimer timer;
+    timer.start();
+    if (sync == nullptr)
+        sync = new SceneSync(model, renderer);
+    sync->rebuild();
+    result["scene_ms"] = elapsedMs(timer);
+
+    renderer->ResetCamera();
+    result["first_frame_ms"] = renderFrame();
+    result["second_frame_ms"] = renderFrame();
+    result["actors"] = sync->actorCount();
+    result["props"] = renderer->GetViewProps()->GetNumberOfItems();
+    return result;
+}
+
+/**
+ * @brief This function orbits the camera around the loaded assembly, one render per step.
+ * The camera makes one turn, rising and then falling back, with level of detail selection on and
+ * then the same turn with it off, which renders every part at full detail.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::orbit() {
+    QJsonObject result;
+    if (sync == nullptr || window == nullptr)
+        result = firstFrame();
+    if (result.contains("error"))
+        return result;
+
+    /* One full turn, the camera ends where it started so both passes see the same views */
+    auto pass = [this]() {
+        std::vector<double> frames;
+        frames.reserve(size_t(options.frames));
+        vtkCamera* camera = renderer->GetActiveCamera();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < options.frames; i++) {
+            camera->Azimuth(360. / double(std::max(options.frames, 1)));
+            camera->Elevation(i < options.frames / 2 ? 0.5 : -0.5);
+            camera->OrthogonalizeViewUp();
+            renderer->ResetCameraClippingRange();
+            frames.push_back(renderFrame());
+        }
+        double totalMs = elapsedMs(timer);
+
+        QJsonObject figures = summary(frames);
+        figures["fps"] = totalMs > 0. ? 1000. * double(frames.size()) / totalMs : 0.;
+        figures["triangles_last_frame"] = double(sync->levelOfDetail().triangleCount());
+        return figures;
+    };
+
+    LODSelector& lods = sync->levelOfDetail();
+    bool enabled = lods.isEnabled();
+    lods.setEnabled(true);
+    result = pass();
+
+    /* The same turn with every part at full detail */
+    lods.setEnabled(false);
+    QJsonObject full = pass();
+    lods.setEnabled(enabled);
+
+    result["lod_off"] = full;
+    result["lod_speedup"] = full["mean_ms"].toDouble() / std::max(result["mean_ms"].toDouble(), 1e-3);
+    return result;
+}
+
+/**
+ * @brief This function changes the colour of random parts of a 5,000-part tree, one render per change.
+ * The tree is built for the scenario, whatever the size of the generated assembly, and drawn by its
+ * own renderer and SceneSync in the benchmark window. Each change goes through the model, as the
+ * colour dialog does: setting the colour and ModelPartList::updatePart(), whose dataChanged signal
+ * makes SceneSync update the part's actor, is timed as the scene update. The render that follows
+ * is timed on its own.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::colourEdits() {
+    QJsonObject result;
+    createWindow();
+
+    ModelPartList tree("PartsList");
+    QList<QList<QVariant>> rows;
+    for (int i = 0; i < EDIT_PARTS; i++)
+        rows.append({ QString("part_%1.stl").arg(i), true });
+    QList<ModelPart*> parts = tree.appendChildren(QModelIndex(), rows);
+
+    int grid = SyntheticAssembly::gridSize(EDIT_PARTS);
+    for (int i = 0; i < parts.size(); i++)
+        parts[i]->setGeometry(std::make_shared<const PartGeometry>(SyntheticAssembly::createPart(EDIT_TRIANGLES, i, grid)));
+
+    /* The assembly's renderer is swapped out so only the edited tree is drawn */
+    window->RemoveRenderer(renderer);
+    vtkNew<vtkRenderer> edited;
+    edited->SetBackground(0.1, 0.2, 0.4);
+    window->AddRenderer(edited);
+    {
+        SceneSync scene(&tree, edited);
+        scene.rebuild();
+        edited->ResetCamera();
+        renderFrame();
+
+        std::mt19937 random(options.seed);
+        std::uniform_int_distribution<int> pick(0, EDIT_PARTS - 1);
+        std::uniform_int_distribution<int> channel(0, 255);
+
+        std::vector<double> updates, frames;
+        updates.reserve(size_t(options.edits));
+        frames.reserve(size_t(options.edits));
+        for (int i = 0; i < options.edits; i++) {
+            ModelPart* part = parts[pick(random)];
+
+            QElapsedTimer timer;
+            timer.start();
+            part->setColour(channel(random), channel(random), channel(random));
+            tree.updatePart(part);
+            updates.push_back(elapsedMs(timer));
+
+            frames.push_back(renderFrame());
+        }
+
+        result = summary(updates);
+        result["render"] = summary(frames);
+        result["actors"] = scene.actorCount();
+    }
+    window->RemoveRenderer(edited);
+    window->AddRenderer(renderer);
+
+    result["parts"] = EDIT_PARTS;
+    return result;
+}
+
+/**
+ * @brief This function picks parts of the loaded assembly with exact ray casts.
+ * Rays run down through the centre of random parts, then random rays hit one part's triangle index directly.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::picks() {
+    QJsonObject result;
+    if (!requireAssembly()) {
+        result["error"] = "the assembly could not be loaded";
+        return result;
+    }
+    if (sync == nullptr) {
+        if (renderer == nullptr)
+            renderer = vtkSmartPointer<vtkRenderer>::New();
+        sync = new SceneSync(model, renderer);
+        sync->rebuild();
+    }
+
+    std::vector<ModelPart*> parts = loadedParts(model);
+    if (parts.empty()) {
+        result["error"] = "no part was loaded";
+        return result;
+    }
+
+    std::mt19937 random(options.seed);
+    std::uniform_int_distribution<size_t> pick(0, parts.size() - 1);
+
+    double sceneBounds[6];
+    if (!sync->boundsIndex().getBounds(sceneBounds)) {
+        result["error"] = "the scene has no bounds";
+        return result;
+    }
+
+    int hits = 0;
+    const double down[3] = { 0., 0., -1. };
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ASSEMBLY_PICKS; i++) {
+        double partBounds[6];
+        parts[pick(random)]->getGeometry()->polyData()->GetBounds(partBounds);
+        double origin[3] = { 0.5 * (partBounds[0] + partBounds[1]), 0.5 * (partBounds[2] + partBounds[3]),
+                             sceneBounds[5] + 1. };
+        if (sync->pick(origin, down) != nullptr)
+            hits++;
+    }
+    double assemblyMs = elapsedMs(timer);
+
+    /* Rays from around a single part towards random points inside its box */
+    const PartGeometry* geometry = parts.front()->getGeometry().get();
+    double bounds[6];
+    geometry->polyData()->GetBounds(bounds);
+    double centre[3] = { 0.5 * (bounds[0] + bounds[1]), 0.5 * (bounds[2] + bounds[3]), 0.5 * (bounds[4] + bounds[5]) };
+    double radius = bounds[1] - bounds[0] + bounds[3] - bounds[2] + bounds[5] - bounds[4];
+
+    std::uniform_real_distribution<double> unit(-1., 1.);
+    int triangleHits = 0;
+    timer.restart();
+    for (int i = 0; i < PART_PICKS; i++) {
+        double origin[3], direction[3];
+        for (int k = 0; k < 3; k++) {
+            origin[k] = centre[k] + radius * unit(random);
+            direction[k] = centre[k] + 0.25 * (bounds[2 * k + 1] - bounds[2 * k]) * unit(random) - origin[k];
+        }
+        double distance = 1e300;
+        if (geometry->pickIndex()->intersect(origin, direction, distance))
+            triangleHits++;
+    }
+    double partMs = elapsedMs(timer);
+
+    result["assembly_picks"] = ASSEMBLY_PICKS;
+    result["assembly_hits"] = hits;
+    result["assembly_picks_per_s"] = assemblyMs > 0. ? 1000. * ASSEMBLY_PICKS / assemblyMs : 0.;
+    result["triangle_index_rays"] = PART_PICKS;
+    result["triangle_index_hits"] = triangleHits;
+    result["triangle_index_triangles"] = double(geometry->pickIndex()->triangleCount());
+    result["triangle_index_rays_per_s"] = partMs > 0. ? 1000. * PART_PICKS / partMs : 0.;
+    return result;
+}
+
+/**
+ * @brief This function culls and ray casts a PartBVH of 1,000, 10,000 and 100,000 boxes.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::partIndex() {
+    QJsonObject result;
+
+    vtkNew<vtkCubeSource> cube;
+    vtkNew<vtkPolyDataMapper> mapper;
+    mapper->SetInputConnection(cube->GetOutputPort());
+    mapper->Update();
+
+    std::mt19937 random(options.seed);
+    for (int size : INDEX_SIZES) {
+        /* Unit boxes spread through a cube about twice as wide as they would be packed */
+        double side = 2. * std::cbrt(double(size));
+        std::uniform_real_distribution<double> position(0., side);
+        std::vector<vtkSmartPointer<vtkActor>> actors(size_t(size));
+        for (vtkSmartPointer<vtkActor>& actor : actors) {
+            actor = vtkSmartPointer<vtkActor>::New();
+            actor->SetMapper(mapper);
+            actor->SetPosition(position(random), position(random), position(random));
+        }
+
+        PartBVH index;
+        QElapsedTimer timer;
+        timer.start();
+        for (vtkActor* actor : actors)
+            index.insert(actor);
+        double insertMs = elapsedMs(timer);
+
+        /* A camera outside the cube turning around it, looking at its centre */
+        vtkNew<vtkCamera> camera;
+        camera->SetFocalPoint(0.5 * side, 0.5 * side, 0.5 * side);
+        camera->SetPosition(0.5 * side, 0.5 * side, 2. * side);
+        camera->SetClippingRange(0.1, 4. * side);
+
+        double planes[24];
+        double visible = 0.;
+        timer.restart();
+        for (int i = 0; i < INDEX_CULLS; i++) {
+            camera->Azimuth(360. / INDEX_CULLS);
+            camera->GetFrustumPlanes(16. / 9., planes);
+            visible += index.cull(planes);
+        }
+        double cullMs = elapsedMs(timer) / INDEX_CULLS;
+
+        std::uniform_real_distribution<double> unit(-1., 1.);
+        int hits = 0;
+        timer.restart();
+        for (int i = 0; i < INDEX_RAYS; i++) {
+            double origin[3] = { 0.5 * side + side * unit(random), 0.5 * side + side * unit(random), 2. * side };
+            double direction[3] = { 0.5 * side - origin[0], 0.5 * side - origin[1], 0.5 * side - origin[2] };
+            if (index.raycast(origin, direction) != nullptr)
+                hits++;
+        }
+        double rayMs = elapsedMs(timer);
+
+        QJsonObject figures;
+        figures["insert_ms"] = insertMs;
+        figures["height"] = index.height();
+        figures["cull_ms"] = cullMs;
+        figures["visible"] = visible / INDEX_CULLS;
+        figures["rays_per_s"] = rayMs > 0. ? 1000. * INDEX_RAYS / rayMs : 0.;
+        figures["ray_hits"] = hits;
+        result[QString::number(size)] = figures;
+    }
+    return result;
+}
+
+/**
+ * @brief This function reads binary STL files from 1 MB up with the FastSTLReader and with vtkSTLReader.
+ * Files of 1, 16, 256 and 2048 MB are written, as far as the largest size asked for, which is
+ * also read if it is not one of them. Each file is read by vtkSTLReader and by the FastSTLReader,
+ * both welding the vertices, and by the FastSTLReader without welding, which is how the loader
+ * uses it. The files are in the page cache after being written, so the rates are those of
+ * parsing rather than of the disk.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::stlReaders() {
+    QJsonObject result;
+    std::vector<int> sizes;
+    for (int size : READER_SIZES) {
+        if (size < options.readerSize)
+            sizes.push_back(size);
+    }
+    sizes.push_back(options.readerSize);
+
+    for (int size : sizes) {
+        QJsonObject figures;
+        QString fileName = QDir(directory).filePath(QString("reader_%1mb.stl").arg(size));
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!SyntheticAssembly::writeLargeSTL(fileName, qint64(size) * 1048576)) {
+            result["error"] = QString("could not write %1").arg(fileName);
+            QFile::remove(fileName);
+            break;
+        }
+        figures["write_ms"] = elapsedMs(timer);
+        double fileMb = double(QFileInfo(fileName).size()) / 1048576.;
+        figures["file_mb"] = fileMb;
+
+        /* Each reader is freed before the next one runs, the larger files need most of the memory */
+        auto timed = [&timer, fileMb](vtkPolyDataAlgorithm* reader) {
+            QJsonObject read;
+            timer.restart();
+            reader->Update();
+            double ms = elapsedMs(timer);
+            vtkPolyData* output = reader->GetOutput();
+            read["ms"] = ms;
+            read["mb_per_s"] = ms > 0. ? 1000. * fileMb / ms : 0.;
+            read["points"] = double(output->GetNumberOfPoints());
+            read["triangles"] = double(output->GetNumberOfPolys());
+            return read;
+        };
+        {
+            vtkNew<vtkSTLReader> reader;
+            reader->SetFileName(fileName.toStdString().c_str());
+            figures["vtk_stl_reader"] = timed(reader);
+        }
+        {
+            vtkNew<FastSTLReader> reader;
+            reader->SetFileName(fileName.toStdString());
+            figures["fast_stl_reader"] = timed(reader);
+        }
+        {
+            vtkNew<FastSTLReader> reader;
+            reader->SetFileName(fileName.toStdString());
+            reader->MergePointsOff();
+            figures["fast_stl_reader_unwelded"] = timed(reader);
+        }
+
+        double vtkMs = figures["vtk_stl_reader"].toObject()["ms"].toDouble();
+        double fastMs = figures["fast_stl_reader"].toObject()["ms"].toDouble();
+        figures["speedup"] = vtkMs / std::max(fastMs, 1e-3);
+        result[QString("mb_%1").arg(size)] = figures;
+        QFile::remove(fileName);
+    }
+    return result;
+}
+
+/**
+ * @brief This function welds and adds normals to parts of 10,000 to 1,000,000 triangles with MeshPreparation and with VTK's filters.
+ * Each part starts as unwelded triangles, as the loader reads them. MeshPreparation::prepare is
+ * compared with the VTK pipeline that does the same: vtkCleanPolyData merging identical points,
+ * then vtkPolyDataNormals computing smooth point normals without splitting sharp edges or
+ * reordering the triangles.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::meshPreparation() {
+    QJsonObject result;
+    for (int triangles : PREPARATION_SIZES) {
+        QJsonObject figures;
+        vtkSmartPointer<vtkPolyData> raw = SyntheticAssembly::createTriangles(triangles);
+        figures["triangles"] = double(raw->GetNumberOfPolys());
+
+        QElapsedTimer timer;
+        timer.start();
+        vtkSmartPointer<vtkPolyData> prepared = MeshPreparation::prepare(raw);
+        double prepareMs = elapsedMs(timer);
+        figures["prepare_ms"] = prepareMs;
+        figures["prepare_points"] = double(prepared->GetNumberOfPoints());
+
+        timer.restart();
+        vtkNew<vtkCleanPolyData> clean;
+        clean->SetInputData(raw);
+        clean->PointMergingOn();
+        clean->SetTolerance(0.);
+        vtkNew<vtkPolyDataNormals> normals;
+        normals->SetInputConnection(clean->GetOutputPort());
+        normals->ComputePointNormalsOn();
+        normals->ComputeCellNormalsOff();
+        normals->SplittingOff();
+        normals->ConsistencyOff();
+        normals->Update();
+        double vtkMs = elapsedMs(timer);
+        figures["vtk_ms"] = vtkMs;
+        figures["vtk_points"] = double(normals->GetOutput()->GetNumberOfPoints());
+
+        figures["speedup"] = vtkMs / std::max(prepareMs, 1e-3);
+        result[QString("triangles_%1").arg(triangles)] = figures;
+    }
+    return result;
+}
+
+/**
+ * @brief This function builds a part tree of 100,000 parts, walks it, and adds a lazy folder of 50,000 files.
+ * The folders are filled with one insertion each, and then 10,000 rows are added one at a time for
+ * comparison. The walk, parent() and row() passes are repeated on the same folders held as child
+ * lists, the way the tree was stored before PartTree, where a row is found by searching the parent's list. The resident memory of the process is read before and after, on Linux. A smaller tree
+ * is built, updated and fetched under QAbstractItemModelTester, and any failure it reports is recorded
+ * as a failed check, as is a lazy row that is not requested when shown, or not requested again once
+ * its load has failed.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::partTree() {
+    QJsonObject result;
+    double rssBefore = residentMegabytes();
+    ModelPartList tree("PartsList");
+
+    QList<QList<QVariant>> folderRows;
+    for (int i = 0; i < TREE_FOLDERS + 1; i++)
+        folderRows.append({ QString("Folder %1").arg(i), true });
+    QList<ModelPart*> folders = tree.appendChildren(QModelIndex(), folderRows);
+
+    QList<QList<QVariant>> rows;
+    QStringList fileNames;
+    for (int i = 0; i < std::max(TREE_FOLDER_SIZE, TREE_LAZY_SIZE); i++) {
+        rows.append({ QString("part_%1.stl").arg(i), true });
+        fileNames.append(QString("part_%1.stl").arg(i));
+    }
+
+    /* Insertion, one batch of rows per folder */
+    std::vector<double> inserts;
+    QElapsedTimer timer;
+    for (int i = 0; i < TREE_FOLDERS; i++) {
+        timer.start();
+        tree.appendChildren(tree.indexOf(folders[i]), rows.mid(0, TREE_FOLDER_SIZE));
+        inserts.push_back(elapsedMs(timer));
+    }
+
+    /* A flat pass over the tree's columns, then the parent and row of every part through the model as a view asks */
+    const PartTree* nodes = tree.getRootItem()->getTree();
+    int eagerNodes = nodes->size();
+    timer.start();
+    qint64 checksum = 0;
+    for (int node = 0; node < nodes->size(); node++)
+        checksum += nodes->childCount(node) + nodes->name(node).size() + (nodes->visible(node) ? 1 : 0);
+    double walkMs = elapsedMs(timer);
+
+    timer.start();
+    for (int node = 0; node < nodes->size(); node++) {
+        QModelIndex index = tree.indexOf(nodes->part(node));
+        checksum += tree.parent(index).row();
+    }
+    double parentMs = elapsedMs(timer);
+
+    timer.start();
+    for (int node = 0; node < nodes->size(); node++)
+        checksum += nodes->part(node)->row();
+    double rowMs = elapsedMs(timer);
+
+    /* The same folders as child lists, walked and looked up the way the tree did before PartTree */
+    double legacyWalkMs, legacyParentMs, legacyRowMs;
+    int legacyNodes;
+    {
+        LegacyItem legacy;
+        std::vector<LegacyItem*> items = { &legacy };
+        for (int i = 0; i < TREE_FOLDERS + 1; i++) {
+            LegacyItem* folder = new LegacyItem{ &legacy, {}, folderRows[i] };
+            legacy.children.append(folder);
+            items.push_back(folder);
+            for (int j = 0; i < TREE_FOLDERS && j < TREE_FOLDER_SIZE; j++) {
+                folder->children.append(new LegacyItem{ folder, {}, rows[j] });
+                items.push_back(folder->children.last());
+            }
+        }
+
+        timer.start();
+        std::vector<const LegacyItem*> stack = { &legacy };
+        while (!stack.empty()) {
+            const LegacyItem* item = stack.back();
+            stack.pop_back();
+            checksum += item->children.size() + (item->itemData.isEmpty() ? 0 : item->itemData[0].toString().size())
+                + (item->itemData.size() > 1 && item->itemData[1].toBool() ? 1 : 0);
+            for (const LegacyItem* child : item->children)
+                stack.push_back(child);
+        }
+        legacyWalkMs = elapsedMs(timer);
+
+        /* ModelPartList::parent() made the parent's index from its row */
+        timer.start();
+        for (const LegacyItem* item : items) {
+            if (item->parent != nullptr && item->parent != &legacy)
+                checksum += item->parent->row();
+        }
+        legacyParentMs = elapsedMs(timer);
+
+        timer.start();
+        for (const LegacyItem* item : items)
+            checksum += item->row();
+        legacyRowMs = elapsedMs(timer);
+        legacyNodes = int(items.size());
+    }
+
+    /* A lazy folder only makes the first block of parts, the rest as a view scrolls */
+    QModelIndex lazy = tree.indexOf(folders.last());
+    timer.start();
+    tree.appendLater(lazy, rows.mid(0, TREE_LAZY_SIZE), fileNames.mid(0, TREE_LAZY_SIZE));
+    double lazyMs = elapsedMs(timer);
+    int firstBlock = folders.last()->childCount();
+
+    timer.start();
+    while (tree.canFetchMore(lazy))
+        tree.fetchMore(lazy);
+    double fetchMs = elapsedMs(timer);
+
+    /* The same number of rows as a folder, added one at a time as appendChild() does */
+    QModelIndex single = tree.indexOf(tree.appendChildren(QModelIndex(), { { QString("Single rows"), true } }).first());
+    timer.start();
+    for (int i = 0; i < TREE_FOLDER_SIZE; i++)
+        tree.appendChild(single, rows[i]);
+    double singleMs = elapsedMs(timer);
+    double rssAfter = residentMegabytes();
+
+    /* A smaller tree built and changed in every way the application does, under the model tester */
+    modelTestFailures = 0;
+    defaultMessageHandler = qInstallMessageHandler(countModelTestFailures);
+    {
+        ModelPartList checked("PartsList");
+        QAbstractItemModelTester tester(&checked, QAbstractItemModelTester::FailureReportingMode::Warning);
+
+        QList<ModelPart*> checkedFolders = checked.appendChildren(QModelIndex(), folderRows.mid(0, TESTER_FOLDERS + 1));
+        for (int i = 0; i < TESTER_FOLDERS; i++) {
+            QList<ModelPart*> parts = checked.appendChildren(checked.indexOf(checkedFolders[i]), rows.mid(0, TESTER_FOLDER_SIZE));
+            ModelPartList::DeferredUpdates deferred(&checked);
+            for (int j = 0; j < parts.size(); j += 3) {
+                parts[j]->setColour(j % 256, 128, 255 - j % 256);
+                parts[j]->setVisible(j % 2 == 0);
+                checked.updatePart(parts[j]);
+            }
+        }
+        QModelIndex checkedLazy = checked.indexOf(checkedFolders.last());
+        checked.appendLater(checkedLazy, rows.mid(0, TESTER_LAZY_SIZE), fileNames.mid(0, TESTER_LAZY_SIZE));
+        while (checked.canFetchMore(checkedLazy))
+            checked.fetchMore(checkedLazy);
+        checked.updatePart(checkedFolders.first());
+
+        /* Showing the lazy rows requests each part once, and again once its load has failed */
+        int requests = 0;
+        QObject::connect(&checked, &ModelPartList::partsRequested, [&requests](const QList<ModelPart*>& parts) {
+            requests += int(parts.size());
+        });
+        QList<ModelPart*> shown;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int row = 0; row < checked.rowCount(checkedLazy); row++) {
+                QModelIndex index = checked.index(row, 0, checkedLazy);
+                checked.partShown(index);
+                if (pass == 0)
+                    shown.append(static_cast<ModelPart*>(index.internalPointer()));
+            }
+            QCoreApplication::processEvents();
+            if (pass == 0)
+                checked.requestFailed(shown);
+        }
+        if (requests != 2 * int(shown.size()))
+            failures.append(QString("part_tree: %1 requests for %2 parts shown twice with a failure between")
+                            .arg(requests).arg(shown.size()));
+    }
+    qInstallMessageHandler(defaultMessageHandler);
+    if (modelTestFailures != 0)
+        failures.append(QString("part_tree: QAbstractItemModelTester reported %1 failures").arg(modelTestFailures));
+
+    result["parts"] = nodes->size();
+    result["insert_10k"] = summary(inserts);
+    result["walk_ms"] = walkMs;
+    result["parent_ns"] = 1e6 * parentMs / double(eagerNodes);
+    result["row_all_ms"] = rowMs;
+    result["legacy_walk_ms"] = legacyWalkMs;
+    result["legacy_parent_ns"] = 1e6 * legacyParentMs / double(legacyNodes);
+    result["legacy_row_all_ms"] = legacyRowMs;
+    result["row_speedup"] = legacyRowMs / std::max(rowMs, 1e-3);
+    result["lazy_append_ms"] = lazyMs;
+    result["lazy_first_block"] = firstBlock;
+    result["lazy_fetch_all_ms"] = fetchMs;
+    result["insert_10k_single_rows_ms"] = singleMs;
+    result["model_tester_failures"] = modelTestFailures;
+    if (rssBefore >= 0. && rssAfter >= 0.) {
+        result["rss_mb"] = rssAfter;
+        result["rss_tree_mb"] = rssAfter - rssBefore;
+        result["rss_bytes_per_part"] = 1048576. * (rssAfter - rssBefore) / double(nodes->size());
+    }
+    result["checksum"] = double(checksum);
+    return result;
+}
+
+/**
+ * @brief This function scans a generated folder tree through the DirectoryScanner, first only building the rows and then loading the files.
+ * The tree has 20 subassemblies of 10 folders each, the files spread evenly over the folders. The
+ * first pass only builds the rows, which times the walk and the insertions. The second pass also
+ * queues every file on an STLLoader, as Open Directory does, and times until every part is loaded.
+ * The tree is then loaded twice more with the geometry cache on and empty: the cold pass parses
+ * every file and stores it, the warm pass finds every file in the cache, which is what reopening
+ * the folder costs. Every pass reports the time until the first row appears, which is what the
+ * user waits for.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::directoryScan() {
+    QJsonObject result;
+    QDir root(QDir(directory).filePath("scan"));
+
+    QElapsedTimer timer;
+    timer.start();
+    int written = 0;
+    for (int group = 0; group < SCAN_GROUPS; group++) {
+        for (int folder = 0; folder < SCAN_FOLDERS; folder++) {
+            QString path = root.filePath(QString("subassembly_%1/folder_%2").arg(group).arg(folder));
+            if (!QDir().mkpath(path)) {
+                result["error"] = QString("could not create %1").arg(path);
+                return result;
+            }
+
+            int first = options.scanFiles * (group * SCAN_FOLDERS + folder) / (SCAN_GROUPS * SCAN_FOLDERS);
+            int last = options.scanFiles * (group * SCAN_FOLDERS + folder + 1) / (SCAN_GROUPS * SCAN_FOLDERS);
+            for (int i = first; i < last; i++) {
+                std::vector<float> vertices = SyntheticAssembly::sphere(SCAN_TRIANGLES, i, SyntheticAssembly::spacing(),
+                                                                        SyntheticAssembly::gridSize(options.scanFiles));
+                if (!SyntheticAssembly::writeSTL(QDir(path).filePath(QString("part_%1.stl").arg(i)), vertices)) {
+                    result["error"] = QString("could not write the folder tree to %1").arg(root.path());
+                    return result;
+                }
+                written++;
+            }
+        }
+    }
+    result["write_ms"] = elapsedMs(timer);
+
+    /* One pass, timed from the call to scan() until the rows (and with a loader, the parts) are all there */
+    auto pass = [&](bool load) {
+        QJsonObject figures;
+        ModelPartList tree("PartsList");
+        STLLoader loader;
+        DirectoryScanner scanner(&tree, load ? &loader : nullptr);
+        scanner.setLazyThreshold(SCAN_LAZY_SIZE);
+
+        QElapsedTimer passTimer;
+        double firstRowMs = -1.;
+        double firstPartMs = -1.;
+        int folders = 0, files = 0;
+        QObject::connect(&tree, &QAbstractItemModel::rowsInserted, [&]() {
+            if (firstRowMs < 0.)
+                firstRowMs = elapsedMs(passTimer);
+        });
+        QObject::connect(&loader, &STLLoader::partsLoaded, [&](const QList<ModelPart*>& parts) {
+            if (firstPartMs < 0.)
+                firstPartMs = elapsedMs(passTimer);
+            ModelPartList::DeferredUpdates deferred(&tree);
+            for (ModelPart* part : parts)
+                tree.updatePart(part);
+        });
+        QObject::connect(&scanner, &DirectoryScanner::progressChanged, [&](int listed, int found) {
+            folders = listed;
+            files = found;
+        });
+
+        passTimer.start();
+        QEventLoop loop;
+        QObject::connect(&scanner, &DirectoryScanner::finished, &loop, &QEventLoop::quit);
+        scanner.scan(root.path(), QModelIndex());
+        if (scanner.isBusy())
+            loop.exec();
+        figures["time_to_first_row_ms"] = firstRowMs;
+        figures["scan_ms"] = elapsedMs(passTimer);
+
+        /* The loader may still be reading the last files queued */
+        if (load) {
+            QEventLoop loadLoop;
+            QObject::connect(&loader, &STLLoader::finished, &loadLoop, &QEventLoop::quit);
+            if (loader.isBusy())
+                loadLoop.exec();
+            figures["time_to_first_part_ms"] = firstPartMs;
+            figures["load_ms"] = elapsedMs(passTimer);
+            figures["parts_loaded"] = int(loadedParts(&tree).size());
+        }
+
+        figures["folders"] = folders;
+        figures["files"] = files;
+        figures["rows"] = tree.getRootItem()->getTree()->size() - 1;
+        return figures;
+    };
+
+    /* The cache lives with the generated files so runs never touch the user's cache */
+    QString cacheDirectory = GeometryCache::directory();
+    bool cache = GeometryCache::isEnabled();
+    GeometryCache::setDirectory(QDir(directory).filePath("scan_cache"));
+    GeometryCache::setEnabled(options.cache);
+
+    result["files_written"] = written;
+    result["rows_only"] = pass(false);
+    result["with_loader"] = pass(true);
+
+    GeometryCache::setEnabled(true);
+    GeometryCache::clear();
+    QJsonObject cold = pass(true);
+    QJsonObject warm = pass(true);
+    result["cold_cache"] = cold;
+    result["warm_cache"] = warm;
+    result["warm_speedup"] = cold["load_ms"].toDouble() / std::max(warm["load_ms"].toDouble(), 1e-3);
+
+    GeometryCache::clear();
+    GeometryCache::setDirectory(cacheDirectory);
+    GeometryCache::setEnabled(cache);
+    return result;
+}
+
+/**
+ * @brief This function opens a folder of 50,000 STL files into a tree view, the way Open Directory does, and times the first paint.
+ * The folder is scanned by a DirectoryScanner with the application's lazy threshold, so the first
+ * 2,000 files become parts and are loaded and the rest are added with appendLater(). The tree is
+ * shown in a QTreeView with the application's ShownPartDelegate, on Qt's offscreen platform, and
+ * each new folder row is expanded. The first paint is the time from the call to scan() until the
+ * view has painted a part row, with the folder row expanded as the parts arrive. The view is then scrolled to the bottom, which fetches a block of
+ * the lazy rows and requests the geometry of those painted. The resident memory the scan, the
+ * tree and the view added is read at the end. A first paint of a second or more, more than 64 MB
+ * added, or every file made into a part, is recorded as a failed check.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::largeFolder() {
+    QJsonObject result;
+    QDir folder(QDir(directory).filePath("large_folder"));
+    if (!QDir().mkpath(folder.path())) {
+        result["error"] = QString("could not create %1").arg(folder.path());
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int grid = SyntheticAssembly::gridSize(LARGE_FOLDER_FILES);
+    for (int i = 0; i < LARGE_FOLDER_FILES; i++) {
+        QString fileName = folder.filePath(QString("part_%1.stl").arg(i));
+        if (!SyntheticAssembly::writeSTL(fileName, SyntheticAssembly::sphere(SCAN_TRIANGLES, i, SyntheticAssembly::spacing(), grid))) {
+            result["error"] = QString("could not write %1").arg(fileName);
+            folder.removeRecursively();
+            return result;
+        }
+    }
+    result["write_ms"] = elapsedMs(timer);
+
+    /* The cache lives with the generated files so runs never touch the user's cache */
+    QString cacheDirectory = GeometryCache::directory();
+    bool cache = GeometryCache::isEnabled();
+    GeometryCache::setDirectory(QDir(directory).filePath("large_folder_cache"));
+    GeometryCache::setEnabled(options.cache);
+
+    double firstPaintMs = -1.;
+    int requested = 0;
+    int madeParts = 0;
+    double rssBefore = -1., rssAfter = -1.;
+    {
+        ModelPartList tree("PartsList");
+        STLLoader loader;
+        DirectoryScanner scanner(&tree, &loader);
+        scanner.setLazyThreshold(SCAN_LAZY_SIZE);
+
+        /* Wired as in the main window */
+        QObject::connect(&tree, &ModelPartList::partsRequested, [&loader, &requested](const QList<ModelPart*>& parts) {
+            requested += int(parts.size());
+            for (ModelPart* part : parts)
+                loader.load(part, part->getFileName());
+        });
+        QObject::connect(&loader, &STLLoader::partsFailed, &tree, &ModelPartList::requestFailed);
+        QObject::connect(&loader, &STLLoader::partsLoaded, [&tree](const QList<ModelPart*>& parts) {
+            ModelPartList::DeferredUpdates deferred(&tree);
+            for (ModelPart* part : parts)
+                tree.updatePart(part);
+        });
+
+        QEventLoop painted;
+        QTreeView view;
+        view.setModel(&tree);
+        view.setItemDelegate(new FirstPaintDelegate(&tree, &view, [&]() {
+            if (firstPaintMs < 0.) {
+                firstPaintMs = elapsedMs(timer);
+                painted.quit();
+            }
+        }));
+        view.setUniformRowHeights(true);
+        view.resize(400, 800);
+        QObject::connect(&tree, &QAbstractItemModel::rowsInserted, [&view](const QModelIndex& parent) {
+            if (parent.isValid())
+                view.expand(parent);
+        });
+
+        /* The empty view is shown first, so the platform's start-up is neither timed nor counted */
+        view.show();
+        QCoreApplication::processEvents();
+        rssBefore = residentMegabytes();
+
+        QTimer::singleShot(LARGE_FOLDER_TIMEOUT_MS, &painted, &QEventLoop::quit);
+        timer.start();
+        scanner.scan(folder.path(), QModelIndex());
+        painted.exec();
+
+        QEventLoop loop;
+        QObject::connect(&scanner, &DirectoryScanner::finished, &loop, &QEventLoop::quit);
+        if (scanner.isBusy())
+            loop.exec();
+        result["scan_ms"] = elapsedMs(timer);
+
+        QEventLoop loadLoop;
+        QObject::connect(&loader, &STLLoader::finished, &loadLoop, &QEventLoop::quit);
+        if (loader.isBusy())
+            loadLoop.exec();
+        result["load_ms"] = elapsedMs(timer);
+        result["parts_loaded"] = int(loadedParts(&tree).size());
+
+        /* Scrolling to the end of the folder fetches lazy rows, and the ones painted are requested */
+        int madeBefore = tree.getRootItem()->getTree()->size() - 1;
+        view.scrollToBottom();
+        QCoreApplication::processEvents();
+        QCoreApplication::processEvents();
+        result["rows_fetched_by_scroll"] = tree.getRootItem()->getTree()->size() - 1 - madeBefore;
+        result["lazy_parts_requested"] = requested;
+
+        madeParts = tree.getRootItem()->getTree()->size() - 1;
+        rssAfter = residentMegabytes();
+
+        scanner.cancel();
+        loader.cancel();
+        loader.waitForDone();
+    }
+
+    result["files"] = LARGE_FOLDER_FILES;
+    result["first_paint_ms"] = firstPaintMs;
+    result["rows_made"] = madeParts;
+    if (rssBefore >= 0. && rssAfter >= 0.)
+        result["rss_mb"] = rssAfter - rssBefore;
+
+    if (firstPaintMs < 0. || firstPaintMs >= LARGE_FOLDER_FIRST_PAINT_MS)
+        failures.append(QString("large_folder: first part painted after %1 ms").arg(firstPaintMs < 0. ? LARGE_FOLDER_TIMEOUT_MS : firstPaintMs));
+    if (rssBefore >= 0. && rssAfter - rssBefore > LARGE_FOLDER_RSS_MB)
+        failures.append(QString("large_folder: the tree added %1 MB of resident memory").arg(rssAfter - rssBefore));
+    if (madeParts >= LARGE_FOLDER_FILES)
+        failures.append("large_folder: every file was made into a part");
+
+    folder.removeRecursively();
+    GeometryCache::clear();
+    GeometryCache::setDirectory(cacheDirectory);
+    GeometryCache::setEnabled(cache);
+    return result;
+}
+
+/**
+ * @brief This function loads large files through the STLLoader, with and without progressive loading.
+ * Two files are written, one with a quarter of the triangles and one with all of them. Each is
+ * loaded once with progressive loading off, when nothing shows until the whole file is read, and
+ * once with it on. Both report the time until the part first shows something and until it shows
+ * its full geometry, and the longest the event loop went without running, which is how long the
+ * GUI would have frozen. These two passes have the geometry cache off so the file is parsed. The
+ * file is then loaded progressively with the cache on, as the application does: first with an
+ * empty cache, which also hashes and stores the file, then again when it is found in the cache.
+ * The files are in the page cache after being written, so the times are those of a fast disk.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::progressiveLoad() {
+    QJsonObject result;
+    QString cacheDirectory = GeometryCache::directory();
+    bool cache = GeometryCache::isEnabled();
+    GeometryCache::setDirectory(QDir(directory).filePath("progressive_cache"));
+
+    auto pass = [](const QString& fileName, bool progressive, bool cached) {
+        QJsonObject figures;
+        GeometryCache::setEnabled(cached);
+        ModelPartList tree("PartsList");
+        STLLoader loader;
+        loader.setProgressive(progressive);
+        ModelPart* part = tree.appendChildren(QModelIndex(), { { QFileInfo(fileName).fileName(), true } }).first();
+
+        QElapsedTimer timer;
+        double completeMs = -1.;
+        std::vector<double> previews;
+        vtkIdType previewTriangles = 0;
+        QObject::connect(&loader, &STLLoader::partsPreviewed, [&]() {
+            previews.push_back(elapsedMs(timer));
+            previewTriangles = part->getGeometry()->triangleCount();
+        });
+        QObject::connect(&loader, &STLLoader::partsLoaded, [&]() {
+            completeMs = elapsedMs(timer);
+        });
+
+        /* A timer that should fire every few milliseconds, the longest gap is how long the loop was held up */
+        QTimer ticker;
+        ticker.setInterval(STALL_TICK_MS);
+        QElapsedTimer gap;
+        double stallMs = 0.;
+        QObject::connect(&ticker, &QTimer::timeout, [&]() {
+            stallMs = std::max(stallMs, elapsedMs(gap));
+            gap.restart();
+        });
+
+        QEventLoop loop;
+        QObject::connect(&loader, &STLLoader::finished, &loop, &QEventLoop::quit);
+        timer.start();
+        gap.start();
+        ticker.start();
+        loader.load(part, fileName);
+        if (loader.isBusy())
+            loop.exec();
+        ticker.stop();
+
+        if (completeMs < 0. || part->getGeometry() == nullptr) {
+            figures["error"] = QString("could not load %1").arg(fileName);
+            return figures;
+        }
+        figures["time_to_first_visible_ms"] = previews.empty() ? completeMs : previews.front();
+        if (previews.size() > 1) {
+            figures["time_to_preview_ms"] = previews[1];
+            figures["preview_triangles"] = double(previewTriangles);
+        }
+        figures["time_to_complete_ms"] = completeMs;
+        figures["max_event_loop_gap_ms"] = std::max(stallMs, elapsedMs(gap));
+        figures["triangles"] = double(part->getGeometry()->triangleCount());
+        return figures;
+    };
+
+    for (int triangles : { options.largeSize / 4, options.largeSize }) {
+        QJsonObject figures;
+        QString fileName = QDir(directory).filePath(QString("progressive_%1.stl").arg(triangles));
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!SyntheticAssembly::writeSTL(fileName, SyntheticAssembly::sphere(triangles, 0, SyntheticAssembly::spacing(), 1))) {
+            result["error"] = QString("could not write %1").arg(fileName);
+            break;
+        }
+        figures["write_ms"] = elapsedMs(timer);
+        figures["file_mb"] = double(QFileInfo(fileName).size()) / 1048576.;
+        figures["progressive_from_mb"] = double(STLLoader::progressiveSize()) / 1048576.;
+
+        figures["blocking"] = pass(fileName, false, false);
+        figures["progressive"] = pass(fileName, true, false);
+        GeometryCache::clear();
+        figures["progressive_cold_cache"] = pass(fileName, true, true);
+        figures["warm_cache"] = pass(fileName, true, true);
+        result[QString("triangles_%1").arg(triangles)] = figures;
+        QFile::remove(fileName);
+    }
+
+    GeometryCache::clear();
+    GeometryCache::setDirectory(cacheDirectory);
+    GeometryCache::setEnabled(cache);
+    return result;
+}
+
+/**
+ * @brief This function runs the ResidencyManager over in-memory parts with a budget half their size.
+ * The budget is then raised so proxies are reloaded, and every reload is reported as failed; the
+ * next update must ask for each of them again, or the failure is recorded as a failed check.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::residency() {
+    QJsonObject result;
+    ModelPartList tree("PartsList");
+
+    QList<QList<QVariant>> rows;
+    for (int i = 0; i < RESIDENCY_PARTS; i++)
+        rows.append({ QString("part_%1.stl").arg(i), true });
+    QList<ModelPart*> parts = tree.appendChildren(QModelIndex(), rows);
+
+    /* Distinct geometry for every part, each with a file name so it may be evicted */
+    int grid = SyntheticAssembly::gridSize(RESIDENCY_PARTS);
+    for (int i = 0; i < parts.size(); i++) {
+        vtkSmartPointer<vtkPolyData> polyData = SyntheticAssembly::createPart(options.triangles, i, grid);
+        parts[i]->setGeometry(std::make_shared<const PartGeometry>(polyData));
+        parts[i]->setFileName(rows[i].first().toString());
+        parts[i]->setLastShown(uint32_t(i + 1));
+    }
+
+    size_t hostBytes = 0, gpuBytes = 0;
+    tree.memoryUsage(hostBytes, gpuBytes);
+
+    /* A fixed pseudo-random importance per part stands in for the size on screen */
+    ResidencyManager manager(&tree);
+    manager.setImportance([](ModelPart* part) { return double((part->lastShown() * 2654435761u) % 1000u); });
+    int reloads = 0;
+    QList<ModelPart*> requested;
+    QObject::connect(&manager, &ResidencyManager::reloadRequested, [&reloads, &requested](const QList<ModelPart*>& parts) {
+        reloads += parts.size();
+        requested = parts;
+    });
+
+    manager.setBudget(hostBytes / 2, gpuBytes / 2);
+    QElapsedTimer timer;
+    timer.start();
+    manager.update();
+    double evictMs = elapsedMs(timer);
+    ResidencyManager::Counters evicted = manager.counters();
+
+    timer.start();
+    manager.update();
+    double steadyMs = elapsedMs(timer);
+
+    manager.setBudget(hostBytes * 2, gpuBytes * 2);
+    timer.start();
+    manager.update();
+    double reloadMs = elapsedMs(timer);
+
+    /* Reloads that fail are asked for again by the next update, the parts keep their proxies meanwhile */
+    int firstReloads = reloads;
+    manager.reloadFailed(requested);
+    manager.update();
+    int retries = reloads - firstReloads;
+    if (retries != firstReloads)
+        failures.append(QString("residency: %1 of %2 failed reloads were asked for again").arg(retries).arg(firstReloads));
+
+    result["parts"] = RESIDENCY_PARTS;
+    result["host_bytes"] = double(hostBytes);
+    result["host_budget"] = double(hostBytes / 2);
+    result["evict_update_ms"] = evictMs;
+    result["evictions"] = evicted.evictions;
+    result["host_bytes_after"] = double(evicted.hostBytes);
+    result["steady_update_ms"] = steadyMs;
+    result["reload_update_ms"] = reloadMs;
+    result["reloads_requested"] = firstReloads;
+    result["reloads_retried"] = retries;
+    return result;
+}
+
+/**
+ * @brief This function animates 10,000 parts with the Animator, checking that the poses do not depend on the frame times.
+ * Every part is a small cube in its own grid cell, with its own seeded rotation and translation
+ * rates, under a global rotation while the assembly explodes. The same ten simulated seconds are
+ * played three times, each by a new Animator on its own actors: at a steady 90 frames a second,
+ * with irregular frame times and stalls, and with the same irregular times again. The last two
+ * must end with exactly the same poses, and the steady run with the same poses to rounding,
+ * since the simulation runs on fixed steps; a difference is recorded as a failed check. The
+ * update times of the steady run are the cost of animating the parts each frame.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::animation() {
+    QJsonObject result;
+    int grid = SyntheticAssembly::gridSize(ANIMATION_PARTS);
+    double spacing = SyntheticAssembly::spacing();
+
+    /* Frame times of the irregular runs: 8 to 14 ms, with a 70 ms stall every 97th frame */
+    std::vector<double> irregular;
+    std::mt19937 jitter(options.seed);
+    std::uniform_real_distribution<double> frameTime(0.008, 0.014);
+    for (double time = 0.; time < ANIMATION_SECONDS; ) {
+        time = std::min(time + (irregular.size() % 97 == 96 ? 0.07 : frameTime(jitter)), ANIMATION_SECONDS);
+        irregular.push_back(time);
+    }
+    std::vector<double> steady;
+    for (int frame = 1; double(frame) * ANIMATION_FRAME < ANIMATION_SECONDS; frame++)
+        steady.push_back(double(frame) * ANIMATION_FRAME);
+    steady.push_back(ANIMATION_SECONDS);
+
+    /* Plays the frame times on new actors and returns the final pose of every part */
+    auto play = [&](const std::vector<double>& times, std::vector<double>* updateMs) {
+        std::vector<vtkSmartPointer<vtkActor>> actors;
+        Animator animator;
+        std::mt19937 random(options.seed);
+        std::uniform_real_distribution<double> rate(-30., 30.);
+        std::uniform_real_distribution<double> drift(-0.5, 0.5);
+        for (int i = 0; i < ANIMATION_PARTS; i++) {
+            vtkNew<vtkCubeSource> cube;
+            cube->SetCenter(spacing * (i % grid), spacing * ((i / grid) % grid), spacing * (i / (grid * grid)));
+            vtkNew<vtkPolyDataMapper> mapper;
+            mapper->SetInputConnection(cube->GetOutputPort());
+            vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+            actor->SetMapper(mapper);
+            animator.addPart(actor);
+
+            double rotate[3] = { rate(random), rate(random), rate(random) };
+            double translate[3] = { drift(random), drift(random), drift(random) };
+            animator.setPartMotion(actor, rotate, translate);
+            actors.push_back(actor);
+        }
+        animator.setRotation(2, 10.);
+        animator.setExplode(1., 0.25);
+
+        for (double time : times) {
+            QElapsedTimer timer;
+            timer.start();
+            animator.update(time);
+            if (updateMs != nullptr)
+                updateMs->push_back(elapsedMs(timer));
+        }
+
+        std::vector<double> poses(actors.size() * 16);
+        for (size_t i = 0; i < actors.size(); i++)
+            animator.getPose(actors[i], poses.data() + 16 * i);
+        return poses;
+    };
+
+    std::vector<double> updateMs;
+    std::vector<double> steadyPoses = play(steady, &updateMs);
+    std::vector<double> irregularPoses = play(irregular, nullptr);
+    std::vector<double> replayPoses = play(irregular, nullptr);
+
+    double frameRateError = 0.;
+    for (size_t i = 0; i < steadyPoses.size(); i++)
+        frameRateError = std::max(frameRateError, std::abs(steadyPoses[i] - irregularPoses[i]));
+    bool replayed = irregularPoses == replayPoses;
+
+    result = summary(updateMs);
+    result["parts"] = ANIMATION_PARTS;
+    result["simulated_s"] = ANIMATION_SECONDS;
+    result["steady_frames"] = int(steady.size());
+    result["irregular_frames"] = int(irregular.size());
+    result["ns_per_part"] = result["mean_ms"].toDouble() * 1e6 / double(ANIMATION_PARTS);
+    result["replay_identical"] = replayed;
+    result["max_frame_rate_error"] = frameRateError;
+
+    if (!replayed)
+        failures.append("animation: replaying the same frame times gave different poses");
+    if (frameRateError > 1e-9)
+        failures.append(QString("animation: poses differ by %1 between frame rates").arg(frameRateError));
+    return result;
+}
+
+/**
+ * @brief This function measures the memory of 200 parts each drawn by a desktop and a VR actor, the way the parts were drawn before PartGeometry and now.
+ * Before, each part kept its vtkSTLReader output: the desktop actor drew it through a
+ * vtkPolyDataMapper and the VR actor through a vtkDataSetMapper, which extracts the surface of
+ * its input into a mesh of its own. Now the part's prepared mesh is one PartGeometry and both
+ * actors come from PartGeometry::createActor(). Both ways the two actors are drawn once, in two
+ * renderers side by side standing in for the desktop and VR views, so the mappers have built
+ * everything they keep. The host memory is the arrays of every mesh the mappers draw, each array
+ * counted once however many meshes share it. The GPU memory is estimated from the meshes each
+ * mapper uploads. The resident memory the process gained is reported too, on Linux.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::viewMemory() {
+    QJsonObject result;
+    createWindow();
+
+    QDir folder(QDir(directory).filePath("view_memory"));
+    if (!QDir().mkpath(folder.path())) {
+        result["error"] = QString("could not create %1").arg(folder.path());
+        return result;
+    }
+    int grid = SyntheticAssembly::gridSize(VIEW_MEMORY_PARTS);
+    QStringList fileNames;
+    for (int i = 0; i < VIEW_MEMORY_PARTS; i++) {
+        QString fileName = folder.filePath(QString("part_%1.stl").arg(i));
+        if (!SyntheticAssembly::writeSTL(fileName, SyntheticAssembly::sphere(options.triangles, i, SyntheticAssembly::spacing(), grid))) {
+            result["error"] = QString("could not write %1").arg(fileName);
+            return result;
+        }
+        fileNames.append(fileName);
+    }
+
+    /* The assembly's renderer is swapped out for a desktop and a VR view side by side */
+    window->RemoveRenderer(renderer);
+    auto measure = [this, &fileNames](bool shared) {
+        QJsonObject figures;
+        double rssBefore = residentMegabytes();
+        vtkNew<vtkRenderer> desktop, vr;
+        desktop->SetViewport(0., 0., 0.5, 1.);
+        vr->SetViewport(0.5, 0., 1., 1.);
+        window->AddRenderer(desktop);
+        window->AddRenderer(vr);
+
+        std::vector<vtkSmartPointer<vtkSTLReader>> readers;
+        std::vector<std::shared_ptr<const PartGeometry>> geometry;
+        std::vector<vtkSmartPointer<vtkMapper>> mappers;
+        double partHost = 0.;
+        for (const QString& fileName : fileNames) {
+            if (shared) {
+                vtkSmartPointer<vtkPolyData> polyData = STLLoader::readGeometry(fileName);
+                if (polyData == nullptr)
+                    continue;
+                geometry.push_back(std::make_shared<const PartGeometry>(polyData));
+                partHost += double(geometry.back()->hostBytes());
+                for (vtkRenderer* view : { desktop.GetPointer(), vr.GetPointer() }) {
+                    vtkSmartPointer<vtkActor> actor = geometry.back()->createActor();
+                    view->AddActor(actor);
+                    mappers.push_back(actor->GetMapper());
+                }
+            } else {
+                vtkSmartPointer<vtkSTLReader> reader = vtkSmartPointer<vtkSTLReader>::New();
+                reader->SetFileName(fileName.toStdString().c_str());
+                reader->Update();
+                readers.push_back(reader);
+
+                vtkNew<vtkPolyDataMapper> desktopMapper;
+                desktopMapper->SetInputConnection(reader->GetOutputPort());
+                vtkNew<vtkDataSetMapper> vrMapper;
+                vrMapper->SetInputConnection(reader->GetOutputPort());
+                const std::pair<vtkRenderer*, vtkMapper*> views[] = { { desktop.GetPointer(), desktopMapper.GetPointer() },
+                                                                      { vr.GetPointer(), vrMapper.GetPointer() } };
+                for (const auto& view : views) {
+                    vtkNew<vtkActor> actor;
+                    actor->SetMapper(view.second);
+                    view.first->AddActor(actor);
+                    mappers.push_back(view.second);
+                }
+            }
+        }
+        desktop->ResetCamera();
+        vr->ResetCamera();
+        figures["first_frame_ms"] = renderFrame();
+
+        /* The meshes each mapper draws, the dataset mapper's own surface included */
+        std::unordered_set<vtkAbstractArray*> arrays;
+        double gpu = 0.;
+        for (vtkMapper* mapper : mappers) {
+            vtkPolyData* drawn = nullptr;
+            if (vtkDataSetMapper* datasetMapper = vtkDataSetMapper::SafeDownCast(mapper)) {
+                addArrays(vtkPolyData::SafeDownCast(datasetMapper->GetInput()), arrays);
+                if (datasetMapper->GetPolyDataMapper() != nullptr)
+                    drawn = datasetMapper->GetPolyDataMapper()->GetInput();
+            } else if (vtkPolyDataMapper* polyMapper = vtkPolyDataMapper::SafeDownCast(mapper)) {
+                drawn = polyMapper->GetInput();
+            }
+            addArrays(drawn, arrays);
+            gpu += meshGpuBytes(drawn);
+        }
+        double rssAfter = residentMegabytes();
+
+        figures["host_bytes"] = arrayBytes(arrays);
+        figures["gpu_bytes"] = gpu;
+        if (shared)
+            figures["part_geometry_host_bytes"] = partHost;
+        if (rssBefore >= 0. && rssAfter >= 0.)
+            figures["rss_mb"] = rssAfter - rssBefore;
+
+        window->RemoveRenderer(desktop);
+        window->RemoveRenderer(vr);
+        return figures;
+    };
+
+    QJsonObject before = measure(false);
+    QJsonObject after = measure(true);
+    window->AddRenderer(renderer);
+
+    result["parts"] = VIEW_MEMORY_PARTS;
+    result["triangles_per_part"] = options.triangles;
+    result["dual_pipeline"] = before;
+    result["shared_geometry"] = after;
+    result["host_ratio"] = after["host_bytes"].toDouble() / std::max(before["host_bytes"].toDouble(), 1.);
+    result["gpu_ratio"] = after["gpu_bytes"].toDouble() / std::max(before["gpu_bytes"].toDouble(), 1.);
+
+    for (const QString& fileName : fileNames)
+        QFile::remove(fileName);
+    return result;
+}
+
+/**
+ * @brief This function renders many copies of one part, as separate actors and then instanced.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::instancing() {
+    QJsonObject result;
+    createWindow();
+
+    int grid = SyntheticAssembly::gridSize(options.instances);
+    std::shared_ptr<const PartGeometry> geometry =
+        std::make_shared<const PartGeometry>(SyntheticAssembly::createPart(options.triangles));
+
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<double> colour(0., 1.);
+
+    /* The assembly's renderer is swapped out so only the copies are drawn */
+    window->RemoveRenderer(renderer);
+    for (bool instanced : { false, true }) {
+        vtkNew<vtkRenderer> copies;
+        window->AddRenderer(copies);
+
+        InstancedScene scene(instanced ? 8 : INT_MAX);
+        scene.setRenderer(copies);
+        std::vector<vtkSmartPointer<vtkActor>> actors;
+        for (int i = 0; i < options.instances; i++) {
+            vtkSmartPointer<vtkActor> actor = geometry->createActor();
+            actor->SetPosition(SyntheticAssembly::spacing() * double(i % grid),
+                               SyntheticAssembly::spacing() * double((i / grid) % grid),
+                               SyntheticAssembly::spacing() * double(i / (grid * grid)));
+            actor->GetProperty()->SetColor(colour(random), colour(random), colour(random));
+            scene.add(actor, geometry->polyData());
+            actors.push_back(actor);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        scene.update();
+        double updateMs = elapsedMs(timer);
+
+        copies->ResetCamera();
+        double first = 0.;
+        {
+            QElapsedTimer frame;
+            frame.start();
+            window->Render();
+            window->WaitForCompletion();
+            first = elapsedMs(frame);
+        }
+
+        std::vector<double> frames;
+        for (int i = 0; i < INSTANCING_FRAMES; i++) {
+            copies->GetActiveCamera()->Azimuth(360. / INSTANCING_FRAMES);
+            copies->ResetCameraClippingRange();
+
+            QElapsedTimer frame;
+            frame.start();
+            scene.update();
+            window->Render();
+            window->WaitForCompletion();
+            frames.push_back(elapsedMs(frame));
+        }
+
+        QJsonObject figures = summary(frames);
+        figures["props"] = scene.propCount();
+        figures["update_ms"] = updateMs;
+        figures["first_frame_ms"] = first;
+        result[instanced ? "instanced" : "separate"] = figures;
+
+        scene.clear();
+        window->RemoveRenderer(copies);
+    }
+    window->AddRenderer(renderer);
+
+    result["copies"] = options.instances;
+    result["triangles_per_copy"] = double(geometry->triangleCount());
+    return result;
+}
+
+/**
+ * @brief This function runs the VR thread on the loaded assembly with a simulated headset.
+ * The headset plays its built-in script unpaced, so the frame times are the cost of the VR loop and
+ * of rendering both eyes; each eye is half the width of the benchmark window. The mean frame time
+ * is taken from the headset, so running the scenario from builds with and without VR_FRAME_STATS
+ * gives the cost of recording the phases.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::vrFrames() {
+    QJsonObject result;
+    if (!requireAssembly()) {
+        result["error"] = "the assembly could not be loaded";
+        return result;
+    }
+
+    SimulatedHMD* hmd = new SimulatedHMD(std::max(options.width / 2, 1), options.height);
+    hmd->setDefaultScript(options.vrSeconds);
+
+    VRRenderThread thread;
+    thread.setBackend(hmd);
+    for (ModelPart* part : loadedParts(model)) {
+        vtkSmartPointer<vtkActor> actor = part->getGeometry()->createActor();
+        actor->GetProperty()->SetColor(part->getColourR() / 255., part->getColourG() / 255., part->getColourB() / 255.);
+        thread.addActorOffline(actor);
+        thread.setActorGeometry(actor, part->getGeometry());
+    }
+
+    /* Picks are counted as they happen, there is no event loop to deliver the queued signal */
+    std::atomic<int> picked(0);
+    QObject::connect(&thread, &VRRenderThread::partPicked, &thread, [&picked](vtkActor*) { picked++; },
+                     Qt::DirectConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    thread.start();
+    thread.wait();
+    double totalMs = elapsedMs(timer);
+
+    SimulatedHMD::Timing timing = hmd->timing();
+    if (timing.frames == 0) {
+        result["error"] = "the simulated headset rendered no frames";
+        return result;
+    }
+
+    result["frames"] = double(timing.frames);
+    result["actions"] = double(timing.actions);
+    result["picks"] = picked.load();
+    result["run_ms"] = totalMs;
+    result["fps"] = timing.seconds > 0. ? double(timing.frames) / timing.seconds : 0.;
+    result["stereo_render_mean_ms"] = timing.renderMs / double(timing.frames);
+    result["stereo_render_max_ms"] = timing.maxRenderMs;
+
+    /* The mean frame does not depend on the frame stats, so builds with and without them can be compared */
+    result["frame_mean_ms"] = 1000. * timing.seconds / double(timing.frames);
+#ifdef VR_FRAME_STATS
+    result["frame_stats"] = true;
+#else
+    result["frame_stats"] = false;
+#endif
+
+    /* The phases of the VR loop, when the thread records them */
+    FrameStats& stats = thread.frameStats();
+    stats.collect();
+    if (stats.frameCount() > 0) {
+        for (int phase = 0; phase < FrameStats::PHASE_COUNT; phase++) {
+            FrameStats::Phase p = FrameStats::Phase(phase);
+            QJsonObject figures;
+            figures["mean_ms"] = stats.mean(p);
+            figures["p50_ms"] = stats.percentile(p, 50.);
+            figures["p95_ms"] = stats.percentile(p, 95.);
+            figures["p99_ms"] = stats.percentile(p, 99.);
+            result[FrameStats::phaseName(p)] = figures;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief This function clips and shrinks one large part through the FilterPipeline, with and without cached stages.
+ * The kernels are timed on their own first. The pipeline then goes through the steps of a user
+ * ticking the boxes: both filters cold, shrink off and on again, clip off and on again, and both
+ * off. Each step is timed until the part shows its result, including the pick index built for it.
+ * The clipping plane passes through the centre of the part, so about half of it is kept.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::filters() {
+    QJsonObject result;
+    ModelPartList tree("PartsList");
+    ModelPart* part = tree.appendChildren(QModelIndex(), { { QString("filtered.stl"), true } }).first();
+
+    QElapsedTimer timer;
+    timer.start();
+    part->setGeometry(std::make_shared<const PartGeometry>(SyntheticAssembly::createPart(options.filterSize)));
+    result["create_ms"] = elapsedMs(timer);
+    result["triangles"] = double(part->getGeometry()->triangleCount());
+
+    FilterPipeline::Settings settings = FilterPipeline::defaults();
+    double bounds[6];
+    part->getGeometry()->getBounds(bounds);
+    for (int k = 0; k < 3; k++)
+        settings.origin[k] = 0.5 * (bounds[2 * k] + bounds[2 * k + 1]);
+
+    vtkPolyData* source = part->getGeometry()->polyData();
+    timer.start();
+    vtkSmartPointer<vtkPolyData> clipped = FilterPipeline::clip(source, settings.origin, settings.normal);
+    result["clip_kernel_ms"] = elapsedMs(timer);
+    timer.start();
+    vtkSmartPointer<vtkPolyData> shrunk = FilterPipeline::shrink(clipped, settings.factor);
+    result["shrink_kernel_ms"] = elapsedMs(timer);
+    result["clipped_triangles"] = double(shrunk->GetNumberOfCells());
+    clipped = nullptr;
+    shrunk = nullptr;
+
+    /* Results come back through the event loop, as they do in the application */
+    FilterPipeline pipeline(&tree);
+    auto step = [&](bool clip, bool shrink) {
+        settings.clip = clip;
+        settings.shrink = shrink;
+        QElapsedTimer stepTimer;
+        stepTimer.start();
+        pipeline.setFilters(part, settings);
+        while (pipeline.isBusy()) {
+            pipeline.waitForDone();
+            QCoreApplication::processEvents();
+        }
+        return elapsedMs(stepTimer);
+    };
+
+    result["clip_shrink_cold_ms"] = step(true, true);
+    result["shown_triangles"] = double(part->getDisplayGeometry()->triangleCount());
+    result["shrink_off_ms"] = step(true, false);
+    result["shrink_on_cached_ms"] = step(true, true);
+    result["clip_off_ms"] = step(false, true);
+    result["clip_on_cached_ms"] = step(true, true);
+    result["filters_off_ms"] = step(false, false);
+    return result;
+}
+
+/**
+ * @brief This function drags section planes through the loaded assembly, one render per step, then caps the cut parts.
+ * A plane normal to X is turned on through the centre and dragged across the assembly, one render
+ * per step, as the position slider does. The drag is repeated with all six planes on (the other
+ * five boxing in the assembly). For comparison, one step of cutting the geometry on the CPU (a
+ * clip of every part, as the clip filter does) is timed without rendering. Finally the planes are
+ * left still and the cut faces of every part are computed by the SectionCapper and rendered.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::sections() {
+    QJsonObject result;
+    if (sync == nullptr || window == nullptr)
+        result = firstFrame();
+    if (result.contains("error"))
+        return result;
+
+    double bounds[6];
+    if (!sync->boundsIndex().getBounds(bounds)) {
+        result["error"] = "no part is in the scene";
+        return result;
+    }
+    double centre[3];
+    for (int k = 0; k < 3; k++)
+        centre[k] = 0.5 * (bounds[2 * k] + bounds[2 * k + 1]);
+
+    /* Plane 0 moves along X, the others close in on the assembly from each side */
+    auto place = [&](int index, double position) {
+        double origin[3] = { centre[0], centre[1], centre[2] };
+        double normal[3] = { 0., 0., 0. };
+        int axis = index < 2 ? 0 : (index < 4 ? 1 : 2);
+        double sign = index % 2 == 0 ? -1. : 1.;
+        origin[axis] = bounds[2 * axis] + position * (bounds[2 * axis + 1] - bounds[2 * axis]);
+        normal[axis] = sign;
+        sync->setSectionPlane(index, true, origin, normal);
+    };
+    auto drag = [&]() {
+        std::vector<double> frames;
+        frames.reserve(size_t(options.frames));
+        for (int i = 0; i < options.frames; i++) {
+            place(0, 0.2 + 0.6 * double(i) / double(std::max(options.frames - 1, 1)));
+            frames.push_back(renderFrame());
+        }
+        return frames;
+    };
+
+    renderer->ResetCamera();
+    renderFrame();
+    QElapsedTimer timer;
+    timer.start();
+    place(0, 0.5);
+    renderFrame();
+    result["enable_frame_ms"] = elapsedMs(timer);
+    result["drag"] = summary(drag());
+
+    for (int i = 1; i < SectionPlanes::MAX_PLANES; i++)
+        place(i, i % 2 == 0 ? 0.1 : 0.9);
+    result["drag_six_planes"] = summary(drag());
+
+    /* What one drag step would cost if the parts were cut again instead */
+    std::vector<ModelPart*> parts = loadedParts(model);
+    double normal[3] = { -1., 0., 0. };
+    timer.start();
+    for (ModelPart* part : parts)
+        FilterPipeline::clip(part->getDisplayGeometry()->polyData(), centre, normal);
+    result["cpu_clip_step_ms"] = elapsedMs(timer);
+
+    /* Caps arrive through the event loop, as they do in the application */
+    SectionCapper capper(model, &sync->sectionPlanes());
+    QObject::connect(&capper, &SectionCapper::capsChanged, [this, &capper](const QList<ModelPart*>& changed) {
+        for (ModelPart* part : changed)
+            sync->setCap(part, capper.cap(part));
+    });
+    timer.start();
+    capper.setEnabled(true);
+    while (capper.isBusy()) {
+        capper.waitForDone();
+        QCoreApplication::processEvents();
+    }
+    result["caps_ms"] = elapsedMs(timer);
+
+    double capTriangles = 0.;
+    int capped = 0;
+    for (ModelPart* part : parts) {
+        std::shared_ptr<const PartGeometry> cap = capper.cap(part);
+        if (cap != nullptr) {
+            capped++;
+            capTriangles += double(cap->triangleCount());
+        }
+    }
+    result["capped_frame_ms"] = renderFrame();
+    result["caps"] = capped;
+    result["caps_shown"] = sync->sectionPlanes().visibleCaps();
+    result["cap_triangles"] = capTriangles;
+
+    /* Later scenarios see the whole assembly again */
+    capper.setEnabled(false);
+    double off[3] = { 0., 0., 0. }, up[3] = { 0., 0., 1. };
+    for (int i = 0; i < SectionPlanes::MAX_PLANES; i++)
+        sync->setSectionPlane(i, false, off, up);
+    renderFrame();
+    return result;
+}
+
+/**
+ * @brief This function saves the loaded assembly as a project in each geometry mode, opens it again and checks what came back.
+ * The loaded parts are put in groups under folder rows and given colours and placements, and some
+ * are hidden, so every field of the format is used. The tree is saved with full, quantized and no
+ * geometry, and each project is opened into a new tree. Opening the project without geometry reads
+ * every STL file again, which is what the other two are compared with. The opened tree is checked
+ * against the saved one part by part: names, rows, visibility, colours, placements, source files and
+ * counts must match exactly, positions and normals within the rounding of the mode. A part that
+ * differs, or geometry outside the tolerance, is recorded as a failure (see failures()). The geometry
+ * cache is off so the STL files are parsed.
+ * @return the figures of the scenario.
+ */
+QJsonObject Benchmark::project() {
+    QJsonObject result;
+    if (!requireAssembly()) {
+        result["error"] = "the assembly could not be loaded";
+        return result;
+    }
+    bool cache = GeometryCache::isEnabled();
+    GeometryCache::setEnabled(false);
+
+    /* The saved tree shares the geometry of the loaded parts, so copies stay copies */
+    std::vector<ModelPart*> loaded = loadedParts(model);
+    ModelPartList saved("PartsList");
+    std::mt19937 random(options.seed);
+    std::uniform_int_distribution<int> channel(0, 255);
+    std::uniform_real_distribution<double> angle(0., 2. * vtkMath::Pi());
+    for (size_t first = 0; first < loaded.size(); first += PROJECT_GROUP_SIZE) {
+        QString name = QString("group_%1").arg(first / PROJECT_GROUP_SIZE);
+        ModelPart* group = saved.appendChildren(QModelIndex(), { { name, true } }).first();
+        size_t last = std::min(first + PROJECT_GROUP_SIZE, loaded.size());
+
+        QList<QList<QVariant>> rows;
+        for (size_t i = first; i < last; i++)
+            rows.append({ loaded[i]->data(0), i % 7 != 3 });
+        QList<ModelPart*> parts = saved.appendChildren(saved.indexOf(group), rows);
+
+        for (size_t i = first; i < last; i++) {
+            ModelPart* part = parts[int(i - first)];
+            double turn = angle(random);
+            double placement[16] = { std::cos(turn), -std::sin(turn), 0., double(i),
+                                     std::sin(turn), std::cos(turn), 0., 0.5 * double(i),
+                                     0., 0., 1., -double(i),
+                                     0., 0., 0., 1. };
+            part->setFileName(loaded[i]->getFileName());
+            part->setColour(channel(random), channel(random), channel(random));
+            part->setTransform(placement);
+            part->setGeometry(loaded[i]->getGeometry());
+        }
+    }
+
+    auto preorder = [](ModelPartList& tree) {
+        std::vector<ModelPart*> parts;
+        std::vector<ModelPart*> stack = { tree.getRootItem() };
+        while (!stack.empty()) {
+            ModelPart* part = stack.back();
+            stack.pop_back();
+            if (part != tree.getRootItem())
+                parts.push_back(part);
+            for (int row = part->childCount() - 1; row >= 0; row--)
+                stack.push_back(part->child(row));
+        }
+        return parts;
+    };
+
+    /* Largest difference between the points and normals of two meshes, positions relative to the size of the part */
+    auto geometryError = [](vtkPolyData* from, vtkPolyData* to, double& positionError, double& normalError) {
+        if (from->GetNumberOfPoints() != to->GetNumberOfPoints() || from->GetNumberOfPolys() != to->GetNumberOfPolys())
+            return false;
+
+        double bounds[6];
+        from->GetBounds(bounds);
+        double size = std::max({ bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4], 1e-12 });
+        vtkDataArray* fromNormals = from->GetPointData()->GetNormals();
+        vtkDataArray* toNormals = to->GetPointData()->GetNormals();
+        for (vtkIdType i = 0; i < from->GetNumberOfPoints(); i++) {
+            double p[3], q[3], m[3], n[3];
+            from->GetPoint(i, p);
+            to->GetPoint(i, q);
+            fromNormals->GetTuple(i, m);
+            toNormals->GetTuple(i, n);
+            for (int c = 0; c < 3; c++) {
+                positionError = std::max(positionError, std::abs(p[c] - q[c]) / size);
+                normalError = std::max(normalError, std::abs(m[c] - n[c]));
+            }
+        }
+        return true;
+    };
+
+    std::vector<ModelPart*> original = preorder(saved);
+    result["parts"] = int(original.size());
+
+    /* Full geometry and reimported files must come back exactly, quantized geometry within its rounding */
+    struct Mode {
+        QString                 name;                   /**< Name of the figures */
+        ProjectFile::Geometry   geometry;               /**< How the geometry is saved */
+        double                  positionTolerance;      /**< Largest position error allowed, relative to the size of the part */
+        double                  normalTolerance;        /**< Largest error allowed in a normal component */
+    };
+    const Mode modes[] = {
+        { "full", ProjectFile::FULL_GEOMETRY, 0., 0. },
+        { "quantized", ProjectFile::QUANTIZED_GEOMETRY, QUANTIZED_POSITION_TOLERANCE, QUANTIZED_NORMAL_TOLERANCE },
+        { "reimport_stl", ProjectFile::NO_GEOMETRY, 0., 0. }
+    };
+    for (const auto& mode : modes) {
+        QJsonObject figures;
+        QString fileName = QDir(directory).filePath(QString("assembly_%1.vrproj").arg(mode.name));
+
+        QElapsedTimer timer;
+        timer.start();
+        QString error;
+        if (!ProjectFile::save(fileName, &saved, mode.geometry, nullptr, &error)) {
+            figures["error"] = error;
+            failures.append(QString("project %1: %2").arg(mode.name, error));
+            result[mode.name] = figures;
+            continue;
+        }
+        figures["save_ms"] = elapsedMs(timer);
+        figures["file_mb"] = double(QFileInfo(fileName).size()) / 1048576.;
+
+        ModelPartList opened("PartsList");
+        STLLoader projectLoader;
+        QEventLoop loop;
+        QObject::connect(&projectLoader, &STLLoader::finished, &loop, &QEventLoop::quit);
+
+        timer.restart();
+        if (!ProjectFile::open(fileName, &opened, QModelIndex(), &projectLoader, &error)) {
+            figures["error"] = error;
+            failures.append(QString("project %1: %2").arg(mode.name, error));
+            result[mode.name] = figures;
+            continue;
+        }
+        figures["time_to_rows_ms"] = elapsedMs(timer);
+        if (projectLoader.isBusy())
+            loop.exec();
+        figures["time_to_complete_ms"] = elapsedMs(timer);
+
+        /* Both trees in pre-order, part by part */
+        std::vector<ModelPart*> copy = preorder(opened);
+        int mismatches = int(std::max(copy.size(), original.size()) - std::min(copy.size(), original.size()));
+        double positionError = 0., normalError = 0.;
+        std::unordered_set<const vtkPolyData*> distinct;
+        for (size_t i = 0; i < std::min(copy.size(), original.size()); i++) {
+            ModelPart* a = original[i];
+            ModelPart* b = copy[i];
+            double m[16], n[16];
+            a->getTransform(m);
+            b->getTransform(n);
+            bool same = a->data(0) == b->data(0) && a->visible() == b->visible() && a->getFileName() == b->getFileName()
+                && a->getColourR() == b->getColourR() && a->getColourG() == b->getColourG()
+                && a->getColourB() == b->getColourB() && a->row() == b->row() && a->childCount() == b->childCount()
+                && std::equal(m, m + 16, n) && (a->getGeometry() == nullptr) == (b->getGeometry() == nullptr);
+            if (same && a->getGeometry() != nullptr) {
+                distinct.insert(b->getGeometry()->polyData());
+                same = geometryError(a->getGeometry()->polyData(), b->getGeometry()->polyData(), positionError, normalError);
+            }
+            if (!same)
+                mismatches++;
+        }
+        figures["mismatches"] = mismatches;
+        figures["distinct_geometry"] = int(distinct.size());
+        figures["max_position_error"] = positionError;
+        figures["max_normal_error"] = normalError;
+        result[mode.name] = figures;
+
+        if (mismatches != 0)
+            failures.append(QString("project %1: %2 parts differ from the saved tree").arg(mode.name).arg(mismatches));
+        if (positionError > mode.positionTolerance || normalError > mode.normalTolerance)
+            failures.append(QString("project %1: geometry error of %2 (positions) and %3 (normals) is over the tolerance")
+                            .arg(mode.name).arg(positionError).arg(normalError));
+
+        /* Levels of detail may still be building for the opened parts */
+        projectLoader.cancel();
+        projectLoader.waitForDone();
+        QFile::remove(fileName);
+    }
+
+    QJsonObject full = result["full"].toObject();
+    QJsonObject reimport = result["reimport_stl"].toObject();
+    if (full.contains("time_to_complete_ms") && reimport.contains("time_to_complete_ms"))
+        result["speedup_vs_reimport"] = reimport["time_to_complete_ms"].toDouble() / std::max(full["time_to_complete_ms"].toDouble(), 1e-3);
+
+    GeometryCache::setEnabled(cache);
+    return result;
+}
+
+/**
+ * @brief This function creates the offscreen render window on first use.
+ */
+void Benchmark::createWindow() {
+    if (window != nullptr)
+        return;
+
+    if (renderer == nullptr)
+        renderer = vtkSmartPointer<vtkRenderer>::New();
+    renderer->SetBackground(0.1, 0.2, 0.4);
+
+    window = vtkSmartPointer<vtkRenderWindow>::New();
+    window->SetOffScreenRendering(1);
+    window->SetSize(options.width, options.height);
+    window->AddRenderer(renderer);
+}
+
+/**
+ * @brief This function renders one frame and waits for it to finish.
+ * @return the time taken in milliseconds.
+ */
+double Benchmark::renderFrame() {
+    QElapsedTimer timer;
+    timer.start();
+    window->Render();
+    window->WaitForCompletion();
+    return elapsedMs(timer);
+}
+
+/**
+ * @brief This function makes sure the assembly is loaded, for scenarios run without the load scenario.
+ * @return false if the assembly could not be generated.
+ */
+bool Benchmark::requireAssembly() {
+    if (model == nullptr)
+        load();
+    return model != nullptr;
+}
@@ -0,0 +1,249 @@
+/** @file Benchmark.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Scripted, headless scenarios that time the load and render pipeline.
+  */
+
+#ifndef VIEWER_BENCHMARK_H
+#define VIEWER_BENCHMARK_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+
+class ModelPartList;
+class STLLoader;
+class SceneSync;
+
+/**
+ * @class Benchmark
+ * @brief The Benchmark class runs the scenarios of vr_bench and returns their figures as JSON.
+ *
+ * The assembly scenarios use the same classes as the application: parts are read from synthetic
+ * STL files by the STLLoader into a ModelPartList, and a SceneSync keeps an offscreen renderer in
+ * step with the tree. The remaining scenarios time one data structure each on generated data.
+ * Rendering needs an OpenGL context but no GPU (a software rasteriser such as Mesa's llvmpipe
+ * under a virtual X server is enough); the scenarios that render are skipped when rendering is
+ * turned off. Times are wall clock milliseconds. Some scenarios also check their results, and a
+ * check that fails is reported so the run can be failed (see failedChecks()).
+ */
+class Benchmark {
+public:
+    /**
+     * @struct Options
+     * @brief The Options structure holds the size of the generated data and of each scenario.
+     */
+    struct Options {
+        int         parts;          /**< Parts in the synthetic assembly */
+        int         triangles;      /**< Triangles of each part */
+        double      copies;         /**< Fraction of the parts that are copies of another part */
+        int         frames;         /**< Frames rendered by the orbit scenario */
+        int         edits;          /**< Colour changes made by the colour scenario */
+        int         instances;      /**< Copies drawn by the instancing scenario */
+        double      vrSeconds;      /**< Length of the simulated headset script of the VR scenario */
+        int         filterSize;     /**< Triangles of the part clipped and shrunk by the filter scenario */
+        int         scanFiles;      /**< STL files in the folder tree of the directory scan scenario */
+        int         largeSize;      /**< Triangles of the largest file of the progressive load scenario */
+        int         readerSize;     /**< Size in MB of the largest file of the STL reader scenario */
+        int         width;          /**< Width of the render window in pixels */
+        int         height;         /**< Height of the render window in pixels */
+        bool        render;         /**< False to skip the scenarios that render */
+        bool        cache;          /**< True to let the loader use the geometry cache */
+        unsigned    seed;           /**< Seed of the random choices, so runs can be compared */
+        QString     directory;      /**< Directory for the generated files, a temporary one if empty */
+    };
+
+    /**
+     * @brief This function returns the options used when none are given.
+     * @return the options.
+     */
+    static Options defaults();
+
+    /**
+     * @brief This function returns the name of every scenario, in the order they run.
+     * @return the names.
+     */
+    static QStringList scenarios();
+
+    /**
+     * @brief Constructor for the Benchmark class.
+     * @param options are the sizes to run with.
+     */
+    explicit Benchmark(const Options& options);
+
+    /**
+     * @brief Destructor for the Benchmark class, removes the generated files unless a directory was given.
+     */
+    ~Benchmark();
+
+    /**
+     * @brief This function runs scenarios and collects their figures.
+     * @param names are the scenarios to run, every scenario if empty.
+     * @return an object with the options, the environment, one object of figures per scenario and the checks that failed.
+     */
+    QJsonObject run(const QStringList& names);
+
+    /**
+     * @brief This function returns the checks that failed in the scenarios run so far.
+     * @return a description of each failed check, empty if they all passed.
+     */
+    QStringList failedChecks() const;
+
+private:
+    /**
+     * @brief This function generates the synthetic assembly and loads it through the STLLoader.
+     * @return the figures of the scenario.
+     */
+    QJsonObject load();
+
+    /**
+     * @brief This function renders the loaded assembly for the first time.
+     * @return the figures of the scenario.
+     */
+    QJsonObject firstFrame();
+
+    /**
+     * @brief This function orbits the camera around the loaded assembly, one render per step.
+     * @return the figures of the scenario.
+     */
+    QJsonObject orbit();
+
+    /**
+     * @brief This function changes the colour of random parts of a 5,000-part tree, one render per change, timing the scene update and the render apart.
+     * @return the figures of the scenario.
+     */
+    QJsonObject colourEdits();
+
+    /**
+     * @brief This function picks parts of the loaded assembly with exact ray casts.
+     * @return the figures of the scenario.
+     */
+    QJsonObject picks();
+
+    /**
+     * @brief This function culls and ray casts a PartBVH of 1,000, 10,000 and 100,000 boxes.
+     * @return the figures of the scenario.
+     */
+    QJsonObject partIndex();
+
+    /**
+     * @brief This function reads binary STL files from 1 MB up with the FastSTLReader and with vtkSTLReader.
+     * @return the figures of the scenario.
+     */
+    QJsonObject stlReaders();
+
+    /**
+     * @brief This function welds and adds normals to parts of 10,000 to 1,000,000 triangles with MeshPreparation and with VTK's filters.
+     * @return the figures of the scenario.
+     */
+    QJsonObject meshPreparation();
+
+    /**
+     * @brief This function builds a part tree of 100,000 parts, walks it, and adds a lazy folder of 50,000 files.
+     * It also checks the model with QAbstractItemModelTester.
+     * @return the figures of the scenario.
+     */
+    QJsonObject partTree();
+
+    /**
+     * @brief This function scans a generated folder tree through the DirectoryScanner, first only building the rows and then loading the files.
+     * @return the figures of the scenario.
+     */
+    QJsonObject directoryScan();
+
+    /**
+     * @brief This function opens a folder of 50,000 STL files into a tree view, the way Open Directory does, and times the first paint.
+     * @return the figures of the scenario.
+     */
+    QJsonObject largeFolder();
+
+    /**
+     * @brief This function loads large files through the STLLoader, with and without progressive loading.
+     * @return the figures of the scenario.
+     */
+    QJsonObject progressiveLoad();
+
+    /**
+     * @brief This function runs the ResidencyManager over in-memory parts with a budget half their size.
+     * @return the figures of the scenario.
+     */
+    QJsonObject residency();
+
+    /**
+     * @brief This function animates 10,000 parts with the Animator, checking that the poses do not depend on the frame times.
+     * @return the figures of the scenario.
+     */
+    QJsonObject animation();
+
+    /**
+     * @brief This function renders many copies of one part, as separate actors and then instanced.
+     * @return the figures of the scenario.
+     */
+    QJsonObject instancing();
+
+    /**
+     * @brief This function measures the memory of 200 parts each drawn by a desktop and a VR actor, the way the parts were drawn before PartGeometry and now.
+     * @return the figures of the scenario.
+     */
+    QJsonObject viewMemory();
+
+    /**
+     * @brief This function runs the VR thread on the loaded assembly with a simulated headset.
+     * @return the figures of the scenario.
+     */
+    QJsonObject vrFrames();
+
+    /**
+     * @brief This function clips and shrinks one large part through the FilterPipeline, with and without cached stages.
+     * @return the figures of the scenario.
+     */
+    QJsonObject filters();
+
+    /**
+     * @brief This function drags section planes through the loaded assembly, one render per step, then caps the cut parts.
+     * @return the figures of the scenario.
+     */
+    QJsonObject sections();
+
+    /**
+     * @brief This function saves the loaded assembly as a project in each geometry mode, opens it again and checks what came back.
+     * @return the figures of the scenario.
+     */
+    QJsonObject project();
+
+    /**
+     * @brief This function creates the offscreen render window on first use.
+     */
+    void createWindow();
+
+    /**
+     * @brief This function renders one frame and waits for it to finish.
+     * @return the time taken in milliseconds.
+     */
+    double renderFrame();
+
+    /**
+     * @brief This function makes sure the assembly is loaded, for scenarios run without the load scenario.
+     * @return false if the assembly could not be generated.
+     */
+    bool requireAssembly();
+
+    Options                             options;        /**< Sizes of the scenarios */
+    std::unique_ptr<QTemporaryDir>      temporary;      /**< Directory of the generated files when none was given */
+    QString                             directory;      /**< Directory of the generated files */
+    ModelPartList*                      model;          /**< Tree of the loaded assembly, nullptr until it is loaded */
+    STLLoader*                          loader;         /**< Loader of the assembly */
+    SceneSync*                          sync;           /**< Keeps the renderer in step with the tree */
+    vtkSmartPointer<vtkRenderWindow>    window;         /**< Offscreen render window */
+    vtkSmartPointer<vtkRenderer>        renderer;       /**< Renderer of the assembly */
+    QStringList                         failures;       /**< Checks that failed, such as a project that did not open as it was saved */
+};
+
+#endif
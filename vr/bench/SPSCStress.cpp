@@ -0,0 +1,106 @@
+/** @file SPSCStress.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Entry point of spsc_stress, a producer/consumer stress test of SPSCQueue meant to be built with ThreadSanitizer.
+  */
+
+#include "SPSCQueue.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+
+/* Elements pushed through each queue unless a count is given */
+const uint64_t DEFAULT_COUNT = 2000000;
+
+/**
+ * @struct Record
+ * @brief The Record structure is a plain element, like the frame samples of FrameStats.
+ */
+struct Record {
+    uint64_t    sequence = 0;   /**< Position in the stream */
+    uint64_t    check = 0;      /**< Derived from the sequence, a torn element does not match */
+};
+
+/**
+ * @brief This function pushes count elements from one thread and pops them on another, checking each arrives once and in order.
+ * The producer and the consumer spin when the queue is full or empty, so a small capacity makes
+ * them meet at both ends all the time.
+ * @param name is the name of the run, for the report.
+ * @param count is the number of elements.
+ * @param make makes the element for a sequence number.
+ * @param sequence returns the sequence number of an element, or a different number if it is damaged.
+ * @return true if every element arrived intact and in order.
+ */
+template <typename T, size_t Capacity, typename Make, typename Sequence>
+bool stress(const char* name, uint64_t count, Make make, Sequence sequence) {
+    SPSCQueue<T, Capacity> queue;
+    std::thread producer([&queue, count, &make]() {
+        /* push() takes the element by value, so it is made again for every attempt */
+        for (uint64_t i = 0; i < count; i++) {
+            while (!queue.push(make(i)))
+                std::this_thread::yield();
+        }
+    });
+
+    uint64_t errors = 0;
+    uint64_t expected = 0;
+    while (expected < count) {
+        T value;
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (sequence(value) != expected)
+            errors++;
+        expected++;
+    }
+    producer.join();
+
+    if (queue.size() != 0)
+        errors++;
+
+    std::printf("%s: %llu elements through %zu slots, %llu errors\n", name, (unsigned long long)count, Capacity,
+                (unsigned long long)errors);
+    return errors == 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_COUNT;
+    if (count == 0) {
+        std::fprintf(stderr, "Usage: spsc_stress [elements]\n");
+        return 1;
+    }
+
+    bool ok = true;
+
+    /* Plain elements through a tiny queue, so it is full or empty most of the time */
+    ok = stress<Record, 4>("record", count, [](uint64_t i) {
+        return Record{ i, i * 0x9E3779B97F4A7C15ull };
+    }, [](const Record& record) {
+        return record.check == record.sequence * 0x9E3779B97F4A7C15ull ? record.sequence : ~record.sequence;
+    }) && ok;
+
+    /* Elements that own memory, which pop() moves out and resets in the slot */
+    ok = stress<std::unique_ptr<uint64_t>, 64>("owning", count, [](uint64_t i) {
+        return std::unique_ptr<uint64_t>(new uint64_t(i));
+    }, [](const std::unique_ptr<uint64_t>& value) {
+        return value != nullptr ? *value : ~uint64_t(0);
+    }) && ok;
+
+    /* Elements larger than a cache line, through a queue the size of the VR command queue */
+    ok = stress<std::string, 1024>("string", count, [](uint64_t i) {
+        return std::to_string(i) + std::string(64, 'x');
+    }, [](const std::string& value) {
+        return value.size() > 64 ? std::strtoull(value.c_str(), nullptr, 10) : ~uint64_t(0);
+    }) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+/** @file SyntheticAssembly.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Generates STL assemblies of a given size for the benchmarks.
+  */
+
+#include "SyntheticAssembly.h"
+#include "MeshPreparation.h"
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+
+namespace {
+
+/* Distance between the centres of neighbouring parts */
+const double SPACING = 10.;
+
+/* Binary STL layout */
+const int HEADER_SIZE = 80;
+const int RECORD_SIZE = 50;
+
+/* Triangles of each sphere of a large file */
+const int LARGE_CHUNK = 65536;
+
+}
+
+/**
+ * @brief This function returns the triangles of one part as a flat array of vertices.
+ * @param triangles is the number of triangles wanted, the sphere has at least this many.
+ * @param index is the grid cell of the part, which gives its position.
+ * @param spacing is the distance between grid cells, the sphere's diameter is 80% of it.
+ * @param grid is the number of cells along each side of the grid.
+ * @return x, y, z of the three vertices of each triangle.
+ */
+std::vector<float> SyntheticAssembly::sphere(int triangles, int index, double spacing, int grid) {
+    /* Two triangles per quad of a latitude/longitude grid, about twice as many segments as rings */
+    int rings = std::max(2, int(std::ceil(std::sqrt(std::max(triangles, 8) / 4.))));
+    int segments = std::max(3, int(std::ceil(std::max(triangles, 8) / (2. * rings))));
+
+    grid = std::max(grid, 1);
+    double centre[3] = {
+        spacing * double(index % grid),
+        spacing * double((index / grid) % grid),
+        spacing * double(index / (grid * grid))
+    };
+    double radius = 0.4 * spacing;
+
+    auto vertex = [&](int ring, int segment, float* out) {
+        double theta = vtkMath::Pi() * double(ring) / double(rings);
+        double phi = 2. * vtkMath::Pi() * double(segment % segments) / double(segments);
+        out[0] = float(centre[0] + radius * std::sin(theta) * std::cos(phi));
+        out[1] = float(centre[1] + radius * std::sin(theta) * std::sin(phi));
+        out[2] = float(centre[2] + radius * std::cos(theta));
+    };
+
+    std::vector<float> vertices;
+    vertices.reserve(size_t(rings) * size_t(segments) * 18);
+    for (int ring = 0; ring < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            float corners[4][3];
+            vertex(ring, segment, corners[0]);
+            vertex(ring + 1, segment, corners[1]);
+            vertex(ring + 1, segment + 1, corners[2]);
+            vertex(ring, segment + 1, corners[3]);
+
+            /* The quads touching the poles have one edge of zero length, only one of their triangles has an area */
+            const int order[6] = { 0, 1, 2, 0, 2, 3 };
+            for (int corner : order)
+                vertices.insert(vertices.end(), corners[corner], corners[corner] + 3);
+        }
+    }
+    return vertices;
+}
+
+/**
+ * @brief This function writes triangles to a binary STL file.
+ * @param fileName is the name of the file.
+ * @param vertices are x, y, z of the three vertices of each triangle.
+ * @return true if the file was written.
+ */
+bool SyntheticAssembly::writeSTL(const QString& fileName, const std::vector<float>& vertices) {
+    uint32_t triangles = uint32_t(vertices.size() / 9);
+
+    QByteArray data(HEADER_SIZE + 4 + RECORD_SIZE * int(triangles), '\0');
+    char* out = data.data();
+    std::memcpy(out, "vr_bench synthetic part", 23);
+    std::memcpy(out + HEADER_SIZE, &triangles, 4);
+
+    /* Normals are left at zero, the loader computes its own */
+    char* record = out + HEADER_SIZE + 4;
+    for (uint32_t i = 0; i < triangles; i++) {
+        std::memcpy(record + 12, vertices.data() + 9 * size_t(i), 36);
+        record += RECORD_SIZE;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write(data) == data.size();
+}
+
+/**
+ * @brief This function writes a binary STL file of about a given size, a row of spheres written a sphere at a time so the file is never held in memory.
+ * The spheres are a spacing apart along x, so no vertex is shared between them.
+ * @param fileName is the name of the file.
+ * @param bytes is the size wanted, the file is at most one triangle larger.
+ * @return true if the file was written.
+ */
+bool SyntheticAssembly::writeLargeSTL(const QString& fileName, qint64 bytes) {
+    qint64 total = std::max<qint64>(1, (bytes - HEADER_SIZE - 4 + RECORD_SIZE - 1) / RECORD_SIZE);
+    if (total > qint64(UINT32_MAX))
+        return false;
+    uint32_t triangles = uint32_t(total);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray header(HEADER_SIZE + 4, '\0');
+    std::memcpy(header.data(), "vr_bench synthetic part", 23);
+    std::memcpy(header.data() + HEADER_SIZE, &triangles, 4);
+    if (file.write(header) != header.size())
+        return false;
+
+    std::vector<float> vertices = sphere(LARGE_CHUNK, 0, SPACING, 1);
+    uint32_t sphereTriangles = uint32_t(vertices.size() / 9);
+    QByteArray records;
+    uint32_t written = 0;
+    for (int index = 0; written < triangles; index++) {
+        uint32_t count = std::min(sphereTriangles, triangles - written);
+        records.fill('\0', RECORD_SIZE * int(count));
+        char* record = records.data();
+        float shift = float(SPACING * index);
+        for (uint32_t i = 0; i < count; i++) {
+            float triangle[9];
+            std::memcpy(triangle, vertices.data() + 9 * size_t(i), 36);
+            triangle[0] += shift;
+            triangle[3] += shift;
+            triangle[6] += shift;
+            std::memcpy(record + 12, triangle, 36);
+            record += RECORD_SIZE;
+        }
+        if (file.write(records) != records.size())
+            return false;
+        written += count;
+    }
+    return true;
+}
+
+/**
+ * @brief This function writes a whole assembly to a directory.
+ * The distinct parts come first, the copies after them repeat the distinct parts in turn.
+ * @param directory is the directory, it must exist.
+ * @param parts is the number of parts.
+ * @param triangles is the number of triangles of each part.
+ * @param copyFraction is the fraction of parts that are copies of another part, from 0 to 1.
+ * @return the file of each part, empty if a file could not be written.
+ */
+QStringList SyntheticAssembly::write(const QString& directory, int parts, int triangles, double copyFraction) {
+    QStringList fileNames;
+    int distinct = std::max(1, int(std::lround(double(parts) * (1. - std::min(std::max(copyFraction, 0.), 1.)))));
+    int grid = gridSize(distinct);
+
+    QDir dir(directory);
+    std::vector<float> vertices;
+    for (int i = 0; i < parts; i++) {
+        QString fileName = dir.filePath(QString("part_%1.stl").arg(i, 6, 10, QChar('0')));
+
+        /* A copy has the same contents as the distinct part it repeats, so it also sits in the same place */
+        int shape = i < distinct ? i : (i - distinct) % distinct;
+        vertices = sphere(triangles, shape, SPACING, grid);
+        if (!writeSTL(fileName, vertices))
+            return QStringList();
+
+        fileNames.append(fileName);
+    }
+    return fileNames;
+}
+
+/**
+ * @brief This function makes one part in memory, prepared the same way the loader prepares files.
+ * @param triangles is the number of triangles wanted.
+ * @param index is the grid cell of the part.
+ * @param grid is the number of cells along each side of the grid.
+ * @return the welded geometry with point normals.
+ */
+vtkSmartPointer<vtkPolyData> SyntheticAssembly::createPart(int triangles, int index, int grid) {
+    return MeshPreparation::prepare(createTriangles(triangles, index, grid));
+}
+
+/**
+ * @brief This function makes one part in memory as unwelded triangles, as the loader reads them from a file.
+ * @param triangles is the number of triangles wanted.
+ * @param index is the grid cell of the part.
+ * @param grid is the number of cells along each side of the grid.
+ * @return three vertices of its own for every triangle, without normals.
+ */
+vtkSmartPointer<vtkPolyData> SyntheticAssembly::createTriangles(int triangles, int index, int grid) {
+    std::vector<float> vertices = sphere(triangles, index, SPACING, grid);
+    vtkIdType count = vtkIdType(vertices.size() / 3);
+
+    vtkNew<vtkPoints> points;
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(count);
+    for (vtkIdType i = 0; i < count; i++)
+        points->SetPoint(i, vertices[size_t(3 * i)], vertices[size_t(3 * i + 1)], vertices[size_t(3 * i + 2)]);
+
+    vtkNew<vtkCellArray> polys;
+    polys->AllocateExact(count / 3, count);
+    for (vtkIdType i = 0; i < count; i += 3) {
+        vtkIdType triangle[3] = { i, i + 1, i + 2 };
+        polys->InsertNextCell(3, triangle);
+    }
+
+    vtkSmartPointer<vtkPolyData> raw = vtkSmartPointer<vtkPolyData>::New();
+    raw->SetPoints(points);
+    raw->SetPolys(polys);
+    return raw;
+}
+
+/**
+ * @brief This function returns the number of cells along each side of a grid that holds a number of parts.
+ * @param parts is the number of parts.
+ * @return the number of cells per side.
+ */
+int SyntheticAssembly::gridSize(int parts) {
+    int grid = 1;
+    while (grid * grid * grid < parts)
+        grid++;
+    return grid;
+}
+
+/**
+ * @brief This function returns the distance between grid cells used by write() and createPart().
+ * @return the spacing.
+ */
+double SyntheticAssembly::spacing() {
+    return SPACING;
+}
@@ -0,0 +1,96 @@
+/** @file SyntheticAssembly.h
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Generates STL assemblies of a given size for the benchmarks.
+  */
+
+#ifndef VIEWER_SYNTHETICASSEMBLY_H
+#define VIEWER_SYNTHETICASSEMBLY_H
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @class SyntheticAssembly
+ * @brief The SyntheticAssembly class makes repeatable test parts: tessellated spheres laid out on a grid.
+ *
+ * Every part is a sphere with the number of triangles asked for, placed in its own cell of a cubic
+ * grid so the parts do not overlap and the assembly fills the view. A fraction of the parts can be
+ * made exact copies of others (byte-identical files), which the loader shares and the views
+ * instance. The same arguments always give the same files.
+ */
+class SyntheticAssembly {
+public:
+    /**
+     * @brief This function returns the triangles of one part as a flat array of vertices.
+     * @param triangles is the number of triangles wanted, the sphere has at least this many.
+     * @param index is the grid cell of the part, which gives its position.
+     * @param spacing is the distance between grid cells, the sphere's diameter is 80% of it.
+     * @param grid is the number of cells along each side of the grid.
+     * @return x, y, z of the three vertices of each triangle.
+     */
+    static std::vector<float> sphere(int triangles, int index, double spacing, int grid);
+
+    /**
+     * @brief This function writes triangles to a binary STL file.
+     * @param fileName is the name of the file.
+     * @param vertices are x, y, z of the three vertices of each triangle.
+     * @return true if the file was written.
+     */
+    static bool writeSTL(const QString& fileName, const std::vector<float>& vertices);
+
+    /**
+     * @brief This function writes a binary STL file of about a given size, a row of spheres written a sphere at a time so the file is never held in memory.
+     * @param fileName is the name of the file.
+     * @param bytes is the size wanted, the file is at most one triangle larger.
+     * @return true if the file was written.
+     */
+    static bool writeLargeSTL(const QString& fileName, qint64 bytes);
+
+    /**
+     * @brief This function writes a whole assembly to a directory.
+     * @param directory is the directory, it must exist.
+     * @param parts is the number of parts.
+     * @param triangles is the number of triangles of each part.
+     * @param copyFraction is the fraction of parts that are copies of another part, from 0 to 1.
+     * @return the file of each part, empty if a file could not be written.
+     */
+    static QStringList write(const QString& directory, int parts, int triangles, double copyFraction);
+
+    /**
+     * @brief This function makes one part in memory, prepared the same way the loader prepares files.
+     * @param triangles is the number of triangles wanted.
+     * @param index is the grid cell of the part.
+     * @param grid is the number of cells along each side of the grid.
+     * @return the welded geometry with point normals.
+     */
+    static vtkSmartPointer<vtkPolyData> createPart(int triangles, int index = 0, int grid = 1);
+
+    /**
+     * @brief This function makes one part in memory as unwelded triangles, as the loader reads them from a file.
+     * @param triangles is the number of triangles wanted.
+     * @param index is the grid cell of the part.
+     * @param grid is the number of cells along each side of the grid.
+     * @return three vertices of its own for every triangle, without normals.
+     */
+    static vtkSmartPointer<vtkPolyData> createTriangles(int triangles, int index = 0, int grid = 1);
+
+    /**
+     * @brief This function returns the number of cells along each side of a grid that holds a number of parts.
+     * @param parts is the number of parts.
+     * @return the number of cells per side.
+     */
+    static int gridSize(int parts);
+
+    /**
+     * @brief This function returns the distance between grid cells used by write() and createPart().
+     * @return the spacing.
+     */
+    static double spacing();
+};
+
+#endif
@@ -0,0 +1,141 @@
+/** @file main.cpp
+  * @brief EEEE2076 - Software Engineering & VR Project
+  * Entry point of vr_bench, the headless benchmark of the load and render pipeline.
+  */
+
+#include "Benchmark.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    // The tree view of the large folder scenario is never shown on a screen
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("vr_bench");
+
+    Benchmark::Options options = Benchmark::defaults();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs scripted load and render scenarios offscreen and prints their timings as JSON.");
+    parser.addHelpOption();
+
+    QCommandLineOption partsOption("parts", "Parts in the synthetic assembly.", "count", QString::number(options.parts));
+    QCommandLineOption trianglesOption("triangles", "Triangles of each part.", "count", QString::number(options.triangles));
+    QCommandLineOption copiesOption("copies", "Fraction of the parts that are copies of another part.", "fraction",
+                                    QString::number(options.copies));
+    QCommandLineOption framesOption("frames", "Frames rendered while orbiting.", "count", QString::number(options.frames));
+    QCommandLineOption editsOption("edits", "Colour changes made.", "count", QString::number(options.edits));
+    QCommandLineOption instancesOption("instances", "Copies drawn by the instancing scenario.", "count",
+                                       QString::number(options.instances));
+    QCommandLineOption vrSecondsOption("vr-seconds", "Length of the simulated headset script.", "seconds",
+                                       QString::number(options.vrSeconds));
+    QCommandLineOption filterOption("filter-triangles", "Triangles of the part clipped and shrunk by the filter scenario.", "count",
+                                    QString::number(options.filterSize));
+    QCommandLineOption scanOption("scan-files", "STL files in the folder tree of the directory scan scenario.", "count",
+                                  QString::number(options.scanFiles));
+    QCommandLineOption progressiveOption("progressive-triangles", "Triangles of the largest file of the progressive load scenario.", "count",
+                                         QString::number(options.largeSize));
+    QCommandLineOption readerOption("reader-mb", "Size in MB of the largest file of the STL reader scenario.", "size",
+                                    QString::number(options.readerSize));
+    QCommandLineOption widthOption("width", "Width of the render window.", "pixels", QString::number(options.width));
+    QCommandLineOption heightOption("height", "Height of the render window.", "pixels", QString::number(options.height));
+    QCommandLineOption seedOption("seed", "Seed of the random choices.", "number", QString::number(options.seed));
+    QCommandLineOption directoryOption("directory", "Directory to generate the assembly in (kept afterwards).", "path");
+    QCommandLineOption scenarioOption("scenario", "Scenario to run, may be repeated or comma separated (default: all).", "name");
+    QCommandLineOption outputOption("output", "File to write the results to (default: standard output).", "file");
+    QCommandLineOption noRenderOption("no-render", "Skip the scenarios that need an OpenGL context.");
+    QCommandLineOption cacheOption("cache", "Let the loader use the geometry cache.");
+    QCommandLineOption listOption("list", "List the scenarios and exit.");
+
+    parser.addOptions({ partsOption, trianglesOption, copiesOption, framesOption, editsOption, instancesOption,
+                        vrSecondsOption, filterOption, scanOption, progressiveOption, readerOption,
+                        widthOption, heightOption, seedOption, directoryOption,
+                        scenarioOption, outputOption, noRenderOption, cacheOption, listOption });
+    parser.process(app);
+
+    if (parser.isSet(listOption)) {
+        QTextStream(stdout) << Benchmark::scenarios().join('\n') << '\n';
+        return 0;
+    }
+
+    /* Every number must parse and be positive, a typo should not quietly run a different benchmark */
+    bool valid = true;
+    auto positive = [&parser, &valid](const QCommandLineOption& option) {
+        bool ok = false;
+        int value = parser.value(option).toInt(&ok);
+        if (!ok || value <= 0) {
+            QTextStream(stderr) << "Invalid value for --" << option.names().first() << ": " << parser.value(option) << '\n';
+            valid = false;
+        }
+        return value;
+    };
+
+    options.parts = positive(partsOption);
+    options.triangles = positive(trianglesOption);
+    options.frames = positive(framesOption);
+    options.edits = positive(editsOption);
+    options.instances = positive(instancesOption);
+    options.filterSize = positive(filterOption);
+    options.scanFiles = positive(scanOption);
+    options.largeSize = positive(progressiveOption);
+    options.readerSize = positive(readerOption);
+    options.width = positive(widthOption);
+    options.height = positive(heightOption);
+    options.seed = unsigned(parser.value(seedOption).toUInt());
+    bool ok = false;
+    options.copies = parser.value(copiesOption).toDouble(&ok);
+    if (!ok || options.copies < 0. || options.copies > 1.) {
+        QTextStream(stderr) << "Invalid value for --copies: " << parser.value(copiesOption) << '\n';
+        valid = false;
+    }
+    options.vrSeconds = parser.value(vrSecondsOption).toDouble(&ok);
+    if (!ok || options.vrSeconds <= 0.) {
+        QTextStream(stderr) << "Invalid value for --vr-seconds: " << parser.value(vrSecondsOption) << '\n';
+        valid = false;
+    }
+    options.render = !parser.isSet(noRenderOption);
+    options.cache = parser.isSet(cacheOption);
+    options.directory = parser.value(directoryOption);
+
+    QStringList scenarios;
+    for (const QString& value : parser.values(scenarioOption))
+        scenarios.append(value.split(',', Qt::SkipEmptyParts));
+    for (const QString& name : scenarios) {
+        if (!Benchmark::scenarios().contains(name)) {
+            QTextStream(stderr) << "Unknown scenario: " << name << '\n';
+            valid = false;
+        }
+    }
+
+    if (!valid)
+        return 1;
+
+    Benchmark benchmark(options);
+    QByteArray json = QJsonDocument(benchmark.run(scenarios)).toJson(QJsonDocument::Indented);
+
+    if (!parser.isSet(outputOption)) {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    } else {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size()) {
+            QTextStream(stderr) << "Could not write " << output.fileName() << '\n';
+            return 1;
+        }
+    }
+
+    /* The figures are written either way, a failed check then fails the run so CI notices */
+    const QStringList failures = benchmark.failedChecks();
+    for (const QString& failure : failures)
+        QTextStream(stderr) << "Check failed: " << failure << '\n';
+    return failures.isEmpty() ? 0 : 2;
+}
@@ -1,12 +1,17 @@
 // Include the necessary libraries
 #include <vtkLight.h>
 #include "VRRenderThread.h"
+#include "OpenVRBackend.h"
+#include "SimulatedHMD.h"
 #include <QDebug>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QInputDialog>
 #include "optiondialog.h"
+#include "ProjectFile.h"
+#include "ShownPartDelegate.h"
 #include <vtkPlaneSource.h>
 #include <vtkTextureMapToPlane.h>
 #include <vtkTexture.h>
@@ -18,30 +23,43 @@
 #include <vtkImageReader2.h>
 #include <vtkSphereSource.h>
 #include <vtkTextureMapToSphere.h>
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+#include <vtkRenderWindowInteractor.h>
 
 // For color palette
 #include <QColorDialog>
 #include <QColor>
 #include <QPalette>
+#include <QSignalBlocker>
 
-//for filters
-/*
-#include <vtkProperty.h>
-#include <vtkPolyDataMapper.h>
-#include <vtkSmartPointer.h>
+#include <algorithm>
+#include <cstdlib>
 
-#include <vtkDataSetMapper.h>
-#include <vtkClipDataSet.h>
-#include <vtkShrinkFilter.h>
-#include <vtkPlane.h>
-#include <vtkActor.h>
-*/
+// For the frame stats panel
+#include <QFontDatabase>
+
+// For the section plane panel
+#include <QFormLayout>
+#include <QMenu>
+#include <QMenuBar>
 
 /**
  * @file mainwindow.h
  * @brief This file contains the declarations of all exported functions in vtk libraries.
  */
 
+namespace {
+
+// Folders with more STL files than this are added to the tree lazily
+const int LAZY_FOLDER_SIZE = 2000;
+
+// Memory the parts' geometry may use before the least important parts are swapped for proxies
+const size_t HOST_BUDGET = size_t(4) << 30;
+const size_t GPU_BUDGET = size_t(3) << 30;
+
+}
+
 /**
  * @class MainWindow
  * @brief The MainWindow class inherits from QMainWindow and represents the main window of the application.
@@ -51,6 +69,7 @@
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , vrThread(nullptr)
 {
     ui->setupUi(this);
 
@@ -71,13 +90,15 @@ MainWindow::MainWindow(QWidget *parent)
     // Initialises ModelPartList and link to treeView
     this->partList = new ModelPartList("PartsList");
     ui->treeView->setModel(this->partList);
+    // Parts are stamped and their geometry requested as the tree paints them
+    ui->treeView->setItemDelegate(new ShownPartDelegate(this->partList, ui->treeView));
     ModelPart *rootItem = this->partList->getRootItem();
 
     // Add top 3 level item
     for (int i = 0; i < 3; i++) {
         QString name = QString("TopLevel %1").arg(i);
         QString visible("true");
-        ModelPart *childItem = new ModelPart({name, visible});
+        ModelPart *childItem = new ModelPart({name, visible}, rootItem);
         rootItem->appendChild(childItem);
     }
 
@@ -92,6 +113,96 @@ MainWindow::MainWindow(QWidget *parent)
     light = vtkSmartPointer<vtkLight>::New();
     renderer->AddLight(light);
     light->SetIntensity(0.5);
+
+    // Scene follows the tree, only the parts that change are touched
+    sceneSync = new SceneSync(partList, renderer, this);
+
+    // Clicking a part in the view selects it in the tree, dragging still rotates the camera
+    pressPosition[0] = pressPosition[1] = 0;
+    vtkNew<vtkCallbackCommand> viewButton;
+    viewButton->SetCallback(MainWindow::handleViewButton);
+    viewButton->SetClientData(this);
+    renderWindow->GetInteractor()->AddObserver(vtkCommand::LeftButtonPressEvent, viewButton);
+    renderWindow->GetInteractor()->AddObserver(vtkCommand::LeftButtonReleaseEvent, viewButton);
+
+    // Clip and shrink filters run on worker threads, parts show the result once it is ready
+    filterPipeline = new FilterPipeline(partList, this);
+    connect(filterPipeline, &FilterPipeline::filtered, this, &MainWindow::updateVRPart);
+
+    // Background loader, files are read on worker threads and handed back here
+    loader = new STLLoader(this);
+    connect(loader, &STLLoader::partsPreviewed, this, &MainWindow::handlePartsPreviewed);
+    connect(loader, &STLLoader::partsLoaded, this, &MainWindow::handlePartsLoaded);
+    connect(partList, &ModelPartList::partsRequested, this, &MainWindow::handlePartsRequested);
+    connect(loader, &STLLoader::partsFailed, partList, &ModelPartList::requestFailed);
+    connect(loader, &STLLoader::levelsBuilt, this, &MainWindow::handlePartLoaded);
+    connect(loader, &STLLoader::progressChanged, this, &MainWindow::handleLoadProgress);
+    connect(loader, &STLLoader::finished, this, &MainWindow::handleLoadFinished);
+
+    // Directories are walked on worker threads, folders and files appear in the tree as they are found
+    scanner = new DirectoryScanner(partList, loader, this);
+    scanner->setLazyThreshold(LAZY_FOLDER_SIZE);
+    connect(scanner, &DirectoryScanner::progressChanged, this, &MainWindow::handleScanProgress);
+    connect(scanner, &DirectoryScanner::finished, this, &MainWindow::handleScanFinished);
+
+    // Geometry over budget is swapped for proxies, hidden, culled and small parts on screen first
+    residency = new ResidencyManager(partList, this);
+    residency->setBudget(HOST_BUDGET, GPU_BUDGET);
+    residency->setImportance([this](ModelPart* part) {
+        if (!part->visible()) {
+            return 0.;
+        }
+        // The VR session may see parts the desktop view culls
+        double size = sceneSync->screenSize(part);
+        if (vrThread != nullptr && vrThread->isRunning()) {
+            return std::max(size, 1.);
+        }
+        return size;
+    });
+    connect(residency, &ResidencyManager::geometryReplaced, this, &MainWindow::handleGeometryReplaced);
+    connect(residency, &ResidencyManager::reloadRequested, this, &MainWindow::handlePartsRequested);
+    connect(loader, &STLLoader::partsFailed, residency, &ResidencyManager::reloadFailed);
+    connect(residency, &ResidencyManager::countersChanged, this, &MainWindow::updateResidencyCounters);
+
+    // The camera moves without telling the tree, so importance is measured again every second
+    residencyTimer = new QTimer(this);
+    residencyTimer->setInterval(1000);
+    connect(residencyTimer, &QTimer::timeout, residency, &ResidencyManager::update);
+    residencyTimer->start();
+
+    residencyLabel = new QLabel(this);
+    ui->statusbar->addPermanentWidget(residencyLabel);
+
+    // Load progress and cancel button live in the status bar, hidden while idle
+    loadProgress = new QProgressBar(this);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->hide();
+    ui->statusbar->addPermanentWidget(loadProgress);
+
+    cancelLoad = new QToolButton(this);
+    cancelLoad->setText(tr("Cancel"));
+    cancelLoad->hide();
+    ui->statusbar->addPermanentWidget(cancelLoad);
+    connect(cancelLoad, &QToolButton::clicked, scanner, &DirectoryScanner::cancel);
+    connect(cancelLoad, &QToolButton::clicked, loader, &STLLoader::cancel);
+
+    // VR frame timings, shown once VR starts
+    frameStatsLabel = new QLabel(this);
+    frameStatsLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    frameStatsLabel->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+    frameStatsDock = new QDockWidget(tr("VR Frame Stats"), this);
+    frameStatsDock->setWidget(frameStatsLabel);
+    frameStatsDock->hide();
+    addDockWidget(Qt::RightDockWidgetArea, frameStatsDock);
+
+    frameStatsTimer = new QTimer(this);
+    frameStatsTimer->setInterval(500);
+    connect(frameStatsTimer, &QTimer::timeout, this, &MainWindow::updateFrameStats);
+
+    // Section planes cut the parts while drawing, the cut faces are computed once a plane stops moving
+    capper = new SectionCapper(partList, &sceneSync->sectionPlanes(), this);
+    connect(capper, &SectionCapper::capsChanged, this, &MainWindow::handleCapsChanged);
+    createSectionDock();
 }
 
 /**
@@ -99,6 +210,9 @@ MainWindow::MainWindow(QWidget *parent)
  */
 MainWindow::~MainWindow()
 {
+    // Stop the workers before the parts they are loading are destroyed, the scanner queues work on the loader
+    delete scanner;
+    delete loader;
     delete ui;
 }
 
@@ -144,7 +258,8 @@ void MainWindow::handleModelColorChange() {
     if (ColorValue.isValid()) {
         // You can set the color of the part using the color value obtained from the color dialog
         part->setColour(ColorValue.red(), ColorValue.green(), ColorValue.blue()); // Set RGB values
-        updateRender();
+        partList->updatePart(part);
+        updateVRPart(part);
         emit statusUpdateMessage(QString("Model Color Change accepted"), 0);
     } else {
         emit statusUpdateMessage(QString("Model Color Change rejected"), 0);
@@ -156,15 +271,37 @@ void MainWindow::handleModelColorChange() {
  */
 void MainWindow::handleStartVR() {
     vrThread = new VRRenderThread(this);
-    updateVRRenderFromTree(partList->index(0, 0, QModelIndex()));
+
+    // VR_SIMULATED_HMD runs the VR view without a headset, rendered offscreen and driven by a
+    // script (the file it names, or the built-in one), at the pace of a 90 Hz display
+    if (qEnvironmentVariableIsSet("VR_SIMULATED_HMD")) {
+        SimulatedHMD* hmd = new SimulatedHMD();
+        QString script = qEnvironmentVariable("VR_SIMULATED_HMD");
+        if (!script.isEmpty() && script != "1" && !hmd->loadScript(script)) {
+            emit statusUpdateMessage(QString("Could not read the VR script %1").arg(script), 0);
+        }
+        hmd->setPaced(true);
+        vrThread->setBackend(hmd);
+    } else {
+        vrThread->setBackend(new OpenVRBackend());
+    }
+
+    vrActors.clear();
+    connect(vrThread, &VRRenderThread::partPicked, this, &MainWindow::handleVRPartPicked);
+    // Every top level row, opened directories each add their own
+    updateVRRenderFromTree(QModelIndex());
+    sendSectionsToVR();
     vrThread->start();
     emit statusUpdateMessage(QString("VR LOADING.."), 0);
+
+    frameStatsDock->show();
+    frameStatsTimer->start();
 }
 
 /**
  * @brief This function updates the VR rendering from the tree.
  *
- * @param index is the index of the item in the tree view.
+ * @param index is the index of the item in the tree view, invalid for the whole tree.
  */
 void MainWindow::updateVRRenderFromTree(const QModelIndex& index) {
     if (index.isValid()) {
@@ -173,7 +310,8 @@ void MainWindow::updateVRRenderFromTree(const QModelIndex& index) {
         vtkSmartPointer<vtkActor> actor = selectedPart->getNewActor();
         if (actor != nullptr && selectedPart->visible()) {
             vrThread->addActorOffline(actor);
-
+            vrThread->setActorGeometry(actor, selectedPart->getDisplayGeometry());
+            vrActors.insert(selectedPart, actor);
         }
     }
 
@@ -187,6 +325,39 @@ void MainWindow::updateVRRenderFromTree(const QModelIndex& index) {
     }
 }
 
+/**
+ * @brief This function sends a part (when it is new), its colour and its visibility to the running VR session.
+ *
+ * @param part is the part that changed.
+ */
+void MainWindow::updateVRPart(ModelPart* part) {
+    if (vrThread == nullptr || !vrThread->isRunning()) {
+        return;
+    }
+
+    // Parts loaded after VR started are added to the live session
+    vtkSmartPointer<vtkActor> actor = vrActors.value(part);
+    if (actor == nullptr) {
+        actor = part->getNewActor();
+        if (actor == nullptr) {
+            return;
+        }
+        vrThread->addActor(actor);
+        vrActors.insert(part, actor);
+        vrThread->setActorCap(actor, capper->cap(part));
+    }
+
+    // VTK is not thread safe, so the VR actor is only changed by the VR thread through its queue.
+    // The geometry is sent every time in case it has gained levels of detail or been filtered, the VR thread ignores repeats.
+    vrThread->setActorGeometry(actor, part->getDisplayGeometry());
+
+    double colour[3] = { part->getColourR() / 255., part->getColourG() / 255., part->getColourB() / 255. };
+    vrThread->issueCommand(VRRenderThread::COLOUR, actor, colour, 3);
+
+    double visible = part->visible() ? 1. : 0.;
+    vrThread->issueCommand(VRRenderThread::VISIBILITY, actor, &visible, 1);
+}
+
 /**
  * @brief This function handles the action of clicking on an item in a tree view.
  */
@@ -196,10 +367,81 @@ void MainWindow::handleTreeClicked() {
     // Get name string from internal QVariant data array
     QString text = selectedPart->data(0).toString();
 
+    sceneSync->setHighlight(selectedPart);
+    showPartFilters(selectedPart);
+
     emit statusUpdateMessage(QString("The selected item is: ") + text, 0);
 }
 
 
+/**
+ * @brief This function makes a part the current item of the tree view and reports it in the status bar.
+ *
+ * @param part is the part to select.
+ */
+void MainWindow::selectPart(ModelPart* part) {
+    QModelIndex index = partList->indexOf(part);
+    if (!index.isValid()) {
+        return;
+    }
+
+    ui->treeView->setCurrentIndex(index);
+    ui->treeView->scrollTo(index);
+    handleTreeClicked();
+}
+
+/**
+ * @brief This function is the observer of left button presses and releases in the view, it picks the part clicked.
+ *
+ * @param caller is the view's interactor.
+ * @param eventId is the event observed.
+ * @param clientData is a pointer to the MainWindow.
+ * @param callData is unused.
+ */
+void MainWindow::handleViewButton(vtkObject* caller, unsigned long eventId, void* clientData, void* callData) {
+    Q_UNUSED(callData);
+    MainWindow* window = static_cast<MainWindow*>(clientData);
+    vtkRenderWindowInteractor* interactor = static_cast<vtkRenderWindowInteractor*>(caller);
+    int* position = interactor->GetEventPosition();
+
+    if (eventId == vtkCommand::LeftButtonPressEvent) {
+        window->pressPosition[0] = position[0];
+        window->pressPosition[1] = position[1];
+        return;
+    }
+
+    // A release far from the press ends a camera drag, not a click
+    const int clickTolerance = 3;
+    if (std::abs(position[0] - window->pressPosition[0]) > clickTolerance ||
+        std::abs(position[1] - window->pressPosition[1]) > clickTolerance) {
+        return;
+    }
+
+    ModelPart* part = window->sceneSync->pickAt(position[0], position[1]);
+    if (part == nullptr) {
+        window->sceneSync->setHighlight(nullptr);
+        window->ui->treeView->clearSelection();
+        window->ui->treeView->setCurrentIndex(QModelIndex());
+        return;
+    }
+    window->selectPart(part);
+}
+
+/**
+ * @brief This function selects the part whose VR actor was picked with a controller ray.
+ *
+ * @param actor is the VR actor that was picked.
+ */
+void MainWindow::handleVRPartPicked(vtkActor* actor) {
+    // The part may have been removed since the pick, so the actor is only compared, never used
+    for (auto it = vrActors.constBegin(); it != vrActors.constEnd(); ++it) {
+        if (it.value() == actor) {
+            selectPart(it.key());
+            return;
+        }
+    }
+}
+
 /**
  * @brief This function handles the action of opening one or multiple files.
  */
@@ -208,91 +450,76 @@ void MainWindow::on_actionOpen_File_triggered()
     // Emit status update message
     emit statusUpdateMessage(QString("Open File action triggered"), 0);
 
-    // Open file dialog to select one or multiple STL or TXT files
+    // Open file dialog to select one or multiple STL, project or TXT files
     QStringList fileNames = QFileDialog::getOpenFileNames(
         this,
         tr("Open File"),
         "C:\\",
-        tr("STL Files(*.stl);;Text Files(*.txt)")
+        tr("STL Files(*.stl);;Project Files(*.vrproj);;Text Files(*.txt)")
     );
 
+    // Projects bring their own rows, the other files get one row each
+    QStringList stlFiles;
+    for (const QString& fileName : fileNames) {
+        if (QFileInfo(fileName).suffix().compare("vrproj", Qt::CaseInsensitive) == 0) {
+            openProject(fileName);
+        }
+        else {
+            stlFiles.append(fileName);
+        }
+    }
+
     // If files are selected
-    if (!fileNames.isEmpty()) {
-        // For each selected file
-        for (const QString& fileName : fileNames) {
+    if (!stlFiles.isEmpty()) {
+        // One row per selected file, all inserted at once under the current item
+        QList<QList<QVariant>> rows;
+        for (const QString& fileName : stlFiles) {
             // Emit status update message
             emit statusUpdateMessage(QString("File " + fileName + " was opened"), 0);
 
             // Get file info
             QFileInfo fileInfo(fileName);
+            rows.append({ fileInfo.fileName(), QString("true") });
+        }
 
-            // Get current index in the tree view
-            QModelIndex index = ui->treeView->currentIndex();
-            // Append child to the part list
-            QModelIndex part = partList->appendChild(index, { fileInfo.fileName(), QString("true") });
+        // Append children to the part list
+        QList<ModelPart*> parts = partList->appendChildren(ui->treeView->currentIndex(), rows);
 
-            // Get pointer to the model part
-            ModelPart* viewPart = static_cast<ModelPart*>(part.internalPointer());
-            // Load STL file
-            viewPart->loadSTL(fileName);
+        // Load STL files in the background, the rows stay as placeholders until they are read
+        for (int i = 0; i < parts.size(); i++) {
+            parts[i]->setFileName(stlFiles[i]);
+            loader->load(parts[i], stlFiles[i]);
         }
-
-        // Update render
-        updateRender();
     }
 }
 
 /**
- * @brief This function updates the render from the tree view.
+ * @brief This function adds the parts of a project file under the current item, their geometry is mapped in the background.
  *
- * @param index is the index of the item in the tree view.
+ * @param fileName is the name of the project file.
  */
-void MainWindow::updateRenderFromTree( const QModelIndex& index ) {
-    // If index is valid
-    if (index.isValid()) {
-        // Get pointer to the selected model part
-        ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
-
-        // Get actor of the selected model part
-        vtkSmartPointer<vtkActor> actor = selectedPart->getActor();
-        // If actor is not null and selected part is visible
-        if (actor != nullptr && selectedPart->visible()) {
-            // Add actor to the renderer
-            renderer->AddActor(actor);
-        }
-    }
-
-    // If part list has no children or index flags indicate that item never has children
-    if (!partList->hasChildren(index) || (index.flags() & Qt::ItemNeverHasChildren)) {
+void MainWindow::openProject(const QString& fileName) {
+    QString error;
+    if (!ProjectFile::open(fileName, partList, ui->treeView->currentIndex(), loader, &error)) {
+        emit statusUpdateMessage("Error: " + error, 1);
         return;
     }
 
-    // Get row count of the part list
-    int rows = partList->rowCount(index);
-    // For each row
-    for (int i = 0; i < rows; i++) {
-        // Update render from the tree
-        updateRenderFromTree(partList->index(i, 0, index));
-    }
+    // The rows are shown now, the loader reports the progress of the geometry
+    emit statusUpdateMessage("Project " + fileName + " was opened", 0);
 }
 
 /**
- * @brief This function updates the render.
+ * @brief This function rebuilds the part actors in the scene from the whole tree and fits the camera.
  */
 void MainWindow::updateRender() {
-    // Remove all view props from the renderer
-    renderer->RemoveAllViewProps();
-    // For each row in the part list
-    for (int i = 0; i < partList->rowCount(QModelIndex()); i++){
-        // Update render from the tree
-        updateRenderFromTree(partList->index(i, 0, QModelIndex()));
-    }
-    // Render
-    renderer->Render();
+    // Re-add every part actor, other props (e.g. the background) are left alone
+    sceneSync->rebuild();
 
     // Reset camera and camera clipping range
     renderer->ResetCamera();
     renderer->ResetCameraClippingRange();
+    renderWindow->Render();
 }
 
 /**
@@ -338,8 +565,9 @@ void MainWindow::on_actionItem_Options_triggered() {
         // Set visibility to the part
         part->setVisible(colour.isVisible);
 
-        // Update render
-        //updateRender();
+        // Update the tree and the part's actors
+        partList->updatePart(part);
+        updateVRPart(part);
         // Emit status update message
         emit statusUpdateMessage(QString("Dialog accepted"), 0);
     }
@@ -356,24 +584,42 @@ void MainWindow::on_actionSave_triggered()
 {
     // Emit status update message
     emit statusUpdateMessage("Save As action Triggered", 0);
-    // Open save file dialog to select a STL or TXT file
-    QString fileName = QFileDialog::getSaveFileName(this, tr("Save As"), "C:\\", tr("STL Files(*.stl);;Text Files(*.txt)"));
+    // Open save file dialog to select a project file
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save As"), "C:\\", tr("Project Files(*.vrproj)"));
     // If file name is not empty
-    if (!fileName.isEmpty()) {
-        // Saving logic
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (QFileInfo(fileName).suffix().isEmpty()) {
+        fileName += ".vrproj";
+    }
+
+    // Stored geometry makes the project open without reading the STL files again
+    QStringList choices = {
+        tr("Parts and geometry"),
+        tr("Parts and compact geometry (16-bit positions)"),
+        tr("Parts only (geometry read from the STL files when opened)")
+    };
+    bool ok = false;
+    QString choice = QInputDialog::getItem(this, tr("Save As"), tr("Save:"), choices, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    ProjectFile::Geometry geometry = choice == choices[0] ? ProjectFile::FULL_GEOMETRY
+        : choice == choices[1] ? ProjectFile::QUANTIZED_GEOMETRY : ProjectFile::NO_GEOMETRY;
+
+    // Parts showing a preview or a proxy are saved without geometry, the project reads their STL files instead
+    QString error;
+    bool saved = ProjectFile::save(fileName, partList, geometry, [this](ModelPart* part) {
+        return !loader->isPreview(part) && !residency->isProxy(part);
+    }, &error);
+
+    if (saved) {
         emit statusUpdateMessage("File " + fileName + " was saved", 0);
-        // Open file for writing
-        QFile file(fileName);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            // Write to the file
-            QTextStream out(&file);
-            out << "test";
-            file.close();
-        }
-        else {
-            // Handle error if cannot open file for writing
-            emit statusUpdateMessage("Error: Couldn't save the file", 1);
-        }
+    }
+    else {
+        // Handle error if the project could not be written
+        emit statusUpdateMessage("Error: " + error, 1);
     }
 }
 
@@ -398,32 +644,238 @@ void MainWindow::on_actionOpen_Directory_triggered()
         // Emit status update message
         emit statusUpdateMessage("Directory " + directory + " was opened", 0);
 
-        // Open directory
-        QDir dir(directory);
-        // Set filters to select STL files
-        QStringList filters;
-        filters << "*.stl"; // Add more extensions if needed
+        // Walk the directory and its subfolders in the background, each folder becomes a row of the tree
+        scanner->scan(directory, ui->treeView->currentIndex());
+    }
+}
 
-        // Get list of files in the directory
-        QStringList fileList = dir.entryList(filters, QDir::Files);
+/**
+ * @brief This function tells the tree (and so the scene) that the background loader has read a part's geometry
+ * or built its levels of detail.
+ *
+ * @param part is the part that was loaded.
+ */
+void MainWindow::handlePartLoaded(ModelPart* part) {
+    // The part now has an actor, SceneSync adds it to the scene
+    partList->updatePart(part);
+    updateVRPart(part);
+}
 
-        // For each file in the list
-        foreach(QString fileName, fileList) {
-            // Get file path
-            QString filePath = dir.filePath(fileName);
+/**
+ * @brief This function tells the tree (and so the scene) that the background loader has read the geometry of several parts.
+ *
+ * @param parts are the parts that were loaded.
+ */
+void MainWindow::handlePartsLoaded(const QList<ModelPart*>& parts) {
+    // The tree announces neighbouring rows together once the scope ends
+    ModelPartList::DeferredUpdates deferred(partList);
+    for (ModelPart* part : parts) {
+        // A reloaded part's VR actor still renders its proxy, a part whose file turned out unreadable its preview
+        if (residency->isProxy(part) || part->getGeometry() == nullptr) {
+            releaseVRActor(part);
+        }
+        handlePartLoaded(part);
+    }
 
-            // Add file to the tree view
-            QModelIndex index = ui->treeView->currentIndex();
-            QModelIndex part = partList->appendChild(index, { fileName, QString("true") });
+    residency->update();
+}
 
-            // Get pointer to the model part
-            ModelPart* viewPart = static_cast<ModelPart*>(part.internalPointer());
-            // Load STL file
-            viewPart->loadSTL(filePath);
-        }
+/**
+ * @brief This function shows the previews of large parts that are still being read.
+ *
+ * @param parts are the parts given a preview.
+ */
+void MainWindow::handlePartsPreviewed(const QList<ModelPart*>& parts) {
+    // Previews are swapped for the full geometry in place, the VR actors only change what they draw
+    ModelPartList::DeferredUpdates deferred(partList);
+    for (ModelPart* part : parts) {
+        handlePartLoaded(part);
+    }
+}
 
-        // Update render
-        updateRender();
+/**
+ * @brief This function gives the VR session new actors for parts whose geometry was swapped for a proxy.
+ *
+ * @param parts are the parts.
+ */
+void MainWindow::handleGeometryReplaced(const QList<ModelPart*>& parts) {
+    for (ModelPart* part : parts) {
+        releaseVRActor(part);
+        updateVRPart(part);
+    }
+}
+
+/**
+ * @brief This function removes a part's actor from the VR session, if it has one.
+ *
+ * @param part is the part.
+ */
+void MainWindow::releaseVRActor(ModelPart* part) {
+    vtkSmartPointer<vtkActor> actor = vrActors.take(part);
+    if (actor != nullptr && vrThread != nullptr) {
+        vrThread->removeActor(actor);
+    }
+}
+
+/**
+ * @brief This function shows the geometry memory and the number of proxy parts in the status bar.
+ */
+void MainWindow::updateResidencyCounters() {
+    const ResidencyManager::Counters& counters = residency->counters();
+    auto megabytes = [](size_t bytes) { return QString::number(bytes / 1048576.0, 'f', 0); };
+    auto budget = [&megabytes](size_t bytes) { return bytes > 0 ? megabytes(bytes) : QString("-"); };
+
+    residencyLabel->setText(QString("Geometry %1/%2 MB, GPU %3/%4 MB, %5 full, %6 proxies")
+                            .arg(megabytes(counters.hostBytes), budget(counters.hostBudget))
+                            .arg(megabytes(counters.gpuBytes), budget(counters.gpuBudget))
+                            .arg(counters.fullParts).arg(counters.proxyParts));
+    residencyLabel->setToolTip(QString("%1 parts evicted and %2 reloaded so far")
+                               .arg(counters.evictions).arg(counters.reloads));
+}
+
+/**
+ * @brief This function handles the action of setting the geometry memory budget.
+ */
+void MainWindow::on_actionGeometry_Budget_triggered() {
+    const ResidencyManager::Counters& counters = residency->counters();
+
+    bool ok = false;
+    int hostMegabytes = QInputDialog::getInt(this, tr("Geometry Budget"), tr("Host memory for geometry in MB (0 for no limit):"),
+                                             int(counters.hostBudget >> 20), 0, 1 << 20, 256, &ok);
+    if (!ok) {
+        return;
+    }
+    int gpuMegabytes = QInputDialog::getInt(this, tr("Geometry Budget"), tr("GPU memory for geometry in MB (0 for no limit):"),
+                                            int(counters.gpuBudget >> 20), 0, 1 << 20, 256, &ok);
+    if (!ok) {
+        return;
+    }
+
+    residency->setBudget(size_t(hostMegabytes) << 20, size_t(gpuMegabytes) << 20);
+    residency->update();
+    emit statusUpdateMessage(QString("Geometry budget set to %1 MB host, %2 MB GPU").arg(hostMegabytes).arg(gpuMegabytes), 0);
+}
+
+/**
+ * @brief This function reads the geometry of parts that the tree has shown and that load on demand.
+ *
+ * @param parts are the parts to read.
+ */
+void MainWindow::handlePartsRequested(const QList<ModelPart*>& parts) {
+    for (ModelPart* part : parts) {
+        loader->load(part, part->getFileName());
+    }
+}
+
+/**
+ * @brief This function updates the load progress shown in the status bar.
+ *
+ * @param done is the number of files that have been read.
+ * @param total is the number of files being read.
+ */
+void MainWindow::handleLoadProgress(int done, int total) {
+    loadProgress->setRange(0, total);
+    loadProgress->setValue(done);
+    loadProgress->show();
+    cancelLoad->show();
+
+    emit statusUpdateMessage(QString("Loading %1 of %2 files").arg(done).arg(total), 0);
+}
+
+/**
+ * @brief This function hides the load progress once all files have been read.
+ */
+void MainWindow::handleLoadFinished() {
+    loadProgress->hide();
+    // A scan still running may queue more files
+    if (!scanner->isBusy()) {
+        cancelLoad->hide();
+    }
+
+    size_t hostBytes, gpuBytes;
+    partList->memoryUsage(hostBytes, gpuBytes);
+    emit statusUpdateMessage(QString("Loading finished, geometry uses %1 MB (%2 MB GPU)")
+                             .arg(hostBytes / 1048576.0, 0, 'f', 1).arg(gpuBytes / 1048576.0, 0, 'f', 1), 0);
+}
+
+/**
+ * @brief This function shows how far the directory scan has got in the status bar.
+ *
+ * @param folders is the number of folders listed so far.
+ * @param files is the number of STL files found so far.
+ */
+void MainWindow::handleScanProgress(int folders, int files) {
+    cancelLoad->show();
+
+    emit statusUpdateMessage(QString("Scanning, %1 files found in %2 folders").arg(files).arg(folders), 0);
+}
+
+/**
+ * @brief This function hides the cancel button once the scan has finished, unless files are still being read.
+ */
+void MainWindow::handleScanFinished() {
+    if (!loader->isBusy()) {
+        cancelLoad->hide();
+    }
+}
+
+/**
+ * @brief This function collects the VR frame timings and shows them in the frame stats panel.
+ */
+void MainWindow::updateFrameStats() {
+    if (vrThread == nullptr) {
+        return;
+    }
+
+    // Keep the trace moving even if nobody saves it, the VR thread's queue is only 4096 frames long
+    FrameStats& stats = vrThread->frameStats();
+    stats.collect();
+
+    quint64 frames = stats.frameCount();
+    QString text = QString("Frames  %1\nDropped %2 (%3%)\n\n%4 %5 %6 %7 %8\n")
+                       .arg(frames)
+                       .arg(stats.droppedFrames())
+                       .arg(frames > 0 ? 100.0 * stats.droppedFrames() / frames : 0.0, 0, 'f', 1)
+                       .arg(QString("ms"), -10).arg(QString("mean"), 7).arg(QString("p50"), 7).arg(QString("p95"), 7).arg(QString("p99"), 7);
+
+    for (int phase = 0; phase < FrameStats::PHASE_COUNT; phase++) {
+        FrameStats::Phase p = FrameStats::Phase(phase);
+        text += QString("%1 %2 %3 %4 %5\n")
+                    .arg(QString(FrameStats::phaseName(p)), -10)
+                    .arg(stats.mean(p), 7, 'f', 2)
+                    .arg(stats.percentile(p, 50.), 7, 'f', 2)
+                    .arg(stats.percentile(p, 95.), 7, 'f', 2)
+                    .arg(stats.percentile(p, 99.), 7, 'f', 2);
+    }
+    frameStatsLabel->setText(text);
+
+    // Stop refreshing once the session has ended, the last figures stay on screen
+    if (!vrThread->isRunning()) {
+        frameStatsTimer->stop();
+    }
+}
+
+/**
+ * @brief This function handles the action of saving the VR frame timings to a CSV or JSON file.
+ */
+void MainWindow::on_actionSave_Frame_Trace_triggered() {
+    if (vrThread == nullptr) {
+        emit statusUpdateMessage(QString("No VR session has been started"), 0);
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save VR Frame Trace"), "",
+                                                    tr("CSV Files(*.csv);;JSON Files(*.json)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    vrThread->frameStats().collect();
+    if (vrThread->frameStats().saveTrace(fileName)) {
+        emit statusUpdateMessage("Frame trace saved to " + fileName, 0);
+    }
+    else {
+        emit statusUpdateMessage("Error: Couldn't save the frame trace", 0);
     }
 }
 
@@ -498,8 +950,9 @@ void MainWindow::changeBackground() {
         // Rotate the sphere 180 degrees around the y-axis
         sphereActor->RotateY(180.0);
 
-        // Add the actor to the renderer
+        // Add the actor to the renderer, the section planes must not cut the background
         renderer->AddActor(sphereActor);
+        sceneSync->excludeFromSection(sphereActor);
 
         // Set the material properties of the sphere actor to not receive lighting
         vtkSmartPointer<vtkProperty> sphereProperty = sphereActor->GetProperty();
@@ -515,120 +968,189 @@ void MainWindow::changeBackground() {
     }
 }
 
-//for filters
-/*
-void MainWindow::on_checkBox_stateChanged(int arg1){
-    QModelIndex index = ui->treeView->currentIndex();
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
-    if(arg1){
-        emit statusUpdateMessage(QString("Clip filter applier"),0);
-        isClippingApplied = 1;
-        if (selectedPart != nullptr)
-            if (selectedPart->getSource()!=nullptr)
-                applyPartFilters();
+/**
+ * @brief This function handles ticking the shrink filter box.
+ *
+ * @param arg1 is the new state of the box.
+ */
+void MainWindow::on_checkBox_stateChanged(int arg1) {
+    emit statusUpdateMessage(arg1 ? QString("Shrink filter applied") : QString("Shrink filter removed"), 0);
+    applyPartFilters();
+}
+
+/**
+ * @brief This function handles ticking the clip filter box.
+ *
+ * @param arg1 is the new state of the box.
+ */
+void MainWindow::on_checkBox_2_stateChanged(int arg1) {
+    emit statusUpdateMessage(arg1 ? QString("Clip filter applied") : QString("Clip filter removed"), 0);
+    applyPartFilters();
+}
+
+/**
+ * @brief This function applies the clip and shrink filters ticked in the window to the selected part and every part inside it.
+ */
+void MainWindow::applyPartFilters() {
+    ModelPart* selectedPart = static_cast<ModelPart*>(ui->treeView->currentIndex().internalPointer());
+    if (selectedPart == nullptr) {
+        emit statusUpdateMessage(QString("Select a part to filter"), 0);
+        return;
     }
-    else{
-        emit statusUpdateMessage(QString("Clip filter not applier"),0);
-        isClippingApplied = 0;
-        if (selectedPart != nullptr)
-            if (selectedPart->getSource()!=nullptr)
-                applyPartFilters();
+
+    // Only the filter flags change, each part keeps its plane and shrink factor
+    bool clip = ui->checkBox_2->isChecked();
+    bool shrink = ui->checkBox->isChecked();
+    QList<ModelPart*> parts = { selectedPart };
+    while (!parts.isEmpty()) {
+        ModelPart* part = parts.takeLast();
+        FilterPipeline::Settings settings = filterPipeline->filters(part);
+        settings.clip = clip;
+        settings.shrink = shrink;
+        filterPipeline->setFilters(part, settings);
+
+        for (int i = 0; i < part->childCount(); i++) {
+            parts.append(part->child(i));
+        }
     }
 }
 
+/**
+ * @brief This function ticks the filter boxes to match the filters of a part, without applying them again.
+ *
+ * @param part is the part.
+ */
+void MainWindow::showPartFilters(ModelPart* part) {
+    FilterPipeline::Settings settings = filterPipeline->filters(part);
+    QSignalBlocker shrinkBlocker(ui->checkBox);
+    QSignalBlocker clipBlocker(ui->checkBox_2);
+    ui->checkBox->setChecked(settings.shrink);
+    ui->checkBox_2->setChecked(settings.clip);
+}
 
-void MainWindow::on_checkBox_2_stateChanged(int arg1)
-{
-    QModelIndex index = ui->treeView->currentIndex();
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
-    if(arg1){
-        emit statusUpdateMessage(QString("Shrink filter applier"),0);
-        isShrinkApplied = 1;
-        if (selectedPart != nullptr)
-            if (selectedPart->getSource()!=nullptr)
-                applyPartFilters();
+/**
+ * @brief This function builds the section plane dock and the View menu that shows it.
+ */
+void MainWindow::createSectionDock() {
+    QWidget* panel = new QWidget(this);
+    QFormLayout* layout = new QFormLayout(panel);
+
+    sectionPlane = new QComboBox(panel);
+    for (int i = 0; i < SectionPlanes::MAX_PLANES; i++) {
+        sectionPlane->addItem(tr("Plane %1").arg(i + 1));
+    }
+    layout->addRow(tr("Plane"), sectionPlane);
+
+    sectionEnabled = new QCheckBox(tr("Enabled"), panel);
+    layout->addRow(sectionEnabled);
+
+    sectionAxis = new QComboBox(panel);
+    sectionAxis->addItems({ "X", "Y", "Z" });
+    layout->addRow(tr("Axis"), sectionAxis);
+
+    sectionFlip = new QCheckBox(tr("Keep the far side"), panel);
+    layout->addRow(sectionFlip);
+
+    sectionPosition = new QSlider(Qt::Horizontal, panel);
+    sectionPosition->setRange(0, 1000);
+    sectionPosition->setValue(500);
+    layout->addRow(tr("Position"), sectionPosition);
+
+    sectionCaps = new QCheckBox(tr("Cap cross-sections"), panel);
+    layout->addRow(sectionCaps);
+
+    sectionDock = new QDockWidget(tr("Section Planes"), this);
+    sectionDock->setWidget(panel);
+    sectionDock->hide();
+    addDockWidget(Qt::RightDockWidgetArea, sectionDock);
+
+    QMenu* viewMenu = ui->menubar->addMenu(tr("View"));
+    viewMenu->addAction(sectionDock->toggleViewAction());
+    viewMenu->addAction(frameStatsDock->toggleViewAction());
+
+    connect(sectionPlane, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::showSectionPlane);
+    connect(sectionEnabled, &QCheckBox::toggled, this, &MainWindow::applySectionPlane);
+    connect(sectionAxis, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::applySectionPlane);
+    connect(sectionFlip, &QCheckBox::toggled, this, &MainWindow::applySectionPlane);
+    connect(sectionPosition, &QSlider::valueChanged, this, &MainWindow::applySectionPlane);
+    connect(sectionCaps, &QCheckBox::toggled, capper, &SectionCapper::setEnabled);
+}
+
+/**
+ * @brief This function moves the section plane chosen in the section dock to match the dock's controls, in both views.
+ */
+void MainWindow::applySectionPlane() {
+    int index = sectionPlane->currentIndex();
+    SectionControl& control = sectionControls[index];
+    control.enabled = sectionEnabled->isChecked();
+    control.axis = sectionAxis->currentIndex();
+    control.flip = sectionFlip->isChecked();
+    control.position = sectionPosition->value();
+
+    // The slider spans the parts in the scene along the axis
+    double bounds[6] = { -1., 1., -1., 1., -1., 1. };
+    sceneSync->boundsIndex().getBounds(bounds);
+    double origin[3], normal[3] = { 0., 0., 0. };
+    for (int k = 0; k < 3; k++) {
+        origin[k] = 0.5 * (bounds[2 * k] + bounds[2 * k + 1]);
     }
-    else{
-        emit statusUpdateMessage(QString("Shrink filter not applier"),0);
-        if (selectedPart != nullptr)
-            if (selectedPart->getSource()!=nullptr)
-                applyPartFilters();
+    int axis = control.axis;
+    origin[axis] = bounds[2 * axis] + (bounds[2 * axis + 1] - bounds[2 * axis]) * control.position / 1000.;
+    normal[axis] = control.flip ? 1. : -1.;
+
+    sceneSync->setSectionPlane(index, control.enabled, origin, normal);
+    if (vrThread != nullptr && vrThread->isRunning()) {
+        vrThread->setSectionPlane(index, control.enabled, origin, normal);
     }
+    capper->schedule();
 }
 
-void MainWindow::applyPartFilters()
-{
-    vtkSmartPointer<vtkClipDataSet> clipFilter = vtkSmartPointer<vtkClipDataSet>::New();
-    vtkSmartPointer<vtkShrinkFilter> shrinkFilter = vtkSmartPointer<vtkShrinkFilter>::New();
+/**
+ * @brief This function sets the section dock's controls to match one plane, without moving it.
+ *
+ * @param index is the plane.
+ */
+void MainWindow::showSectionPlane(int index) {
+    const SectionControl& control = sectionControls[index];
+    QSignalBlocker enabledBlocker(sectionEnabled);
+    QSignalBlocker axisBlocker(sectionAxis);
+    QSignalBlocker flipBlocker(sectionFlip);
+    QSignalBlocker positionBlocker(sectionPosition);
+    sectionEnabled->setChecked(control.enabled);
+    sectionAxis->setCurrentIndex(control.axis);
+    sectionFlip->setChecked(control.flip);
+    sectionPosition->setValue(control.position);
+}
 
-    QModelIndex index = ui->treeView->currentIndex();
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
-    if (isClippingApplied && isShrinkApplied)
-    {
-        // This will apply a clipping plane whose normal is the x-axis that crosses the x-axis at x=0
-        vtkSmartPointer<vtkPlane> planeLeft = vtkSmartPointer<vtkPlane>::New();
-        planeLeft->SetOrigin(0.0, 0.0, 0.0);
-        planeLeft->SetNormal(-1.0, 0.0, 0.0);
-        //clipFilter = vtkSmartPointer<vtkClipDataSet>::New();
-        clipFilter->SetInputConnection(selectedPart->getSource()->GetOutputPort());
-        clipFilter->SetClipFunction(planeLeft.Get());
-
-        // Create a vtkShrinkFilter object
-        //shrinkFilter = vtkSmartPointer<vtkShrinkFilter>::New();
-        // Set the input connection for the shrink filter
-        shrinkFilter->SetInputConnection(clipFilter->GetOutputPort());
-        // Set the shrink factor (0.8 in this case, meaning 20% shrinkage)
-        shrinkFilter->SetShrinkFactor(0.8);
-        // Update the shrink filter to process the input data
-        shrinkFilter->Update();
-
-        selectedPart->getMapper()->SetInputConnection(shrinkFilter->GetOutputPort());
-    }
-    else if (isClippingApplied)
-    {
-        // This will apply a clipping plane whose normal is the x-axis that crosses the x-axis at x=0
-        vtkSmartPointer<vtkPlane> planeLeft = vtkSmartPointer<vtkPlane>::New();
-        planeLeft->SetOrigin(0.0, 0.0, 0.0);
-        planeLeft->SetNormal(-1.0, 0.0, 0.0);
-        //clipFilter = vtkSmartPointer<vtkClipDataSet>::New();
-        clipFilter->SetInputConnection(selectedPart->getSource()->GetOutputPort());
-        clipFilter->SetClipFunction(planeLeft.Get());
-        selectedPart->getMapper()->SetInputConnection(clipFilter->GetOutputPort());
-
-    }
-    else if (isShrinkApplied)
-    {
-        // Create a vtkShrinkFilter object
-        //shrinkFilter = vtkSmartPointer<vtkShrinkFilter>::New();
-        // Set the input connection for the shrink filter
-        shrinkFilter->SetInputConnection(selectedPart->getSource()->GetOutputPort());
-        // Set the shrink factor (0.8 in this case, meaning 20% shrinkage)
-        shrinkFilter->SetShrinkFactor(0.8);
-        // Update the shrink filter to process the input data
-        shrinkFilter->Update();
-
-        selectedPart->getMapper()->SetInputConnection(shrinkFilter->GetOutputPort());
-    }
-    else
-    {
-        selectedPart->getMapper()->SetInputConnection(selectedPart->getSource()->GetOutputPort());
-    }
-
-
-    selectedPart->getActor()->SetMapper(selectedPart->getMapper());
-    selectedPart->getActor()->GetProperty()->SetColor(1., 0., 0.35);
-    //renderer->AddActor(selectedPart->getActor());
-    renderer->RemoveAllViewProps();
-    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
-    actor->SetMapper(selectedPart->getMapper());
-    actor->GetProperty()->SetColor(1., 0., 0.35);
-    renderer->AddActor(actor);
-
-
-    //updateRender();
-
-
-    // updateRender();
-    renderer->GetRenderWindow()->Render();
-}
-*/
+/**
+ * @brief This function gives both views the new caps of parts.
+ *
+ * @param parts are the parts whose caps changed.
+ */
+void MainWindow::handleCapsChanged(const QList<ModelPart*>& parts) {
+    for (ModelPart* part : parts) {
+        std::shared_ptr<const PartGeometry> cap = capper->cap(part);
+        sceneSync->setCap(part, cap);
+
+        vtkSmartPointer<vtkActor> actor = vrActors.value(part);
+        if (actor != nullptr && vrThread != nullptr && vrThread->isRunning()) {
+            vrThread->setActorCap(actor, cap);
+        }
+    }
+}
+
+/**
+ * @brief This function sends every section plane and cap to the VR session.
+ */
+void MainWindow::sendSectionsToVR() {
+    const SectionPlanes& planes = sceneSync->sectionPlanes();
+    for (int i = 0; i < SectionPlanes::MAX_PLANES; i++) {
+        double origin[3], normal[3];
+        planes.getPlane(i, origin, normal);
+        vrThread->setSectionPlane(i, planes.isEnabled(i), origin, normal);
+    }
+
+    for (auto it = vrActors.constBegin(); it != vrActors.constEnd(); ++it) {
+        vrThread->setActorCap(it.value(), capper->cap(it.key()));
+    }
+}
@@ -4,6 +4,21 @@
 #include <QMainWindow>
 #include "ModelPartList.h"
 #include "VRRenderThread.h"
+#include "STLLoader.h"
+#include "DirectoryScanner.h"
+#include "SceneSync.h"
+#include "ResidencyManager.h"
+#include "FilterPipeline.h"
+#include "SectionCapper.h"
+
+#include <QProgressBar>
+#include <QToolButton>
+#include <QDockWidget>
+#include <QLabel>
+#include <QTimer>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSlider>
 
 #include <QVTKOpenGLNativeWidget.h>
 #include <vtkGenericOpenGLRenderWindow.h>
@@ -18,12 +33,6 @@
 #include <vtkProperty.h>
 #include <vtkLight.h>
 
-//For filters
-/*
-#include "ModelPart.h"
-#include <vtkDataSetMapper.h>
-*/
-
 /**
  * @file mainwindow.h
  * @brief This file contains the declarations of all exported functions in vtk libraries.
@@ -109,17 +118,11 @@ public slots:
     void on_actionOpen_Directory_triggered();
 
     /**
-     * @brief This function refreshes the rendering of the scene, clears existing view props and updates the scene.
+     * @brief This function rebuilds the part actors in the scene from the whole tree and fits the camera.
+     * Routine edits do not need this, the scene follows the tree through SceneSync.
      */
     void updateRender();
 
-    /**
-     * @brief This function recursively updates the rendering of the scene based on the hierarchical structure.
-     *
-     * @param index is the index of the item in the tree view.
-     */
-    void updateRenderFromTree(const QModelIndex& index);
-
     /**
      * @brief This function handles the light intensity options.
      *
@@ -135,13 +138,140 @@ public slots:
     /**
      * @brief This function updates the VR rendering from the tree.
      *
-     * @param index is the index of the item in the tree view.
+     * @param index is the index of the item in the tree view, invalid for the whole tree.
      */
     void updateVRRenderFromTree(const QModelIndex& index);
 
-    //for filters
-    //void applyPartFilters();
+    /**
+     * @brief This function sends a part (when it is new), its colour and its visibility to the running VR session.
+     *
+     * @param part is the part that changed.
+     */
+    void updateVRPart(ModelPart* part);
+
+    /**
+     * @brief This function tells the tree (and so the scene) that the background loader has read a part's geometry
+     * or built its levels of detail.
+     *
+     * @param part is the part that was loaded.
+     */
+    void handlePartLoaded(ModelPart* part);
 
+    /**
+     * @brief This function shows the previews of large parts that are still being read.
+     *
+     * @param parts are the parts given a preview.
+     */
+    void handlePartsPreviewed(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This function tells the tree (and so the scene) that the background loader has read the geometry of several parts.
+     *
+     * @param parts are the parts that were loaded.
+     */
+    void handlePartsLoaded(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This function reads the geometry of parts that the tree has shown and that load on demand.
+     *
+     * @param parts are the parts to read.
+     */
+    void handlePartsRequested(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This function gives the VR session new actors for parts whose geometry was swapped for a proxy.
+     *
+     * @param parts are the parts.
+     */
+    void handleGeometryReplaced(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief This function shows the geometry memory and the number of proxy parts in the status bar.
+     */
+    void updateResidencyCounters();
+
+    /**
+     * @brief This function updates the load progress shown in the status bar.
+     *
+     * @param done is the number of files that have been read.
+     * @param total is the number of files being read.
+     */
+    void handleLoadProgress(int done, int total);
+
+    /**
+     * @brief This function hides the load progress once all files have been read.
+     */
+    void handleLoadFinished();
+
+    /**
+     * @brief This function shows how far the directory scan has got in the status bar.
+     *
+     * @param folders is the number of folders listed so far.
+     * @param files is the number of STL files found so far.
+     */
+    void handleScanProgress(int folders, int files);
+
+    /**
+     * @brief This function hides the cancel button once the scan has finished, unless files are still being read.
+     */
+    void handleScanFinished();
+
+    /**
+     * @brief This function collects the VR frame timings and shows them in the frame stats panel.
+     */
+    void updateFrameStats();
+
+    /**
+     * @brief This function handles the action of saving the VR frame timings to a CSV or JSON file.
+     */
+    void on_actionSave_Frame_Trace_triggered();
+
+    /**
+     * @brief This function makes a part the current item of the tree view, expanding its parents, and reports it in the status bar.
+     *
+     * @param part is the part to select.
+     */
+    void selectPart(ModelPart* part);
+
+    /**
+     * @brief This function selects the part whose VR actor was picked with a controller ray.
+     *
+     * @param actor is the VR actor that was picked.
+     */
+    void handleVRPartPicked(vtkActor* actor);
+
+    /**
+     * @brief This function applies the clip and shrink filters ticked in the window to the selected part and every part inside it.
+     * The parts are filtered in the background and each shows its result once it is ready.
+     */
+    void applyPartFilters();
+
+    /**
+     * @brief This function ticks the filter boxes to match the filters of a part, without applying them again.
+     *
+     * @param part is the part.
+     */
+    void showPartFilters(ModelPart* part);
+
+    /**
+     * @brief This function moves the section plane chosen in the section dock to match the dock's controls, in both views.
+     * The plane is cut on the GPU while it moves, caps are computed once it stops.
+     */
+    void applySectionPlane();
+
+    /**
+     * @brief This function sets the section dock's controls to match one plane, without moving it.
+     *
+     * @param index is the plane.
+     */
+    void showSectionPlane(int index);
+
+    /**
+     * @brief This function gives both views the new caps of parts.
+     *
+     * @param parts are the parts whose caps changed.
+     */
+    void handleCapsChanged(const QList<ModelPart*>& parts);
 
 signals:
     /**
@@ -158,21 +288,31 @@ private slots:
      */
     void on_actionOpen_File_triggered();
 
-    //for filters
-    /*
+    /**
+     * @brief This function handles the action of setting the geometry memory budget.
+     */
+    void on_actionGeometry_Budget_triggered();
+
+    /**
+     * @brief This function handles ticking the shrink filter box.
+     *
+     * @param arg1 is the new state of the box.
+     */
     void on_checkBox_stateChanged(int arg1);
 
+    /**
+     * @brief This function handles ticking the clip filter box.
+     *
+     * @param arg1 is the new state of the box.
+     */
     void on_checkBox_2_stateChanged(int arg1);
-    */
+
 private:
     /**
      * @brief A pointer to the UI of the MainWindow class.
      */
     Ui::MainWindow* ui;
 
-    //for filters
-    //ModelPartList* partList;
-
     /**
      * @brief A smart pointer to the renderer.
      */
@@ -183,12 +323,6 @@ private:
      */
     vtkSmartPointer<vtkGenericOpenGLRenderWindow> renderWindow;
 
-    //for filters
-    /*
-    bool isClippingApplied;
-    bool isShrinkApplied;
-    */
-
     /**
      * @brief A smart pointer to the light.
      */
@@ -198,6 +332,166 @@ private:
      * @brief A pointer to the VR render thread.
      */
     VRRenderThread* vrThread;
+
+    /**
+     * @brief The VR actor of each part, used to address commands to the VR thread.
+     */
+    QHash<ModelPart*, vtkSmartPointer<vtkActor>> vrActors;
+
+    /**
+     * @brief A pointer to the object that keeps the renderer in step with the part tree.
+     */
+    SceneSync* sceneSync;
+
+    /**
+     * @brief A pointer to the background STL loader.
+     */
+    STLLoader* loader;
+
+    /**
+     * @brief A pointer to the background directory scanner.
+     */
+    DirectoryScanner* scanner;
+
+    /**
+     * @brief A pointer to the object that clips and shrinks parts in the background.
+     */
+    FilterPipeline* filterPipeline;
+
+    /**
+     * @brief A pointer to the load progress bar shown in the status bar.
+     */
+    QProgressBar* loadProgress;
+
+    /**
+     * @brief A pointer to the button that cancels loading, shown in the status bar.
+     */
+    QToolButton* cancelLoad;
+
+    /**
+     * @brief A pointer to the dock that shows the VR frame timings.
+     */
+    QDockWidget* frameStatsDock;
+
+    /**
+     * @brief A pointer to the label inside the frame stats dock.
+     */
+    QLabel* frameStatsLabel;
+
+    /**
+     * @brief A pointer to the timer that refreshes the frame stats panel while VR runs.
+     */
+    QTimer* frameStatsTimer;
+
+    /**
+     * @brief A pointer to the object that keeps the parts' geometry within the memory budget.
+     */
+    ResidencyManager* residency;
+
+    /**
+     * @brief A pointer to the timer that runs the residency manager.
+     */
+    QTimer* residencyTimer;
+
+    /**
+     * @brief A pointer to the label that shows the geometry memory in the status bar.
+     */
+    QLabel* residencyLabel;
+
+    /**
+     * @struct SectionControl
+     * @brief The SectionControl structure holds the section dock's controls for one plane.
+     */
+    struct SectionControl {
+        bool    enabled = false;        /**< True if the plane cuts the parts */
+        int     axis = 0;               /**< Axis the plane is normal to: 0 X, 1 Y, 2 Z */
+        bool    flip = false;           /**< True to keep the side above the plane rather than below */
+        int     position = 500;         /**< Position across the scene along the axis, 0 to 1000 */
+    };
+
+    /**
+     * @brief The section dock's controls for each plane.
+     */
+    SectionControl sectionControls[SectionPlanes::MAX_PLANES];
+
+    /**
+     * @brief A pointer to the object that computes the cut faces of the parts in the background.
+     */
+    SectionCapper* capper;
+
+    /**
+     * @brief A pointer to the dock that holds the section plane controls.
+     */
+    QDockWidget* sectionDock;
+
+    /**
+     * @brief A pointer to the box that chooses the plane the controls apply to.
+     */
+    QComboBox* sectionPlane;
+
+    /**
+     * @brief A pointer to the box that turns the chosen plane on.
+     */
+    QCheckBox* sectionEnabled;
+
+    /**
+     * @brief A pointer to the box that chooses the axis the plane is normal to.
+     */
+    QComboBox* sectionAxis;
+
+    /**
+     * @brief A pointer to the box that chooses which side of the plane is kept.
+     */
+    QCheckBox* sectionFlip;
+
+    /**
+     * @brief A pointer to the slider that moves the plane along its axis.
+     */
+    QSlider* sectionPosition;
+
+    /**
+     * @brief A pointer to the box that turns the cut faces on.
+     */
+    QCheckBox* sectionCaps;
+
+    /**
+     * @brief This function builds the section plane dock and the View menu that shows it.
+     */
+    void createSectionDock();
+
+    /**
+     * @brief This function sends every section plane and cap to the VR session.
+     */
+    void sendSectionsToVR();
+
+    /**
+     * @brief This function removes a part's actor from the VR session, if it has one.
+     *
+     * @param part is the part.
+     */
+    void releaseVRActor(ModelPart* part);
+
+    /**
+     * @brief This function adds the parts of a project file under the current item, their geometry is mapped in the background.
+     *
+     * @param fileName is the name of the project file.
+     */
+    void openProject(const QString& fileName);
+
+    /**
+     * @brief The display position of the last left button press in the view, a release close to it is a click.
+     */
+    int pressPosition[2];
+
+    /**
+     * @brief This function is the observer of left button presses and releases in the view, it picks the part clicked.
+     *
+     * @param caller is the view's interactor.
+     * @param eventId is the event observed.
+     * @param clientData is a pointer to the MainWindow.
+     * @param callData is unused.
+     */
+    static void handleViewButton(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
 };
 
 #endif // MAINWINDOW_H